@@ -63,6 +63,33 @@ PaAlsaStreamInfo;
 /** Initialize host API specific structure, call this before setting relevant attributes. */
 void PaAlsa_InitializeStreamInfo( PaAlsaStreamInfo *info );
 
+/** Host API specific stream info for capturing from several ALSA pcms as one input device.
+ *
+ * Pass it as the hostApiSpecificStreamInfo of the input parameters of a callback stream, with the device
+ * set to paUseHostApiSpecificDeviceSpecification and the channel count set to the sum of channelCounts.
+ * The stream's channels are those of each pcm in turn.
+ *
+ * The first pcm is the clock master, it is opened like a pcm named with PaAlsaStreamInfo. The others are
+ * resampled to follow it, adaptively tracking the drift of their clocks, so devices which aren't clocked
+ * together can be combined. Where the driver allows it the pcms are linked to start at the same sample,
+ * otherwise the first frames are aligned as the drift is tracked. The master is delayed by about one
+ * period so the other pcms' frames have arrived when they are needed, which is included in the input latency.
+ */
+typedef struct PaAlsaAggregateStreamInfo
+{
+    unsigned long size;
+    PaHostApiTypeId hostApiType;
+    unsigned long version;
+
+    int numDevices;
+    const char * const *deviceStrings;  /**< ALSA pcm names, the first is the clock master */
+    const int *channelCounts;           /**< Channels to capture from each pcm */
+}
+PaAlsaAggregateStreamInfo;
+
+/** Initialize an aggregate stream info structure, call this before setting the devices. */
+void PaAlsa_InitializeAggregateStreamInfo( PaAlsaAggregateStreamInfo *info );
+
 /** Instruct whether to enable real-time priority when starting the audio thread.
  *
  * If this is turned on by the stream is started, the audio callback thread will be created
@@ -70,9 +97,23 @@ void PaAlsa_InitializeStreamInfo( PaAlsaStreamInfo *info );
  **/
 void PaAlsa_EnableRealtimeScheduling( PaStream *s, int enable );
 
-#if 0
+/** Instruct whether to monitor the audio thread with a watchdog when starting the stream.
+ *
+ * If the real-time audio thread uses nearly a whole CPU for a sustained period, for example because the
+ * callback is stuck in a loop, the watchdog temporarily demotes it to normal scheduling so the rest of
+ * the system keeps running. Throttling is reported by Pa_GetStreamStatistics.
+ **/
 void PaAlsa_EnableWatchdog( PaStream *s, int enable );
-#endif
+
+/** Instruct whether to service the stream on a thread shared with other streams when starting it.
+ *
+ * Instead of spawning its own audio thread, a callback stream started with this turned on is serviced
+ * by a single I/O thread which waits on the devices of all such streams and invokes each ready stream's
+ * callback in turn. This saves context switches and scheduling jitter when a process runs many streams.
+ * The shared thread is started with the real-time scheduling and thread configuration of the first
+ * stream that uses it, and the watchdog is not available for it. Has no effect on blocking streams.
+ **/
+void PaAlsa_EnableSharedThread( PaStream *s, int enable );
 
 /** Get the ALSA-lib card index of this stream's input device. */
 PaError PaAlsa_GetStreamInputCard( PaStream *s, int *card );
@@ -80,6 +121,40 @@ PaError PaAlsa_GetStreamInputCard( PaStream *s, int *card );
 /** Get the ALSA-lib card index of this stream's output device. */
 PaError PaAlsa_GetStreamOutputCard( PaStream *s, int *card );
 
+/** Start several stopped streams so that their devices start at the same sample.
+ *
+ * Each stream is started as by Pa_StartStream, but its pcms are only prepared. The pcms are then linked
+ * with snd_pcm_link and started by a single trigger, pcms which can't be linked (typically those of other
+ * cards) are started right after it. Once running the pcms are unlinked again, so the streams are stopped
+ * and recover from xruns independently. Playback of blocking streams, and of callback streams on pcms
+ * without mmap access, starts when it is first written as usual and isn't part of the group.
+ * @param startSkew If not NULL, return the spread of the pcms' trigger times in seconds, 0 if all could
+ * be linked.
+ */
+PaError PaAlsa_StartStreamGroup( PaStream * const *streams, int numStreams, PaTime *startSkew );
+
+/** Functions of this type are called when an adaptive latency stream has resized its buffers, see
+ * PaAlsa_SetAdaptiveLatency. They run on a notification thread, never on the audio thread.
+ * @param info A copy of the stream's info as of the change, with the new input and output latency. The
+ * stream's own info may have changed again by the time the callback runs.
+ */
+typedef void PaAlsaLatencyCallback( PaStream *s, const PaStreamInfo *info, void *userData );
+
+/** Let a stopped stream adapt its latency to what the machine currently sustains.
+ *
+ * After several xruns in a short time the stream's ALSA buffers are doubled, as far as whole periods fit
+ * within maxLatency, when the stream restarts to recover. After running without xruns for a while the
+ * latency is lowered again a step at a time, down to the size opened with. This doesn't interrupt the
+ * stream: playback is kept less full, and the buffers themselves are shrunk the next time the stream
+ * starts or restarts. The period, and so the callback's buffer size, stays the same. Every change is
+ * reflected in the latencies of the stream info and notified to latencyCallback. Pcms accessed without
+ * mmap, and timer scheduled streams, keep their buffer size.
+ * @param maxLatency The most latency to grow to, in seconds, 0 to disable adaptation (the default).
+ * @param latencyCallback The function to notify of changes, or NULL.
+ */
+PaError PaAlsa_SetAdaptiveLatency( PaStream *s, PaTime maxLatency, PaAlsaLatencyCallback *latencyCallback,
+        void *userData );
+
 /** Set the number of periods (buffer fragments) to configure devices with.
  *
  * By default the number of periods is 4, this is the lowest number of periods that works well on
@@ -93,6 +168,16 @@ PaError PaAlsa_SetNumPeriods( int numPeriods );
  */
 PaError PaAlsa_SetRetriesBusy( int retries );
 
+/** Pace playback by a timer instead of the device's period interrupts, for output-only callback streams
+ * opened afterwards.
+ *
+ * The hardware buffer is made large, but only the stream's suggested latency worth of it is kept filled,
+ * topped up a period at a time as the timer finds room. Period wakeups are disabled where the driver
+ * allows it. This saves wakeups at large latencies and lets the write-ahead differ from the buffer size.
+ * @param enable Non-zero to enable timer scheduling, 0 (the default) to wait for period interrupts.
+ */
+PaError PaAlsa_SetTimerScheduling( int enable );
+
 /** Set the path and name of ALSA library file if PortAudio is configured to load it dynamically (see
  *  PA_ALSA_DYNAMIC). This setting will overwrite the default name set by PA_ALSA_PATHNAME define.
  * @param pathName Full path with filename. Only filename can be used, but dlopen() will lookup default
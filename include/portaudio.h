@@ -482,6 +482,30 @@ typedef struct PaDeviceInfo
 const PaDeviceInfo* Pa_GetDeviceInfo( PaDeviceIndex device );
 
 
+/** Update the device list to reflect devices which have been attached or
+ detached since Pa_Initialize(), without closing open streams.
+
+ Existing device indices and the PaDeviceInfo pointers returned for them stay
+ valid. Newly found devices are appended with indices starting at the
+ previous value of Pa_GetDeviceCount(), so they are not contiguous with the
+ other devices of their host API; use Pa_HostApiDeviceIndexToDeviceIndex() to
+ enumerate the devices of a host API. Devices which have disappeared remain in
+ the list with zero channels and opening them fails with paDeviceUnavailable,
+ they become usable again under the same index when they return. Default
+ devices are not changed.
+
+ Only host APIs which support refreshing are updated, currently ALSA (sound
+ cards only, not plugins). Pa_RefreshDeviceList() must not be called
+ concurrently with other PortAudio functions.
+
+ @return paNoError on success, otherwise an error code indicating the cause
+ of the failure. Devices found before a failure are still added.
+
+ @see Pa_GetDeviceCount, Pa_HostApiDeviceIndexToDeviceIndex
+*/
+PaError Pa_RefreshDeviceList( void );
+
+
 /** Parameters for one direction (input or output) of a stream.
 */
 typedef struct PaStreamParameters
@@ -597,7 +621,7 @@ typedef void PaStream;
 
  @see Pa_OpenStream, Pa_OpenDefaultStream
  @see paNoFlag, paClipOff, paDitherOff, paNeverDropInput,
-  paPrimeOutputBuffersUsingStreamCallback, paPlatformSpecificFlags
+  paPrimeOutputBuffersUsingStreamCallback, paLockMemory, paPlatformSpecificFlags
 */
 typedef unsigned long PaStreamFlags;
 
@@ -633,6 +657,19 @@ typedef unsigned long PaStreamFlags;
 */
 #define   paPrimeOutputBuffersUsingStreamCallback ((PaStreamFlags) 0x00000008)
 
+/** Lock the memory used by the audio path into physical RAM and touch every
+ page of it before the stream starts, so the first callbacks and callbacks
+ made under memory pressure do not take page faults. This covers the buffer
+ processor's buffers, host API buffers and ring buffers and, where the
+ implementation owns it, the callback thread's stack. Failure to lock memory
+ (for example because RLIMIT_MEMLOCK is too low) does not cause Pa_OpenStream
+ to fail; the outcome is reported in PaStreamInfo. Host APIs which don't
+ support locking ignore this flag.
+
+ @see PaStreamFlags, PaStreamInfo
+*/
+#define   paLockMemory      ((PaStreamFlags) 0x00000010)
+
 /** A mask specifying the platform specific bits.
  @see PaStreamFlags
 */
@@ -652,6 +689,56 @@ typedef struct PaStreamCallbackTimeInfo{
 } PaStreamCallbackTimeInfo;
 
 
+/** A signed 64-bit integer, used for frame positions. */
+#if defined(_MSC_VER)
+typedef __int64 PaInt64;
+#else
+typedef long long PaInt64;
+#endif
+
+
+/**
+ Exact frame positions of the buffers passed to the stream callback, as
+ returned by Pa_GetStreamCallbackFramePositions().
+
+ Positions count frames from the time the stream was last started. They
+ advance by the callback's frameCount on each call, and additionally by
+ any frames the host API knows were lost to an xrun, so unlike the
+ PaStreamCallbackTimeInfo times they accumulate no rounding error.
+*/
+typedef struct PaStreamCallbackFramePositions{
+    /** this is struct version 1 */
+    int structVersion;
+
+    /** The position of the first frame of the input buffer, or 0 for an
+     output-only stream. */
+    PaInt64 inputBufferFrame;
+
+    /** The position of the first frame of the output buffer, or 0 for an
+     input-only stream. */
+    PaInt64 outputBufferFrame;
+
+    /** The time, in the Pa_GetStreamTime() time base, at which the host API
+     sampled the device position for the host buffer containing these
+     buffers. Equal to the currentTime of the first callback made for that
+     host buffer.
+    */
+    PaTime hostTime;
+} PaStreamCallbackFramePositions;
+
+
+/** Retrieve the frame positions of the buffers passed to a stream callback.
+
+ @param timeInfo The timeInfo pointer passed to the stream callback. The
+ function must only be called from within the stream callback.
+
+ @return A pointer to the frame positions, valid until the stream callback
+ returns.
+*/
+const PaStreamCallbackFramePositions* Pa_GetStreamCallbackFramePositions(
+        const PaStreamCallbackTimeInfo *timeInfo );
+
+
 /**
  Flag bit constants for the statusFlags to PaStreamCallback.
 
@@ -987,7 +1074,7 @@ PaError Pa_IsStreamActive( PaStream *stream );
 
 typedef struct PaStreamInfo
 {
-    /** this is struct version 1 */
+    /** this is struct version 2 */
     int structVersion;
 
     /** The input latency of the stream in seconds. This value provides the most
@@ -1014,7 +1101,25 @@ typedef struct PaStreamInfo
      parameter passed to Pa_OpenStream().
     */
     double sampleRate;
-    
+
+    /** The number of bytes of audio path memory that were locked into physical
+     RAM because the stream was opened with the paLockMemory flag. Zero if the
+     flag was not passed or the host API does not support it.
+     @see paLockMemory
+    */
+    unsigned long lockedMemoryBytes;
+
+    /** The time in seconds spent locking and prefaulting memory for the
+     paLockMemory flag.
+    */
+    PaTime memoryLockTime;
+
+    /** paNoError if every block requested by paLockMemory was locked, otherwise
+     the error of the first block which could not be locked. Memory which could
+     not be locked is still prefaulted.
+    */
+    PaError memoryLockResult;
+
 } PaStreamInfo;
 
 
@@ -1071,6 +1176,299 @@ PaTime Pa_GetStreamTime( PaStream *stream );
 double Pa_GetStreamCpuLoad( PaStream* stream );
 
 
+/** Configure the CPU load measurement of a callback stream.
+
+ @param stream A pointer to an open, stopped stream previously created with
+ Pa_OpenStream.
+
+ @param timeConstant The time constant, in seconds, of the low pass filter
+ used to smooth the value returned by Pa_GetStreamCpuLoad(). Zero selects
+ the default of 0.05 seconds.
+
+ @param measureThreadCpuTime If non-zero, the CPU time consumed by the
+ audio thread is measured in addition to the wall clock time. This
+ separates time spent processing from time the thread was preempted, but
+ makes each measurement more expensive.
+
+ @return paNoError on success, paStreamIsNotStopped if the stream is running,
+ paInvalidFlag if thread CPU time is not available on this platform, or
+ paIncompatibleStreamHostApi if the stream's host API does not support
+ these options.
+
+ @see Pa_GetStreamCpuLoadInfo
+*/
+PaError Pa_SetStreamCpuLoadOptions( PaStream *stream, PaTime timeConstant,
+        int measureThreadCpuTime );
+
+
+/** Detailed CPU load information, as returned by Pa_GetStreamCpuLoadInfo().
+ Loads are fractions of the time available to process each buffer, as
+ described for Pa_GetStreamCpuLoad(). Percentiles are estimated from a
+ histogram of per-buffer loads with quarter-octave resolution.
+*/
+typedef struct PaStreamCpuLoadInfo
+{
+    /** this is struct version 1 */
+    int structVersion;
+
+    /** The number of buffers measured since the stream was last started. */
+    unsigned long measurementCount;
+
+    /** Wall clock based load: the low pass filtered average (the value
+     returned by Pa_GetStreamCpuLoad()), percentiles and maximum.
+    */
+    double averageLoad;
+    double p50Load;
+    double p90Load;
+    double p99Load;
+    double maxLoad;
+
+    /** Non-zero if the fields below are valid, see Pa_SetStreamCpuLoadOptions(). */
+    int threadCpuTimeMeasured;
+
+    /** Load based on the CPU time consumed by the audio thread. */
+    double averageThreadLoad;
+    double p99ThreadLoad;
+    double maxThreadLoad;
+} PaStreamCpuLoadInfo;
+
+
+/** Retrieve detailed CPU load information for a callback stream.
+
+ This function may be called from the stream callback function or the
+ application. Values read while the stream is running are approximate.
+
+ @return paNoError on success, paBadBufferPtr if info is NULL, or
+ paIncompatibleStreamHostApi if the stream's host API does not provide
+ detailed load information.
+*/
+PaError Pa_GetStreamCpuLoadInfo( PaStream *stream, PaStreamCpuLoadInfo *info );
+
+
+/** Real-time statistics for a stream, as returned by Pa_GetStreamStatistics().
+
+ The counters accumulate from the time the stream is opened. Durations are
+ in seconds. Host APIs which do not maintain statistics leave every field
+ zero.
+*/
+typedef struct PaStreamStatistics
+{
+    /** this is struct version 2 */
+    int structVersion;
+
+    /** The number of input overflows (capture overruns) reported by the host. */
+    unsigned long inputOverflowCount;
+
+    /** The number of output underflows (playback underruns) reported by the
+     host.
+    */
+    unsigned long outputUnderflowCount;
+
+    /** The number of host buffers processed by the stream callback. */
+    unsigned long callbackCount;
+
+    /** The shortest, mean, longest and 99th percentile time spent processing
+     a host buffer, including the stream callback. The 99th percentile is
+     estimated from a histogram with quarter-octave resolution.
+    */
+    PaTime minCallbackDuration;
+    PaTime meanCallbackDuration;
+    PaTime maxCallbackDuration;
+    PaTime p99CallbackDuration;
+
+    /** The mean and largest absolute difference between the interval at
+     which the audio thread woke up and the ideal interval implied by the
+     host buffer size.
+    */
+    PaTime meanWakeupJitter;
+    PaTime maxWakeupJitter;
+
+    /** The number of input frames lost or discarded before they could be
+     delivered to the client.
+    */
+    unsigned long droppedFrames;
+
+    /** The number of times the audio thread was demoted to normal scheduling
+     because it used nearly a whole CPU for too long, and the total time it
+     spent demoted. Only host APIs which run a watchdog, such as ALSA with
+     PaAlsa_EnableWatchdog(), throttle the audio thread.
+    */
+    unsigned long throttleCount;
+    PaTime throttledTime;
+} PaStreamStatistics;
+
+
+/** Retrieve real-time statistics for the specified stream.
+
+ The statistics are maintained by the audio thread without locks, so this
+ function may be called at any time from any thread, including the stream
+ callback, without disturbing the stream.
+
+ @param stream A pointer to an open stream previously created with Pa_OpenStream.
+
+ @param statistics A pointer to a PaStreamStatistics structure which
+ receives the statistics.
+
+ @return paNoError on success, otherwise an error code such as
+ paBadStreamPtr or paBadBufferPtr.
+
+ @see PaStreamStatistics
+*/
+PaError Pa_GetStreamStatistics( PaStream *stream, PaStreamStatistics *statistics );
+
+
+/** Information passed to a PaStreamHeadroomCallback. Headroom is the
+ amount of audio, in seconds, left in the host buffer when the stream
+ callback returned: for output the audio still queued for the device, for
+ input the space left before the device overflows. An xrun occurs when it
+ reaches zero.
+*/
+typedef struct PaStreamHeadroomInfo
+{
+    /** The headroom after the buffer which triggered the notification. */
+    PaTime headroom;
+
+    /** The lowest headroom seen since the previous notification. */
+    PaTime minimumHeadroom;
+
+    /** The fraction of the buffer's period consumed while it was being
+     processed, measured by the device. Values close to or above 1 mean the
+     stream callback is not keeping up.
+    */
+    double budgetUsed;
+
+    /** The number of buffers with headroom below the threshold since the
+     previous notification, including the one which triggered it.
+    */
+    unsigned long lowHeadroomCount;
+} PaStreamHeadroomInfo;
+
+
+/** Functions of type PaStreamHeadroomCallback are registered with
+ Pa_SetStreamHeadroomCallback() and are called when a stream's headroom
+ falls below a threshold, before an xrun occurs.
+
+ The function is called on a dedicated notification thread, never on the
+ audio thread, so it may block or call other PortAudio functions except
+ Pa_CloseStream() on the same stream. While it runs further low headroom
+ buffers are counted and reported with the next call.
+*/
+typedef void PaStreamHeadroomCallback( PaStream *stream,
+        const PaStreamHeadroomInfo *info, void *userData );
+
+
+/** Register a function to be notified when the headroom of a callback
+ stream falls below a threshold.
+
+ @param stream A pointer to an open, stopped stream previously created with
+ Pa_OpenStream.
+
+ @param threshold The headroom, in seconds, below which the function is
+ notified.
+
+ @param headroomCallback The function to notify, or NULL to remove a
+ previously registered function.
+
+ @return paNoError on success, paStreamIsNotStopped if the stream is running,
+ paIncompatibleStreamHostApi if the stream's host API does not measure
+ headroom, or paUnanticipatedHostError if the notification thread could not
+ be started.
+*/
+PaError Pa_SetStreamHeadroomCallback( PaStream *stream, PaTime threshold,
+        PaStreamHeadroomCallback *headroomCallback, void *userData );
+
+
+/** Scheduling policies for a stream's audio thread, see PaThreadConfiguration. */
+typedef enum PaThreadSchedulingPolicy
+{
+    paThreadPolicyDefault = 0,  /**< leave the policy chosen by the host API */
+    paThreadPolicyOther,        /**< normal time sharing scheduling */
+    paThreadPolicyFifo,         /**< real-time first in, first out */
+    paThreadPolicyRoundRobin,   /**< real-time round robin */
+    paThreadPolicyDeadline      /**< earliest deadline first, with a budget each host buffer period */
+} PaThreadSchedulingPolicy;
+
+
+/** The number of CPUs which can be selected in
+ PaThreadConfiguration::cpuAffinity.
+*/
+#define paMaxThreadAffinityCpus (1024)
+
+
+/** Scheduling, CPU affinity and stack size of the thread which runs a
+ stream's callback or i/o, used with Pa_SetStreamThreadConfiguration() and
+ Pa_GetStreamThreadConfiguration().
+*/
+typedef struct PaThreadConfiguration
+{
+    /** this is struct version 1 */
+    int structVersion;
+
+    /** The scheduling policy. */
+    PaThreadSchedulingPolicy policy;
+
+    /** The priority for the paThreadPolicyFifo and paThreadPolicyRoundRobin
+     policies, clamped to the range the system supports. 0 selects the lowest
+     real-time priority.
+    */
+    int priority;
+
+    /** The CPUs the thread may run on: CPU n is selected by bit (n % 8) of
+     byte (n / 8). If no bit is set the affinity is not changed.
+    */
+    unsigned char cpuAffinity[ paMaxThreadAffinityCpus / 8 ];
+
+    /** The stack size in bytes, or 0 for the system default. */
+    unsigned long stackSize;
+
+    /** For paThreadPolicyDeadline, the fraction of each host buffer period
+     the thread is guaranteed to run for, or 0 for the default of 0.5. The
+     deadline and period are the host buffer period. Where the system does not
+     admit the thread, for example because it lacks the privilege or the thread
+     is restricted to some CPUs with cpuAffinity, paThreadPolicyFifo is used
+     with the configured priority instead.
+    */
+    double deadlineRuntime;
+} PaThreadConfiguration;
+
+
+/** Configure the thread which runs a stream's callback or i/o. The
+ configuration is applied the next time the stream is started. When the
+ system refuses part of it, for example because the process lacks the
+ privilege for real-time scheduling, the stream still starts and
+ Pa_GetStreamThreadConfiguration() reports what was actually applied.
+
+ @param stream A pointer to an open, stopped stream previously created with
+ Pa_OpenStream.
+
+ @param configuration The configuration to apply, or NULL to restore the
+ host API's defaults.
+
+ @return paNoError on success, paStreamIsNotStopped if the stream is running,
+ paIncompatibleStreamHostApi if the stream's host API does not support thread
+ configuration, or paInvalidFlag if the configuration is not valid.
+*/
+PaError Pa_SetStreamThreadConfiguration( PaStream *stream,
+        const PaThreadConfiguration *configuration );
+
+
+/** Retrieve the configuration applied to a stream's audio thread when the
+ stream was last started. Before the stream has been started the policy is
+ paThreadPolicyDefault and all other fields are zero.
+
+ @param stream A pointer to an open stream previously created with
+ Pa_OpenStream.
+
+ @param configuration A pointer to a PaThreadConfiguration structure which
+ receives the applied configuration.
+
+ @return paNoError on success, otherwise an error code such as
+ paBadStreamPtr, paBadBufferPtr or paIncompatibleStreamHostApi.
+*/
+PaError Pa_GetStreamThreadConfiguration( PaStream *stream,
+        PaThreadConfiguration *configuration );
+
+
 /** Read samples from an input stream. The function doesn't return until
  the entire buffer has been filled - this may involve waiting for the operating
  system to supply the data.
@@ -1146,6 +1544,290 @@ signed long Pa_GetStreamReadAvailable( PaStream* stream );
 signed long Pa_GetStreamWriteAvailable( PaStream* stream );
 
 
+/** Obtain direct access to the captured frames of a blocking stream, without
+ the copy made by Pa_ReadStream().
+
+ Waits until at least *frames frames (limited to the host buffer size) can be
+ read, then returns a region of the host buffer holding the oldest captured
+ frames. The region is in the stream's input sample format. For an interleaved
+ stream *buffer points to the first frame; for a stream opened with
+ paNonInterleaved it points to an array of pointers, one per channel. The
+ region may hold more or fewer frames than requested, fewer when the requested
+ frames wrap around the end of the host buffer.
+
+ Only available when the host API can expose its buffer in exactly the
+ sample format, interleaving and channel count the stream was opened with.
+ A region stays valid until it is released with Pa_CommitStreamRead(); a
+ stream can't be read with Pa_ReadStream() while a region is outstanding.
+
+ @param stream A pointer to an open, running blocking stream.
+
+ @param buffer Receives the address of the region.
+
+ @param frames On entry the number of frames to wait for, 0 not to wait. On
+ return the number of frames in the region, which may be 0 if frames was 0.
+
+ @return paNoError on success, paInputOverflowed if input data was discarded
+ since the last read (the region is still returned), paBadBufferPtr if buffer
+ or frames is NULL, paStreamIsStopped, paCanNotReadFromAnOutputOnlyStream,
+ paSampleFormatNotSupported if the input host format differs from the
+ stream's, or paIncompatibleStreamHostApi if the stream's host API does not
+ support regions.
+
+ @see Pa_CommitStreamRead, Pa_GetStreamWriteRegion
+*/
+PaError Pa_GetStreamReadRegion( PaStream *stream, const void **buffer, unsigned long *frames );
+
+
+/** Release frames of the region obtained with Pa_GetStreamReadRegion() back
+ to the host API.
+
+ @param frames The number of frames consumed from the start of the region,
+ at most the number the region holds.
+
+ @return paNoError on success, paBufferTooBig if frames exceeds the region,
+ or an error code as for Pa_GetStreamReadRegion().
+*/
+PaError Pa_CommitStreamRead( PaStream *stream, unsigned long frames );
+
+
+/** Obtain direct access to the host buffer of a blocking stream, so output
+ can be rendered straight into it without the copy made by Pa_WriteStream().
+
+ Waits until at least *frames frames (limited to the host buffer size) can be
+ written, then returns the writable region of the host buffer, in the same
+ layout as described for Pa_GetStreamReadRegion(). The region's contents are
+ undefined; frames written to it are played once committed with
+ Pa_CommitStreamWrite(). As with Pa_WriteStream(), output starts once a host
+ buffer period has been committed.
+
+ @return paNoError on success, paOutputUnderflowed if output was underflowed
+ since the last write (the region is still returned), paBadBufferPtr if
+ buffer or frames is NULL, paStreamIsStopped,
+ paCanNotWriteToAnInputOnlyStream, paSampleFormatNotSupported if the output
+ host format differs from the stream's, or paIncompatibleStreamHostApi if
+ the stream's host API does not support regions.
+
+ @see Pa_CommitStreamWrite, Pa_GetStreamReadRegion
+*/
+PaError Pa_GetStreamWriteRegion( PaStream *stream, void **buffer, unsigned long *frames );
+
+
+/** Queue frames written to the region obtained with Pa_GetStreamWriteRegion()
+ for playback.
+
+ @param frames The number of frames written from the start of the region,
+ at most the number the region holds.
+
+ @return paNoError on success, paBufferTooBig if frames exceeds the region,
+ or an error code as for Pa_GetStreamWriteRegion().
+*/
+PaError Pa_CommitStreamWrite( PaStream *stream, unsigned long frames );
+
+
+/** A file descriptor to wait on for a blocking stream, laid out like the
+ POSIX struct pollfd so an array of them can be passed to poll() as is.
+
+ @see Pa_GetStreamPollDescriptors, Pa_ProcessStreamPollEvents
+*/
+typedef struct PaStreamPollDescriptor
+{
+    int fd;
+    short events;   /**< the poll() events to wait for */
+    short revents;  /**< the poll() events which occurred */
+} PaStreamPollDescriptor;
+
+
+/** Readiness reported by Pa_ProcessStreamPollEvents(). */
+#define paStreamPollReadable  ((int) 0x01)
+#define paStreamPollWritable  ((int) 0x02)
+
+
+/** Retrieve the file descriptors of a blocking stream, so an event loop can
+ wait on them along with its own instead of blocking in Pa_ReadStream() or
+ Pa_WriteStream(). The descriptors stay the same while the stream is open.
+
+ @param descriptors Receives up to maxDescriptors descriptors, may be NULL
+ if maxDescriptors is 0.
+
+ @return The number of descriptors the stream has, which may exceed
+ maxDescriptors, or a PaErrorCode (which are always negative):
+ paBadBufferPtr if descriptors is NULL and maxDescriptors isn't 0, or
+ paIncompatibleStreamHostApi if the stream is a callback stream or its host
+ API can't be waited on with poll().
+
+ @see Pa_ProcessStreamPollEvents
+*/
+int Pa_GetStreamPollDescriptors( PaStream *stream, PaStreamPollDescriptor *descriptors, int maxDescriptors );
+
+
+/** Interpret the events poll() returned for a running stream's descriptors.
+
+ Devices may report events which don't mean the stream is ready, so the raw
+ revents must not be relied on. Xruns reported by the events are recovered
+ from. Once the stream is readable, Pa_GetStreamReadAvailable() frames can be
+ read without blocking; once writable, Pa_GetStreamWriteAvailable() frames can
+ be written without blocking.
+
+ @param descriptors All of the stream's descriptors, in the order returned by
+ Pa_GetStreamPollDescriptors(), with revents set by poll().
+
+ @param ready Receives paStreamPollReadable and/or paStreamPollWritable, or 0
+ if the stream isn't ready yet.
+
+ @return paNoError on success, paBadBufferPtr if descriptors or ready is NULL
+ or numDescriptors is not the stream's number of descriptors,
+ paStreamIsStopped, or an error code as for Pa_GetStreamPollDescriptors().
+*/
+PaError Pa_ProcessStreamPollEvents( PaStream *stream, const PaStreamPollDescriptor *descriptors,
+        int numDescriptors, int *ready );
+
+
+/* Allocation statistics */
+
+
+/** The categories used to account for memory allocated by PortAudio.
+ @see PaAllocationStatistics
+*/
+typedef enum PaAllocationCategory
+{
+    paAllocationHostApi=0,          /**< host API and stream representations */
+    paAllocationDeviceInfo,         /**< host API and device info structures */
+    paAllocationBufferProcessor,    /**< buffer processor temporary buffers */
+    paAllocationRingBuffer,         /**< ring buffers used by blocking i/o */
+
+    paAllocationCategoryCount       /**< the number of categories, not a category */
+} PaAllocationCategory;
+
+
+/** Allocation counters for a single PaAllocationCategory.
+ @see PaAllocationStatistics
+*/
+typedef struct PaAllocationCategoryStatistics
+{
+    /** The number of bytes currently allocated. */
+    unsigned long currentBytes;
+
+    /** The number of blocks currently allocated. */
+    unsigned long currentBlocks;
+
+    /** The largest value currentBytes has reached since the counters were
+     last reset.
+    */
+    unsigned long peakBytes;
+
+    /** The number of blocks allocated since the counters were last reset. */
+    unsigned long totalBlocks;
+} PaAllocationCategoryStatistics;
+
+
+/** A snapshot of the memory allocated by PortAudio, as returned by
+ Pa_GetAllocationStatistics().
+
+ The counters are maintained with relaxed atomic updates, so a snapshot
+ taken while other threads allocate may be slightly inconsistent between
+ fields.
+*/
+typedef struct PaAllocationStatistics
+{
+    /** this is struct version 1 */
+    int structVersion;
+
+    /** Per-category counters, indexed by PaAllocationCategory. */
+    PaAllocationCategoryStatistics categories[ paAllocationCategoryCount ];
+
+    /** The sum of all categories. total.peakBytes is the peak of the sum,
+     not the sum of the category peaks.
+    */
+    PaAllocationCategoryStatistics total;
+
+    /** The number of blocks allocated, and their size in bytes, on the
+     threads running a stream's audio path while at least one stream was
+     started. Allocations made on a running audio path are usually a source
+     of glitches, so these should normally stay zero.
+    */
+    unsigned long allocationsAfterStreamStart;
+    unsigned long bytesAllocatedAfterStreamStart;
+} PaAllocationStatistics;
+
+
+/** Retrieve a snapshot of PortAudio's allocation counters.
+
+ This function may be called at any time, including before Pa_Initialize()
+ and after Pa_Terminate().
+
+ @param statistics A pointer to a PaAllocationStatistics structure which
+ receives the counters.
+
+ @return paNoError on success, or paBadBufferPtr if statistics is NULL.
+
+ @see Pa_ResetAllocationStatistics, Pa_FormatAllocationStatisticsJson
+*/
+PaError Pa_GetAllocationStatistics( PaAllocationStatistics *statistics );
+
+
+/** Reset the peak, total and after-stream-start allocation counters. The
+ current byte and block counts are not affected; the peaks restart from the
+ current values.
+*/
+void Pa_ResetAllocationStatistics( void );
+
+
+/** Format a statistics snapshot as a JSON object.
+
+ @param statistics The snapshot to format, usually filled by
+ Pa_GetAllocationStatistics().
+
+ @param buffer The buffer which receives the nul terminated JSON text. May be
+ NULL if bufferSize is 0.
+
+ @param bufferSize The size of buffer in bytes.
+
+ @return The length of the complete JSON text, excluding the terminating nul,
+ or a PaErrorCode (which are always negative) if statistics is NULL. If the
+ return value is not less than bufferSize the text was truncated.
+*/
+int Pa_FormatAllocationStatisticsJson( const PaAllocationStatistics *statistics,
+        char *buffer, unsigned long bufferSize );
+
+
+/* Event tracing */
+
+
+/** Enable or disable the binary event tracer. While enabled, the audio
+ threads of host APIs which support tracing record timestamped begin/end
+ events around waiting for the device, buffer processing, the stream
+ callback and handing buffers back to the device, as well as xruns.
+
+ The first call which enables tracing allocates the trace buffers. This
+ function may be called at any time, including before Pa_Initialize().
+
+ @return paNoError on success, paInsufficientMemory if the trace buffers could
+ not be allocated, or paInternalError if tracing is not supported by the
+ compiler PortAudio was built with.
+
+ @see Pa_WriteTraceJson
+*/
+PaError Pa_SetTraceEnabled( int enabled );
+
+
+/** Write the recorded events to a file in the Chrome trace event JSON
+ format, for viewing in chrome://tracing or Perfetto. Each thread buffer
+ holds the most recent events; older events are overwritten. For a
+ consistent trace, disable tracing before writing it.
+
+ @return paNoError on success, paBadBufferPtr if fileName is NULL, or
+ paInternalError if the file could not be written.
+*/
+PaError Pa_WriteTraceJson( const char *fileName );
+
+
+/** Discard the recorded events. If tracing is disabled, the trace buffers
+ are also freed. Must not be called while a stream is running.
+*/
+void Pa_ResetTrace( void );
+
+
 /* Miscellaneous utilities */
 
 
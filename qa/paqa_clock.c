@@ -0,0 +1,198 @@
+/** @file paqa_clock.c
+	@ingroup qa_src
+	@brief Self Testing Quality Assurance app for the PortAudio clock.
+	Checks that PaUtil_GetTime() and PaUtil_GetMeasurementTime() never run
+	backwards and reports how much a call to each of them costs. No audio
+	device is needed.
+
+	Run with --step-clock as root to additionally step the system time back
+	and forth while the clocks are being sampled. The system time is
+	restored afterwards, but NTP daemons may complain.
+*/
+/*
+ * $Id$
+ *
+ * This program uses the PortAudio Portable Audio Library.
+ * For more information see: http://www.portaudio.com
+ * Copyright (c) 1999-2000 Ross Bencina and Phil Burk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "portaudio.h"
+#include "pa_util.h"
+
+#define BENCHMARK_CALLS       (1000000)
+#define SAMPLE_SECONDS        (2.0)
+#define CLOCK_STEP_SECONDS    (3600)
+
+typedef double (*ClockFunction)( void );
+
+static int gNumPassed = 0; /* Two globals */
+static int gNumFailed = 0;
+
+#define HOPEFOR(_exp) \
+    do \
+    { \
+        if ((_exp)) {\
+            gNumPassed++; \
+        } \
+        else { \
+            printf("\nERROR - %s\n", #_exp ); \
+            gNumFailed++; \
+        } \
+    } while(0)
+
+/*-------------------------------------------------------------------------*/
+/* Report the average cost of one call to a clock function. */
+static void BenchmarkClock( const char *name, ClockFunction clock )
+{
+    volatile double sink = 0.;
+    double start, elapsed;
+    int i;
+
+    for( i=0; i<BENCHMARK_CALLS / 10; i++ ) /* warm up */
+        sink += clock();
+
+    start = PaUtil_GetTime();
+    for( i=0; i<BENCHMARK_CALLS; i++ )
+        sink += clock();
+    elapsed = PaUtil_GetTime() - start;
+
+    printf( "%-28s %8.1f ns per call\n", name, elapsed * 1e9 / BENCHMARK_CALLS );
+    (void) sink;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Sample a clock for SAMPLE_SECONDS and count how often it runs backwards. */
+static int CountClockRegressions( ClockFunction clock, double *largestRegression )
+{
+    double end = PaUtil_GetTime() + SAMPLE_SECONDS;
+    double previous = clock(), now;
+    int regressions = 0;
+
+    *largestRegression = 0.;
+    while( PaUtil_GetTime() < end )
+    {
+        now = clock();
+        if( now < previous )
+        {
+            regressions++;
+            if( previous - now > *largestRegression )
+                *largestRegression = previous - now;
+        }
+        previous = now;
+    }
+    return regressions;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Step the system time back and forth while the main thread samples the clocks. */
+static volatile int gStepperDone = 0;
+static volatile int gStepsMade = 0;
+
+static void *ClockStepper( void *userData )
+{
+    struct timespec ts, pause = { 0, 100 * 1000 * 1000 };
+    int i;
+    (void) userData;
+
+    for( i=0; i<4 && !gStepperDone; i++ )
+    {
+        nanosleep( &pause, NULL );
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec += (i % 2) ? CLOCK_STEP_SECONDS : -CLOCK_STEP_SECONDS;
+        if( clock_settime( CLOCK_REALTIME, &ts ) != 0 )
+            break;
+        gStepsMade++;
+    }
+
+    if( gStepsMade % 2 ) /* undo an unmatched step */
+    {
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec += CLOCK_STEP_SECONDS;
+        clock_settime( CLOCK_REALTIME, &ts );
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------*/
+static void TestMonotonic( const char *name, ClockFunction clock, int stepClock )
+{
+    pthread_t stepper;
+    double largestRegression;
+    int regressions;
+
+    gStepperDone = 0;
+    gStepsMade = 0;
+    if( stepClock && pthread_create( &stepper, NULL, ClockStepper, NULL ) != 0 )
+        stepClock = 0;
+
+    regressions = CountClockRegressions( clock, &largestRegression );
+
+    if( stepClock )
+    {
+        gStepperDone = 1;
+        pthread_join( stepper, NULL );
+    }
+
+    printf( "%-28s %d regressions (largest %g s)", name, regressions, largestRegression );
+    if( stepClock )
+        printf( ", system time stepped %d times", gStepsMade );
+    printf( "\n" );
+
+    HOPEFOR( regressions == 0 );
+}
+
+/*-------------------------------------------------------------------------*/
+int main( int argc, char **argv );
+int main( int argc, char **argv )
+{
+    int stepClock = argc > 1 && strcmp( argv[1], "--step-clock" ) == 0;
+
+    PaUtil_InitializeClock();
+
+    printf( "Clock cost:\n" );
+    BenchmarkClock( "PaUtil_GetTime", PaUtil_GetTime );
+    BenchmarkClock( "PaUtil_GetMeasurementTime", PaUtil_GetMeasurementTime );
+
+    printf( "Clock monotonicity over %g seconds:\n", SAMPLE_SECONDS );
+    TestMonotonic( "PaUtil_GetTime", PaUtil_GetTime, stepClock );
+    TestMonotonic( "PaUtil_GetMeasurementTime", PaUtil_GetMeasurementTime, stepClock );
+
+    printf( "QA Report: %d passed, %d failed.\n", gNumPassed, gNumFailed );
+    return gNumFailed ? 1 : 0;
+}
@@ -40,10 +40,12 @@
 /** @file
  @ingroup common_src
 
- @brief Allocation Group implementation.
+ @brief Allocation Group and arena implementation.
 */
 
 
+#include <string.h> /* memset() */
+
 #include "pa_allocation.h"
 #include "pa_util.h"
 
@@ -74,13 +76,14 @@ struct PaUtilAllocationGroupLink
 */
 static struct PaUtilAllocationGroupLink *AllocateLinks( long count,
         struct PaUtilAllocationGroupLink *nextBlock,
-        struct PaUtilAllocationGroupLink *nextSpare )
+        struct PaUtilAllocationGroupLink *nextSpare,
+        PaAllocationCategory category )
 {
     struct PaUtilAllocationGroupLink *result;
     int i;
     
-    result = (struct PaUtilAllocationGroupLink *)PaUtil_AllocateMemory(
-            sizeof(struct PaUtilAllocationGroupLink) * count );
+    result = (struct PaUtilAllocationGroupLink *)PaUtil_AllocateMemoryInCategory(
+            sizeof(struct PaUtilAllocationGroupLink) * count, category );
     if( result )
     {
         /* the block link */
@@ -101,21 +104,29 @@ static struct PaUtilAllocationGroupLink *AllocateLinks( long count,
 
 
 PaUtilAllocationGroup* PaUtil_CreateAllocationGroup( void )
+{
+    return PaUtil_CreateAllocationGroupInCategory( paAllocationDeviceInfo );
+}
+
+
+PaUtilAllocationGroup* PaUtil_CreateAllocationGroupInCategory( PaAllocationCategory category )
 {
     PaUtilAllocationGroup* result = 0;
     struct PaUtilAllocationGroupLink *links;
 
 
-    links = AllocateLinks( PA_INITIAL_LINK_COUNT_, 0, 0 );
+    links = AllocateLinks( PA_INITIAL_LINK_COUNT_, 0, 0, category );
     if( links != 0 )
     {
-        result = (PaUtilAllocationGroup*)PaUtil_AllocateMemory( sizeof(PaUtilAllocationGroup) );
+        result = (PaUtilAllocationGroup*)PaUtil_AllocateMemoryInCategory(
+                sizeof(PaUtilAllocationGroup), category );
         if( result )
         {
             result->linkCount = PA_INITIAL_LINK_COUNT_;
             result->linkBlocks = &links[0];
             result->spareLinks = &links[1];
             result->allocations = 0;
+            result->category = category;
         }
         else
         {
@@ -152,7 +163,7 @@ void* PaUtil_GroupAllocateMemory( PaUtilAllocationGroup* group, long size )
     if( !group->spareLinks )
     {
         /* double the link count on each block allocation */
-        links = AllocateLinks( group->linkCount, group->linkBlocks, group->spareLinks );
+        links = AllocateLinks( group->linkCount, group->linkBlocks, group->spareLinks, group->category );
         if( links )
         {
             group->linkCount += group->linkCount;
@@ -163,7 +174,7 @@ void* PaUtil_GroupAllocateMemory( PaUtilAllocationGroup* group, long size )
 
     if( group->spareLinks )
     {
-        result = PaUtil_AllocateMemory( size );
+        result = PaUtil_AllocateMemoryInCategory( size, group->category );
         if( result )
         {
             link = group->spareLinks;
@@ -241,3 +252,82 @@ void PaUtil_FreeAllAllocations( PaUtilAllocationGroup* group )
     }
 }
 
+
+#define PA_ARENA_ROUND_UP_( size ) \
+    ( ( (size) + (PA_ARENA_ALIGNMENT - 1) ) & ~(long)(PA_ARENA_ALIGNMENT - 1) )
+
+
+void PaUtil_InitializeArena( PaUtilArena* arena, PaAllocationCategory category )
+{
+    arena->block = 0;
+    arena->base = 0;
+    arena->size = 0;
+    arena->used = 0;
+    arena->locked = 0;
+    arena->category = category;
+}
+
+
+void PaUtil_ReserveArenaMemory( PaUtilArena* arena, long size )
+{
+    if( size > 0 )
+        arena->size += PA_ARENA_ROUND_UP_( size );
+}
+
+
+PaError PaUtil_CommitArena( PaUtilArena* arena )
+{
+    if( arena->size == 0 )
+        return paNoError;
+
+    /* over-allocate so the base can be rounded up to the alignment boundary */
+    arena->block = PaUtil_AllocateMemoryInCategory( arena->size + PA_ARENA_ALIGNMENT - 1, arena->category );
+    if( !arena->block )
+        return paInsufficientMemory;
+
+    arena->base = (char*)( ( (size_t)arena->block + (PA_ARENA_ALIGNMENT - 1) )
+            & ~(size_t)(PA_ARENA_ALIGNMENT - 1) );
+    arena->used = 0;
+
+    memset( arena->base, 0, arena->size );
+
+    return paNoError;
+}
+
+
+void* PaUtil_ArenaAllocateMemory( PaUtilArena* arena, long size )
+{
+    void *result;
+    long roundedSize = PA_ARENA_ROUND_UP_( size );
+
+    if( !arena->base || size <= 0 || roundedSize > arena->size - arena->used )
+        return 0;
+
+    result = arena->base + arena->used;
+    arena->used += roundedSize;
+
+    return result;
+}
+
+
+PaError PaUtil_LockArena( PaUtilArena* arena )
+{
+    PaError result = PaUtil_LockMemory( arena->base, arena->size );
+
+    if( result == paNoError && arena->base )
+        arena->locked = 1;
+
+    return result;
+}
+
+
+void PaUtil_FreeArena( PaUtilArena* arena )
+{
+    if( arena->locked )
+        PaUtil_UnlockMemory( arena->base, arena->size );
+
+    if( arena->block )
+        PaUtil_FreeMemory( arena->block );
+
+    PaUtil_InitializeArena( arena, arena->category );
+}
@@ -53,9 +53,18 @@
 
  The allocation group implementation is built on top of the lower
  level allocation functions defined in pa_util.h
+
+ This file also declares the arena allocator. An arena hands out all of
+ an object's buffers from a single contiguous, cache-aligned block. Sizes
+ are reserved first, the block is committed with one allocation, and the
+ buffers are then carved from it in the order they were reserved. The whole
+ arena is released with a single free.
 */
 
 
+#include "portaudio.h"
+
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -68,14 +77,22 @@ typedef struct
     struct PaUtilAllocationGroupLink *linkBlocks;
     struct PaUtilAllocationGroupLink *spareLinks;
     struct PaUtilAllocationGroupLink *allocations;
+    PaAllocationCategory category;
 }PaUtilAllocationGroup;
 
 
 
-/** Create an allocation group.
+/** Create an allocation group. Memory allocated through the group is
+ accounted in the paAllocationDeviceInfo category.
 */
 PaUtilAllocationGroup* PaUtil_CreateAllocationGroup( void );
 
+/** Create an allocation group whose memory, including the group's own
+ bookkeeping, is accounted in category.
+ @see Pa_GetAllocationStatistics
+*/
+PaUtilAllocationGroup* PaUtil_CreateAllocationGroupInCategory( PaAllocationCategory category );
+
 /** Destroy an allocation group, but not the memory allocated through the group.
 */
 void PaUtil_DestroyAllocationGroup( PaUtilAllocationGroup* group );
@@ -98,6 +115,64 @@ void PaUtil_GroupFreeMemory( PaUtilAllocationGroup* group, void *buffer );
 void PaUtil_FreeAllAllocations( PaUtilAllocationGroup* group );
 
 
+/** Alignment, in bytes, of the arena block and of every buffer carved from it.
+ Chosen to match the cache line size of current CPUs.
+*/
+#define PA_ARENA_ALIGNMENT  (64)
+
+
+typedef struct PaUtilArena
+{
+    void *block;        /**< the block returned by PaUtil_AllocateMemoryInCategory, or NULL */
+    char *base;         /**< block rounded up to PA_ARENA_ALIGNMENT */
+    long size;          /**< bytes reserved so far, each reservation rounded up to PA_ARENA_ALIGNMENT */
+    long used;          /**< bytes handed out by PaUtil_ArenaAllocateMemory */
+    int locked;         /**< non-zero if the block is locked with PaUtil_LockMemory */
+    PaAllocationCategory category; /**< the category the block is accounted in */
+}PaUtilArena;
+
+
+/** Initialize an empty arena whose block will be accounted in category.
+ Nothing is allocated.
+*/
+void PaUtil_InitializeArena( PaUtilArena* arena, PaAllocationCategory category );
+
+/** Reserve space for a buffer of size bytes. Must be called before
+ PaUtil_CommitArena, once for every buffer that will later be requested
+ with PaUtil_ArenaAllocateMemory.
+*/
+void PaUtil_ReserveArenaMemory( PaUtilArena* arena, long size );
+
+/** Allocate the arena's block, large enough for all reservations, and zero it.
+ Zeroing touches every page so that page faults are taken here rather than
+ in the audio thread.
+
+ @return paNoError on success, or paInsufficientMemory.
+*/
+PaError PaUtil_CommitArena( PaUtilArena* arena );
+
+/** Carve a buffer of size bytes from a committed arena. The returned memory
+ is zeroed and aligned to PA_ARENA_ALIGNMENT. This function never calls the
+ system allocator and is safe to use from a real-time thread.
+
+ @return The buffer, or NULL if the request exceeds the reserved space.
+*/
+void* PaUtil_ArenaAllocateMemory( PaUtilArena* arena, long size );
+
+/** Prefault a committed arena and lock it into physical memory. The lock is
+ released by PaUtil_FreeArena.
+
+ @return The result of PaUtil_LockMemory.
+*/
+PaError PaUtil_LockArena( PaUtilArena* arena );
+
+/** Free the arena's block in one operation, invalidating every buffer carved
+ from it, and return the arena to its initialized state. Safe to call on an
+ arena which was never committed.
+*/
+void PaUtil_FreeArena( PaUtilArena* arena );
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -43,18 +43,20 @@
  @brief Functions to assist in measuring the CPU utilization of a callback
  stream. Used to implement the Pa_GetStreamCpuLoad() function.
 
- @todo Dynamically calculate the coefficients used to smooth the CPU Load
- Measurements over time to provide a uniform characterisation of CPU Load
- independent of rate at which PaUtil_BeginCpuLoadMeasurement /
- PaUtil_EndCpuLoadMeasurement are called. see http://www.portaudio.com/trac/ticket/113
+ The average load is smoothed with a first order low pass filter whose
+ coefficient is derived from the configured time constant and the duration
+ of each measured buffer, so the smoothing does not depend on the rate at
+ which PaUtil_BeginCpuLoadMeasurement / PaUtil_EndCpuLoadMeasurement are
+ called (see http://www.portaudio.com/trac/ticket/113).
 */
 
 
 #include "pa_cpuload.h"
 
 #include <assert.h>
+#include <string.h>
 
-#include "pa_util.h"   /* for PaUtil_GetTime() */
+#include "pa_util.h"   /* for PaUtil_GetMeasurementTime() */
 
 
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate )
@@ -62,39 +64,114 @@ void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double s
     assert( sampleRate > 0 );
 
     measurer->samplingPeriod = 1. / sampleRate;
-    measurer->averageLoad = 0.;
+    measurer->timeConstant = PA_CPU_LOAD_DEFAULT_TIME_CONSTANT;
+    measurer->measureThreadCpuTime = 0;
+    PaUtil_ResetCpuLoadMeasurer( measurer );
 }
 
 void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer )
 {
     measurer->averageLoad = 0.;
+    measurer->averageThreadLoad = 0.;
+    measurer->maxLoad = 0.;
+    measurer->maxThreadLoad = 0.;
+    measurer->measurementCount = 0;
+    memset( measurer->loadHistogram, 0, sizeof(measurer->loadHistogram) );
+    memset( measurer->threadLoadHistogram, 0, sizeof(measurer->threadLoadHistogram) );
+}
+
+PaError PaUtil_ConfigureCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer,
+        double timeConstant, int measureThreadCpuTime )
+{
+    if( measureThreadCpuTime && PaUtil_GetThreadCpuTime() < 0. )
+        return paInvalidFlag;
+
+    measurer->timeConstant = ( timeConstant > 0. ) ? timeConstant : PA_CPU_LOAD_DEFAULT_TIME_CONSTANT;
+    measurer->measureThreadCpuTime = measureThreadCpuTime ? 1 : 0;
+
+    return paNoError;
 }
 
 void PaUtil_BeginCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer )
 {
-    measurer->measurementStartTime = PaUtil_GetTime();
+    measurer->measurementStartTime = PaUtil_GetMeasurementTime();
+
+    if( measurer->measureThreadCpuTime )
+        measurer->measurementStartThreadCpuTime = PaUtil_GetThreadCpuTime();
+}
+
+
+/* loads are bucketed relative to 2^-12, four buckets per octave */
+#define PA_CPU_LOAD_HISTOGRAM_SCALE_    (4096.)
+
+static const double quarterOctaves_[4] = { 1.189207115, 1.414213562, 1.681792831, 2. };
+
+static int LoadToHistogramBucket( double load )
+{
+    int octave = 0, bucket;
+
+    load *= PA_CPU_LOAD_HISTOGRAM_SCALE_;
+    if( load < 1. )
+        return 0;
+
+    while( load >= 2. && octave < PA_CPU_LOAD_HISTOGRAM_BUCKETS / 4 )
+    {
+        load *= .5;
+        ++octave;
+    }
+
+    bucket = 1 + octave * 4 + (load >= quarterOctaves_[0]) + (load >= quarterOctaves_[1])
+            + (load >= quarterOctaves_[2]);
+
+    return ( bucket < PA_CPU_LOAD_HISTOGRAM_BUCKETS ) ? bucket : PA_CPU_LOAD_HISTOGRAM_BUCKETS - 1;
+}
+
+/* the exclusive upper bound of a bucket */
+static double HistogramBucketUpperBound( int bucket )
+{
+    if( bucket == 0 )
+        return 1. / PA_CPU_LOAD_HISTOGRAM_SCALE_;
+
+    return (double)( 1UL << ((bucket - 1) / 4) ) * quarterOctaves_[ (bucket - 1) % 4 ]
+            / PA_CPU_LOAD_HISTOGRAM_SCALE_;
 }
 
 
 void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned long framesProcessed )
 {
-    double measurementEndTime, secondsFor100Percent, measuredLoad;
+    double measurementEndTime, secondsFor100Percent, measuredLoad, coefficient;
 
     if( framesProcessed > 0 ){
-        measurementEndTime = PaUtil_GetTime();
+        measurementEndTime = PaUtil_GetMeasurementTime();
 
         assert( framesProcessed > 0 );
         secondsFor100Percent = framesProcessed * measurer->samplingPeriod;
 
         measuredLoad = (measurementEndTime - measurer->measurementStartTime) / secondsFor100Percent;
 
-        /* Low pass filter the calculated CPU load to reduce jitter using a simple IIR low pass filter. */
-        /** FIXME @todo these coefficients shouldn't be hardwired see: http://www.portaudio.com/trac/ticket/113 */
-#define LOWPASS_COEFFICIENT_0   (0.9)
-#define LOWPASS_COEFFICIENT_1   (0.99999 - LOWPASS_COEFFICIENT_0)
-
-        measurer->averageLoad = (LOWPASS_COEFFICIENT_0 * measurer->averageLoad) +
-                               (LOWPASS_COEFFICIENT_1 * measuredLoad);
+        /* Low pass filter the calculated CPU load to reduce jitter using a
+            first order IIR low pass filter. The coefficient is the discrete
+            equivalent of an RC filter with the configured time constant,
+            sampled once per buffer. */
+        coefficient = secondsFor100Percent / (measurer->timeConstant + secondsFor100Percent);
+
+        measurer->averageLoad += coefficient * (measuredLoad - measurer->averageLoad);
+        if( measuredLoad > measurer->maxLoad )
+            measurer->maxLoad = measuredLoad;
+        ++measurer->loadHistogram[ LoadToHistogramBucket( measuredLoad ) ];
+
+        if( measurer->measureThreadCpuTime )
+        {
+            measuredLoad = (PaUtil_GetThreadCpuTime() - measurer->measurementStartThreadCpuTime)
+                    / secondsFor100Percent;
+
+            measurer->averageThreadLoad += coefficient * (measuredLoad - measurer->averageThreadLoad);
+            if( measuredLoad > measurer->maxThreadLoad )
+                measurer->maxThreadLoad = measuredLoad;
+            ++measurer->threadLoadHistogram[ LoadToHistogramBucket( measuredLoad ) ];
+        }
+
+        ++measurer->measurementCount;
     }
 }
 
@@ -103,3 +180,47 @@ double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer )
 {
     return measurer->averageLoad;
 }
+
+
+double PaUtil_GetThreadCpuLoad( PaUtilCpuLoadMeasurer* measurer )
+{
+    return measurer->measureThreadCpuTime ? measurer->averageThreadLoad : 0.;
+}
+
+
+double PaUtil_GetCpuLoadPercentile( PaUtilCpuLoadMeasurer* measurer,
+        double percentile, int threadCpuTime )
+{
+    const unsigned long *histogram = threadCpuTime ? measurer->threadLoadHistogram : measurer->loadHistogram;
+    double maxLoad = threadCpuTime ? measurer->maxThreadLoad : measurer->maxLoad;
+    unsigned long total = 0, target, count = 0;
+    double result;
+    int i;
+
+    /* the histogram may be updated concurrently, so total it rather than
+        relying on measurementCount */
+    for( i=0; i < PA_CPU_LOAD_HISTOGRAM_BUCKETS; ++i )
+        total += histogram[i];
+
+    if( total == 0 )
+        return 0.;
+
+    if( percentile < 0. )
+        percentile = 0.;
+    else if( percentile > 1. )
+        percentile = 1.;
+
+    target = (unsigned long)( percentile * total + .5 );
+    if( target == 0 )
+        target = 1;
+
+    for( i=0; i < PA_CPU_LOAD_HISTOGRAM_BUCKETS - 1; ++i )
+    {
+        count += histogram[i];
+        if( count >= target )
+            break;
+    }
+
+    result = HistogramBucketUpperBound( i );
+    return ( i == PA_CPU_LOAD_HISTOGRAM_BUCKETS - 1 || result > maxLoad ) ? maxLoad : result;
+}
@@ -47,24 +47,84 @@
 */
 
 
+#include "portaudio.h"
+
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
 
-typedef struct {
+/** The time constant, in seconds, of the low pass filter applied to the
+ average load unless PaUtil_ConfigureCpuLoadMeasurer() is used.
+*/
+#define PA_CPU_LOAD_DEFAULT_TIME_CONSTANT   (0.05)
+
+/** The number of buckets in the per-callback load histograms. Bucket 0 holds
+ loads below 2^-12, the last bucket loads of 2^3.75 and above; the buckets in
+ between are a quarter of an octave wide.
+*/
+#define PA_CPU_LOAD_HISTOGRAM_BUCKETS       (64)
+
+
+typedef struct PaUtilCpuLoadMeasurer {
     double samplingPeriod;
     double measurementStartTime;
     double averageLoad;
+    double timeConstant;            /**< seconds, see PaUtil_ConfigureCpuLoadMeasurer */
+    int measureThreadCpuTime;       /**< also measure the CPU time of the calling thread */
+    double measurementStartThreadCpuTime;
+    double averageThreadLoad;
+    double maxLoad;
+    double maxThreadLoad;
+    unsigned long measurementCount;
+    unsigned long loadHistogram[ PA_CPU_LOAD_HISTOGRAM_BUCKETS ];
+    unsigned long threadLoadHistogram[ PA_CPU_LOAD_HISTOGRAM_BUCKETS ];
 } PaUtilCpuLoadMeasurer; /**< @todo need better name than measurer */
 
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate );
 void PaUtil_BeginCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer );
 void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned long framesProcessed );
+
+/** Clear the average loads, the maxima and the histograms. */
 void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer );
+
+/** Return the low pass filtered load, based on the wall clock. */
 double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer );
 
+/** Set the time constant of the low pass filter applied to the average
+ loads, and whether the CPU time of the measuring thread is measured in
+ addition to the wall clock time. Must not be called while measurements
+ are being made.
+
+ @param timeConstant The time constant in seconds. Values <= 0 select
+ PA_CPU_LOAD_DEFAULT_TIME_CONSTANT.
+
+ @return paNoError, or paInvalidFlag if measureThreadCpuTime is non-zero and
+ PaUtil_GetThreadCpuTime() is not available on this platform.
+*/
+PaError PaUtil_ConfigureCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer,
+        double timeConstant, int measureThreadCpuTime );
+
+/** Return the low pass filtered load based on the CPU time consumed by the
+ measuring thread, or 0 if thread CPU time is not measured. Unlike the wall
+ clock load this does not include time the thread spent preempted.
+*/
+double PaUtil_GetThreadCpuLoad( PaUtilCpuLoadMeasurer* measurer );
+
+/** Estimate a percentile of the per-callback load from the histogram.
+
+ @param percentile The percentile as a fraction, e.g. 0.99.
+
+ @param threadCpuTime Non-zero to query the thread CPU time histogram.
+
+ @return The upper bound of the histogram bucket containing the percentile,
+ limited to the largest load measured, or 0 if nothing has been measured.
+*/
+double PaUtil_GetCpuLoadPercentile( PaUtilCpuLoadMeasurer* measurer,
+        double percentile, int threadCpuTime );
+
 
 #ifdef __cplusplus
 }
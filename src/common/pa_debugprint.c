@@ -52,8 +52,10 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "pa_debugprint.h"
+#include "pa_memorybarrier.h"
 
 // for OutputDebugStringA
 #if defined(_MSC_VER) && defined(PA_ENABLE_MSVC_DEBUG_OUTPUT)
@@ -79,14 +81,495 @@ void PaUtil_SetDebugPrintFunction(PaUtilLogCallback cb)
 	   According to MSDN "vsnprintf is identical to _vsnprintf". So we use _vsnprintf with MSC.
 	*/
 	#define VSNPRINTF  _vsnprintf 
+	#define SNPRINTF   _snprintf
 #else
 	#define VSNPRINTF  vsnprintf
+	#define SNPRINTF   snprintf
 #endif
 
 #define PA_LOG_BUF_SIZE 2048
 
+/*
+    Deferred mode
+
+    PaUtil_DebugPrint() formats and writes its message synchronously, which
+    is not acceptable on a real-time audio thread. In deferred mode the
+    format pointer and the raw argument values are captured into a fixed
+    size record and pushed onto a bounded lock-free multi-producer queue.
+    A background thread pops the records, formats them and passes the text
+    to the user callback or stderr. Capturing a message scans the format
+    once and copies at most PA_LOG_STRING_BYTES of %s arguments, so its cost
+    is bounded and it never allocates, locks or blocks. When the queue is
+    full the message is dropped and counted, and the background thread
+    reports the count.
+
+    Supported conversions are those of C89 printf plus the hh, h, l, ll, z,
+    j and t length modifiers. The format string must remain valid until the
+    message is emitted, which holds for the string literals used with
+    PA_DEBUG(). Formatting stops at an unsupported conversion (%n, %L...) or
+    after PA_LOG_MAX_ARGS arguments.
+*/
+
+#if defined(__GNUC__)
+#define PA_LOG_COMPARE_AND_SWAP_( pointer, oldValue, newValue ) \
+        __sync_bool_compare_and_swap( (pointer), (oldValue), (newValue) )
+#define PA_LOG_INCREMENT_( pointer ) __sync_add_and_fetch( (pointer), 1 )
+#define PA_LOG_DECREMENT_( pointer ) __sync_sub_and_fetch( (pointer), 1 )
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define PA_LOG_COMPARE_AND_SWAP_( pointer, oldValue, newValue ) \
+        (_InterlockedCompareExchange( (pointer), (newValue), (oldValue) ) == (oldValue))
+#define PA_LOG_INCREMENT_( pointer ) _InterlockedIncrement( (pointer) )
+#define PA_LOG_DECREMENT_( pointer ) _InterlockedDecrement( (pointer) )
+#endif
+
+#ifdef PA_LOG_COMPARE_AND_SWAP_
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define PA_LOG_QUEUE_RECORDS        (128)   /* must be a power of two */
+#define PA_LOG_MAX_ARGS             (12)
+#define PA_LOG_STRING_BYTES         (160)
+#define PA_LOG_DRAIN_INTERVAL_MSEC  (10)
+
+typedef enum PaUtilLogArgumentType
+{
+    paUtilLogInt,
+    paUtilLogLong,
+    paUtilLogLongLong,
+    paUtilLogSize,
+    paUtilLogDouble,
+    paUtilLogPointer,
+    paUtilLogString         /* offset into the record's string buffer */
+} PaUtilLogArgumentType;
+
+typedef struct PaUtilLogArgument
+{
+    unsigned char type;
+    union
+    {
+        int i;
+        long l;
+        long long ll;
+        size_t z;
+        double d;
+        const void *p;
+        unsigned int stringOffset;
+    } value;
+} PaUtilLogArgument;
+
+typedef struct PaUtilLogRecord
+{
+    volatile long sequence;
+    const char *format;
+    const char *formatEnd;  /* where formatting stops, after the last captured conversion */
+    int argumentCount;
+    PaUtilLogArgument arguments[ PA_LOG_MAX_ARGS ];
+    char strings[ PA_LOG_STRING_BYTES ];
+} PaUtilLogRecord;
+
+static PaUtilLogRecord logQueue_[ PA_LOG_QUEUE_RECORDS ];
+static volatile long logQueueTail_ = 0;    /* next record to be claimed by a producer */
+static long logQueueHead_ = 0;             /* next record to be emitted, only used by the log thread */
+static volatile long droppedMessages_ = 0;
+static volatile int deferredMode_ = 0;
+static volatile long logProducers_ = 0;    /* PaUtil_DebugPrint() calls that may be pushing a record */
+static volatile int logThreadRunning_ = 0;
+
+#if defined(_WIN32)
+static HANDLE logThread_ = NULL;
+#else
+static pthread_t logThread_;
+#endif
+
+
+/* Parse the conversion specification which starts after '%'. Sets *starCount
+ to the number of '*' widths and precisions it consumes and returns the
+ argument type, or -1 for a literal '%' and -2 for an unsupported conversion.
+ *end is set to the character after the conversion. */
+static int ParseConversion( const char *p, const char **end, int *starCount )
+{
+    int length = 0; /* 0 none or h/hh, 1 l, 2 ll/j, 3 z/t */
+    int type;
+
+    *starCount = 0;
+
+    while( *p && strchr( "-+ #0", *p ) )
+        ++p;
+    if( *p == '*' ) { ++*starCount; ++p; }
+    while( *p >= '0' && *p <= '9' )
+        ++p;
+    if( *p == '.' )
+    {
+        ++p;
+        if( *p == '*' ) { ++*starCount; ++p; }
+        while( *p >= '0' && *p <= '9' )
+            ++p;
+    }
+
+    if( *p == 'h' ) { ++p; if( *p == 'h' ) ++p; }
+    else if( *p == 'l' ) { ++p; length = 1; if( *p == 'l' ) { ++p; length = 2; } }
+    else if( *p == 'j' ) { ++p; length = 2; }
+    else if( *p == 'z' || *p == 't' ) { ++p; length = 3; }
+
+    switch( *p )
+    {
+    case '%':
+        type = -1;
+        break;
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        type = (length == 1) ? paUtilLogLong : (length == 2) ? paUtilLogLongLong
+                : (length == 3) ? paUtilLogSize : paUtilLogInt;
+        break;
+    case 'c':
+        type = (length == 0) ? paUtilLogInt : -2;
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        type = paUtilLogDouble;
+        break;
+    case 'p':
+        type = paUtilLogPointer;
+        break;
+    case 's':
+        type = (length == 0) ? paUtilLogString : -2;
+        break;
+    default:
+        type = -2;
+        break;
+    }
+
+    *end = *p ? p + 1 : p;
+    return type;
+}
+
+
+static void CaptureLogMessage( PaUtilLogRecord *record, const char *format, va_list ap )
+{
+    const char *p = format, *end;
+    unsigned int stringsUsed = 0;
+    int type, starCount, i;
+
+    record->format = format;
+    record->argumentCount = 0;
+
+    while( (p = strchr( p, '%' )) != NULL )
+    {
+        type = ParseConversion( p + 1, &end, &starCount );
+        if( type == -2 || record->argumentCount + starCount + (type >= 0) > PA_LOG_MAX_ARGS )
+            break;
+
+        for( i=0; i < starCount; ++i )
+        {
+            PaUtilLogArgument *argument = &record->arguments[ record->argumentCount++ ];
+            argument->type = paUtilLogInt;
+            argument->value.i = va_arg( ap, int );
+        }
+
+        if( type >= 0 )
+        {
+            PaUtilLogArgument *argument = &record->arguments[ record->argumentCount++ ];
+            argument->type = (unsigned char)type;
+            switch( type )
+            {
+            case paUtilLogInt: argument->value.i = va_arg( ap, int ); break;
+            case paUtilLogLong: argument->value.l = va_arg( ap, long ); break;
+            case paUtilLogLongLong: argument->value.ll = va_arg( ap, long long ); break;
+            case paUtilLogSize: argument->value.z = va_arg( ap, size_t ); break;
+            case paUtilLogDouble: argument->value.d = va_arg( ap, double ); break;
+            case paUtilLogPointer: argument->value.p = va_arg( ap, void* ); break;
+            case paUtilLogString:
+                {
+                    const char *s = va_arg( ap, const char* );
+                    /* once the buffer is full, later strings point at its final terminator and print empty */
+                    argument->value.stringOffset = stringsUsed < PA_LOG_STRING_BYTES ? stringsUsed : PA_LOG_STRING_BYTES - 1;
+                    if( !s )
+                        s = "(null)";
+                    /* copy what fits, the string buffer always ends with a terminator */
+                    while( *s && stringsUsed < PA_LOG_STRING_BYTES - 1 )
+                        record->strings[ stringsUsed++ ] = *s++;
+                    if( stringsUsed < PA_LOG_STRING_BYTES )
+                        record->strings[ stringsUsed++ ] = '\0';
+                    else
+                        record->strings[ PA_LOG_STRING_BYTES - 1 ] = '\0';
+                }
+                break;
+            }
+        }
+
+        p = end;
+    }
+
+    record->formatEnd = p ? p : format + strlen( format );
+}
+
+
+/* Format one conversion with its captured '*' values and argument. */
+static int FormatLogArgument( char *buffer, size_t size, const char *spec,
+        const PaUtilLogRecord *record, const PaUtilLogArgument *stars, int starCount,
+        const PaUtilLogArgument *argument )
+{
+#define PA_LOG_FORMAT_( x ) \
+    ( starCount == 0 ? SNPRINTF( buffer, size, spec, x ) \
+    : starCount == 1 ? SNPRINTF( buffer, size, spec, stars[0].value.i, x ) \
+    : SNPRINTF( buffer, size, spec, stars[0].value.i, stars[1].value.i, x ) )
+
+    if( !argument ) /* "%%" */
+        return SNPRINTF( buffer, size, "%%" );
+
+    switch( argument->type )
+    {
+    case paUtilLogInt: return PA_LOG_FORMAT_( argument->value.i );
+    case paUtilLogLong: return PA_LOG_FORMAT_( argument->value.l );
+    case paUtilLogLongLong: return PA_LOG_FORMAT_( argument->value.ll );
+    case paUtilLogSize: return PA_LOG_FORMAT_( argument->value.z );
+    case paUtilLogDouble: return PA_LOG_FORMAT_( argument->value.d );
+    case paUtilLogPointer: return PA_LOG_FORMAT_( argument->value.p );
+    case paUtilLogString: return PA_LOG_FORMAT_( record->strings + argument->value.stringOffset );
+    }
+    return 0;
+
+#undef PA_LOG_FORMAT_
+}
+
+
+static void FormatLogRecord( const PaUtilLogRecord *record, char *buffer, size_t size )
+{
+    const char *p = record->format, *end;
+    size_t used = 0;
+    int argumentIndex = 0, type, starCount, n;
+    char spec[32];
+
+    while( p < record->formatEnd && used < size - 1 )
+    {
+        if( *p != '%' )
+        {
+            buffer[ used++ ] = *p++;
+            continue;
+        }
+
+        type = ParseConversion( p + 1, &end, &starCount );
+        if( (size_t)(end - p) >= sizeof(spec) )
+            break;
+        memcpy( spec, p, end - p );
+        spec[ end - p ] = '\0';
+
+        n = FormatLogArgument( buffer + used, size - used, spec, record,
+                &record->arguments[ argumentIndex ], starCount,
+                (type >= 0) ? &record->arguments[ argumentIndex + starCount ] : NULL );
+        argumentIndex += starCount + (type >= 0);
+
+        if( n > 0 )
+            used += ( (size_t)n < size - used ) ? (size_t)n : size - used - 1;
+        p = end;
+    }
+    buffer[ used ] = '\0';
+
+    /* mark messages cut short by an unsupported conversion */
+    if( *record->formatEnd != '\0' && used < size - 1 )
+        SNPRINTF( buffer + used, size - used, "...\n" );
+}
+
+
+static void EmitLogMessage( const char *text )
+{
+#if defined(_MSC_VER) && defined(PA_ENABLE_MSVC_DEBUG_OUTPUT)
+    OutputDebugStringA( text );
+#endif
+
+    if( userCB != NULL )
+    {
+        userCB( text );
+    }
+    else
+    {
+        fputs( text, stderr );
+        fflush( stderr );
+    }
+}
+
+/* Emit all queued records, returns the number emitted. */
+static int DrainLogQueue( void )
+{
+    char text[ PA_LOG_BUF_SIZE ];
+    int count = 0;
+    long dropped;
+
+    for( ;; )
+    {
+        PaUtilLogRecord *record = &logQueue_[ logQueueHead_ & (PA_LOG_QUEUE_RECORDS - 1) ];
+        if( record->sequence != logQueueHead_ + 1 )
+            break;
+        PaUtil_ReadMemoryBarrier();
+
+        FormatLogRecord( record, text, sizeof(text) );
+        EmitLogMessage( text );
+
+        /* hand the record back to the producers for the next lap */
+        PaUtil_FullMemoryBarrier();
+        record->sequence = logQueueHead_ + PA_LOG_QUEUE_RECORDS;
+        ++logQueueHead_;
+        ++count;
+    }
+
+    dropped = droppedMessages_;
+    if( dropped > 0 && PA_LOG_COMPARE_AND_SWAP_( &droppedMessages_, dropped, 0 ) )
+    {
+        SNPRINTF( text, sizeof(text), "PaUtil_DebugPrint: %ld deferred messages dropped\n", dropped );
+        EmitLogMessage( text );
+    }
+
+    return count;
+}
+
+
+static void PushLogMessage( const char *format, va_list ap )
+{
+    PaUtilLogRecord *record;
+    long position = logQueueTail_;
+    long difference;
+
+    for( ;; )
+    {
+        record = &logQueue_[ position & (PA_LOG_QUEUE_RECORDS - 1) ];
+        difference = (long)( (unsigned long)record->sequence - (unsigned long)position );
+        if( difference == 0 )
+        {
+            if( PA_LOG_COMPARE_AND_SWAP_( &logQueueTail_, position, position + 1 ) )
+                break;
+        }
+        else if( difference < 0 )
+        {
+            PA_LOG_INCREMENT_( &droppedMessages_ ); /* queue full */
+            return;
+        }
+        position = logQueueTail_;
+    }
+
+    CaptureLogMessage( record, format, ap );
+
+    /* publish the record only after it has been written */
+    PaUtil_WriteMemoryBarrier();
+    record->sequence = position + 1;
+}
+
+
+#if defined(_WIN32)
+static DWORD WINAPI LogThreadFunc( LPVOID userData )
+#else
+static void *LogThreadFunc( void *userData )
+#endif
+{
+    (void) userData;
+
+    while( logThreadRunning_ )
+    {
+        DrainLogQueue();
+#if defined(_WIN32)
+        Sleep( PA_LOG_DRAIN_INTERVAL_MSEC );
+#else
+        {
+            struct timespec interval = { 0, PA_LOG_DRAIN_INTERVAL_MSEC * 1000000L };
+            nanosleep( &interval, NULL );
+        }
+#endif
+    }
+
+    return 0;
+}
+
+
+PaError PaUtil_SetDebugPrintDeferred( int deferred )
+{
+    long i;
+
+    if( deferred && !logThreadRunning_ )
+    {
+        for( i=0; i < PA_LOG_QUEUE_RECORDS; ++i )
+            logQueue_[i].sequence = logQueueHead_ + i;
+        logQueueTail_ = logQueueHead_;
+        PaUtil_WriteMemoryBarrier();
+
+        logThreadRunning_ = 1;
+#if defined(_WIN32)
+        logThread_ = CreateThread( NULL, 0, LogThreadFunc, NULL, 0, NULL );
+        if( logThread_ == NULL )
+#else
+        if( pthread_create( &logThread_, NULL, LogThreadFunc, NULL ) != 0 )
+#endif
+        {
+            logThreadRunning_ = 0;
+            return paUnanticipatedHostError;
+        }
+        deferredMode_ = 1;
+    }
+    else if( !deferred && logThreadRunning_ )
+    {
+        /* messages pushed while the thread winds down are emitted by the final drain,
+            once every producer that saw deferred mode has published its record */
+        deferredMode_ = 0;
+        PaUtil_FullMemoryBarrier();
+        while( logProducers_ > 0 )
+        {
+#if defined(_WIN32)
+            Sleep( 0 );
+#else
+            struct timespec interval = { 0, 100000L };
+            nanosleep( &interval, NULL );
+#endif
+        }
+        logThreadRunning_ = 0;
+#if defined(_WIN32)
+        WaitForSingleObject( logThread_, INFINITE );
+        CloseHandle( logThread_ );
+        logThread_ = NULL;
+#else
+        pthread_join( logThread_, NULL );
+#endif
+        DrainLogQueue();
+    }
+
+    return paNoError;
+}
+
+#else /* PA_LOG_COMPARE_AND_SWAP_ */
+
+/* deferred mode needs atomic operations */
+
+PaError PaUtil_SetDebugPrintDeferred( int deferred )
+{
+    return deferred ? paInternalError : paNoError;
+}
+
+#endif /* PA_LOG_COMPARE_AND_SWAP_ */
+
+
 void PaUtil_DebugPrint( const char *format, ... )
 {
+#ifdef PA_LOG_COMPARE_AND_SWAP_
+    if( deferredMode_ )
+    {
+        /* registering is a full barrier, so either PaUtil_SetDebugPrintDeferred()
+            waits for this push or we see deferred mode switched off */
+        PA_LOG_INCREMENT_( &logProducers_ );
+        if( deferredMode_ )
+        {
+            va_list ap;
+            va_start(ap, format);
+            PushLogMessage( format, ap );
+            va_end(ap);
+            PA_LOG_DECREMENT_( &logProducers_ );
+            return;
+        }
+        PA_LOG_DECREMENT_( &logProducers_ );
+    }
+#endif
+
 	// Optional logging into Output console of Visual Studio
 #if defined(_MSC_VER) && defined(PA_ENABLE_MSVC_DEBUG_OUTPUT)
 	{
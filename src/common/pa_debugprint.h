@@ -40,6 +40,8 @@
 */
 
 
+#include "portaudio.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -141,6 +143,19 @@ typedef void (*PaUtilLogCallback ) (const char *log);
 */
 void PaUtil_SetDebugPrintFunction(PaUtilLogCallback  cb);
 
+/**
+    Enable or disable deferred debug output. When enabled, PaUtil_DebugPrint
+    only captures the format pointer and argument values into a lock-free
+    queue, which is bounded, allocation free and safe to call from real-time
+    threads. A background thread formats the messages and passes them to the
+    log function, so the log function is then called from that thread.
+    Disabling deferred output stops the thread and emits the queued messages.
+
+    @return paNoError, or paUnanticipatedHostError if the thread could not be
+    started.
+*/
+PaError PaUtil_SetDebugPrintDeferred( int deferred );
+
 
 
 #ifdef __cplusplus
@@ -73,6 +73,8 @@
 #include "pa_types.h"
 #include "pa_hostapi.h"
 #include "pa_stream.h"
+#include "pa_cpuload.h"
+#include "pa_process.h"
 #include "pa_trace.h" /* still usefull?*/
 #include "pa_debugprint.h"
 
@@ -114,7 +116,251 @@ void PaUtil_SetLastHostErrorInfo( PaHostApiTypeId hostApiType, long errorCode,
 
 
 
+/*
+    Allocation accounting. The counters are updated by the platform specific
+    allocators on every PaUtil_AllocateMemory()/PaUtil_FreeMemory() call so
+    they must stay cheap: relaxed atomic adds where the compiler provides
+    them, plain adds otherwise. Peaks are updated without a compare-and-swap
+    and may miss a concurrent maximum.
+*/
+
+#if defined(__ATOMIC_RELAXED)
+#define PA_ATOMIC_ADD_( pointer, value ) __atomic_add_fetch( (pointer), (value), __ATOMIC_RELAXED )
+#elif defined(_MSC_VER) && (_MSC_VER >= 1400)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchangeAdd)
+#define PA_ATOMIC_ADD_( pointer, value ) (_InterlockedExchangeAdd( (pointer), (value) ) + (value))
+#else
+#define PA_ATOMIC_ADD_( pointer, value ) (*(pointer) += (value))
+#endif
+
+/* Allocations after stream start are only counted on threads marked by
+    PaUtil_MarkAudioThread(). Without thread local storage every allocation
+    made while a stream is started is counted. */
+#if defined(__GNUC__)
+#define PA_THREAD_LOCAL_ __thread
+#elif defined(_MSC_VER)
+#define PA_THREAD_LOCAL_ __declspec(thread)
+#endif
+
+#ifdef PA_THREAD_LOCAL_
+static PA_THREAD_LOCAL_ int isAudioThread_ = 0;
+#define PA_IS_AUDIO_THREAD_ (isAudioThread_)
+#else
+#define PA_IS_AUDIO_THREAD_ (1)
+#endif
+
+typedef struct PaAllocationCounters
+{
+    volatile long currentBytes;
+    volatile long currentBlocks;
+    volatile long peakBytes;
+    volatile long totalBlocks;
+} PaAllocationCounters;
+
+/* the last entry holds the total of all categories */
+static PaAllocationCounters allocationCounters_[ paAllocationCategoryCount + 1 ];
+
+static volatile long startedStreamCount_ = 0;
+static volatile long allocationsAfterStreamStart_ = 0;
+static volatile long bytesAllocatedAfterStreamStart_ = 0;
+
+#define PA_VALID_ALLOCATION_CATEGORY_( category ) \
+    ( ((unsigned int)(category) < (unsigned int)paAllocationCategoryCount) ? (category) : paAllocationHostApi )
+
+
+static void CountAllocation( PaAllocationCounters *counters, long size )
+{
+    long currentBytes = PA_ATOMIC_ADD_( &counters->currentBytes, size );
+    PA_ATOMIC_ADD_( &counters->currentBlocks, 1 );
+    PA_ATOMIC_ADD_( &counters->totalBlocks, 1 );
+
+    if( currentBytes > counters->peakBytes )
+        counters->peakBytes = currentBytes;
+}
+
+
+void PaUtil_AccountAllocation( PaAllocationCategory category, long size )
+{
+    CountAllocation( &allocationCounters_[ PA_VALID_ALLOCATION_CATEGORY_( category ) ], size );
+    CountAllocation( &allocationCounters_[ paAllocationCategoryCount ], size );
+
+    if( startedStreamCount_ > 0 && PA_IS_AUDIO_THREAD_ )
+    {
+        PA_ATOMIC_ADD_( &allocationsAfterStreamStart_, 1 );
+        PA_ATOMIC_ADD_( &bytesAllocatedAfterStreamStart_, size );
+    }
+}
+
+
+void PaUtil_AccountFree( PaAllocationCategory category, long size )
+{
+    PaAllocationCounters *counters = &allocationCounters_[ PA_VALID_ALLOCATION_CATEGORY_( category ) ];
+    PaAllocationCounters *total = &allocationCounters_[ paAllocationCategoryCount ];
+
+    PA_ATOMIC_ADD_( &counters->currentBytes, -size );
+    PA_ATOMIC_ADD_( &counters->currentBlocks, -1 );
+    PA_ATOMIC_ADD_( &total->currentBytes, -size );
+    PA_ATOMIC_ADD_( &total->currentBlocks, -1 );
+}
+
+
+void PaUtil_MarkAudioThread( void )
+{
+#ifdef PA_THREAD_LOCAL_
+    isAudioThread_ = 1;
+#endif
+}
+
+
+int PaUtil_CountCurrentlyAllocatedBlocks( void )
+{
+    return (int)allocationCounters_[ paAllocationCategoryCount ].currentBlocks;
+}
+
+
+/* called by Pa_StartStream() and friends so allocations made while a stream
+    is running can be reported */
+static void SetStreamStarted( PaStream *stream, int started )
+{
+    PaUtilStreamRepresentation *streamRep = PA_STREAM_REP( stream );
+
+    if( started && !streamRep->isStarted )
+    {
+        streamRep->isStarted = 1;
+        PA_ATOMIC_ADD_( &startedStreamCount_, 1 );
+    }
+    else if( !started && streamRep->isStarted )
+    {
+        streamRep->isStarted = 0;
+        PA_ATOMIC_ADD_( &startedStreamCount_, -1 );
+    }
+}
+
+
+static void GetAllocationCounters( PaAllocationCategoryStatistics *statistics,
+        const PaAllocationCounters *counters )
+{
+    /* a concurrent free may briefly drive a counter below zero */
+    statistics->currentBytes = (counters->currentBytes > 0) ? counters->currentBytes : 0;
+    statistics->currentBlocks = (counters->currentBlocks > 0) ? counters->currentBlocks : 0;
+    statistics->peakBytes = counters->peakBytes;
+    statistics->totalBlocks = counters->totalBlocks;
+}
+
+
+PaError Pa_GetAllocationStatistics( PaAllocationStatistics *statistics )
+{
+    int i;
+
+    if( !statistics )
+        return paBadBufferPtr;
+
+    statistics->structVersion = 1;
+
+    for( i=0; i < paAllocationCategoryCount; ++i )
+        GetAllocationCounters( &statistics->categories[i], &allocationCounters_[i] );
+
+    GetAllocationCounters( &statistics->total, &allocationCounters_[ paAllocationCategoryCount ] );
+
+    statistics->allocationsAfterStreamStart = allocationsAfterStreamStart_;
+    statistics->bytesAllocatedAfterStreamStart = bytesAllocatedAfterStreamStart_;
+
+    return paNoError;
+}
+
+
+void Pa_ResetAllocationStatistics( void )
+{
+    int i;
+
+    for( i=0; i <= paAllocationCategoryCount; ++i )
+    {
+        allocationCounters_[i].peakBytes = allocationCounters_[i].currentBytes;
+        allocationCounters_[i].totalBlocks = 0;
+    }
+
+    allocationsAfterStreamStart_ = 0;
+    bytesAllocatedAfterStreamStart_ = 0;
+}
+
+
+typedef struct PaJsonWriter
+{
+    char *buffer;
+    unsigned long bufferSize;
+    unsigned long length;
+} PaJsonWriter;
+
+
+/* appends text, keeping buffer nul terminated and counting the full length */
+static void AppendJson( PaJsonWriter *writer, const char *text )
+{
+    while( *text )
+    {
+        if( writer->length + 1 < writer->bufferSize )
+        {
+            writer->buffer[ writer->length ] = *text;
+            writer->buffer[ writer->length + 1 ] = '\0';
+        }
+        ++writer->length;
+        ++text;
+    }
+}
+
+
+static void AppendJsonCounters( PaJsonWriter *writer, const char *name,
+        const PaAllocationCategoryStatistics *statistics )
+{
+    char text[ 160 ];
+
+    sprintf( text, "\"%s\":{\"currentBytes\":%lu,\"currentBlocks\":%lu,\"peakBytes\":%lu,\"totalBlocks\":%lu}",
+            name, statistics->currentBytes, statistics->currentBlocks,
+            statistics->peakBytes, statistics->totalBlocks );
+    AppendJson( writer, text );
+}
+
+
+int Pa_FormatAllocationStatisticsJson( const PaAllocationStatistics *statistics,
+        char *buffer, unsigned long bufferSize )
+{
+    static const char *categoryNames[ paAllocationCategoryCount ] =
+            { "hostApi", "deviceInfo", "bufferProcessor", "ringBuffer" };
+    PaJsonWriter writer;
+    char text[ 96 ];
+    int i;
+
+    if( !statistics )
+        return paBadBufferPtr;
+
+    writer.buffer = buffer;
+    writer.bufferSize = buffer ? bufferSize : 0;
+    writer.length = 0;
+    if( writer.bufferSize > 0 )
+        buffer[0] = '\0';
+
+    AppendJson( &writer, "{\"categories\":{" );
+    for( i=0; i < paAllocationCategoryCount; ++i )
+    {
+        if( i > 0 )
+            AppendJson( &writer, "," );
+        AppendJsonCounters( &writer, categoryNames[i], &statistics->categories[i] );
+    }
+    AppendJson( &writer, "}," );
+    AppendJsonCounters( &writer, "total", &statistics->total );
+
+    sprintf( text, ",\"allocationsAfterStreamStart\":%lu,\"bytesAllocatedAfterStreamStart\":%lu}",
+            statistics->allocationsAfterStreamStart, statistics->bytesAllocatedAfterStreamStart );
+    AppendJson( &writer, text );
+
+    return (int)writer.length;
+}
+
+
+
 static PaUtilHostApiRepresentation **hostApis_ = 0;
+static PaUtilDeviceInfoProbe **deviceInfoProbes_ = 0; /* indexed like hostApis_, see PaUtil_SetDeviceInfoProbe */
+static PaUtilDeviceListRefresher **deviceListRefreshers_ = 0; /* indexed like hostApis_ */
 static int hostApisCount_ = 0;
 static int defaultHostApiIndex_ = 0;
 static int initializationCount_ = 0;
@@ -144,6 +390,8 @@ static void TerminateHostApis( void )
     while( hostApisCount_ > 0 )
     {
         --hostApisCount_;
+        if( hostApis_[hostApisCount_]->privatePaFrontInfo.addedDevices )
+            PaUtil_FreeMemory( hostApis_[hostApisCount_]->privatePaFrontInfo.addedDevices );
         hostApis_[hostApisCount_]->Terminate( hostApis_[hostApisCount_] );
     }
     hostApisCount_ = 0;
@@ -154,6 +402,14 @@ static void TerminateHostApis( void )
         PaUtil_FreeMemory( hostApis_ );
     hostApis_ = 0;
 
+    if( deviceInfoProbes_ != 0 )
+        PaUtil_FreeMemory( deviceInfoProbes_ );
+    deviceInfoProbes_ = 0;
+
+    if( deviceListRefreshers_ != 0 )
+        PaUtil_FreeMemory( deviceListRefreshers_ );
+    deviceListRefreshers_ = 0;
+
     PA_DEBUG(("TerminateHostApis out\n"));
 }
 
@@ -173,6 +429,22 @@ static PaError InitializeHostApis( void )
         goto error; 
     }
 
+    deviceInfoProbes_ = (PaUtilDeviceInfoProbe**)PaUtil_AllocateMemory(
+            sizeof(PaUtilDeviceInfoProbe*) * initializerCount );
+    if( !deviceInfoProbes_ )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
+    deviceListRefreshers_ = (PaUtilDeviceListRefresher**)PaUtil_AllocateMemory(
+            sizeof(PaUtilDeviceListRefresher*) * initializerCount );
+    if( !deviceListRefreshers_ )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
     hostApisCount_ = 0;
     defaultHostApiIndex_ = -1; /* indicates that we haven't determined the default host API yet */
     deviceCount_ = 0;
@@ -181,6 +453,8 @@ static PaError InitializeHostApis( void )
     for( i=0; i< initializerCount; ++i )
     {
         hostApis_[hostApisCount_] = NULL;
+        deviceInfoProbes_[hostApisCount_] = NULL;
+        deviceListRefreshers_[hostApisCount_] = NULL;
 
         PA_DEBUG(( "before paHostApiInitializers[%d].\n",i));
 
@@ -207,6 +481,8 @@ static PaError InitializeHostApis( void )
             }
 
             hostApi->privatePaFrontInfo.baseDeviceIndex = baseDeviceIndex;
+            hostApi->privatePaFrontInfo.baseDeviceCount = hostApi->info.deviceCount;
+            hostApi->privatePaFrontInfo.addedDevices = NULL;
 
             if( hostApi->info.defaultInputDevice != paNoDevice )
                 hostApi->info.defaultInputDevice += baseDeviceIndex;
@@ -233,6 +509,34 @@ error:
 }
 
 
+void PaUtil_SetDeviceInfoProbe( PaHostApiIndex hostApiIndex, PaUtilDeviceInfoProbe *probe )
+{
+    deviceInfoProbes_[hostApiIndex] = probe;
+}
+
+
+void PaUtil_SetDeviceListRefresher( PaHostApiIndex hostApiIndex, PaUtilDeviceListRefresher *refresher )
+{
+    deviceListRefreshers_[hostApiIndex] = refresher;
+}
+
+
+/*
+    HostApiDeviceIndexToDeviceIndex() maps a valid host specific device index
+    to the global device index. Devices found at initialization occupy a
+    contiguous range, devices added by Pa_RefreshDeviceList() are appended to
+    the end of the global range in the order they appeared.
+*/
+static PaDeviceIndex HostApiDeviceIndexToDeviceIndex( PaUtilHostApiRepresentation *hostApi, int hostApiDeviceIndex )
+{
+    const PaUtilPrivatePaFrontHostApiInfo *frontInfo = &hostApi->privatePaFrontInfo;
+
+    if( hostApiDeviceIndex < frontInfo->baseDeviceCount )
+        return frontInfo->baseDeviceIndex + hostApiDeviceIndex;
+    return frontInfo->addedDevices[ hostApiDeviceIndex - frontInfo->baseDeviceCount ];
+}
+
+
 /*
     FindHostApi() finds the index of the host api to which
     <device> belongs and returns it. if <hostSpecificDeviceIndex> is
@@ -242,24 +546,42 @@ error:
 */
 static int FindHostApi( PaDeviceIndex device, int *hostSpecificDeviceIndex )
 {
-    int i=0;
+    PaDeviceIndex globalDevice = device;
+    int i=0, j;
 
     if( !PA_IS_INITIALISED_ )
         return -1;
 
-    if( device < 0 )
+    if( device < 0 || device >= deviceCount_ )
         return -1;
 
     while( i < hostApisCount_
-            && device >= hostApis_[i]->info.deviceCount )
+            && device >= hostApis_[i]->privatePaFrontInfo.baseDeviceCount )
     {
 
-        device -= hostApis_[i]->info.deviceCount;
+        device -= hostApis_[i]->privatePaFrontInfo.baseDeviceCount;
         ++i;
     }
 
     if( i >= hostApisCount_ )
+    {
+        /* device was added by Pa_RefreshDeviceList() */
+        for( i=0; i < hostApisCount_; ++i )
+        {
+            const PaUtilPrivatePaFrontHostApiInfo *frontInfo = &hostApis_[i]->privatePaFrontInfo;
+
+            for( j=0; j < hostApis_[i]->info.deviceCount - frontInfo->baseDeviceCount; ++j )
+            {
+                if( frontInfo->addedDevices[j] == globalDevice )
+                {
+                    if( hostSpecificDeviceIndex )
+                        *hostSpecificDeviceIndex = frontInfo->baseDeviceCount + j;
+                    return i;
+                }
+            }
+        }
         return -1;
+    }
 
     if( hostSpecificDeviceIndex )
         *hostSpecificDeviceIndex = device;
@@ -491,11 +813,10 @@ PaError PaUtil_DeviceIndexToHostApiDeviceIndex(
         PaDeviceIndex *hostApiDevice, PaDeviceIndex device, struct PaUtilHostApiRepresentation *hostApi )
 {
     PaError result;
-    PaDeviceIndex x;
+    int x;
+    int hostApiIndex = FindHostApi( device, &x );
     
-    x = device - hostApi->privatePaFrontInfo.baseDeviceIndex;
-
-    if( x < 0 || x >= hostApi->info.deviceCount )
+    if( hostApiIndex < 0 || hostApis_[hostApiIndex] != hostApi )
     {
         result = paInvalidDevice;
     }
@@ -627,7 +948,7 @@ PaDeviceIndex Pa_HostApiDeviceIndexToDeviceIndex( PaHostApiIndex hostApi, int ho
             }
             else
             {
-                result = hostApis_[hostApi]->privatePaFrontInfo.baseDeviceIndex + hostApiDeviceIndex;
+                result = HostApiDeviceIndexToDeviceIndex( hostApis_[hostApi], hostApiDeviceIndex );
             }
         }
     }
@@ -725,6 +1046,9 @@ const PaDeviceInfo* Pa_GetDeviceInfo( PaDeviceIndex device )
     }
     else
     {
+        if( deviceInfoProbes_[hostApiIndex] )
+            deviceInfoProbes_[hostApiIndex]( hostApis_[hostApiIndex], hostSpecificDeviceIndex );
+
         result = hostApis_[hostApiIndex]->deviceInfos[ hostSpecificDeviceIndex ];
 
         PA_LOGAPI(("Pa_GetDeviceInfo returned:\n" ));
@@ -744,6 +1068,79 @@ const PaDeviceInfo* Pa_GetDeviceInfo( PaDeviceIndex device )
 }
 
 
+/*
+    MapAddedDevices() assigns global device indices to the devices a host API
+    appended to its device list, starting with host specific index
+    <firstAdded>.
+*/
+static PaError MapAddedDevices( PaUtilHostApiRepresentation *hostApi, int firstAdded )
+{
+    PaUtilPrivatePaFrontHostApiInfo *frontInfo = &hostApi->privatePaFrontInfo;
+    int previousAdded = firstAdded - frontInfo->baseDeviceCount;
+    int added = hostApi->info.deviceCount - frontInfo->baseDeviceCount;
+    PaDeviceIndex *addedDevices;
+    int i;
+
+    addedDevices = (PaDeviceIndex*)PaUtil_AllocateMemory( sizeof(PaDeviceIndex) * added );
+    if( !addedDevices )
+        return paInsufficientMemory;
+
+    for( i=0; i < previousAdded; ++i )
+        addedDevices[i] = frontInfo->addedDevices[i];
+    for( ; i < added; ++i )
+        addedDevices[i] = deviceCount_++;
+
+    if( frontInfo->addedDevices )
+        PaUtil_FreeMemory( frontInfo->addedDevices );
+    frontInfo->addedDevices = addedDevices;
+
+    return paNoError;
+}
+
+
+PaError Pa_RefreshDeviceList( void )
+{
+    PaError result = paNoError, mapResult;
+    int i, previousDeviceCount;
+
+    PA_LOGAPI_ENTER( "Pa_RefreshDeviceList" );
+
+    if( !PA_IS_INITIALISED_ )
+    {
+        result = paNotInitialized;
+    }
+    else
+    {
+        for( i=0; i < hostApisCount_ && result == paNoError; ++i )
+        {
+            PaUtilHostApiRepresentation *hostApi = hostApis_[i];
+
+            if( !deviceListRefreshers_[i] )
+                continue;
+
+            previousDeviceCount = hostApi->info.deviceCount;
+            result = deviceListRefreshers_[i]( hostApi );
+
+            /* devices appended before a failure are still valid and must be mapped */
+            if( hostApi->info.deviceCount > previousDeviceCount )
+            {
+                mapResult = MapAddedDevices( hostApi, previousDeviceCount );
+                if( mapResult != paNoError )
+                {
+                    /* the host api finds the devices again on the next refresh */
+                    hostApi->info.deviceCount = previousDeviceCount;
+                    result = mapResult;
+                }
+            }
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_RefreshDeviceList", result );
+
+    return result;
+}
+
+
 /*
     SampleFormatIsValid() returns 1 if sampleFormat is a sample format
     defined in portaudio.h, or 0 otherwise.
@@ -968,7 +1365,7 @@ static PaError ValidateOpenStreamParameters(
     if( (sampleRate < 1000.0) || (sampleRate > 384000.0) )
         return paInvalidSampleRate;
 
-    if( ((streamFlags & ~paPlatformSpecificFlags) & ~(paClipOff | paDitherOff | paNeverDropInput | paPrimeOutputBuffersUsingStreamCallback ) ) != 0 )
+    if( ((streamFlags & ~paPlatformSpecificFlags) & ~(paClipOff | paDitherOff | paNeverDropInput | paPrimeOutputBuffersUsingStreamCallback | paLockMemory ) ) != 0 )
         return paInvalidFlag;
 
     if( streamFlags & paNeverDropInput )
@@ -1348,8 +1745,14 @@ PaError Pa_CloseStream( PaStream* stream )
         else if( result == 0 )
             result = interface->Abort( stream );
 
+        SetStreamStarted( stream, 0 );
+
         if( result == paNoError )                 /** @todo REVIEW: shouldn't we close anyway? see: http://www.portaudio.com/trac/ticket/115 */
+        {
+            /* stop the headroom notification thread, the stream no longer runs */
+            PaUtil_SetStreamHeadroomCallback( PA_STREAM_REP( stream ), 0., NULL, NULL );
             result = interface->Close( stream );
+        }
     }
 
     PA_LOGAPI_EXIT_PAERROR( "Pa_CloseStream", result );
@@ -1403,7 +1806,10 @@ PaError Pa_StartStream( PaStream *stream )
         }
         else if( result == 1 )
         {
+            PaUtil_RestartStreamStatistics( PA_STREAM_REP( stream ) );
             result = PA_STREAM_INTERFACE(stream)->Start( stream );
+            if( result == paNoError )
+                SetStreamStarted( stream, 1 );
         }
     }
 
@@ -1426,6 +1832,8 @@ PaError Pa_StopStream( PaStream *stream )
         if( result == 0 )
         {
             result = PA_STREAM_INTERFACE(stream)->Stop( stream );
+            if( result == paNoError )
+                SetStreamStarted( stream, 0 );
         }
         else if( result == 1 )
         {
@@ -1452,6 +1860,8 @@ PaError Pa_AbortStream( PaStream *stream )
         if( result == 0 )
         {
             result = PA_STREAM_INTERFACE(stream)->Abort( stream );
+            if( result == paNoError )
+                SetStreamStarted( stream, 0 );
         }
         else if( result == 1 )
         {
@@ -1526,6 +1936,9 @@ const PaStreamInfo* Pa_GetStreamInfo( PaStream *stream )
         PA_LOGAPI(("\t\tPaTime inputLatency: %f\n", result->inputLatency ));
         PA_LOGAPI(("\t\tPaTime outputLatency: %f\n", result->outputLatency ));
         PA_LOGAPI(("\t\tdouble sampleRate: %f\n", result->sampleRate ));
+        PA_LOGAPI(("\t\tunsigned long lockedMemoryBytes: %lu\n", result->lockedMemoryBytes ));
+        PA_LOGAPI(("\t\tPaTime memoryLockTime: %f\n", result->memoryLockTime ));
+        PA_LOGAPI(("\t\tPaError memoryLockResult: %d\n", result->memoryLockResult ));
         PA_LOGAPI(("\t}\n" ));
 
     }
@@ -1563,6 +1976,16 @@ PaTime Pa_GetStreamTime( PaStream *stream )
 }
 
 
+const PaStreamCallbackFramePositions* Pa_GetStreamCallbackFramePositions(
+        const PaStreamCallbackTimeInfo *timeInfo )
+{
+    /* timeInfo is the first member of the buffer processor's
+        PaUtilCallbackTimeInfo. no API logging: this is called from the
+        stream callback */
+    return &((const PaUtilCallbackTimeInfo*)timeInfo)->framePositions;
+}
+
+
 double Pa_GetStreamCpuLoad( PaStream* stream )
 {
     PaError error = PaUtil_ValidateStreamPointer( stream );
@@ -1593,6 +2016,233 @@ double Pa_GetStreamCpuLoad( PaStream* stream )
 }
 
 
+PaError Pa_SetStreamCpuLoadOptions( PaStream *stream, PaTime timeConstant,
+        int measureThreadCpuTime )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_SetStreamCpuLoadOptions" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaTime timeConstant: %g\n", timeConstant ));
+    PA_LOGAPI(("\tint measureThreadCpuTime: %d\n", measureThreadCpuTime ));
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->cpuLoadMeasurer )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else
+        {
+            result = PA_STREAM_INTERFACE(stream)->IsStopped( stream );
+            if( result == 0 )
+            {
+                result = paStreamIsNotStopped;
+            }
+            else if( result == 1 )
+            {
+                result = PaUtil_ConfigureCpuLoadMeasurer( PA_STREAM_REP( stream )->cpuLoadMeasurer,
+                        timeConstant, measureThreadCpuTime );
+            }
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_SetStreamCpuLoadOptions", result );
+
+    return result;
+}
+
+
+PaError Pa_GetStreamCpuLoadInfo( PaStream *stream, PaStreamCpuLoadInfo *info )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+    PaUtilCpuLoadMeasurer *measurer;
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamCpuLoadInfo" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaStreamCpuLoadInfo* info: 0x%p\n", info ));
+
+    if( result == paNoError )
+    {
+        measurer = PA_STREAM_REP( stream )->cpuLoadMeasurer;
+
+        if( !measurer )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else if( info == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else
+        {
+            info->structVersion = 1;
+            info->measurementCount = measurer->measurementCount;
+            info->averageLoad = PaUtil_GetCpuLoad( measurer );
+            info->p50Load = PaUtil_GetCpuLoadPercentile( measurer, .5, 0 );
+            info->p90Load = PaUtil_GetCpuLoadPercentile( measurer, .9, 0 );
+            info->p99Load = PaUtil_GetCpuLoadPercentile( measurer, .99, 0 );
+            info->maxLoad = measurer->maxLoad;
+
+            info->threadCpuTimeMeasured = measurer->measureThreadCpuTime;
+            info->averageThreadLoad = PaUtil_GetThreadCpuLoad( measurer );
+            info->p99ThreadLoad = measurer->measureThreadCpuTime ? PaUtil_GetCpuLoadPercentile( measurer, .99, 1 ) : 0.;
+            info->maxThreadLoad = measurer->measureThreadCpuTime ? measurer->maxThreadLoad : 0.;
+
+            PA_LOGAPI(("\tPaStreamCpuLoadInfo*: average %g, p99 %g, max %g\n",
+                    info->averageLoad, info->p99Load, info->maxLoad ));
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamCpuLoadInfo", result );
+
+    return result;
+}
+
+PaError Pa_GetStreamStatistics( PaStream *stream, PaStreamStatistics *statistics )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamStatistics" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaStreamStatistics* statistics: 0x%p\n", statistics ));
+
+    if( result == paNoError )
+    {
+        if( statistics == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else
+        {
+            PaUtil_GetStreamStatistics( PA_STREAM_REP( stream ), statistics );
+
+            PA_LOGAPI(("\tPaStreamStatistics*: callbacks %lu, underflows %lu, overflows %lu, max duration %g\n",
+                    statistics->callbackCount, statistics->outputUnderflowCount,
+                    statistics->inputOverflowCount, statistics->maxCallbackDuration ));
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamStatistics", result );
+
+    return result;
+}
+
+
+PaError Pa_SetStreamHeadroomCallback( PaStream *stream, PaTime threshold,
+        PaStreamHeadroomCallback *headroomCallback, void *userData )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_SetStreamHeadroomCallback" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaTime threshold: %g\n", threshold ));
+    PA_LOGAPI(("\tPaStreamHeadroomCallback* headroomCallback: 0x%p\n", headroomCallback ));
+    PA_LOGAPI(("\tvoid* userData: 0x%p\n", userData ));
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->headroom.supported )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else
+        {
+            result = PA_STREAM_INTERFACE(stream)->IsStopped( stream );
+            if( result == 0 )
+            {
+                result = paStreamIsNotStopped;
+            }
+            else if( result == 1 )
+            {
+                result = PaUtil_SetStreamHeadroomCallback( PA_STREAM_REP( stream ),
+                        threshold, headroomCallback, userData );
+            }
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_SetStreamHeadroomCallback", result );
+
+    return result;
+}
+
+
+PaError Pa_SetStreamThreadConfiguration( PaStream *stream,
+        const PaThreadConfiguration *configuration )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_SetStreamThreadConfiguration" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaThreadConfiguration* configuration: 0x%p\n", configuration ));
+    if( configuration )
+    {
+        PA_LOGAPI(("\tPaThreadSchedulingPolicy configuration->policy: %d\n", configuration->policy ));
+        PA_LOGAPI(("\tint configuration->priority: %d\n", configuration->priority ));
+        PA_LOGAPI(("\tunsigned long configuration->stackSize: %lu\n", configuration->stackSize ));
+    }
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->threadConfiguration.supported )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else
+        {
+            result = PA_STREAM_INTERFACE(stream)->IsStopped( stream );
+            if( result == 0 )
+            {
+                result = paStreamIsNotStopped;
+            }
+            else if( result == 1 )
+            {
+                result = PaUtil_SetStreamThreadConfiguration( PA_STREAM_REP( stream ), configuration );
+            }
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_SetStreamThreadConfiguration", result );
+
+    return result;
+}
+
+
+PaError Pa_GetStreamThreadConfiguration( PaStream *stream,
+        PaThreadConfiguration *configuration )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamThreadConfiguration" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaThreadConfiguration* configuration: 0x%p\n", configuration ));
+
+    if( result == paNoError )
+    {
+        if( configuration == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else if( !PA_STREAM_REP( stream )->threadConfiguration.supported )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else
+        {
+            *configuration = PA_STREAM_REP( stream )->threadConfiguration.applied;
+            configuration->structVersion = 1;
+
+            PA_LOGAPI(("\tPaThreadConfiguration*: policy %d, priority %d, stack size %lu\n",
+                    configuration->policy, configuration->priority, configuration->stackSize ));
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamThreadConfiguration", result );
+
+    return result;
+}
+
+
 PaError Pa_ReadStream( PaStream* stream,
                        void *buffer,
                        unsigned long frames )
@@ -1730,6 +2380,177 @@ signed long Pa_GetStreamWriteAvailable( PaStream* stream )
 }
 
 
+/* Common checks of the region functions: the stream must be running and
+   its host API must implement the region interface. */
+static PaError ValidateRegionStream( PaStream *stream )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->regionInterface )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else
+        {
+            result = PA_STREAM_INTERFACE(stream)->IsStopped( stream );
+            if( result == 1 )
+                result = paStreamIsStopped;
+        }
+    }
+
+    return result;
+}
+
+
+PaError Pa_GetStreamReadRegion( PaStream *stream, const void **buffer, unsigned long *frames )
+{
+    PaError result = ValidateRegionStream( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamReadRegion" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+
+    if( result == paNoError )
+    {
+        if( buffer == NULL || frames == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else
+        {
+            PA_LOGAPI(("\tunsigned long frames: %lu\n", *frames ));
+            result = PA_STREAM_REP( stream )->regionInterface->GetReadRegion( stream, buffer, frames );
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamReadRegion", result );
+
+    return result;
+}
+
+
+PaError Pa_CommitStreamRead( PaStream *stream, unsigned long frames )
+{
+    PaError result = ValidateRegionStream( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_CommitStreamRead" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tunsigned long frames: %lu\n", frames ));
+
+    if( result == paNoError )
+        result = PA_STREAM_REP( stream )->regionInterface->CommitRead( stream, frames );
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_CommitStreamRead", result );
+
+    return result;
+}
+
+
+PaError Pa_GetStreamWriteRegion( PaStream *stream, void **buffer, unsigned long *frames )
+{
+    PaError result = ValidateRegionStream( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamWriteRegion" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+
+    if( result == paNoError )
+    {
+        if( buffer == NULL || frames == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else
+        {
+            PA_LOGAPI(("\tunsigned long frames: %lu\n", *frames ));
+            result = PA_STREAM_REP( stream )->regionInterface->GetWriteRegion( stream, buffer, frames );
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamWriteRegion", result );
+
+    return result;
+}
+
+
+PaError Pa_CommitStreamWrite( PaStream *stream, unsigned long frames )
+{
+    PaError result = ValidateRegionStream( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_CommitStreamWrite" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tunsigned long frames: %lu\n", frames ));
+
+    if( result == paNoError )
+        result = PA_STREAM_REP( stream )->regionInterface->CommitWrite( stream, frames );
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_CommitStreamWrite", result );
+
+    return result;
+}
+
+
+int Pa_GetStreamPollDescriptors( PaStream *stream, PaStreamPollDescriptor *descriptors, int maxDescriptors )
+{
+    int result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamPollDescriptors" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaStreamPollDescriptor* descriptors: 0x%p\n", descriptors ));
+    PA_LOGAPI(("\tint maxDescriptors: %d\n", maxDescriptors ));
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->pollInterface )
+            result = paIncompatibleStreamHostApi;
+        else if( maxDescriptors < 0 || ( maxDescriptors > 0 && descriptors == NULL ) )
+            result = paBadBufferPtr;
+        else
+            result = PA_STREAM_REP( stream )->pollInterface->GetPollDescriptors( stream, descriptors, maxDescriptors );
+    }
+
+    PA_LOGAPI_EXIT_PAERROR_OR_T_RESULT( "Pa_GetStreamPollDescriptors", "int: %d", result );
+
+    return result;
+}
+
+
+PaError Pa_ProcessStreamPollEvents( PaStream *stream, const PaStreamPollDescriptor *descriptors,
+        int numDescriptors, int *ready )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_ProcessStreamPollEvents" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tint numDescriptors: %d\n", numDescriptors ));
+
+    if( result == paNoError )
+    {
+        if( !PA_STREAM_REP( stream )->pollInterface )
+        {
+            result = paIncompatibleStreamHostApi;
+        }
+        else if( descriptors == NULL || ready == NULL )
+        {
+            result = paBadBufferPtr;
+        }
+        else
+        {
+            result = PA_STREAM_INTERFACE(stream)->IsStopped( stream );
+            if( result == 1 )
+                result = paStreamIsStopped;
+            else if( result == 0 )
+                result = PA_STREAM_REP( stream )->pollInterface->ProcessPollEvents( stream, descriptors,
+                        numDescriptors, ready );
+        }
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_ProcessStreamPollEvents", result );
+
+    return result;
+}
+
+
 PaError Pa_GetSampleSize( PaSampleFormat format )
 {
     int result;
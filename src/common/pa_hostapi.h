@@ -168,6 +168,8 @@ typedef struct PaUtilPrivatePaFrontHostApiInfo {
 
 
     unsigned long baseDeviceIndex;
+    int baseDeviceCount;        /* devices found at initialization, mapped from baseDeviceIndex */
+    PaDeviceIndex *addedDevices; /* global indices of devices added by Pa_RefreshDeviceList() */
 }PaUtilPrivatePaFrontHostApiInfo;
 
 
@@ -356,6 +358,52 @@ typedef PaError PaUtilHostApiInitializer( PaUtilHostApiRepresentation**, PaHostA
 extern PaUtilHostApiInitializer *paHostApiInitializers[];
 
 
+/** Prototype for a function which fills in the capabilities of a device that a
+ host API left incomplete during initialization, for example because probing
+ every device up front is slow.
+
+ @param device The host api specific device index, 0 to deviceCount-1.
+
+ @see PaUtil_SetDeviceInfoProbe
+*/
+typedef void PaUtilDeviceInfoProbe( PaUtilHostApiRepresentation *hostApi, int device );
+
+
+/** Register a function which is called by Pa_GetDeviceInfo() before a device
+ info of the host API is returned. It is called every time, so it should return
+ immediately for devices that are already complete. Host APIs call this from
+ their PaUtilHostApiInitializer, the registration is cleared when the host APIs
+ are terminated.
+
+ @param hostApiIndex The index passed to the host API's initializer.
+*/
+void PaUtil_SetDeviceInfoProbe( PaHostApiIndex hostApiIndex, PaUtilDeviceInfoProbe *probe );
+
+
+/** Prototype for a function which updates the device list of a host API when
+ the client calls Pa_RefreshDeviceList().
+
+ The function may append devices to deviceInfos and increase info.deviceCount
+ accordingly, but must never remove or reorder existing entries since their
+ indices and PaDeviceInfo pointers are held by the client. Devices which have
+ disappeared should stay in the list and be reported as unavailable instead.
+ Default devices must not be changed, info.defaultInputDevice and
+ info.defaultOutputDevice hold global device indices at this point.
+
+ @see PaUtil_SetDeviceListRefresher
+*/
+typedef PaError PaUtilDeviceListRefresher( PaUtilHostApiRepresentation *hostApi );
+
+
+/** Register a function which is called by Pa_RefreshDeviceList(). Host APIs
+ call this from their PaUtilHostApiInitializer, host APIs without a refresher
+ keep the device list built at initialization.
+
+ @param hostApiIndex The index passed to the host API's initializer.
+*/
+void PaUtil_SetDeviceListRefresher( PaHostApiIndex hostApiIndex, PaUtilDeviceListRefresher *refresher );
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
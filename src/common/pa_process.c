@@ -49,6 +49,7 @@
 
 #include "pa_process.h"
 #include "pa_util.h"
+#include "pa_trace.h"
 
 
 #define PA_FRAMES_PER_TEMP_BUFFER_WHEN_HOST_BUFFER_SIZE_IS_UNKNOWN_    1024
@@ -101,7 +102,7 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
 {
     PaError result = paNoError;
     PaError bytesPerSample;
-    unsigned long tempInputBufferSize, tempOutputBufferSize;
+    unsigned long tempInputBufferSize = 0, tempOutputBufferSize = 0;
     PaStreamFlags tempInputStreamFlags;
 
     if( streamFlags & paNeverDropInput )
@@ -113,6 +114,7 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
     }
 
     /* initialize buffer ptrs to zero so they can be freed if necessary in error */
+    PaUtil_InitializeArena( &bp->arena, paAllocationBufferProcessor );
     bp->tempInputBuffer = 0;
     bp->tempInputBufferPtrs = 0;
     bp->tempOutputBuffer = 0;
@@ -198,6 +200,8 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
     bp->framesInTempInputBuffer = bp->initialFramesInTempInputBuffer;
     bp->framesInTempOutputBuffer = bp->initialFramesInTempOutputBuffer;
 
+    bp->inputFramePosition = 0;
+    bp->outputFramePosition = 0;
     
     if( inputChannelCount > 0 )
     {
@@ -248,37 +252,11 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
 
         tempInputBufferSize =
             bp->framesPerTempBuffer * bp->bytesPerUserInputSample * inputChannelCount;
-         
-        bp->tempInputBuffer = PaUtil_AllocateMemory( tempInputBufferSize );
-        if( bp->tempInputBuffer == 0 )
-        {
-            result = paInsufficientMemory;
-            goto error;
-        }
-        
-        if( bp->framesInTempInputBuffer > 0 )
-            memset( bp->tempInputBuffer, 0, tempInputBufferSize );
 
+        PaUtil_ReserveArenaMemory( &bp->arena, tempInputBufferSize );
         if( userInputSampleFormat & paNonInterleaved )
-        {
-            bp->tempInputBufferPtrs =
-                (void **)PaUtil_AllocateMemory( sizeof(void*)*inputChannelCount );
-            if( bp->tempInputBufferPtrs == 0 )
-            {
-                result = paInsufficientMemory;
-                goto error;
-            }
-        }
-
-        bp->hostInputChannels[0] = (PaUtilChannelDescriptor*)
-                PaUtil_AllocateMemory( sizeof(PaUtilChannelDescriptor) * inputChannelCount * 2);
-        if( bp->hostInputChannels[0] == 0 )
-        {
-            result = paInsufficientMemory;
-            goto error;
-        }
-
-        bp->hostInputChannels[1] = &bp->hostInputChannels[0][inputChannelCount];
+            PaUtil_ReserveArenaMemory( &bp->arena, sizeof(void*)*inputChannelCount );
+        PaUtil_ReserveArenaMemory( &bp->arena, sizeof(PaUtilChannelDescriptor) * inputChannelCount * 2 );
     }
 
     if( outputChannelCount > 0 )
@@ -319,35 +297,46 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
         tempOutputBufferSize =
                 bp->framesPerTempBuffer * bp->bytesPerUserOutputSample * outputChannelCount;
 
-        bp->tempOutputBuffer = PaUtil_AllocateMemory( tempOutputBufferSize );
-        if( bp->tempOutputBuffer == 0 )
+        PaUtil_ReserveArenaMemory( &bp->arena, tempOutputBufferSize );
+        if( userOutputSampleFormat & paNonInterleaved )
+            PaUtil_ReserveArenaMemory( &bp->arena, sizeof(void*)*outputChannelCount );
+        PaUtil_ReserveArenaMemory( &bp->arena, sizeof(PaUtilChannelDescriptor)*outputChannelCount * 2 );
+    }
+
+    /* All temp buffers, pointer arrays and channel descriptors live in one
+        cache-aligned block. PaUtil_CommitArena() zeroes it, which also leaves
+        the temp buffers silent for any initial frames of latency. */
+    result = PaUtil_CommitArena( &bp->arena );
+    if( result != paNoError )
+        goto error;
+
+    if( inputChannelCount > 0 )
+    {
+        bp->tempInputBuffer = PaUtil_ArenaAllocateMemory( &bp->arena, tempInputBufferSize );
+
+        if( userInputSampleFormat & paNonInterleaved )
         {
-            result = paInsufficientMemory;
-            goto error;
+            bp->tempInputBufferPtrs =
+                (void **)PaUtil_ArenaAllocateMemory( &bp->arena, sizeof(void*)*inputChannelCount );
         }
 
-        if( bp->framesInTempOutputBuffer > 0 )
-            memset( bp->tempOutputBuffer, 0, tempOutputBufferSize );
-        
+        bp->hostInputChannels[0] = (PaUtilChannelDescriptor*)
+                PaUtil_ArenaAllocateMemory( &bp->arena, sizeof(PaUtilChannelDescriptor) * inputChannelCount * 2 );
+        bp->hostInputChannels[1] = &bp->hostInputChannels[0][inputChannelCount];
+    }
+
+    if( outputChannelCount > 0 )
+    {
+        bp->tempOutputBuffer = PaUtil_ArenaAllocateMemory( &bp->arena, tempOutputBufferSize );
+
         if( userOutputSampleFormat & paNonInterleaved )
         {
             bp->tempOutputBufferPtrs =
-                (void **)PaUtil_AllocateMemory( sizeof(void*)*outputChannelCount );
-            if( bp->tempOutputBufferPtrs == 0 )
-            {
-                result = paInsufficientMemory;
-                goto error;
-            }
+                (void **)PaUtil_ArenaAllocateMemory( &bp->arena, sizeof(void*)*outputChannelCount );
         }
 
         bp->hostOutputChannels[0] = (PaUtilChannelDescriptor*)
-                PaUtil_AllocateMemory( sizeof(PaUtilChannelDescriptor)*outputChannelCount * 2 );
-        if( bp->hostOutputChannels[0] == 0 )
-        {                                                                     
-            result = paInsufficientMemory;
-            goto error;
-        }
-
+                PaUtil_ArenaAllocateMemory( &bp->arena, sizeof(PaUtilChannelDescriptor)*outputChannelCount * 2 );
         bp->hostOutputChannels[1] = &bp->hostOutputChannels[0][outputChannelCount];
     }
 
@@ -361,23 +350,7 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
     return result;
 
 error:
-    if( bp->tempInputBuffer )
-        PaUtil_FreeMemory( bp->tempInputBuffer );
-
-    if( bp->tempInputBufferPtrs )
-        PaUtil_FreeMemory( bp->tempInputBufferPtrs );
-
-    if( bp->hostInputChannels[0] )
-        PaUtil_FreeMemory( bp->hostInputChannels[0] );
-
-    if( bp->tempOutputBuffer )
-        PaUtil_FreeMemory( bp->tempOutputBuffer );
-
-    if( bp->tempOutputBufferPtrs )
-        PaUtil_FreeMemory( bp->tempOutputBufferPtrs );
-
-    if( bp->hostOutputChannels[0] )
-        PaUtil_FreeMemory( bp->hostOutputChannels[0] );
+    PaUtil_FreeArena( &bp->arena );
 
     return result;
 }
@@ -385,23 +358,14 @@ error:
 
 void PaUtil_TerminateBufferProcessor( PaUtilBufferProcessor* bp )
 {
-    if( bp->tempInputBuffer )
-        PaUtil_FreeMemory( bp->tempInputBuffer );
-
-    if( bp->tempInputBufferPtrs )
-        PaUtil_FreeMemory( bp->tempInputBufferPtrs );
+    PaUtil_FreeArena( &bp->arena );
 
-    if( bp->hostInputChannels[0] )
-        PaUtil_FreeMemory( bp->hostInputChannels[0] );
-        
-    if( bp->tempOutputBuffer )
-        PaUtil_FreeMemory( bp->tempOutputBuffer );
-
-    if( bp->tempOutputBufferPtrs )
-        PaUtil_FreeMemory( bp->tempOutputBufferPtrs );
-
-    if( bp->hostOutputChannels[0] )
-        PaUtil_FreeMemory( bp->hostOutputChannels[0] );
+    bp->tempInputBuffer = 0;
+    bp->tempInputBufferPtrs = 0;
+    bp->hostInputChannels[0] = bp->hostInputChannels[1] = 0;
+    bp->tempOutputBuffer = 0;
+    bp->tempOutputBufferPtrs = 0;
+    bp->hostOutputChannels[0] = bp->hostOutputChannels[1] = 0;
 }
 
 
@@ -412,6 +376,9 @@ void PaUtil_ResetBufferProcessor( PaUtilBufferProcessor* bp )
     bp->framesInTempInputBuffer = bp->initialFramesInTempInputBuffer;
     bp->framesInTempOutputBuffer = bp->initialFramesInTempOutputBuffer;
 
+    bp->inputFramePosition = 0;
+    bp->outputFramePosition = 0;
+
     if( bp->framesInTempInputBuffer > 0 )
     {
         tempInputBufferSize =
@@ -428,6 +395,17 @@ void PaUtil_ResetBufferProcessor( PaUtilBufferProcessor* bp )
 }
 
 
+void PaUtil_AdvanceBufferProcessorFramePositions( PaUtilBufferProcessor* bp,
+        unsigned long inputFrames, unsigned long outputFrames )
+{
+    if( bp->inputChannelCount != 0 )
+        bp->inputFramePosition += inputFrames;
+
+    if( bp->outputChannelCount != 0 )
+        bp->outputFramePosition += outputFrames;
+}
+
+
 unsigned long PaUtil_GetBufferProcessorInputLatencyFrames( PaUtilBufferProcessor* bp )
 {
     return bp->initialFramesInTempInputBuffer;
@@ -669,6 +647,8 @@ void PaUtil_Set2ndNonInterleavedOutputChannel( PaUtilBufferProcessor* bp,
 void PaUtil_BeginBufferProcessing( PaUtilBufferProcessor* bp,
         PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags callbackStatusFlags )
 {
+    PaUtil_MarkAudioThread();
+
     bp->timeInfo = timeInfo;
 
     /* the first streamCallback will be called to process samples which are
@@ -692,6 +672,34 @@ void PaUtil_BeginBufferProcessing( PaUtilBufferProcessor* bp,
 }
 
 
+/*
+    CallStreamCallback() calls the user's streamCallback with a copy of
+    *bp->timeInfo extended with the current frame positions, then advances the
+    positions past the frames the callback consumed and produced.
+*/
+static int CallStreamCallback( PaUtilBufferProcessor *bp,
+        const void *userInput, void *userOutput, unsigned long frameCount )
+{
+    PaStreamCallbackFramePositions *positions = &bp->callbackTimeInfo.framePositions;
+    int result;
+
+    bp->callbackTimeInfo.timeInfo = *bp->timeInfo;
+    positions->structVersion = 1;
+    positions->inputBufferFrame = bp->inputFramePosition;
+    positions->outputBufferFrame = bp->outputFramePosition;
+    positions->hostTime = bp->timeInfo->currentTime;
+
+    PaUtil_TraceBegin( paUtilTraceCallback );
+    result = bp->streamCallback( userInput, userOutput, frameCount,
+            &bp->callbackTimeInfo.timeInfo, bp->callbackStatusFlags, bp->userData );
+    PaUtil_TraceEnd( paUtilTraceCallback );
+
+    PaUtil_AdvanceBufferProcessorFramePositions( bp, frameCount, frameCount );
+
+    return result;
+}
+
+
 /*
     NonAdaptingProcess() is a simple buffer copying adaptor that can handle
     both full and half duplex copies. It processes framesToProcess frames,
@@ -868,8 +876,8 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                 }
             }
         
-            *streamCallbackResult = bp->streamCallback( userInput, userOutput,
-                    frameCount, bp->timeInfo, bp->callbackStatusFlags, bp->userData );
+            *streamCallbackResult = CallStreamCallback( bp, userInput, userOutput,
+                    frameCount );
 
             if( *streamCallbackResult == paAbort )
             {
@@ -1050,9 +1058,8 @@ static unsigned long AdaptingInputOnlyProcess( PaUtilBufferProcessor *bp,
             {
                 bp->timeInfo->outputBufferDacTime = 0;
 
-                *streamCallbackResult = bp->streamCallback( userInput, userOutput,
-                        bp->framesPerUserBuffer, bp->timeInfo,
-                        bp->callbackStatusFlags, bp->userData );
+                *streamCallbackResult = CallStreamCallback( bp, userInput, userOutput,
+                        bp->framesPerUserBuffer );
 
                 bp->timeInfo->inputBufferAdcTime += bp->framesPerUserBuffer * bp->samplePeriod;
             }
@@ -1112,9 +1119,8 @@ static unsigned long AdaptingOutputOnlyProcess( PaUtilBufferProcessor *bp,
 
             bp->timeInfo->inputBufferAdcTime = 0;
             
-            *streamCallbackResult = bp->streamCallback( userInput, userOutput,
-                    bp->framesPerUserBuffer, bp->timeInfo,
-                    bp->callbackStatusFlags, bp->userData );
+            *streamCallbackResult = CallStreamCallback( bp, userInput, userOutput,
+                    bp->framesPerUserBuffer );
 
             if( *streamCallbackResult == paAbort )
             {
@@ -1446,9 +1452,8 @@ static unsigned long AdaptingProcess( PaUtilBufferProcessor *bp,
 
                 /* call streamCallback */
 
-                *streamCallbackResult = bp->streamCallback( userInput, userOutput,
-                        bp->framesPerUserBuffer, bp->timeInfo,
-                        bp->callbackStatusFlags, bp->userData );
+                *streamCallbackResult = CallStreamCallback( bp, userInput, userOutput,
+                        bp->framesPerUserBuffer );
 
                 bp->timeInfo->inputBufferAdcTime += bp->framesPerUserBuffer * bp->samplePeriod;
                 bp->timeInfo->outputBufferDacTime += bp->framesPerUserBuffer * bp->samplePeriod;
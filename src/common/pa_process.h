@@ -203,6 +203,7 @@
 #include "portaudio.h"
 #include "pa_converters.h"
 #include "pa_dither.h"
+#include "pa_allocation.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -245,6 +246,14 @@ typedef struct PaUtilChannelDescriptor{
 }PaUtilChannelDescriptor;
 
 
+/** @brief The time information passed to the stream callback, followed by
+ the frame positions returned by Pa_GetStreamCallbackFramePositions(). */
+typedef struct PaUtilCallbackTimeInfo{
+    PaStreamCallbackTimeInfo timeInfo; /**< must be first */
+    PaStreamCallbackFramePositions framePositions;
+}PaUtilCallbackTimeInfo;
+
+
 /** @brief The main buffer processor data structure.
 
  Allocate one of these, initialize it with PaUtil_InitializeBufferProcessor
@@ -286,6 +295,9 @@ typedef struct {
     unsigned long framesInTempOutputBuffer; /**< frames remaining in input buffer from previous adaption iteration */
 
     PaStreamCallbackTimeInfo *timeInfo;
+    PaUtilCallbackTimeInfo callbackTimeInfo; /**< copy of *timeInfo with frame positions, passed to the stream callback */
+    PaInt64 inputFramePosition;     /**< position of the next user input frame */
+    PaInt64 outputFramePosition;    /**< position of the next user output frame */
 
     PaStreamCallbackFlags callbackStatusFlags;
 
@@ -310,6 +322,8 @@ typedef struct {
 
     PaStreamCallback *streamCallback;
     void *userData;
+
+    PaUtilArena arena;              /**< single block holding the temp buffers, pointer arrays and channel descriptors */
 } PaUtilBufferProcessor;
 
 
@@ -406,6 +420,20 @@ void PaUtil_TerminateBufferProcessor( PaUtilBufferProcessor* bufferProcessor );
 void PaUtil_ResetBufferProcessor( PaUtilBufferProcessor* bufferProcessor );
 
 
+/** Advance the frame positions reported by Pa_GetStreamCallbackFramePositions()
+ to account for frames the host API lost, for example to an xrun. Call this
+ from the audio thread, outside of PaUtil_EndBufferProcessing().
+
+ @param bufferProcessor The buffer processor.
+
+ @param inputFrames The number of input frames that were lost.
+
+ @param outputFrames The number of output frames that were not played.
+*/
+void PaUtil_AdvanceBufferProcessorFramePositions( PaUtilBufferProcessor* bufferProcessor,
+        unsigned long inputFrames, unsigned long outputFrames );
+
+
 /** Retrieve the input latency of a buffer processor, in frames.
 
  @param bufferProcessor The buffer processor examine.
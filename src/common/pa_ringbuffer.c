@@ -59,17 +59,31 @@
 #include <string.h>
 #include "pa_memorybarrier.h"
 
+/* The indices are 64 bit even on 32 bit targets, where a plain load or store
+   of them could tear. Use the compiler's atomic builtins where we have them,
+   the memory barriers below still provide the ordering. */
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define PA_RB_LOAD_INDEX(x)      __atomic_load_n( &(x), __ATOMIC_RELAXED )
+#define PA_RB_STORE_INDEX(x, v)  __atomic_store_n( &(x), (v), __ATOMIC_RELAXED )
+#else
+#define PA_RB_LOAD_INDEX(x)      (x)
+#define PA_RB_STORE_INDEX(x, v)  ((x) = (v))
+#endif
+
+/* Address of the element at (monotonic) index. */
+#define PA_RB_ELEMENT_PTR(rbuf, index) \
+    (&(rbuf)->buffer[ (size_t)((index) & (ring_buffer_index_t)(rbuf)->smallMask) * (size_t)(rbuf)->elementSizeBytes ])
+
 /***************************************************************************
  * Initialize FIFO.
  * elementCount must be power of 2, returns -1 if not.
  */
 ring_buffer_size_t PaUtil_InitializeRingBuffer( PaUtilRingBuffer *rbuf, ring_buffer_size_t elementSizeBytes, ring_buffer_size_t elementCount, void *dataPtr )
 {
-    if( ((elementCount-1) & elementCount) != 0) return -1; /* Not Power of two. */
+    if( elementCount <= 0 || ((elementCount-1) & elementCount) != 0) return -1; /* Not Power of two. */
     rbuf->bufferSize = elementCount;
     rbuf->buffer = (char *)dataPtr;
     PaUtil_FlushRingBuffer( rbuf );
-    rbuf->bigMask = (elementCount*2)-1;
     rbuf->smallMask = (elementCount)-1;
     rbuf->elementSizeBytes = elementSizeBytes;
     return 0;
@@ -79,7 +93,8 @@ ring_buffer_size_t PaUtil_InitializeRingBuffer( PaUtilRingBuffer *rbuf, ring_buf
 ** Return number of elements available for reading. */
 ring_buffer_size_t PaUtil_GetRingBufferReadAvailable( const PaUtilRingBuffer *rbuf )
 {
-    return ( (rbuf->writeIndex - rbuf->readIndex) & rbuf->bigMask );
+    /* The indices never wrap, so their difference is always in [0, bufferSize]. */
+    return (ring_buffer_size_t)( PA_RB_LOAD_INDEX( rbuf->writeIndex ) - PA_RB_LOAD_INDEX( rbuf->readIndex ) );
 }
 /***************************************************************************
 ** Return number of elements available for writing. */
@@ -92,7 +107,22 @@ ring_buffer_size_t PaUtil_GetRingBufferWriteAvailable( const PaUtilRingBuffer *r
 ** Clear buffer. Should only be called when buffer is NOT being read or written. */
 void PaUtil_FlushRingBuffer( PaUtilRingBuffer *rbuf )
 {
-    rbuf->writeIndex = rbuf->readIndex = 0;
+    PA_RB_STORE_INDEX( rbuf->writeIndex, 0 );
+    PA_RB_STORE_INDEX( rbuf->readIndex, 0 );
+}
+
+/***************************************************************************
+** Return total number of elements written since the last flush. */
+ring_buffer_index_t PaUtil_GetRingBufferWriteIndex( const PaUtilRingBuffer *rbuf )
+{
+    return PA_RB_LOAD_INDEX( rbuf->writeIndex );
+}
+
+/***************************************************************************
+** Return total number of elements read since the last flush. */
+ring_buffer_index_t PaUtil_GetRingBufferReadIndex( const PaUtilRingBuffer *rbuf )
+{
+    return PA_RB_LOAD_INDEX( rbuf->readIndex );
 }
 
 /***************************************************************************
@@ -105,23 +135,24 @@ ring_buffer_size_t PaUtil_GetRingBufferWriteRegions( PaUtilRingBuffer *rbuf, rin
                                        void **dataPtr1, ring_buffer_size_t *sizePtr1,
                                        void **dataPtr2, ring_buffer_size_t *sizePtr2 )
 {
+    ring_buffer_index_t  writeIndex = PA_RB_LOAD_INDEX( rbuf->writeIndex );
     ring_buffer_size_t   index;
     ring_buffer_size_t   available = PaUtil_GetRingBufferWriteAvailable( rbuf );
     if( elementCount > available ) elementCount = available;
     /* Check to see if write is not contiguous. */
-    index = rbuf->writeIndex & rbuf->smallMask;
-    if( (index + elementCount) > rbuf->bufferSize )
+    index = (ring_buffer_size_t)(writeIndex & (ring_buffer_index_t)rbuf->smallMask);
+    if( elementCount > rbuf->bufferSize - index )
     {
         /* Write data in two blocks that wrap the buffer. */
         ring_buffer_size_t   firstHalf = rbuf->bufferSize - index;
-        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *dataPtr1 = PA_RB_ELEMENT_PTR( rbuf, writeIndex );
         *sizePtr1 = firstHalf;
         *dataPtr2 = &rbuf->buffer[0];
         *sizePtr2 = elementCount - firstHalf;
     }
     else
     {
-        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *dataPtr1 = PA_RB_ELEMENT_PTR( rbuf, writeIndex );
         *sizePtr1 = elementCount;
         *dataPtr2 = NULL;
         *sizePtr2 = 0;
@@ -141,8 +172,10 @@ ring_buffer_size_t PaUtil_AdvanceRingBufferWriteIndex( PaUtilRingBuffer *rbuf, r
     /* ensure that previous writes are seen before we update the write index 
        (write after write)
     */
+    ring_buffer_index_t writeIndex = PA_RB_LOAD_INDEX( rbuf->writeIndex ) + (ring_buffer_index_t)elementCount;
     PaUtil_WriteMemoryBarrier();
-    return rbuf->writeIndex = (rbuf->writeIndex + elementCount) & rbuf->bigMask;
+    PA_RB_STORE_INDEX( rbuf->writeIndex, writeIndex );
+    return (ring_buffer_size_t)(writeIndex & (ring_buffer_index_t)rbuf->smallMask);
 }
 
 /***************************************************************************
@@ -155,23 +188,24 @@ ring_buffer_size_t PaUtil_GetRingBufferReadRegions( PaUtilRingBuffer *rbuf, ring
                                 void **dataPtr1, ring_buffer_size_t *sizePtr1,
                                 void **dataPtr2, ring_buffer_size_t *sizePtr2 )
 {
+    ring_buffer_index_t  readIndex = PA_RB_LOAD_INDEX( rbuf->readIndex );
     ring_buffer_size_t   index;
     ring_buffer_size_t   available = PaUtil_GetRingBufferReadAvailable( rbuf ); /* doesn't use memory barrier */
     if( elementCount > available ) elementCount = available;
     /* Check to see if read is not contiguous. */
-    index = rbuf->readIndex & rbuf->smallMask;
-    if( (index + elementCount) > rbuf->bufferSize )
+    index = (ring_buffer_size_t)(readIndex & (ring_buffer_index_t)rbuf->smallMask);
+    if( elementCount > rbuf->bufferSize - index )
     {
         /* Write data in two blocks that wrap the buffer. */
         ring_buffer_size_t firstHalf = rbuf->bufferSize - index;
-        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *dataPtr1 = PA_RB_ELEMENT_PTR( rbuf, readIndex );
         *sizePtr1 = firstHalf;
         *dataPtr2 = &rbuf->buffer[0];
         *sizePtr2 = elementCount - firstHalf;
     }
     else
     {
-        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *dataPtr1 = PA_RB_ELEMENT_PTR( rbuf, readIndex );
         *sizePtr1 = elementCount;
         *dataPtr2 = NULL;
         *sizePtr2 = 0;
@@ -189,8 +223,10 @@ ring_buffer_size_t PaUtil_AdvanceRingBufferReadIndex( PaUtilRingBuffer *rbuf, ri
     /* ensure that previous reads (copies out of the ring buffer) are always completed before updating (writing) the read index. 
        (write-after-read) => full barrier
     */
+    ring_buffer_index_t readIndex = PA_RB_LOAD_INDEX( rbuf->readIndex ) + (ring_buffer_index_t)elementCount;
     PaUtil_FullMemoryBarrier();
-    return rbuf->readIndex = (rbuf->readIndex + elementCount) & rbuf->bigMask;
+    PA_RB_STORE_INDEX( rbuf->readIndex, readIndex );
+    return (ring_buffer_size_t)(readIndex & (ring_buffer_index_t)rbuf->smallMask);
 }
 
 /***************************************************************************
@@ -203,13 +239,13 @@ ring_buffer_size_t PaUtil_WriteRingBuffer( PaUtilRingBuffer *rbuf, const void *d
     if( size2 > 0 )
     {
 
-        memcpy( data1, data, size1*rbuf->elementSizeBytes );
-        data = ((char *)data) + size1*rbuf->elementSizeBytes;
-        memcpy( data2, data, size2*rbuf->elementSizeBytes );
+        memcpy( data1, data, (size_t)size1*rbuf->elementSizeBytes );
+        data = ((char *)data) + (size_t)size1*rbuf->elementSizeBytes;
+        memcpy( data2, data, (size_t)size2*rbuf->elementSizeBytes );
     }
     else
     {
-        memcpy( data1, data, size1*rbuf->elementSizeBytes );
+        memcpy( data1, data, (size_t)size1*rbuf->elementSizeBytes );
     }
     PaUtil_AdvanceRingBufferWriteIndex( rbuf, numWritten );
     return numWritten;
@@ -224,13 +260,13 @@ ring_buffer_size_t PaUtil_ReadRingBuffer( PaUtilRingBuffer *rbuf, void *data, ri
     numRead = PaUtil_GetRingBufferReadRegions( rbuf, elementCount, &data1, &size1, &data2, &size2 );
     if( size2 > 0 )
     {
-        memcpy( data, data1, size1*rbuf->elementSizeBytes );
-        data = ((char *)data) + size1*rbuf->elementSizeBytes;
-        memcpy( data, data2, size2*rbuf->elementSizeBytes );
+        memcpy( data, data1, (size_t)size1*rbuf->elementSizeBytes );
+        data = ((char *)data) + (size_t)size1*rbuf->elementSizeBytes;
+        memcpy( data, data2, (size_t)size2*rbuf->elementSizeBytes );
     }
     else
     {
-        memcpy( data, data1, size1*rbuf->elementSizeBytes );
+        memcpy( data, data1, (size_t)size1*rbuf->elementSizeBytes );
     }
     PaUtil_AdvanceRingBufferReadIndex( rbuf, numRead );
     return numRead;
@@ -62,6 +62,13 @@
  elements, where N must be a power of two. An element may be any size 
  (specified in bytes).
 
+ The read and write indices are 64 bit element counters which increase
+ monotonically from the last flush and are never wrapped, they are only
+ masked down to a buffer offset when the buffer memory is addressed. The
+ number of elements available is therefore always the plain difference of
+ the two counters, independent of the buffer size. At 192kHz a 64 bit
+ counter takes millions of years to overflow.
+
  The memory area used to store the buffer elements must be allocated by 
  the client prior to calling PaUtil_InitializeRingBuffer() and must outlive
  the use of the ring buffer.
@@ -73,14 +80,19 @@
 #if defined(__APPLE__)
 #include <sys/types.h>
 typedef int32_t ring_buffer_size_t;
+typedef u_int64_t ring_buffer_index_t;
 #elif defined( __GNUC__ )
 typedef long ring_buffer_size_t;
+typedef unsigned long long ring_buffer_index_t;
 #elif (_MSC_VER >= 1400)
 typedef long ring_buffer_size_t;
+typedef unsigned __int64 ring_buffer_index_t;
 #elif defined(_MSC_VER) || defined(__BORLANDC__)
 typedef long ring_buffer_size_t;
+typedef unsigned __int64 ring_buffer_index_t;
 #else
 typedef long ring_buffer_size_t;
+typedef unsigned long long ring_buffer_index_t;
 #endif
 
 
@@ -93,9 +105,8 @@ extern "C"
 typedef struct PaUtilRingBuffer
 {
     ring_buffer_size_t  bufferSize; /**< Number of elements in FIFO. Power of 2. Set by PaUtil_InitRingBuffer. */
-    volatile ring_buffer_size_t  writeIndex; /**< Index of next writable element. Set by PaUtil_AdvanceRingBufferWriteIndex. */
-    volatile ring_buffer_size_t  readIndex;  /**< Index of next readable element. Set by PaUtil_AdvanceRingBufferReadIndex. */
-    ring_buffer_size_t  bigMask;    /**< Used for wrapping indices with extra bit to distinguish full/empty. */
+    volatile ring_buffer_index_t  writeIndex; /**< Total number of elements written since the last flush. Set by PaUtil_AdvanceRingBufferWriteIndex. */
+    volatile ring_buffer_index_t  readIndex;  /**< Total number of elements read since the last flush. Set by PaUtil_AdvanceRingBufferReadIndex. */
     ring_buffer_size_t  smallMask;  /**< Used for fitting indices to buffer. */
     ring_buffer_size_t  elementSizeBytes; /**< Number of bytes per element. */
     char  *buffer;    /**< Pointer to the buffer containing the actual data. */
@@ -108,11 +119,12 @@ typedef struct PaUtilRingBuffer
  @param elementSizeBytes The size of a single data element in bytes.
 
  @param elementCount The number of elements in the buffer (must be a power of 2).
+ Any power of 2 representable by ring_buffer_size_t is accepted.
 
  @param dataPtr A pointer to a previously allocated area where the data
  will be maintained.  It must be elementCount*elementSizeBytes long.
 
- @return -1 if elementCount is not a power of 2, otherwise 0.
+ @return -1 if elementCount is not a positive power of 2, otherwise 0.
 */
 ring_buffer_size_t PaUtil_InitializeRingBuffer( PaUtilRingBuffer *rbuf, ring_buffer_size_t elementSizeBytes, ring_buffer_size_t elementCount, void *dataPtr );
 
@@ -192,7 +204,7 @@ ring_buffer_size_t PaUtil_GetRingBufferWriteRegions( PaUtilRingBuffer *rbuf, rin
 
  @param elementCount The number of elements to advance.
 
- @return The new position.
+ @return The new position, as an element offset within the buffer.
 */
 ring_buffer_size_t PaUtil_AdvanceRingBufferWriteIndex( PaUtilRingBuffer *rbuf, ring_buffer_size_t elementCount );
 
@@ -226,10 +238,28 @@ ring_buffer_size_t PaUtil_GetRingBufferReadRegions( PaUtilRingBuffer *rbuf, ring
 
  @param elementCount The number of elements to advance.
 
- @return The new position.
+ @return The new position, as an element offset within the buffer.
 */
 ring_buffer_size_t PaUtil_AdvanceRingBufferReadIndex( PaUtilRingBuffer *rbuf, ring_buffer_size_t elementCount );
 
+/** Retrieve the total number of elements written since the buffer was last
+ initialized or flushed. Intended for the reader, eg to timestamp captured data.
+
+ @param rbuf The ring buffer.
+
+ @return The monotonic write index.
+*/
+ring_buffer_index_t PaUtil_GetRingBufferWriteIndex( const PaUtilRingBuffer *rbuf );
+
+/** Retrieve the total number of elements read since the buffer was last
+ initialized or flushed.
+
+ @param rbuf The ring buffer.
+
+ @return The monotonic read index.
+*/
+ring_buffer_index_t PaUtil_GetRingBufferReadIndex( const PaUtilRingBuffer *rbuf );
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -45,7 +45,11 @@
 */
 
 
+#include <string.h>
+
 #include "pa_stream.h"
+#include "pa_util.h"
+#include "pa_memorybarrier.h"
 
 
 void PaUtil_InitializeStreamInterface( PaUtilStreamInterface *streamInterface,
@@ -90,9 +94,26 @@ void PaUtil_InitializeStreamRepresentation( PaUtilStreamRepresentation *streamRe
 
     streamRepresentation->userData = userData;
 
+    streamRepresentation->streamInfo.structVersion = 2;
     streamRepresentation->streamInfo.inputLatency = 0.;
     streamRepresentation->streamInfo.outputLatency = 0.;
     streamRepresentation->streamInfo.sampleRate = 0.;
+    streamRepresentation->streamInfo.lockedMemoryBytes = 0;
+    streamRepresentation->streamInfo.memoryLockTime = 0.;
+    streamRepresentation->streamInfo.memoryLockResult = paNoError;
+
+    streamRepresentation->isStarted = 0;
+
+    memset( &streamRepresentation->statistics, 0, sizeof(PaUtilStreamStatistics) );
+
+    streamRepresentation->cpuLoadMeasurer = 0;
+
+    memset( &streamRepresentation->headroom, 0, sizeof(PaUtilStreamHeadroom) );
+
+    memset( &streamRepresentation->threadConfiguration, 0, sizeof(PaUtilStreamThreadConfiguration) );
+
+    streamRepresentation->regionInterface = 0;
+    streamRepresentation->pollInterface = 0;
 }
 
 
@@ -102,6 +123,259 @@ void PaUtil_TerminateStreamRepresentation( PaUtilStreamRepresentation *streamRep
 }
 
 
+void PaUtil_RecordStreamMemoryLock( PaUtilStreamRepresentation *streamRepresentation,
+        PaError result, long size, PaTime duration )
+{
+    PaStreamInfo *info = &streamRepresentation->streamInfo;
+
+    info->memoryLockTime += duration;
+
+    if( result == paNoError )
+        info->lockedMemoryBytes += size;
+    else if( info->memoryLockResult == paNoError )
+        info->memoryLockResult = result;
+}
+
+
+PaError PaUtil_LockStreamMemory( PaUtilStreamRepresentation *streamRepresentation,
+        void *block, long size )
+{
+    PaTime start = PaUtil_GetTime();
+    PaError result = PaUtil_LockMemory( block, size );
+
+    PaUtil_RecordStreamMemoryLock( streamRepresentation, result, size, PaUtil_GetTime() - start );
+
+    return result;
+}
+
+
+PaError PaUtil_LockStreamArena( PaUtilStreamRepresentation *streamRepresentation,
+        PaUtilArena *arena )
+{
+    PaTime start = PaUtil_GetTime();
+    PaError result = PaUtil_LockArena( arena );
+
+    PaUtil_RecordStreamMemoryLock( streamRepresentation, result, arena->size, PaUtil_GetTime() - start );
+
+    return result;
+}
+
+
+/*
+    The statistics are written by the audio thread only. Each update is
+    bracketed by increments of the sequence counter, which is odd while an
+    update is in progress; readers retry until they see the same even value
+    before and after copying.
+*/
+
+static void BeginStatisticsUpdate( PaUtilStreamStatistics *statistics )
+{
+    ++statistics->sequence;
+    PaUtil_WriteMemoryBarrier();
+}
+
+
+static void EndStatisticsUpdate( PaUtilStreamStatistics *statistics )
+{
+    PaUtil_WriteMemoryBarrier();
+    ++statistics->sequence;
+}
+
+
+/* map a duration to a histogram bucket: 1us resolution below 4us, four
+    buckets per octave above */
+static int DurationToHistogramBucket( PaTime duration )
+{
+    unsigned long us = (unsigned long)( duration * 1000000. );
+    int msb = 0;
+    unsigned long v = us;
+    int bucket;
+
+    if( duration >= 33554432e-6 )
+        return PA_STATISTICS_HISTOGRAM_BUCKETS - 1;
+
+    if( us < 4 )
+        return (int)us;
+
+    while( v >>= 1 )
+        ++msb;
+
+    bucket = (msb - 1) * 4 + (int)( (us >> (msb - 2)) & 3 );
+    return ( bucket < PA_STATISTICS_HISTOGRAM_BUCKETS ) ? bucket : PA_STATISTICS_HISTOGRAM_BUCKETS - 1;
+}
+
+
+/* the exclusive upper bound of a histogram bucket in seconds */
+static PaTime HistogramBucketUpperBound( int bucket )
+{
+    int msb;
+
+    if( bucket < 4 )
+        return (bucket + 1) * 1e-6;
+
+    msb = bucket / 4 + 1;
+    return (PaTime)( (unsigned long)(5 + bucket % 4) << (msb - 2) ) * 1e-6;
+}
+
+
+void PaUtil_RecordStreamWakeup( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long idealFrames )
+{
+    PaUtilStreamStatistics *statistics = &streamRepresentation->statistics;
+    double sampleRate = streamRepresentation->streamInfo.sampleRate;
+    PaTime now = PaUtil_GetTime();
+    PaTime jitter;
+
+    BeginStatisticsUpdate( statistics );
+
+    if( statistics->lastWakeupTime > 0. && sampleRate > 0. )
+    {
+        jitter = (now - statistics->lastWakeupTime) - idealFrames / sampleRate;
+        if( jitter < 0. )
+            jitter = -jitter;
+
+        ++statistics->wakeupCount;
+        statistics->totalWakeupJitter += jitter;
+        if( jitter > statistics->maxWakeupJitter )
+            statistics->maxWakeupJitter = jitter;
+    }
+    statistics->lastWakeupTime = now;
+
+    EndStatisticsUpdate( statistics );
+}
+
+
+void PaUtil_BeginStreamCallbackMeasurement( PaUtilStreamRepresentation *streamRepresentation )
+{
+    /* only read by the audio thread, no need to update the sequence */
+    streamRepresentation->statistics.callbackBeginTime = PaUtil_GetMeasurementTime();
+}
+
+
+void PaUtil_EndStreamCallbackMeasurement( PaUtilStreamRepresentation *streamRepresentation )
+{
+    PaUtilStreamStatistics *statistics = &streamRepresentation->statistics;
+    PaTime duration = PaUtil_GetMeasurementTime() - statistics->callbackBeginTime;
+
+    if( duration < 0. )
+        duration = 0.;
+
+    BeginStatisticsUpdate( statistics );
+
+    if( statistics->callbackCount == 0 || duration < statistics->minCallbackDuration )
+        statistics->minCallbackDuration = duration;
+    if( duration > statistics->maxCallbackDuration )
+        statistics->maxCallbackDuration = duration;
+
+    ++statistics->callbackCount;
+    statistics->totalCallbackDuration += duration;
+    ++statistics->callbackDurationHistogram[ DurationToHistogramBucket( duration ) ];
+
+    EndStatisticsUpdate( statistics );
+}
+
+
+void PaUtil_RecordStreamXruns( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long inputOverflows, unsigned long outputUnderflows )
+{
+    PaUtilStreamStatistics *statistics = &streamRepresentation->statistics;
+
+    if( inputOverflows == 0 && outputUnderflows == 0 )
+        return;
+
+    BeginStatisticsUpdate( statistics );
+    statistics->inputOverflowCount += inputOverflows;
+    statistics->outputUnderflowCount += outputUnderflows;
+    EndStatisticsUpdate( statistics );
+}
+
+
+void PaUtil_RecordStreamDroppedFrames( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long frames )
+{
+    PaUtilStreamStatistics *statistics = &streamRepresentation->statistics;
+
+    if( frames == 0 )
+        return;
+
+    BeginStatisticsUpdate( statistics );
+    statistics->droppedFrames += frames;
+    EndStatisticsUpdate( statistics );
+}
+
+
+void PaUtil_RestartStreamStatistics( PaUtilStreamRepresentation *streamRepresentation )
+{
+    PaUtilStreamStatistics *statistics = &streamRepresentation->statistics;
+
+    BeginStatisticsUpdate( statistics );
+    statistics->lastWakeupTime = 0.;
+    EndStatisticsUpdate( statistics );
+}
+
+
+void PaUtil_RecordStreamThrottle( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long throttles, PaTime duration )
+{
+    streamRepresentation->statistics.throttleCount += throttles;
+    streamRepresentation->statistics.throttledTime += duration;
+}
+
+
+void PaUtil_GetStreamStatistics( PaUtilStreamRepresentation *streamRepresentation,
+        PaStreamStatistics *statistics )
+{
+    PaUtilStreamStatistics snapshot;
+    unsigned long sequence, p99Count, count;
+    int i;
+
+    do
+    {
+        sequence = streamRepresentation->statistics.sequence;
+        PaUtil_ReadMemoryBarrier();
+        memcpy( &snapshot, (const void*)&streamRepresentation->statistics, sizeof(snapshot) );
+        PaUtil_ReadMemoryBarrier();
+    }
+    while( (sequence & 1) || sequence != streamRepresentation->statistics.sequence );
+
+    statistics->structVersion = 2;
+    statistics->inputOverflowCount = snapshot.inputOverflowCount;
+    statistics->outputUnderflowCount = snapshot.outputUnderflowCount;
+    statistics->callbackCount = snapshot.callbackCount;
+    statistics->minCallbackDuration = snapshot.minCallbackDuration;
+    statistics->maxCallbackDuration = snapshot.maxCallbackDuration;
+    statistics->meanCallbackDuration = 0.;
+    statistics->p99CallbackDuration = 0.;
+    statistics->meanWakeupJitter = 0.;
+    statistics->maxWakeupJitter = snapshot.maxWakeupJitter;
+    statistics->droppedFrames = snapshot.droppedFrames;
+    statistics->throttleCount = snapshot.throttleCount;
+    statistics->throttledTime = snapshot.throttledTime;
+
+    if( snapshot.callbackCount > 0 )
+    {
+        statistics->meanCallbackDuration = snapshot.totalCallbackDuration / snapshot.callbackCount;
+
+        /* the upper bound of the bucket holding the 99th percentile sample,
+            never more than the largest duration seen */
+        p99Count = snapshot.callbackCount - snapshot.callbackCount / 100;
+        count = 0;
+        for( i=0; i < PA_STATISTICS_HISTOGRAM_BUCKETS; ++i )
+        {
+            count += snapshot.callbackDurationHistogram[i];
+            if( count >= p99Count )
+                break;
+        }
+        statistics->p99CallbackDuration = HistogramBucketUpperBound( i );
+        if( statistics->p99CallbackDuration > snapshot.maxCallbackDuration )
+            statistics->p99CallbackDuration = snapshot.maxCallbackDuration;
+    }
+
+    if( snapshot.wakeupCount > 0 )
+        statistics->meanWakeupJitter = snapshot.totalWakeupJitter / snapshot.wakeupCount;
+}
+
+
 PaError PaUtil_DummyRead( PaStream* stream,
                                void *buffer,
                                unsigned long frames )
@@ -148,3 +422,115 @@ double PaUtil_DummyGetCpuLoad( PaStream* stream )
 
     return 0.0;
 }
+
+
+void PaUtil_RecordStreamHeadroom( PaUtilStreamRepresentation *streamRepresentation,
+        PaTime headroom, double budgetUsed )
+{
+    PaUtilStreamHeadroom *state = &streamRepresentation->headroom;
+    PaUtilNotifier *notifier = state->notifier;
+
+    if( headroom >= state->threshold || !notifier )
+        return;
+
+    if( state->lowHeadroomCount == 0 || headroom < state->minimumHeadroom )
+        state->minimumHeadroom = headroom;
+    ++state->lowHeadroomCount;
+
+    if( !state->pending )
+    {
+        PaUtil_ReadMemoryBarrier(); /* the notifier thread is done with the notification */
+
+        state->notification.headroom = headroom;
+        state->notification.minimumHeadroom = state->minimumHeadroom;
+        state->notification.budgetUsed = budgetUsed;
+        state->notification.lowHeadroomCount = state->lowHeadroomCount;
+        state->lowHeadroomCount = 0;
+
+        PaUtil_WriteMemoryBarrier();
+        state->pending = 1;
+        PaUtil_SignalNotifier( notifier );
+    }
+}
+
+
+static void NotifyStreamHeadroom( void *userData )
+{
+    PaUtilStreamRepresentation *streamRepresentation = (PaUtilStreamRepresentation*)userData;
+    PaUtilStreamHeadroom *state = &streamRepresentation->headroom;
+    PaStreamHeadroomInfo info;
+
+    if( !state->pending )
+        return;
+
+    PaUtil_ReadMemoryBarrier();
+    info = state->notification;
+    PaUtil_FullMemoryBarrier();
+    state->pending = 0;
+
+    state->callback( (PaStream*)streamRepresentation, &info, state->userData );
+}
+
+
+PaError PaUtil_SetStreamHeadroomCallback( PaUtilStreamRepresentation *streamRepresentation,
+        PaTime threshold, PaStreamHeadroomCallback *headroomCallback, void *userData )
+{
+    PaUtilStreamHeadroom *state = &streamRepresentation->headroom;
+    PaUtilNotifier *notifier = state->notifier;
+    PaError result = paNoError;
+
+    /* unpublish the notifier before destroying it, PaUtil_RecordStreamHeadroom may still be looking at it */
+    state->threshold = 0.;
+    state->notifier = NULL;
+    PaUtil_WriteMemoryBarrier();
+    if( notifier )
+        PaUtil_DestroyNotifier( notifier );
+
+    state->callback = NULL;
+    state->userData = NULL;
+    state->lowHeadroomCount = 0;
+    state->pending = 0;
+
+    if( headroomCallback && threshold > 0. )
+    {
+        state->callback = headroomCallback;
+        state->userData = userData;
+
+        result = PaUtil_CreateNotifier( &notifier, NotifyStreamHeadroom, streamRepresentation );
+        if( result == paNoError )
+        {
+            PaUtil_WriteMemoryBarrier();
+            state->notifier = notifier;
+            state->threshold = threshold;
+        }
+    }
+
+    return result;
+}
+
+
+PaError PaUtil_SetStreamThreadConfiguration( PaUtilStreamRepresentation *streamRepresentation,
+        const PaThreadConfiguration *configuration )
+{
+    PaUtilStreamThreadConfiguration *state = &streamRepresentation->threadConfiguration;
+
+    if( configuration )
+    {
+        if( configuration->structVersion != 1
+                || configuration->policy < paThreadPolicyDefault
+                || configuration->policy > paThreadPolicyDeadline
+                || configuration->priority < 0
+                || configuration->deadlineRuntime < 0. || configuration->deadlineRuntime > 1. )
+            return paInvalidFlag;
+
+        state->requested = *configuration;
+        state->configured = 1;
+    }
+    else
+    {
+        memset( &state->requested, 0, sizeof(PaThreadConfiguration) );
+        state->configured = 0;
+    }
+
+    return paNoError;
+}
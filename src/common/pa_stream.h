@@ -48,6 +48,7 @@
 
 
 #include "portaudio.h"
+#include "pa_allocation.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -141,6 +142,102 @@ signed long PaUtil_DummyGetWriteAvailable( PaStream* stream );
 double PaUtil_DummyGetCpuLoad( PaStream* stream );
 
 
+/** The number of buckets in the callback duration histogram of
+ PaUtilStreamStatistics. Buckets below 4us are 1us wide, above that each
+ octave is split into four buckets. Durations beyond 2^25us (about 33
+ seconds) are counted in the last bucket.
+*/
+#define PA_STATISTICS_HISTOGRAM_BUCKETS (96)
+
+
+/** Accumulators for Pa_GetStreamStatistics(). Only the thread doing the
+ stream's i/o (the callback thread, or the thread calling Pa_ReadStream()
+ and Pa_WriteStream()) writes to this structure, through the functions
+ below. Readers use the sequence counter to obtain a consistent copy without
+ taking a lock.
+*/
+typedef struct PaUtilStreamStatistics {
+    volatile unsigned long sequence; /**< odd while the audio thread is updating */
+    unsigned long inputOverflowCount;
+    unsigned long outputUnderflowCount;
+    unsigned long droppedFrames;
+    unsigned long callbackCount;
+    PaTime callbackBeginTime;
+    PaTime minCallbackDuration;
+    PaTime maxCallbackDuration;
+    PaTime totalCallbackDuration;
+    unsigned long callbackDurationHistogram[ PA_STATISTICS_HISTOGRAM_BUCKETS ];
+    PaTime lastWakeupTime;   /**< 0 until the first wakeup after the stream is started */
+    unsigned long wakeupCount;
+    PaTime totalWakeupJitter;
+    PaTime maxWakeupJitter;
+    unsigned long throttleCount;    /**< written by the watchdog thread, outside the sequence */
+    PaTime throttledTime;           /**< written by the watchdog thread, outside the sequence */
+} PaUtilStreamStatistics;
+
+
+/** Headroom tracking state, see PaUtil_RecordStreamHeadroom().
+
+ The accumulated fields are only written by the audio thread. When headroom
+ drops below the threshold and no notification is pending, the audio thread
+ copies them into the notification fields, sets pending and signals the
+ notifier, whose thread clears pending after reading them.
+*/
+typedef struct PaUtilStreamHeadroom {
+    int supported; /**< set by host APIs which call PaUtil_RecordStreamHeadroom() */
+    PaTime threshold; /**< zero while no callback is registered */
+    PaStreamHeadroomCallback *callback;
+    void *userData;
+    struct PaUtilNotifier *notifier;
+
+    PaTime minimumHeadroom;
+    unsigned long lowHeadroomCount;
+
+    volatile int pending;
+    PaStreamHeadroomInfo notification;
+} PaUtilStreamHeadroom;
+
+
+/** Audio thread configuration state, see Pa_SetStreamThreadConfiguration().
+ requested is only read by host APIs when the stream is started; applied is
+ written by them once the audio thread has been configured.
+*/
+typedef struct PaUtilStreamThreadConfiguration {
+    int supported; /**< set by host APIs which honour the configuration */
+    int configured; /**< non-zero if requested holds a configuration set by the user */
+    PaThreadConfiguration requested;
+    PaThreadConfiguration applied;
+} PaUtilStreamThreadConfiguration;
+
+
+/** Functions behind Pa_GetStreamReadRegion(), Pa_CommitStreamRead(),
+ Pa_GetStreamWriteRegion() and Pa_CommitStreamWrite(). Host APIs which can
+ expose their buffers to a blocking stream point the stream representation's
+ regionInterface at one of these. They are only called for a running stream
+ with valid buffer and frames pointers; the host API checks the direction.
+*/
+typedef struct PaUtilStreamRegionInterface {
+    PaError (*GetReadRegion)( PaStream *stream, const void **buffer, unsigned long *frames );
+    PaError (*CommitRead)( PaStream *stream, unsigned long frames );
+    PaError (*GetWriteRegion)( PaStream *stream, void **buffer, unsigned long *frames );
+    PaError (*CommitWrite)( PaStream *stream, unsigned long frames );
+} PaUtilStreamRegionInterface;
+
+
+/** Functions behind Pa_GetStreamPollDescriptors() and
+ Pa_ProcessStreamPollEvents(). Host APIs whose blocking streams can be waited
+ on with poll() point the stream representation's pollInterface at one of
+ these. GetPollDescriptors is called for an open stream with descriptors
+ valid for maxDescriptors entries; ProcessPollEvents is only called for a
+ running stream with valid pointers.
+*/
+typedef struct PaUtilStreamPollInterface {
+    int (*GetPollDescriptors)( PaStream *stream, PaStreamPollDescriptor *descriptors, int maxDescriptors );
+    PaError (*ProcessPollEvents)( PaStream *stream, const PaStreamPollDescriptor *descriptors,
+            int numDescriptors, int *ready );
+} PaUtilStreamPollInterface;
+
+
 /** Non host specific data for a stream. This data is used by pa_front to
  forward to the appropriate functions in the streamInterface structure.
 */
@@ -152,6 +249,13 @@ typedef struct PaUtilStreamRepresentation {
     PaStreamFinishedCallback *streamFinishedCallback;
     void *userData;
     PaStreamInfo streamInfo;
+    int isStarted; /**< set by pa_front.c between a successful start and stop, used for allocation accounting */
+    PaUtilStreamStatistics statistics;
+    struct PaUtilCpuLoadMeasurer *cpuLoadMeasurer; /**< set by host APIs which support Pa_GetStreamCpuLoadInfo, otherwise NULL */
+    PaUtilStreamHeadroom headroom;
+    PaUtilStreamThreadConfiguration threadConfiguration;
+    PaUtilStreamRegionInterface *regionInterface; /**< set by host APIs which support Pa_GetStreamWriteRegion and friends, otherwise NULL */
+    PaUtilStreamPollInterface *pollInterface; /**< set by host APIs which support Pa_GetStreamPollDescriptors, otherwise NULL */
 } PaUtilStreamRepresentation;
 
 
@@ -174,6 +278,149 @@ void PaUtil_InitializeStreamRepresentation(
 void PaUtil_TerminateStreamRepresentation( PaUtilStreamRepresentation *streamRepresentation );
 
 
+/** Record the outcome of locking size bytes of memory for the paLockMemory
+ flag in the stream's PaStreamInfo. Implementations which lock memory
+ themselves (e.g. a thread's stack) use this to report it.
+
+ @param result The result of the lock operation.
+
+ @param duration The time in seconds the operation took.
+*/
+void PaUtil_RecordStreamMemoryLock( PaUtilStreamRepresentation *streamRepresentation,
+        PaError result, long size, PaTime duration );
+
+
+/** Lock and prefault a block of memory for the paLockMemory flag, and record
+ the outcome in the stream's PaStreamInfo. The caller is responsible for
+ calling PaUtil_UnlockMemory before freeing the block.
+
+ @return The result of PaUtil_LockMemory. Callers are expected to treat
+ failure as non-fatal.
+*/
+PaError PaUtil_LockStreamMemory( PaUtilStreamRepresentation *streamRepresentation,
+        void *block, long size );
+
+
+/** Lock and prefault a committed arena for the paLockMemory flag, and record
+ the outcome in the stream's PaStreamInfo. The lock is released when the
+ arena is freed.
+*/
+PaError PaUtil_LockStreamArena( PaUtilStreamRepresentation *streamRepresentation,
+        PaUtilArena *arena );
+
+
+/** Record that the audio thread woke up to process audio. The time since the
+ previous wakeup is compared with the ideal interval, idealFrames at the
+ stream's sample rate, to measure wakeup jitter.
+
+ Must only be called by the thread doing the stream's i/o.
+*/
+void PaUtil_RecordStreamWakeup( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long idealFrames );
+
+
+/** Mark the beginning of the processing of one host buffer. Host APIs call
+ this and PaUtil_EndStreamCallbackMeasurement() next to
+ PaUtil_BeginCpuLoadMeasurement() and PaUtil_EndCpuLoadMeasurement().
+
+ Must only be called by the thread doing the stream's i/o.
+*/
+void PaUtil_BeginStreamCallbackMeasurement( PaUtilStreamRepresentation *streamRepresentation );
+
+
+/** Mark the end of the processing of one host buffer and record its duration.
+
+ Must only be called by the thread doing the stream's i/o.
+*/
+void PaUtil_EndStreamCallbackMeasurement( PaUtilStreamRepresentation *streamRepresentation );
+
+
+/** Record input overflows and output underflows detected by the host API.
+
+ Must only be called by the thread doing the stream's i/o.
+*/
+void PaUtil_RecordStreamXruns( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long inputOverflows, unsigned long outputUnderflows );
+
+
+/** Record input frames which were lost or discarded.
+
+ Must only be called by the thread doing the stream's i/o.
+*/
+void PaUtil_RecordStreamDroppedFrames( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long frames );
+
+
+/** Record that a watchdog demoted the audio thread (throttles 1) or how long
+ it was demoted for when restoring it (throttles 0).
+
+ Must only be called by the watchdog thread.
+*/
+void PaUtil_RecordStreamThrottle( PaUtilStreamRepresentation *streamRepresentation,
+        unsigned long throttles, PaTime duration );
+
+
+/** Forget the time of the last wakeup, so that the gap while a stream was
+ stopped is not counted as jitter. Called by pa_front.c before a stream is
+ started.
+*/
+void PaUtil_RestartStreamStatistics( PaUtilStreamRepresentation *streamRepresentation );
+
+
+/** Take a consistent snapshot of the stream's statistics. May be called from
+ any thread.
+*/
+void PaUtil_GetStreamStatistics( PaUtilStreamRepresentation *streamRepresentation,
+        PaStreamStatistics *statistics );
+
+
+/** Returns non-zero if a headroom callback is registered, so that host APIs
+ only take the measurements PaUtil_RecordStreamHeadroom() needs when they
+ are used.
+*/
+#define PaUtil_IsStreamHeadroomTracked( streamRepresentation ) \
+    ((streamRepresentation)->headroom.threshold > 0.)
+
+
+/** Record the headroom after processing a buffer and notify the registered
+ callback, off the audio thread, if it is below the threshold. Called by the
+ audio thread of host APIs which set headroom.supported.
+
+ @param headroom The audio, in seconds, left in the host buffer.
+
+ @param budgetUsed The fraction of the buffer period which elapsed while it
+ was processed.
+*/
+void PaUtil_RecordStreamHeadroom( PaUtilStreamRepresentation *streamRepresentation,
+        PaTime headroom, double budgetUsed );
+
+
+/** Register or remove (headroomCallback NULL) the headroom callback,
+ starting or stopping the notification thread. The stream must be stopped.
+ Called by pa_front.c.
+*/
+PaError PaUtil_SetStreamHeadroomCallback( PaUtilStreamRepresentation *streamRepresentation,
+        PaTime threshold, PaStreamHeadroomCallback *headroomCallback, void *userData );
+
+
+/** Returns the thread configuration set by the user, or NULL if the host
+ API's defaults should be used. Host APIs which set
+ threadConfiguration.supported call this when creating the audio thread.
+*/
+#define PaUtil_GetStreamThreadConfiguration( streamRepresentation ) \
+    ((streamRepresentation)->threadConfiguration.configured ? \
+            &(streamRepresentation)->threadConfiguration.requested : NULL)
+
+
+/** Validate and store (configuration non-NULL) or clear the user's thread
+ configuration. Called by pa_front.c.
+
+ @return paInvalidFlag if the configuration is not valid.
+*/
+PaError PaUtil_SetStreamThreadConfiguration( PaUtilStreamRepresentation *streamRepresentation,
+        const PaThreadConfiguration *configuration );
+
+
 /** Check that the stream pointer is valid.
 
  @return Returns paNoError if the stream pointer appears to be OK, otherwise
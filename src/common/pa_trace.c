@@ -52,6 +52,7 @@
 #include "pa_trace.h"
 #include "pa_util.h"
 #include "pa_debugprint.h"
+#include "pa_memorybarrier.h"
 
 #if PA_TRACE_REALTIME_EVENTS
 
@@ -227,12 +228,316 @@ void PaUtil_DiscardHighSpeedLog( LogHandle hLog )
     PaUtil_FreeMemory(pLog);
 }
 
-#else
-/* This stub was added so that this file will generate a symbol.
- * Otherwise linker/archiver programs will complain.
- */
-int PaUtil_TraceStubToSatisfyLinker(void)
+#endif /* TRACE_REALTIME_EVENTS */
+
+
+/************************************************************************/
+/* Binary event tracer                                                  */
+/************************************************************************/
+
+#if defined(__GNUC__)
+#define PA_TRACE_THREAD_LOCAL_ __thread
+#define PA_TRACE_COMPARE_AND_SWAP_( pointer, oldValue, newValue ) \
+        __sync_bool_compare_and_swap( (pointer), (oldValue), (newValue) )
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define PA_TRACE_THREAD_LOCAL_ __declspec(thread)
+#define PA_TRACE_COMPARE_AND_SWAP_( pointer, oldValue, newValue ) \
+        (_InterlockedCompareExchange( (pointer), (newValue), (oldValue) ) == (oldValue))
+#endif
+
+#ifdef PA_TRACE_THREAD_LOCAL_
+
+#define PA_TRACE_BUFFER_FREE_       (0)
+#define PA_TRACE_BUFFER_OWNED_      (1)
+#define PA_TRACE_BUFFER_RELEASED_   (2)
+
+#define PA_TRACE_PHASE_BEGIN_       ('B')
+#define PA_TRACE_PHASE_END_         ('E')
+#define PA_TRACE_PHASE_INSTANT_     ('i')
+
+typedef struct PaUtilTraceEvent
+{
+    double time;
+    unsigned long payload;
+    unsigned short id;
+    unsigned char phase;
+} PaUtilTraceEvent;
+
+typedef struct PaUtilTraceBuffer
+{
+    volatile long state;
+    const char *threadName;
+    volatile unsigned long writeIndex; /* only advanced by the owning thread */
+    PaUtilTraceEvent events[ PA_TRACE_BUFFER_EVENTS ];
+} PaUtilTraceBuffer;
+
+static volatile int traceEnabled_ = 0;
+static PaUtilTraceBuffer *traceBuffers_ = NULL; /* array of PA_TRACE_MAX_THREADS buffers */
+static volatile unsigned long traceGeneration_ = 1;
+static double traceBaseTime_ = 0.;
+
+/* the generation lets a thread detect that the buffer it holds was freed by Pa_ResetTrace() */
+static PA_TRACE_THREAD_LOCAL_ PaUtilTraceBuffer *threadTraceBuffer_ = NULL;
+static PA_TRACE_THREAD_LOCAL_ unsigned long threadTraceGeneration_ = 0;
+static PA_TRACE_THREAD_LOCAL_ const char *threadTraceName_ = NULL;
+
+static const char *traceEventNames_[ paUtilTraceEventCount ] =
+    { "wait", "convert", "callback", "commit", "xrun" };
+
+
+static PaUtilTraceBuffer *GetThreadTraceBuffer( void )
 {
-	return 0;
+    PaUtilTraceBuffer *buffers = traceBuffers_;
+    int i;
+
+    if( threadTraceBuffer_ && threadTraceGeneration_ == traceGeneration_ )
+        return threadTraceBuffer_;
+
+    threadTraceBuffer_ = NULL;
+    if( !buffers )
+        return NULL;
+
+    /* prefer a free buffer so that the events of exited threads are kept
+        for as long as possible, otherwise reuse a released one */
+    for( i=0; i < PA_TRACE_MAX_THREADS && !threadTraceBuffer_; ++i )
+    {
+        if( PA_TRACE_COMPARE_AND_SWAP_( &buffers[i].state,
+                PA_TRACE_BUFFER_FREE_, PA_TRACE_BUFFER_OWNED_ ) )
+            threadTraceBuffer_ = &buffers[i];
+    }
+    for( i=0; i < PA_TRACE_MAX_THREADS && !threadTraceBuffer_; ++i )
+    {
+        if( PA_TRACE_COMPARE_AND_SWAP_( &buffers[i].state,
+                PA_TRACE_BUFFER_RELEASED_, PA_TRACE_BUFFER_OWNED_ ) )
+        {
+            buffers[i].writeIndex = 0;
+            threadTraceBuffer_ = &buffers[i];
+        }
+    }
+
+    if( threadTraceBuffer_ )
+    {
+        threadTraceBuffer_->threadName = threadTraceName_;
+        threadTraceGeneration_ = traceGeneration_;
+    }
+    return threadTraceBuffer_;
 }
-#endif /* TRACE_REALTIME_EVENTS */
+
+
+static void RecordTraceEvent( PaUtilTraceEventId id, unsigned char phase, unsigned long payload )
+{
+    PaUtilTraceBuffer *buffer = GetThreadTraceBuffer();
+    PaUtilTraceEvent *event;
+    unsigned long writeIndex;
+
+    if( !buffer )
+        return; /* all buffers are in use, the event is lost */
+
+    writeIndex = buffer->writeIndex;
+    event = &buffer->events[ writeIndex & (PA_TRACE_BUFFER_EVENTS - 1) ];
+    event->time = PaUtil_GetTime();
+    event->payload = payload;
+    event->id = (unsigned short)id;
+    event->phase = phase;
+
+    /* publish the event only after it has been written */
+    PaUtil_WriteMemoryBarrier();
+    buffer->writeIndex = writeIndex + 1;
+}
+
+
+void PaUtil_SetTraceThreadName( const char *name )
+{
+    threadTraceName_ = name;
+    if( threadTraceBuffer_ && threadTraceGeneration_ == traceGeneration_ )
+        threadTraceBuffer_->threadName = name;
+}
+
+
+void PaUtil_TraceBegin( PaUtilTraceEventId id )
+{
+    if( traceEnabled_ )
+        RecordTraceEvent( id, PA_TRACE_PHASE_BEGIN_, 0 );
+}
+
+
+void PaUtil_TraceEnd( PaUtilTraceEventId id )
+{
+    if( traceEnabled_ )
+        RecordTraceEvent( id, PA_TRACE_PHASE_END_, 0 );
+}
+
+
+void PaUtil_TraceInstant( PaUtilTraceEventId id, unsigned long payload )
+{
+    if( traceEnabled_ )
+        RecordTraceEvent( id, PA_TRACE_PHASE_INSTANT_, payload );
+}
+
+
+void PaUtil_ReleaseTraceBuffer( void )
+{
+    if( threadTraceBuffer_ && threadTraceGeneration_ == traceGeneration_ )
+        threadTraceBuffer_->state = PA_TRACE_BUFFER_RELEASED_;
+
+    threadTraceBuffer_ = NULL;
+    threadTraceName_ = NULL;
+}
+
+
+PaError Pa_SetTraceEnabled( int enabled )
+{
+    if( enabled && !traceBuffers_ )
+    {
+        PaUtilTraceBuffer *buffers = (PaUtilTraceBuffer*)PaUtil_AllocateMemory(
+                sizeof(PaUtilTraceBuffer) * PA_TRACE_MAX_THREADS );
+        if( !buffers )
+            return paInsufficientMemory;
+
+        memset( buffers, 0, sizeof(PaUtilTraceBuffer) * PA_TRACE_MAX_THREADS );
+        traceBaseTime_ = PaUtil_GetTime();
+        ++traceGeneration_;
+
+        /* make the buffers visible before any thread can see the enabled flag */
+        PaUtil_WriteMemoryBarrier();
+        traceBuffers_ = buffers;
+    }
+
+    PaUtil_WriteMemoryBarrier();
+    traceEnabled_ = enabled ? 1 : 0;
+    return paNoError;
+}
+
+
+void Pa_ResetTrace( void )
+{
+    int i;
+
+    if( !traceBuffers_ )
+        return;
+
+    if( traceEnabled_ )
+    {
+        for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+        {
+            traceBuffers_[i].writeIndex = 0;
+            PA_TRACE_COMPARE_AND_SWAP_( &traceBuffers_[i].state,
+                    PA_TRACE_BUFFER_RELEASED_, PA_TRACE_BUFFER_FREE_ );
+        }
+        traceBaseTime_ = PaUtil_GetTime();
+    }
+    else
+    {
+        PaUtilTraceBuffer *buffers = traceBuffers_;
+        traceBuffers_ = NULL;
+        ++traceGeneration_;
+        PaUtil_FreeMemory( buffers );
+    }
+}
+
+
+static void WriteTraceJsonString( FILE *f, const char *s )
+{
+    fputc( '"', f );
+    for( ; *s; ++s )
+    {
+        if( *s == '"' || *s == '\\' )
+            fprintf( f, "\\%c", *s );
+        else if( (unsigned char)*s < 0x20 )
+            fprintf( f, "\\u%04x", (unsigned char)*s );
+        else
+            fputc( *s, f );
+    }
+    fputc( '"', f );
+}
+
+
+PaError Pa_WriteTraceJson( const char *fileName )
+{
+    PaUtilTraceBuffer *buffers = traceBuffers_;
+    FILE *f;
+    int i, first = 1;
+    char defaultName[32];
+
+    if( !fileName )
+        return paBadBufferPtr;
+
+    f = fopen( fileName, "w" );
+    if( !f )
+        return paInternalError;
+
+    fprintf( f, "{\"traceEvents\":[" );
+
+    for( i=0; buffers && i < PA_TRACE_MAX_THREADS; ++i )
+    {
+        PaUtilTraceBuffer *buffer = &buffers[i];
+        const char *threadName = buffer->threadName;
+        unsigned long writeIndex, j;
+
+        if( buffer->state == PA_TRACE_BUFFER_FREE_ )
+            continue;
+
+        writeIndex = buffer->writeIndex;
+        PaUtil_ReadMemoryBarrier();
+
+        if( !threadName )
+        {
+            sprintf( defaultName, "PortAudio thread %d", i );
+            threadName = defaultName;
+        }
+        fprintf( f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                first ? "" : ",", i );
+        WriteTraceJsonString( f, threadName );
+        fprintf( f, "}}" );
+        first = 0;
+
+        /* when the buffer has wrapped only the most recent events remain */
+        j = (writeIndex > PA_TRACE_BUFFER_EVENTS) ? writeIndex - PA_TRACE_BUFFER_EVENTS : 0;
+        for( ; j < writeIndex; ++j )
+        {
+            const PaUtilTraceEvent *event = &buffer->events[ j & (PA_TRACE_BUFFER_EVENTS - 1) ];
+            double timestampMicroseconds = (event->time - traceBaseTime_) * 1000000.;
+
+            if( event->id >= paUtilTraceEventCount )
+                continue;
+
+            fprintf( f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    traceEventNames_[ event->id ], event->phase, timestampMicroseconds, i );
+            if( event->phase == PA_TRACE_PHASE_INSTANT_ )
+                fprintf( f, ",\"s\":\"t\",\"args\":{\"payload\":%lu}", event->payload );
+            fprintf( f, "}" );
+        }
+    }
+
+    fprintf( f, "\n]}\n" );
+
+    if( fclose( f ) != 0 )
+        return paInternalError;
+    return paNoError;
+}
+
+#else /* PA_TRACE_THREAD_LOCAL_ */
+
+/* the binary tracer requires thread local storage */
+
+void PaUtil_SetTraceThreadName( const char *name ) { (void)name; }
+void PaUtil_TraceBegin( PaUtilTraceEventId id ) { (void)id; }
+void PaUtil_TraceEnd( PaUtilTraceEventId id ) { (void)id; }
+void PaUtil_TraceInstant( PaUtilTraceEventId id, unsigned long payload ) { (void)id; (void)payload; }
+void PaUtil_ReleaseTraceBuffer( void ) {}
+
+PaError Pa_SetTraceEnabled( int enabled )
+{
+    return enabled ? paInternalError : paNoError;
+}
+
+PaError Pa_WriteTraceJson( const char *fileName )
+{
+    (void)fileName;
+    return paInternalError;
+}
+
+void Pa_ResetTrace( void ) {}
+
+#endif /* PA_TRACE_THREAD_LOCAL_ */
@@ -65,6 +65,9 @@
  @brief Print all messages in the trace buffer to stdout and clear the trace buffer.
 */
 
+#include "portaudio.h"
+
+
 #ifndef PA_TRACE_REALTIME_EVENTS
 #define PA_TRACE_REALTIME_EVENTS     (0)   /**< Set to 1 to enable logging using the trace functions defined below */
 #endif
@@ -110,6 +113,61 @@ void PaUtil_DiscardHighSpeedLog(LogHandle hLog);
 #endif
 
 
+
+/* Binary event tracer
+
+ Unlike the functions above, the binary tracer is always compiled in and is
+ switched on at run time with Pa_SetTraceEnabled(). Each thread which
+ records events is given its own fixed size ring buffer of binary events
+ (a timestamp, an event id, a phase and an integer payload), so recording an
+ event never takes a lock, allocates or formats text. Pa_WriteTraceJson()
+ exports the buffers in the Chrome trace event format, which can be loaded
+ into chrome://tracing or Perfetto.
+
+ When tracing is disabled each trace function returns after testing a
+ single flag.
+*/
+
+#ifndef PA_TRACE_MAX_THREADS
+#define PA_TRACE_MAX_THREADS        (16)    /**< Maximum number of threads with a trace buffer at any time */
+#endif
+
+#ifndef PA_TRACE_BUFFER_EVENTS
+#define PA_TRACE_BUFFER_EVENTS      (4096)  /**< Events per thread, must be a power of two */
+#endif
+
+
+/** Events recorded by the binary tracer. Spans are recorded with
+ PaUtil_TraceBegin() and PaUtil_TraceEnd(), instants with PaUtil_TraceInstant().
+*/
+typedef enum PaUtilTraceEventId
+{
+    paUtilTraceWait=0,      /**< span: the audio thread waits for the device */
+    paUtilTraceConvert,     /**< span: buffer processing, sample conversion plus the callback span */
+    paUtilTraceCallback,    /**< span: the user's stream callback */
+    paUtilTraceCommit,      /**< span: the host API hands the processed buffer back to the device */
+    paUtilTraceXrun,        /**< instant: an xrun was detected, payload is 1 for input, 2 for output, 3 for both */
+
+    paUtilTraceEventCount
+} PaUtilTraceEventId;
+
+
+/** Set the name shown for the calling thread in exported traces. name must
+ remain valid until the trace is exported, usually a string literal.
+*/
+void PaUtil_SetTraceThreadName( const char *name );
+
+void PaUtil_TraceBegin( PaUtilTraceEventId id );
+void PaUtil_TraceEnd( PaUtilTraceEventId id );
+void PaUtil_TraceInstant( PaUtilTraceEventId id, unsigned long payload );
+
+/** Give up the calling thread's trace buffer, typically just before the
+ thread exits. The recorded events are kept until the buffer is reused by
+ another thread.
+*/
+void PaUtil_ReleaseTraceBuffer( void );
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
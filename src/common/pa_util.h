@@ -113,25 +113,95 @@ void PaUtil_SetLastHostErrorInfo( PaHostApiTypeId hostApiType, long errorCode,
 
 
         
+/** Record that a block of size bytes was allocated in category. Called by
+ the platform specific allocators; the counters are always maintained.
+
+ @see Pa_GetAllocationStatistics
+*/
+void PaUtil_AccountAllocation( PaAllocationCategory category, long size );
+
+
+/** Record that a block of size bytes previously recorded with
+ PaUtil_AccountAllocation() was freed.
+*/
+void PaUtil_AccountFree( PaAllocationCategory category, long size );
+
+
+/** Mark the calling thread as running the audio path of a stream for the rest
+ of its life. Only allocations made on marked threads while a stream is
+ started are reported as made after stream start. Host APIs call this when
+ their audio threads start; PaUtil_BeginBufferProcessing() marks the thread
+ running the stream callback.
+
+ @see Pa_GetAllocationStatistics
+*/
+void PaUtil_MarkAudioThread( void );
+
+
+/** Return the number of currently allocated blocks, in all categories. This
+ function can be used for detecting memory leaks.
+*/
+int PaUtil_CountCurrentlyAllocatedBlocks( void );
+
+
+/** The header the platform specific allocators place in front of each
+ block so PaUtil_FreeMemory() knows what to account for. The union keeps
+ the returned block aligned for any type.
+*/
+typedef union PaUtilAllocationHeader
+{
+    struct
+    {
+        long size;
+        PaAllocationCategory category;
+    } info;
+    double alignDouble;
+    void *alignPointer;
+    char pad[16];
+} PaUtilAllocationHeader;
+
+
+        
 /* the following functions are implemented in a platform platform specific
  .c file
 */
 
-/** Allocate size bytes, guaranteed to be aligned to a FIXME byte boundary */
+/** Allocate size bytes, accounted in the paAllocationHostApi category. The
+ block is aligned to at least a 16 byte boundary.
+*/
 void *PaUtil_AllocateMemory( long size );
 
 
-/** Realease block if non-NULL. block may be NULL */
+/** Allocate size bytes, accounted in the given category.
+ @see PaUtil_AllocateMemory
+*/
+void *PaUtil_AllocateMemoryInCategory( long size, PaAllocationCategory category );
+
+
+/** Realease block if non-NULL. block may be NULL. block must have been
+ returned by PaUtil_AllocateMemory() or PaUtil_AllocateMemoryInCategory().
+*/
 void PaUtil_FreeMemory( void *block );
 
 
-/** Return the number of currently allocated blocks. This function can be
- used for detecting memory leaks.
+/** Touch every page of block, so it is backed by physical memory, and lock
+ it into RAM so it cannot be paged out. Used to keep page faults out of the
+ audio path.
 
- @note Allocations will only be tracked if PA_TRACK_MEMORY is #defined. If
- it isn't, this function will always return 0.
+ @return paNoError on success, or paInsufficientMemory if the pages could not
+ be locked (typically because the process' locked memory limit is too low).
+ The block is prefaulted even if locking fails.
+
+ @see PaUtil_UnlockMemory
 */
-int PaUtil_CountCurrentlyAllocatedBlocks( void );
+PaError PaUtil_LockMemory( void *block, long size );
+
+
+/** Unlock a block previously locked with PaUtil_LockMemory, passing the same
+ block and size. Nothing happens if locking the block failed. On Unix, pages
+ the block shares with another block that is still locked stay locked.
+*/
+void PaUtil_UnlockMemory( void *block, long size );
 
 
 /** Initialize the clock used by PaUtil_GetTime(). Call this before calling
@@ -144,11 +214,59 @@ void PaUtil_InitializeClock( void );
 
 /** Return the system time in seconds. Used to implement CPU load functions
 
+ The clock is monotonic where the platform provides one, so it is not
+ affected when the system time is set.
+
  @see PaUtil_InitializeClock
 */
 double PaUtil_GetTime( void );
 
 
+/** Return a time in seconds for measuring short intervals on one thread,
+ such as the duration of a callback. It may be cheaper to read than
+ PaUtil_GetTime(), but its origin is unrelated so the two must not be mixed.
+
+ @see PaUtil_InitializeClock
+*/
+double PaUtil_GetMeasurementTime( void );
+
+
+/** Return the CPU time, in seconds, consumed so far by the calling thread.
+ Unlike PaUtil_GetTime() this clock does not advance while the thread is
+ preempted. It may be considerably more expensive to read.
+
+ @return The thread's CPU time, or a negative value if it is not available
+ on this platform.
+*/
+double PaUtil_GetThreadCpuTime( void );
+
+
+/** A notifier runs a function on a dedicated thread each time it is
+ signalled, which lets real-time threads hand work off to a normal thread.
+ The function runs once for every signal, callers which may signal at a
+ high rate should merge signals themselves.
+*/
+typedef struct PaUtilNotifier PaUtilNotifier;
+
+/** Create a notifier and start its thread.
+
+ @return paNoError, paInsufficientMemory, or paUnanticipatedHostError if the
+ thread or its semaphore could not be created.
+*/
+PaError PaUtil_CreateNotifier( PaUtilNotifier **notifier,
+        void (*function)( void *userData ), void *userData );
+
+/** Wake the notifier thread. This does not block, lock or allocate and may
+ be called from a real-time thread.
+*/
+void PaUtil_SignalNotifier( PaUtilNotifier *notifier );
+
+/** Stop the notifier thread, waiting for a running function to return,
+ and free the notifier. Must not be called from the notifier's function.
+*/
+void PaUtil_DestroyNotifier( PaUtilNotifier *notifier );
+
+
 /* void Pa_Sleep( long msec );  must also be implemented in per-platform .c file */
 
 
@@ -54,6 +54,8 @@
 #undef ALSA_PCM_NEW_SW_PARAMS_API
 
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <string.h> /* strlen() */
 #include <limits.h>
 #include <math.h>
@@ -61,6 +63,9 @@
 #include <signal.h>
 #include <time.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
 #include <signal.h> /* For sig_atomic_t */
 #ifdef PA_ALSA_DYNAMIC
     #include <dlfcn.h> /* For dlXXX functions */
@@ -76,6 +81,8 @@
 #include "pa_process.h"
 #include "pa_endianness.h"
 #include "pa_debugprint.h"
+#include "pa_trace.h"
+#include "pa_memorybarrier.h"
 
 #include "pa_linux_alsa.h"
 
@@ -122,11 +129,15 @@ _PA_DEFINE_FUNC(snd_pcm_poll_descriptors_count);
 _PA_DEFINE_FUNC(snd_pcm_poll_descriptors_revents);
 _PA_DEFINE_FUNC(snd_pcm_format_size);
 _PA_DEFINE_FUNC(snd_pcm_link);
+_PA_DEFINE_FUNC(snd_pcm_unlink);
 _PA_DEFINE_FUNC(snd_pcm_delay);
+_PA_DEFINE_FUNC(snd_pcm_hw_params_set_period_wakeup);
+_PA_DEFINE_FUNC(snd_pcm_htimestamp);
 
 _PA_DEFINE_FUNC(snd_pcm_hw_params_sizeof);
 _PA_DEFINE_FUNC(snd_pcm_hw_params_malloc);
 _PA_DEFINE_FUNC(snd_pcm_hw_params_free);
+_PA_DEFINE_FUNC(snd_pcm_hw_params_copy);
 _PA_DEFINE_FUNC(snd_pcm_hw_params_any);
 _PA_DEFINE_FUNC(snd_pcm_hw_params_set_access);
 _PA_DEFINE_FUNC(snd_pcm_hw_params_set_format);
@@ -182,6 +193,7 @@ _PA_DEFINE_FUNC(snd_pcm_sw_params_set_silence_threshold);
 _PA_DEFINE_FUNC(snd_pcm_sw_params_set_silence_size);
 _PA_DEFINE_FUNC(snd_pcm_sw_params_set_xfer_align);
 _PA_DEFINE_FUNC(snd_pcm_sw_params_set_tstamp_mode);
+_PA_DEFINE_FUNC(snd_pcm_sw_params_set_tstamp_type);
 #define alsa_snd_pcm_sw_params_alloca(ptr) __alsa_snd_alloca(ptr, snd_pcm_sw_params)
 
 _PA_DEFINE_FUNC(snd_pcm_info);
@@ -204,6 +216,7 @@ _PA_DEFINE_FUNC(snd_ctl_card_info_free);
 _PA_DEFINE_FUNC(snd_ctl_card_info);
 _PA_DEFINE_FUNC(snd_ctl_card_info_sizeof);
 _PA_DEFINE_FUNC(snd_ctl_card_info_get_name);
+_PA_DEFINE_FUNC(snd_ctl_card_info_get_id);
 #define alsa_snd_ctl_card_info_alloca(ptr) __alsa_snd_alloca(ptr, snd_ctl_card_info)
 
 _PA_DEFINE_FUNC(snd_config);
@@ -403,11 +416,15 @@ static int PaAlsa_LoadLibrary()
     _PA_LOAD_FUNC(snd_pcm_poll_descriptors_revents);
     _PA_LOAD_FUNC(snd_pcm_format_size);
     _PA_LOAD_FUNC(snd_pcm_link);
+    _PA_LOAD_FUNC(snd_pcm_unlink);
     _PA_LOAD_FUNC(snd_pcm_delay);
+    _PA_LOAD_FUNC(snd_pcm_hw_params_set_period_wakeup);
+    _PA_LOAD_FUNC(snd_pcm_htimestamp);
 
     _PA_LOAD_FUNC(snd_pcm_hw_params_sizeof);
     _PA_LOAD_FUNC(snd_pcm_hw_params_malloc);
     _PA_LOAD_FUNC(snd_pcm_hw_params_free);
+    _PA_LOAD_FUNC(snd_pcm_hw_params_copy);
     _PA_LOAD_FUNC(snd_pcm_hw_params_any);
     _PA_LOAD_FUNC(snd_pcm_hw_params_set_access);
     _PA_LOAD_FUNC(snd_pcm_hw_params_set_format);
@@ -462,6 +479,7 @@ static int PaAlsa_LoadLibrary()
     _PA_LOAD_FUNC(snd_pcm_sw_params_set_silence_size);
     _PA_LOAD_FUNC(snd_pcm_sw_params_set_xfer_align);
     _PA_LOAD_FUNC(snd_pcm_sw_params_set_tstamp_mode);
+    _PA_LOAD_FUNC(snd_pcm_sw_params_set_tstamp_type);
 
     _PA_LOAD_FUNC(snd_pcm_info);
     _PA_LOAD_FUNC(snd_pcm_info_sizeof);
@@ -482,6 +500,7 @@ static int PaAlsa_LoadLibrary()
     _PA_LOAD_FUNC(snd_ctl_card_info);
     _PA_LOAD_FUNC(snd_ctl_card_info_sizeof);
     _PA_LOAD_FUNC(snd_ctl_card_info_get_name);
+    _PA_LOAD_FUNC(snd_ctl_card_info_get_id);
 
     _PA_LOAD_FUNC(snd_config);
     _PA_LOAD_FUNC(snd_config_update);
@@ -586,6 +605,40 @@ static void PaAlsa_CloseLibrary()
 
 static int numPeriods_ = 4;
 static int busyRetries_ = 100;
+static int timerScheduling_ = 0;
+
+/** Hardware buffer to configure for timer scheduled playback, in seconds. Only the write-ahead target of it
+ * is kept filled, the rest guards against underruns when the callback thread is delayed. */
+#define PA_ALSA_TIMER_BUFFER_SECONDS_ (2.0)
+
+/** Bounds of the margin by which the timer wakes up before the fill level reaches its mark, in seconds. */
+#define PA_ALSA_TIMER_MIN_MARGIN_ (0.001)
+
+/** Shortest sleep of the timer, to avoid spinning when the margin exceeds the time to the next mark. */
+#define PA_ALSA_TIMER_MIN_SLEEP_ (0.0005)
+
+/** Most pcms an aggregate stream may combine, see PaAlsaAggregateStreamInfo. */
+#define PA_ALSA_AGGREGATE_MAX_DEVICES_ (16)
+
+/** Time constant over which the alignment error of an aggregate member is smoothed, in seconds. */
+#define PA_ALSA_AGGREGATE_SMOOTHING_ (1.0)
+
+/** Gains of the controller steering an aggregate member's rate, per second of alignment error. */
+#define PA_ALSA_AGGREGATE_KP_ (0.07)
+#define PA_ALSA_AGGREGATE_KI_ (0.0025)
+
+/** Largest relative rate correction of an aggregate member, well beyond the drift of sound card clocks. */
+#define PA_ALSA_AGGREGATE_MAX_CORRECTION_ (0.005)
+
+/** Frames the master of an aggregate is delayed by beyond the members' periods, for the interpolator. */
+#define PA_ALSA_AGGREGATE_HEADROOM_ (4)
+
+/** Xruns within the window after which adaptive latency grows the buffers, see PaAlsa_SetAdaptiveLatency. */
+#define PA_ALSA_ADAPT_XRUNS_ (3)
+#define PA_ALSA_ADAPT_WINDOW_ (10.0)
+
+/** Seconds without xruns after which adaptive latency shrinks the buffers a step. */
+#define PA_ALSA_ADAPT_CLEAN_ (60.0)
 
 int PaAlsa_SetNumPeriods( int numPeriods )
 {
@@ -605,7 +658,7 @@ typedef struct
     int numUserChannels, numHostChannels;
     int userInterleaved, hostInterleaved;
     int canMmap;
-    void *nonMmapBuffer;
+    void *nonMmapBuffer;                /* Carved from the stream arena, holds alsaBufferSize frames */
     unsigned int nonMmapBufferSize;
     PaDeviceIndex device;     /* Keep the device index */
     int deviceIsPlug; /* Distinguish plug types from direct 'hw:' devices */
@@ -621,8 +674,55 @@ typedef struct
     StreamDirection streamDir;
 
     snd_pcm_channel_area_t *channelAreas;  /* Needed for channel adaption */
+    int zeroCopy;                   /* The user format matches the mmap area, see Pa_GetStreamWriteRegion */
+    snd_pcm_uframes_t regionFrames; /* Frames handed out as a region at offset, not yet committed */
+    snd_pcm_uframes_t writeAhead;   /* Fill level kept with timer scheduling, 0 if driven by period wakeups */
+    clockid_t tstampClock;          /* The clock ALSA timestamps this pcm by */
+    snd_pcm_hw_params_t *setupParams;   /* The hw params short of the buffer size, for adaptive latency */
+    snd_pcm_uframes_t minBufferSize;    /* The buffer size opened with, adaptive latency doesn't go below it */
+    snd_pcm_uframes_t adaptBufferSize;  /* The buffer size adaptive latency aims for, applied when the pcm restarts */
+    snd_pcm_uframes_t adaptReserve;     /* Frames of the playback buffer left unfilled until then */
 } PaAlsaStreamComponent;
 
+/* A pcm captured along with the master of an aggregate stream, resampled to the master's clock */
+typedef struct
+{
+    snd_pcm_t *pcm;
+    int linked;                     /* Started and stopped with the master by snd_pcm_link */
+    int numChannels, firstChannel;  /* The member's channels among the stream's */
+    PaSampleFormat hostSampleFormat;
+    PaUtilConverter *toFloat;
+    snd_pcm_uframes_t framesPerPeriod, alsaBufferSize;
+    void *readBuffer;               /* alsaBufferSize interleaved frames in the host format */
+
+    /* Captured frames waiting to be resampled, interleaved. The interpolator reads around position */
+    float *frames;
+    unsigned long numFrames, maxFrames;
+    float *resampled;
+    double position;
+    double ratio;                   /* Member frames per master frame */
+    double error, integral;         /* Smoothed alignment error in seconds and the controller's integral term */
+} PaAlsaAggregateMember;
+
+/* The members of an aggregate stream and the buffers combining them with the master, the capture component */
+typedef struct
+{
+    int numMembers;
+    PaAlsaAggregateMember *members;
+    int numChannels, numMasterChannels;
+    unsigned long delay;            /* Frames the master is held back by */
+    unsigned long maxFrames;        /* Most frames rendered at once, the master's buffer size */
+    unsigned int sampleSize;        /* Of the master's host format, which all channels are staged in */
+    PaUtilConverter *copyMaster, *fromFloat;
+    PaUtilZeroer *zeroer;
+    PaUtilTriangularDitherGenerator ditherGenerator;
+    unsigned char *masterFrames;    /* The master's delayed frames followed by the latest, interleaved */
+    unsigned char *staging;         /* All channels, interleaved, registered with the buffer processor */
+    unsigned long renderedFrames;
+} PaAlsaAggregate;
+
+struct PaAlsaSharedThread;
+
 /* Implementation specific stream structure */
 typedef struct PaAlsaStream
 {
@@ -637,12 +737,41 @@ typedef struct PaAlsaStream
     int callbackMode;              /* bool: are we running in callback mode? */
     int pcmsSynced;                /* Have we successfully synced pcms */
     int rtSched;
+    int useWatchdog;               /* Demote the callback thread if it runs away, see PaUnixThread_StartWatchdog */
+    int lockMemory;                /* paLockMemory: lock audio path memory */
+    int stackLockRecorded;         /* The callback thread's stack lock has been reported in the stream info */
+    void *lockedStack;             /* The callback thread's locked stack, unlocked by OnExit */
+    int stackLockReserved;         /* Room to record the stack lock is reserved, see PaUnixThread_ReserveStackLock */
+    int useSharedThread;           /* Service the stream on the host API's shared thread, see PaAlsa_EnableSharedThread */
+    int timerScheduling;           /* Pace playback by a timer, see PaAlsa_SetTimerScheduling */
+    int groupStart;                /* Only prepare the pcms, PaAlsa_StartStreamGroup triggers them */
+    double timerMargin;            /* Seconds the timer wakes up early, widened after underruns */
+
+    /* Adaptive latency, see PaAlsa_SetAdaptiveLatency */
+    PaTime adaptMaxLatency;        /* 0 unless enabled */
+    PaAlsaLatencyCallback *latencyCallback;
+    void *latencyUserData;
+    PaUtilNotifier *latencyNotifier;
+    PaTime adaptWindowStart;       /* Of the xruns counted towards growing */
+    int adaptXruns;
+    PaTime adaptLastChange;        /* Last xrun or resize, shrinking waits for a clean stretch after it */
+    int adaptResize;               /* 1 to grow the buffers when the stream next restarts */
+    PaStreamInfo latencyInfo;      /* The stream info as of the last change, published under timeSequence */
+
+    /* The stream's clock and the callback's latest view of it, published with a sequence count so
+     * GetStreamTime can read it from any thread without locking or calling into ALSA */
+    clockid_t timeClock;
+    volatile unsigned int timeSequence;
+    volatile PaTime lastTime;
 
     /* the callback thread uses these to poll the sound device(s), waiting
      * for data to be ready/available */
     struct pollfd* pfds;
     int pollTimeout;
 
+    /* pfds and the components' userBuffers and nonMmapBuffer are carved from this one block */
+    PaUtilArena arena;
+
     /* Used in communication between threads */
     volatile sig_atomic_t callback_finished; /* bool: are we in the "callback finished" state? */
     volatile sig_atomic_t callbackAbort;    /* Drop frames? */
@@ -655,9 +784,71 @@ typedef struct PaAlsaStream
     PaTime overrun;
 
     PaAlsaStreamComponent capture, playback;
+    PaAlsaAggregate aggregate;      /* Pcms captured along with capture, if numMembers is set */
+
+    /* State kept across wakeups while the stream is serviced by the shared thread */
+    struct PaAlsaSharedThread *sharedThread;    /* The host API's shared thread, set for the current run */
+    struct PaAlsaStream *nextShared;            /* Next stream in the shared thread's lists */
+    int sharedAttached;                         /* Owned by the shared thread, protected by its mutex */
+    volatile sig_atomic_t sharedStopRequest;    /* paComplete or paAbort once StopStream/AbortStream was called */
+    int sharedCallbackResult;
+    PaStreamCallbackFlags sharedCbFlags;
+    unsigned long sharedSerial;                 /* Last epoll_wait round the stream was serviced in */
+    PaTime sharedDeadline;                      /* Full duplex: give up waiting for the other pcm, 0 if not waiting */
+    PaTime sharedLastEvent;                     /* Last time a pcm was ready, to detect stalled devices */
+    PaAlsaStreamComponent *sharedMasked;        /* Ready pcm taken out of the epoll set while waiting */
 }
 PaAlsaStream;
 
+/** The shared I/O thread, servicing every stream started with PaAlsa_EnableSharedThread.
+ *
+ * The thread waits in epoll_wait on the poll descriptors of all its streams and services each ready stream
+ * in turn, with the same callback semantics as a stream's own callback thread. StartStream hands streams
+ * over through the attaching list and the wakeup eventfd, the thread lets go of them again once they
+ * finish or are stopped.
+ */
+typedef struct PaAlsaSharedThread
+{
+    PaUnixMutex mtx;
+    pthread_cond_t detached;        /* Signalled when the thread lets go of a stream */
+    int running;
+    int quit;
+    PaUnixThread thread;
+    int epollFd;
+    int wakeFd;                     /* eventfd, wakes the thread for attach, stop and quit requests */
+    PaAlsaStream *attaching;        /* Streams handed over by StartStream, protected by mtx */
+    PaAlsaStream *streams;          /* Streams being serviced, only touched by the thread */
+
+    /* Taken from the stream that started the thread */
+    int configured;
+    PaThreadConfiguration configuration;
+    PaTime period;
+
+    /* The stack is locked when the thread starts, if the stream starting it asks for paLockMemory */
+    int lockStack;
+    int stackLockReserved;
+    int stackLocked;
+    void *lockedStack;              /* Unlocked when the thread exits */
+    PaError stackLockResult;
+    PaTime stackLockDuration;
+}
+PaAlsaSharedThread;
+
+/** On-disk cache of device capabilities, see BuildDeviceList.
+ *
+ * Entries are only used while the key, made from the ids of the sound cards and the modification times of
+ * the ALSA configuration files, matches the current system.
+ */
+typedef struct
+{
+    char *path;                         /* NULL if the cache is disabled */
+    char *key;
+    struct PaAlsaDeviceInfo *devices;   /* Capabilities read from the cache, by alsaName */
+    int numDevices;
+    int dirty;                          /* Devices have been probed since the cache was read or written */
+}
+PaAlsaDeviceCache;
+
 /* PaAlsaHostApiRepresentation - host api datastructure specific to this implementation */
 
 typedef struct PaAlsaHostApiRepresentation
@@ -665,11 +856,20 @@ typedef struct PaAlsaHostApiRepresentation
     PaUtilHostApiRepresentation baseHostApiRep;
     PaUtilStreamInterface callbackStreamInterface;
     PaUtilStreamInterface blockingStreamInterface;
+    PaUtilStreamRegionInterface regionInterface;
+    PaUtilStreamPollInterface pollInterface;
 
     PaUtilAllocationGroup *allocations;
 
     PaHostApiIndex hostApiIndex;
     PaUint32 alsaLibVersion; /* Retrieved from the library at run-time */
+
+    PaAlsaSharedThread sharedThread;
+
+    int probeMode;          /* Mode to open pcms with for probing, SND_PCM_NONBLOCK or 0 */
+    int lazyProbe;          /* Probe device capabilities on first use */
+    int usePlughw;          /* Open sound cards through plughw: instead of hw: */
+    PaAlsaDeviceCache cache;
 }
 PaAlsaHostApiRepresentation;
 
@@ -680,6 +880,11 @@ typedef struct PaAlsaDeviceInfo
     int isPlug;
     int minInputChannels;
     int minOutputChannels;
+    int hasCapture, hasPlayback;    /* As reported by the card, or assumed for plugins */
+    int probed;                     /* The capabilities have been probed or read from the cache */
+    char *cardId;                   /* Identifies sound card devices across refreshes, NULL for plugins */
+    int pcmDevice;
+    int unavailable;                /* The sound card has been detached, see RefreshDeviceList */
 }
 PaAlsaDeviceInfo;
 
@@ -708,6 +913,9 @@ static PaError IsStreamActive( PaStream *stream );
 static PaTime GetStreamTime( PaStream *stream );
 static double GetStreamCpuLoad( PaStream* stream );
 static PaError BuildDeviceList( PaAlsaHostApiRepresentation *hostApi );
+static void ProbeDeviceInfo( PaUtilHostApiRepresentation *hostApi, int device );
+static PaError RefreshDeviceList( PaUtilHostApiRepresentation *hostApi );
+static void PaAlsaDeviceCache_Save( PaAlsaHostApiRepresentation *alsaApi );
 static int SetApproximateSampleRate( snd_pcm_t *pcm, snd_pcm_hw_params_t *hwParams, double sampleRate );
 static int GetExactSampleRate( snd_pcm_hw_params_t *hwParams, double *sampleRate );
 static PaUint32 PaAlsaVersionNum(void);
@@ -715,15 +923,36 @@ static PaUint32 PaAlsaVersionNum(void);
 /* Callback prototypes */
 static void *CallbackThreadFunc( void *userData );
 
+/* Shared thread prototypes */
+static PaError PaAlsaSharedThread_Initialize( PaAlsaSharedThread *self );
+static void PaAlsaSharedThread_Terminate( PaAlsaSharedThread *self );
+static PaError PaAlsaSharedThread_Start( PaAlsaSharedThread *self, PaAlsaStream *stream );
+static PaError PaAlsaSharedThread_Attach( PaAlsaSharedThread *self, PaAlsaStream *stream );
+static PaError PaAlsaSharedThread_StopStream( PaAlsaSharedThread *self, PaAlsaStream *stream, int abort );
+
 /* Blocking prototypes */
 static signed long GetStreamReadAvailable( PaStream* s );
 static signed long GetStreamWriteAvailable( PaStream* s );
 static PaError ReadStream( PaStream* stream, void *buffer, unsigned long frames );
 static PaError WriteStream( PaStream* stream, const void *buffer, unsigned long frames );
+static PaError GetStreamReadRegion( PaStream *s, const void **buffer, unsigned long *frames );
+static PaError CommitStreamRead( PaStream *s, unsigned long frames );
+static PaError GetStreamWriteRegion( PaStream *s, void **buffer, unsigned long *frames );
+static PaError CommitStreamWrite( PaStream *s, unsigned long frames );
+static int GetStreamPollDescriptors( PaStream *s, PaStreamPollDescriptor *descriptors, int maxDescriptors );
+static PaError ProcessStreamPollEvents( PaStream *s, const PaStreamPollDescriptor *descriptors, int numDescriptors,
+        int *ready );
 
 
+/** Look up the device info for a host API specific device index, as pa_front passes to IsFormatSupported
+ * and OpenStream. Devices added by Pa_RefreshDeviceList() are appended to our list, so the index applies as is.
+ */
 static const PaAlsaDeviceInfo *GetDeviceInfo( const PaUtilHostApiRepresentation *hostApi, int device )
 {
+    assert( device >= 0 && device < hostApi->info.deviceCount );
+
+    /* Probing only completes the device info, the device list itself stays the same */
+    ProbeDeviceInfo( (PaUtilHostApiRepresentation *)hostApi, device );
     return (const PaAlsaDeviceInfo *)hostApi->deviceInfos[device];
 }
 
@@ -745,8 +974,11 @@ PaError PaAlsa_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
 
     PA_UNLESS( alsaHostApi = (PaAlsaHostApiRepresentation*) PaUtil_AllocateMemory(
                 sizeof(PaAlsaHostApiRepresentation) ), paInsufficientMemory );
+    memset( &alsaHostApi->cache, 0, sizeof (PaAlsaDeviceCache) );
     PA_UNLESS( alsaHostApi->allocations = PaUtil_CreateAllocationGroup(), paInsufficientMemory );
     alsaHostApi->hostApiIndex = hostApiIndex;
+    alsaHostApi->lazyProbe = 0;
+    alsaHostApi->usePlughw = 0;
     alsaHostApi->alsaLibVersion = PaAlsaVersionNum();
 
     *hostApi = (PaUtilHostApiRepresentation*)alsaHostApi;
@@ -783,13 +1015,22 @@ PaError PaAlsa_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
                                       GetStreamReadAvailable,
                                       GetStreamWriteAvailable );
 
+    alsaHostApi->regionInterface.GetReadRegion = GetStreamReadRegion;
+    alsaHostApi->regionInterface.CommitRead = CommitStreamRead;
+    alsaHostApi->regionInterface.GetWriteRegion = GetStreamWriteRegion;
+    alsaHostApi->regionInterface.CommitWrite = CommitStreamWrite;
+    alsaHostApi->pollInterface.GetPollDescriptors = GetStreamPollDescriptors;
+    alsaHostApi->pollInterface.ProcessPollEvents = ProcessStreamPollEvents;
+
     PA_ENSURE( PaUnixThreading_Initialize() );
+    PA_ENSURE( PaAlsaSharedThread_Initialize( &alsaHostApi->sharedThread ) );
 
     return result;
 
 error:
     if( alsaHostApi )
     {
+        PaUtil_FreeMemory( alsaHostApi->cache.devices );
         if( alsaHostApi->allocations )
         {
             PaUtil_FreeAllAllocations( alsaHostApi->allocations );
@@ -812,6 +1053,12 @@ static void Terminate( struct PaUtilHostApiRepresentation *hostApi )
     */
     /*snd_lib_error_set_handler(NULL);*/
 
+    PaAlsaSharedThread_Terminate( &alsaHostApi->sharedThread );
+
+    if( alsaHostApi->cache.dirty )
+        PaAlsaDeviceCache_Save( alsaHostApi );
+    PaUtil_FreeMemory( alsaHostApi->cache.devices );
+
     if( alsaHostApi->allocations )
     {
         PaUtil_FreeAllAllocations( alsaHostApi->allocations );
@@ -987,6 +1234,10 @@ typedef struct
     int isPlug;
     int hasPlayback;
     int hasCapture;
+    PaError probeResult;    /* Outcome of probing the device while building the device list */
+    char *cardId;           /* Id of the sound card, NULL for plugins */
+    int pcmDevice;
+    int listed;             /* Already in the device list, see RefreshDeviceList */
 } HwDevInfo;
 
 
@@ -1042,7 +1293,7 @@ static const HwDevInfo *FindDeviceName( const char *name )
     return NULL;
 }
 
-static PaError PaAlsa_StrDup( PaAlsaHostApiRepresentation *alsaApi,
+static PaError PaAlsa_GroupStrDup( PaUtilAllocationGroup *allocations,
         char **dst,
         const char *src)
 {
@@ -1051,7 +1302,7 @@ static PaError PaAlsa_StrDup( PaAlsaHostApiRepresentation *alsaApi,
 
     /* PA_DEBUG(("PaStrDup %s %d\n", src, len)); */
 
-    PA_UNLESS( *dst = (char *)PaUtil_GroupAllocateMemory( alsaApi->allocations, len ),
+    PA_UNLESS( *dst = (char *)PaUtil_GroupAllocateMemory( allocations, len ),
             paInsufficientMemory );
     strncpy( *dst, src, len );
 
@@ -1059,6 +1310,13 @@ error:
     return result;
 }
 
+static PaError PaAlsa_StrDup( PaAlsaHostApiRepresentation *alsaApi,
+        char **dst,
+        const char *src)
+{
+    return PaAlsa_GroupStrDup( alsaApi->allocations, dst, src );
+}
+
 /* Disregard some standard plugins
  */
 static int IgnorePlugin( const char *pluginId )
@@ -1146,66 +1404,502 @@ static int OpenPcm( snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t stream,
     return ret;
 }
 
-static PaError FillInDevInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* deviceHwInfo, int blocking,
-        PaAlsaDeviceInfo* devInfo, int* devIdx )
+/** First line of the device cache file, bump the version when the format changes. */
+#define PA_ALSA_CACHE_HEADER_ "PortAudio ALSA device cache 1"
+
+/** Get the newest modification time of a configuration directory and the files in it.
+ *
+ * Removing a file updates the directory's own modification time, and links are followed so that edits of
+ * the files they point to are noticed as well.
+ * @return -1 if the directory doesn't exist.
+ */
+static long long PaAlsaDeviceCache_DirectoryTime( const char *path )
 {
-    PaError result = 0;
-    PaDeviceInfo *baseDeviceInfo = &devInfo->baseDeviceInfo;
-    snd_pcm_t *pcm = NULL;
-    PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
+    char entryPath[PATH_MAX];
+    struct stat st;
+    struct dirent *entry;
+    long long newest;
+    DIR *dir;
 
-    PA_DEBUG(( "%s: Filling device info for: %s\n", __FUNCTION__, deviceHwInfo->name ));
+    if( stat( path, &st ) != 0 || !( dir = opendir( path ) ) )
+        return -1;
+    newest = (long long)st.st_mtime;
 
-    /* Zero fields */
-    InitializeDeviceInfo( baseDeviceInfo );
+    while( ( entry = readdir( dir ) ) )
+    {
+        if( entry->d_name[0] == '.' )
+            continue;
+        snprintf( entryPath, sizeof (entryPath), "%s/%s", path, entry->d_name );
+        if( stat( entryPath, &st ) == 0 && (long long)st.st_mtime > newest )
+            newest = (long long)st.st_mtime;
+    }
+    closedir( dir );
+
+    return newest;
+}
+
+/** Build the key under which device capabilities are cached.
+ *
+ * The capabilities of a device only change with the hardware or the ALSA configuration, so the key is made
+ * from the ids of the sound cards, the size and modification time of the configuration files and the newest
+ * modification time in the configuration directories they include.
+ * @param cardIds The ids of the sound cards, in order.
+ */
+static PaError PaAlsaDeviceCache_SetKey( PaAlsaHostApiRepresentation *alsaApi, const char *cardIds )
+{
+    PaError result = paNoError;
+    const char *configPath = getenv( "ALSA_CONFIG_PATH" ), *home = getenv( "HOME" );
+    char userConfig[PATH_MAX], key[PATH_MAX + 512];
+    const char *configFiles[3];
+    static const char *configDirs[] = { "/usr/share/alsa/alsa.conf.d", "/etc/alsa/conf.d" };
+    size_t len;
+    int i;
+
+    configFiles[0] = configPath ? configPath : "/usr/share/alsa/alsa.conf";
+    configFiles[1] = "/etc/asound.conf";
+    snprintf( userConfig, sizeof (userConfig), "%s/.asoundrc", home ? home : "" );
+    configFiles[2] = userConfig;
+
+    len = snprintf( key, sizeof (key), "cards %s config %s", cardIds, configFiles[0] );
+    for( i = 0; i < 3 && len < sizeof (key); ++i )
+    {
+        struct stat st;
+        if( stat( configFiles[i], &st ) == 0 )
+            len += snprintf( key + len, sizeof (key) - len, " %lld:%lld", (long long)st.st_mtime, (long long)st.st_size );
+        else
+            len += snprintf( key + len, sizeof (key) - len, " -" );
+    }
+    for( i = 0; i < 2 && len < sizeof (key); ++i )
+        len += snprintf( key + len, sizeof (key) - len, " %lld", PaAlsaDeviceCache_DirectoryTime( configDirs[i] ) );
+    /* A truncated key could miss changes */
+    PA_UNLESS( len < sizeof (key), paInternalError );
+
+    PA_ENSURE( PaAlsa_StrDup( alsaApi, &alsaApi->cache.key, key ) );
+
+error:
+    return result;
+}
+
+/** Read a line of the cache file into line, which holds size bytes.
+ *
+ * @return 0 at the end of the file. Lines that don't fit are skipped, and returned as empty.
+ */
+static int PaAlsaDeviceCache_ReadLine( FILE *file, char *line, size_t size )
+{
+    size_t len;
+
+    if( !fgets( line, size, file ) )
+        return 0;
+    len = strlen( line );
+    if( len > 0 && line[len - 1] != '\n' && !feof( file ) )
+    {
+        int c;
+        while( ( c = fgetc( file ) ) != EOF && c != '\n' )
+            ;
+        line[0] = '\0';
+    }
+    return 1;
+}
+
+/** Read the device capabilities from the cache file, unless its key differs from the current one.
+ */
+static void PaAlsaDeviceCache_Load( PaAlsaHostApiRepresentation *alsaApi )
+{
+    PaAlsaDeviceCache *cache = &alsaApi->cache;
+    FILE *file;
+    char *line;
+    size_t len, lineSize;
+    int maxDevices = 0;
+
+    if( !( file = fopen( cache->path, "r" ) ) )
+    {
+        PA_DEBUG(( "%s: No device cache at %s\n", __FUNCTION__, cache->path ));
+        return;
+    }
+    /* Room for the key line, which is the longest unless a device has an unusually long name */
+    len = strlen( cache->key );
+    lineSize = PA_MAX( len + sizeof ("key \n"), 1024 );
+    if( !( line = (char *) PaUtil_AllocateMemory( lineSize ) ) )
+        goto end;
+
+    if( !PaAlsaDeviceCache_ReadLine( file, line, lineSize ) || strcmp( line, PA_ALSA_CACHE_HEADER_ "\n" ) )
+        goto end;
+    if( !PaAlsaDeviceCache_ReadLine( file, line, lineSize ) || strncmp( line, "key ", 4 ) ||
+            strncmp( line + 4, cache->key, len ) || strcmp( line + 4 + len, "\n" ) )
+    {
+        PA_DEBUG(( "%s: Device cache is out of date\n", __FUNCTION__ ));
+        goto end;
+    }
+
+    while( PaAlsaDeviceCache_ReadLine( file, line, lineSize ) )
+    {
+        PaAlsaDeviceInfo *device;
+        PaDeviceInfo *info;
+        int nameOffset = 0;
+
+        if( cache->numDevices == maxDevices )
+        {
+            PaAlsaDeviceInfo *devices;
+            maxDevices = maxDevices ? maxDevices * 2 : 16;
+            if( !( devices = (PaAlsaDeviceInfo *) PaUtil_AllocateMemory( maxDevices * sizeof (PaAlsaDeviceInfo) ) ) )
+                break;
+            if( cache->devices )
+            {
+                memcpy( devices, cache->devices, cache->numDevices * sizeof (PaAlsaDeviceInfo) );
+                PaUtil_FreeMemory( cache->devices );
+            }
+            cache->devices = devices;
+        }
+
+        device = &cache->devices[cache->numDevices];
+        info = &device->baseDeviceInfo;
+        InitializeDeviceInfo( info );
+        if( sscanf( line, "%d %d %d %d %lf %lf %lf %lf %lf %n", &info->maxInputChannels, &info->maxOutputChannels,
+                    &device->minInputChannels, &device->minOutputChannels, &info->defaultSampleRate,
+                    &info->defaultLowInputLatency, &info->defaultHighInputLatency, &info->defaultLowOutputLatency,
+                    &info->defaultHighOutputLatency, &nameOffset ) < 9 || 0 == nameOffset )
+            continue;
+
+        len = strlen( line + nameOffset );
+        if( len > 0 && line[nameOffset + len - 1] == '\n' )
+            line[nameOffset + len - 1] = '\0';
+        if( PaAlsa_StrDup( alsaApi, &device->alsaName, line + nameOffset ) != paNoError )
+            break;
+        ++cache->numDevices;
+    }
+    PA_DEBUG(( "%s: Read %d devices from %s\n", __FUNCTION__, cache->numDevices, cache->path ));
+
+end:
+    PaUtil_FreeMemory( line );
+    fclose( file );
+}
+
+/** Fill in the capabilities of a device from the cache.
+ *
+ * @return 1 if the device was found.
+ */
+static int PaAlsaDeviceCache_Lookup( const PaAlsaDeviceCache *cache, PaAlsaDeviceInfo *devInfo )
+{
+    int i;
+
+    for( i = 0; i < cache->numDevices; ++i )
+    {
+        const PaAlsaDeviceInfo *cached = &cache->devices[i];
+        if( strcmp( cached->alsaName, devInfo->alsaName ) )
+            continue;
+
+        devInfo->baseDeviceInfo.maxInputChannels = cached->baseDeviceInfo.maxInputChannels;
+        devInfo->baseDeviceInfo.maxOutputChannels = cached->baseDeviceInfo.maxOutputChannels;
+        devInfo->minInputChannels = cached->minInputChannels;
+        devInfo->minOutputChannels = cached->minOutputChannels;
+        devInfo->baseDeviceInfo.defaultSampleRate = cached->baseDeviceInfo.defaultSampleRate;
+        devInfo->baseDeviceInfo.defaultLowInputLatency = cached->baseDeviceInfo.defaultLowInputLatency;
+        devInfo->baseDeviceInfo.defaultHighInputLatency = cached->baseDeviceInfo.defaultHighInputLatency;
+        devInfo->baseDeviceInfo.defaultLowOutputLatency = cached->baseDeviceInfo.defaultLowOutputLatency;
+        devInfo->baseDeviceInfo.defaultHighOutputLatency = cached->baseDeviceInfo.defaultHighOutputLatency;
+        return 1;
+    }
+    return 0;
+}
+
+/** Write the capabilities of all probed devices to the cache file.
+ *
+ * The file is replaced atomically, so concurrent processes never read a partial cache.
+ */
+static void PaAlsaDeviceCache_Save( PaAlsaHostApiRepresentation *alsaApi )
+{
+    const PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
+    PaAlsaDeviceCache *cache = &alsaApi->cache;
+    char tmpPath[PATH_MAX];
+    FILE *file;
+    int i, failed;
+
+    assert( cache->path && cache->key );
+
+    snprintf( tmpPath, sizeof (tmpPath), "%s.%d", cache->path, (int)getpid() );
+    if( !( file = fopen( tmpPath, "w" ) ) )
+    {
+        PA_DEBUG(( "%s: Failed creating %s\n", __FUNCTION__, tmpPath ));
+        return;
+    }
+
+    fprintf( file, PA_ALSA_CACHE_HEADER_ "\nkey %s\n", cache->key );
+    for( i = 0; i < baseApi->info.deviceCount; ++i )
+    {
+        const PaAlsaDeviceInfo *devInfo = (const PaAlsaDeviceInfo *)baseApi->deviceInfos[i];
+        const PaDeviceInfo *info = &devInfo->baseDeviceInfo;
+
+        /* Devices that failed to open may only be busy, probe them again next time */
+        if( !devInfo->probed || ( info->maxInputChannels <= 0 && info->maxOutputChannels <= 0 ) )
+            continue;
+
+        fprintf( file, "%d %d %d %d %.17g %.17g %.17g %.17g %.17g %s\n", info->maxInputChannels,
+                info->maxOutputChannels, devInfo->minInputChannels, devInfo->minOutputChannels,
+                info->defaultSampleRate, info->defaultLowInputLatency, info->defaultHighInputLatency,
+                info->defaultLowOutputLatency, info->defaultHighOutputLatency, devInfo->alsaName );
+    }
+
+    failed = ferror( file );
+    if( fclose( file ) != 0 || failed || rename( tmpPath, cache->path ) != 0 )
+    {
+        PA_DEBUG(( "%s: Failed writing %s\n", __FUNCTION__, cache->path ));
+        remove( tmpPath );
+        return;
+    }
+    cache->dirty = 0;
+}
+
+/** Probe the capabilities of a device by opening it for capture and playback.
+ *
+ * On failure the device is left with zero channels for the direction that failed. Different devices may be
+ * probed concurrently, see ProbeDevices.
+ */
+static PaError ProbeDevice( PaAlsaHostApiRepresentation *alsaApi, PaAlsaDeviceInfo *devInfo )
+{
+    PaError result = paNoError;
+    snd_pcm_t *pcm = NULL;
+
+    PA_DEBUG(( "%s: Probing device: %s\n", __FUNCTION__, devInfo->alsaName ));
+    devInfo->probed = 1;
 
     /* To determine device capabilities, we must open the device and query the
      * hardware parameter configuration space */
 
     /* Query capture */
-    if( deviceHwInfo->hasCapture &&
-        OpenPcm( &pcm, deviceHwInfo->alsaName, SND_PCM_STREAM_CAPTURE, blocking, 0 ) >= 0 )
+    if( devInfo->hasCapture &&
+        OpenPcm( &pcm, devInfo->alsaName, SND_PCM_STREAM_CAPTURE, alsaApi->probeMode, 0 ) >= 0 )
     {
-        if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_In, blocking, devInfo ) != paNoError )
+        if( ( result = GropeDevice( pcm, devInfo->isPlug, StreamDirection_In, alsaApi->probeMode, devInfo ) )
+                != paNoError )
         {
             /* Error */
-            PA_DEBUG(( "%s: Failed groping %s for capture\n", __FUNCTION__, deviceHwInfo->alsaName ));
+            PA_DEBUG(( "%s: Failed groping %s for capture\n", __FUNCTION__, devInfo->alsaName ));
             goto end;
         }
     }
 
     /* Query playback */
-    if( deviceHwInfo->hasPlayback &&
-        OpenPcm( &pcm, deviceHwInfo->alsaName, SND_PCM_STREAM_PLAYBACK, blocking, 0 ) >= 0 )
+    if( devInfo->hasPlayback &&
+        OpenPcm( &pcm, devInfo->alsaName, SND_PCM_STREAM_PLAYBACK, alsaApi->probeMode, 0 ) >= 0 )
     {
-        if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_Out, blocking, devInfo ) != paNoError )
+        if( ( result = GropeDevice( pcm, devInfo->isPlug, StreamDirection_Out, alsaApi->probeMode, devInfo ) )
+                != paNoError )
         {
             /* Error */
-            PA_DEBUG(( "%s: Failed groping %s for playback\n", __FUNCTION__, deviceHwInfo->alsaName ));
+            PA_DEBUG(( "%s: Failed groping %s for playback\n", __FUNCTION__, devInfo->alsaName ));
             goto end;
         }
     }
 
+end:
+    return result;
+}
+
+/** Remember that a device has been probed successfully, so the device cache is written back.
+ */
+static void MarkDeviceProbed( PaAlsaHostApiRepresentation *alsaApi, const PaAlsaDeviceInfo *devInfo )
+{
+    if( alsaApi->cache.path &&
+            ( devInfo->baseDeviceInfo.maxInputChannels > 0 || devInfo->baseDeviceInfo.maxOutputChannels > 0 ) )
+        alsaApi->cache.dirty = 1;
+}
+
+/** Complete a device info left unprobed by BuildDeviceList, see PaUtil_SetDeviceInfoProbe.
+ */
+static void ProbeDeviceInfo( PaUtilHostApiRepresentation *hostApi, int device )
+{
+    PaAlsaDeviceInfo *devInfo = (PaAlsaDeviceInfo *)hostApi->deviceInfos[device];
+
+    if( devInfo->probed )
+        return;
+    if( ProbeDevice( (PaAlsaHostApiRepresentation *)hostApi, devInfo ) != paNoError )
+        PA_DEBUG(( "%s: Failed probing %s\n", __FUNCTION__, devInfo->alsaName ));
+    else
+        MarkDeviceProbed( (PaAlsaHostApiRepresentation *)hostApi, devInfo );
+}
+
+/** Work shared by the threads of ProbeDevices. */
+typedef struct
+{
+    PaAlsaHostApiRepresentation *alsaApi;
+    HwDevInfo *hwDevInfos;
+    PaAlsaDeviceInfo *devInfos;
+    const size_t *jobs;     /* Indices of the sound card devices to probe, each card's devices in a row */
+    size_t numJobs;
+    size_t nextJob;
+    pthread_mutex_t mtx;
+} PaAlsaProbeJobs;
+
+static void *ProbeDevicesThreadFunc( void *userData )
+{
+    PaAlsaProbeJobs *jobs = (PaAlsaProbeJobs *)userData;
+
+    for( ;; )
+    {
+        size_t first, end, j;
+
+        /* Take all devices of the next card, opening hw and plughw devices of one card concurrently would
+         * have all but one of them fail as busy */
+        pthread_mutex_lock( &jobs->mtx );
+        first = end = jobs->nextJob;
+        while( end < jobs->numJobs && !strcmp( jobs->hwDevInfos[jobs->jobs[end]].cardId,
+                    jobs->hwDevInfos[jobs->jobs[first]].cardId ) )
+            ++end;
+        jobs->nextJob = end;
+        pthread_mutex_unlock( &jobs->mtx );
+        if( first == end )
+            break;
+
+        /* Each job writes only to its own device, the results are merged in list order afterwards */
+        for( j = first; j < end; ++j )
+            jobs->hwDevInfos[jobs->jobs[j]].probeResult = ProbeDevice( jobs->alsaApi, &jobs->devInfos[jobs->jobs[j]] );
+    }
+
+    return NULL;
+}
+
+/** Probe the listed devices that were not found in the device cache.
+ *
+ * With more than one thread the sound cards are handed out to a pool of threads, so the time taken is
+ * bounded by the slowest cards rather than the sum of all of them. A card's devices are probed one after
+ * the other by the same thread, and plugins, which may open any card, are probed by the calling thread
+ * once the pool is done. Devices therefore never fail as busy because of each other. The calling thread
+ * takes part in the probing, if threads cannot be created the remaining work is simply done by fewer of them.
+ * @param jobs Indices of the devices to probe, in device list order.
+ */
+static PaError ProbeDevices( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo *hwDevInfos, PaAlsaDeviceInfo *devInfos,
+        size_t *jobs, size_t numJobs, int numThreads )
+{
+    PaError result = paNoError;
+    PaAlsaProbeJobs probeJobs;
+    pthread_t *threads = NULL;
+    int numStarted = 0, i;
+    size_t j, k, numCardJobs;
+
+    /* Skip devices that need no probing, and move plugins to the end. Card devices are listed card by card,
+     * so each card's devices stay in a row */
+    for( j = 0, k = 0; j < numJobs; ++j )
+    {
+        if( devInfos[jobs[j]].probed || alsaApi->lazyProbe || !hwDevInfos[jobs[j]].cardId )
+            continue;
+        jobs[k++] = jobs[j];
+    }
+    numCardJobs = k;
+    for( j = 0; j < numJobs; ++j )
+    {
+        if( devInfos[jobs[j]].probed || alsaApi->lazyProbe || hwDevInfos[jobs[j]].cardId )
+            continue;
+        jobs[k++] = jobs[j];
+    }
+    numJobs = k;
+    if( numThreads > (int)numCardJobs )
+        numThreads = (int)numCardJobs;
+
+    probeJobs.alsaApi = alsaApi;
+    probeJobs.hwDevInfos = hwDevInfos;
+    probeJobs.devInfos = devInfos;
+    probeJobs.jobs = jobs;
+    probeJobs.numJobs = numCardJobs;
+    probeJobs.nextJob = 0;
+    PA_ENSURE_SYSTEM( pthread_mutex_init( &probeJobs.mtx, NULL ), 0 );
+
+    if( numThreads > 1 && ( threads = (pthread_t *) malloc( ( numThreads - 1 ) * sizeof (pthread_t) ) ) )
+    {
+        for( i = 0; i < numThreads - 1; ++i )
+        {
+            if( pthread_create( &threads[numStarted], NULL, ProbeDevicesThreadFunc, &probeJobs ) != 0 )
+            {
+                PA_DEBUG(( "%s: Failed creating probe thread, continuing with %d\n", __FUNCTION__, numStarted + 1 ));
+                break;
+            }
+            ++numStarted;
+        }
+    }
+
+    ProbeDevicesThreadFunc( &probeJobs );
+    for( i = 0; i < numStarted; ++i )
+        pthread_join( threads[i], NULL );
+    free( threads );
+    pthread_mutex_destroy( &probeJobs.mtx );
+
+    for( j = numCardJobs; j < numJobs; ++j )
+        hwDevInfos[jobs[j]].probeResult = ProbeDevice( alsaApi, &devInfos[jobs[j]] );
+
+    for( j = 0; j < numJobs; ++j )
+    {
+        if( hwDevInfos[jobs[j]].probeResult == paNoError )
+            MarkDeviceProbed( alsaApi, &devInfos[jobs[j]] );
+    }
+
+error:
+    return result;
+}
+
+/** Initialize a device info from what is known without opening the device, that is the names and any
+ * capabilities found in the device cache. ProbeDevices completes the rest.
+ *
+ * @param useCache Whether to look the device up in the cache. The cache key only covers the sound cards
+ * present at initialization, and card indices are reused when cards come and go.
+ */
+static void InitializeAlsaDeviceInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* deviceHwInfo,
+        PaAlsaDeviceInfo* devInfo, int useCache )
+{
+    PaDeviceInfo *baseDeviceInfo = &devInfo->baseDeviceInfo;
+
+    /* Zero fields */
+    InitializeDeviceInfo( baseDeviceInfo );
+
     baseDeviceInfo->structVersion = 2;
     baseDeviceInfo->hostApi = alsaApi->hostApiIndex;
     baseDeviceInfo->name = deviceHwInfo->name;
     devInfo->alsaName = deviceHwInfo->alsaName;
     devInfo->isPlug = deviceHwInfo->isPlug;
+    devInfo->minInputChannels = 0;
+    devInfo->minOutputChannels = 0;
+    devInfo->hasCapture = deviceHwInfo->hasCapture;
+    devInfo->hasPlayback = deviceHwInfo->hasPlayback;
+    devInfo->cardId = deviceHwInfo->cardId;
+    devInfo->pcmDevice = deviceHwInfo->pcmDevice;
+    devInfo->unavailable = 0;
+    devInfo->probed = useCache && PaAlsaDeviceCache_Lookup( &alsaApi->cache, devInfo );
+    deviceHwInfo->probeResult = paNoError;
+}
+
+static PaError FillInDevInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* deviceHwInfo,
+        PaAlsaDeviceInfo* devInfo, int* devIdx )
+{
+    PaError result = 0;
+    PaDeviceInfo *baseDeviceInfo = &devInfo->baseDeviceInfo;
+    PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
+    int hasInput, hasOutput;
+
+    PA_DEBUG(( "%s: Filling device info for: %s\n", __FUNCTION__, deviceHwInfo->name ));
+
+    if( deviceHwInfo->probeResult != paNoError )
+    {
+        /* Probing failed, the device may be busy */
+        goto end;
+    }
+
+    /* Unprobed devices are assumed to work in the directions the card reports, ProbeDeviceInfo completes
+     * them on first use */
+    hasInput = devInfo->probed ? baseDeviceInfo->maxInputChannels > 0 : devInfo->hasCapture;
+    hasOutput = devInfo->probed ? baseDeviceInfo->maxOutputChannels > 0 : devInfo->hasPlayback;
 
     /* A: Storing pointer to PaAlsaDeviceInfo object as pointer to PaDeviceInfo object.
      * Should now be safe to add device info, unless the device supports neither capture nor playback
      */
-    if( baseDeviceInfo->maxInputChannels > 0 || baseDeviceInfo->maxOutputChannels > 0 )
+    if( hasInput || hasOutput )
     {
         /* Make device default if there isn't already one or it is the ALSA "default" device */
         if( ( baseApi->info.defaultInputDevice == paNoDevice ||
-            !strcmp( deviceHwInfo->alsaName, "default" ) ) && baseDeviceInfo->maxInputChannels > 0 )
+            !strcmp( deviceHwInfo->alsaName, "default" ) ) && hasInput )
         {
             baseApi->info.defaultInputDevice = *devIdx;
             PA_DEBUG(( "Default input device: %s\n", deviceHwInfo->name ));
         }
         if( ( baseApi->info.defaultOutputDevice == paNoDevice ||
-            !strcmp( deviceHwInfo->alsaName, "default" ) ) && baseDeviceInfo->maxOutputChannels > 0 )
+            !strcmp( deviceHwInfo->alsaName, "default" ) ) && hasOutput )
         {
             baseApi->info.defaultOutputDevice = *devIdx;
             PA_DEBUG(( "Default output device: %s\n", deviceHwInfo->name ));
@@ -1223,43 +1917,25 @@ end:
     return result;
 }
 
-/* Build PaDeviceInfo list, ignore devices for which we cannot determine capabilities (possibly busy, sigh) */
-static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
+/** Append the PCM devices of all sound cards to a list of devices.
+ *
+ * @param allocations The group the device names are allocated from.
+ * @param cardIds Receives the indices and ids of the cards, truncated if longer than cardIdsSize.
+ * @param cardIdsLen Receives the length cardIds would have had without truncation.
+ */
+static PaError GatherCardDevices( PaAlsaHostApiRepresentation *alsaApi, PaUtilAllocationGroup *allocations,
+        HwDevInfo **hwDevInfos, size_t *numDevices, size_t *maxDevices, char *cardIds, size_t cardIdsSize,
+        size_t *cardIdsLen )
 {
-    PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
-    PaAlsaDeviceInfo *deviceInfoArray;
-    int cardIdx = -1, devIdx = 0;
-    snd_ctl_card_info_t *cardInfo;
     PaError result = paNoError;
-    size_t numDeviceNames = 0, maxDeviceNames = 1, i;
-    HwDevInfo *hwDevInfos = NULL;
-    snd_config_t *topNode = NULL;
+    int cardIdx = -1;
+    snd_ctl_card_info_t *cardInfo;
     snd_pcm_info_t *pcmInfo;
-    int res;
-    int blocking = SND_PCM_NONBLOCK;
-    int usePlughw = 0;
-    char *hwPrefix = "";
+    int usePlughw = alsaApi->usePlughw;
+    char *hwPrefix = usePlughw ? "plug" : "";
     char alsaCardName[50];
-#ifdef PA_ENABLE_DEBUG_OUTPUT
-    PaTime startTime = PaUtil_GetTime();
-#endif
-
-    if( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) && atoi( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) ) )
-        blocking = 0;
 
-    /* If PA_ALSA_PLUGHW is 1 (non-zero), use the plughw: pcm throughout instead of hw: */
-    if( getenv( "PA_ALSA_PLUGHW" ) && atoi( getenv( "PA_ALSA_PLUGHW" ) ) )
-    {
-        usePlughw = 1;
-        hwPrefix = "plug";
-        PA_DEBUG(( "%s: Using Plughw\n", __FUNCTION__ ));
-    }
-
-    /* These two will be set to the first working input and output device, respectively */
-    baseApi->info.defaultInputDevice = paNoDevice;
-    baseApi->info.defaultOutputDevice = paNoDevice;
-
-    /* Gather info about hw devices
+    /* Gather info about hw devices
 
      * alsa_snd_card_next() modifies the integer passed to it to be:
      *      the index of the first card if the parameter is -1
@@ -1272,7 +1948,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
     alsa_snd_pcm_info_alloca( &pcmInfo );
     while( alsa_snd_card_next( &cardIdx ) == 0 && cardIdx >= 0 )
     {
-        char *cardName;
+        char *cardName, *cardId;
         int devIdx = -1;
         snd_ctl_t *ctl;
         char buf[50];
@@ -1288,7 +1964,11 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
         }
         alsa_snd_ctl_card_info( ctl, cardInfo );
 
-        PA_ENSURE( PaAlsa_StrDup( alsaApi, &cardName, alsa_snd_ctl_card_info_get_name( cardInfo )) );
+        PA_ENSURE( PaAlsa_GroupStrDup( allocations, &cardName, alsa_snd_ctl_card_info_get_name( cardInfo )) );
+        PA_ENSURE( PaAlsa_GroupStrDup( allocations, &cardId, alsa_snd_ctl_card_info_get_id( cardInfo ) ) );
+        if( *cardIdsLen < cardIdsSize )
+            *cardIdsLen += snprintf( cardIds + *cardIdsLen, cardIdsSize - *cardIdsLen, "%s%d:%s",
+                    *cardIdsLen ? "," : "", cardIdx, cardId );
 
         while( alsa_snd_ctl_pcm_next_device( ctl, &devIdx ) == 0 && devIdx >= 0 )
         {
@@ -1323,29 +2003,95 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
 
             /* The length of the string written by snprintf plus terminating 0 */
             len = snprintf( NULL, 0, "%s: %s (%s)", cardName, infoName, buf ) + 1;
-            PA_UNLESS( deviceName = (char *)PaUtil_GroupAllocateMemory( alsaApi->allocations, len ),
+            PA_UNLESS( deviceName = (char *)PaUtil_GroupAllocateMemory( allocations, len ),
                     paInsufficientMemory );
             snprintf( deviceName, len, "%s: %s (%s)", cardName, infoName, buf );
 
-            ++numDeviceNames;
-            if( !hwDevInfos || numDeviceNames > maxDeviceNames )
+            ++*numDevices;
+            if( !(*hwDevInfos) || *numDevices > *maxDevices )
             {
-                maxDeviceNames *= 2;
-                PA_UNLESS( hwDevInfos = (HwDevInfo *) realloc( hwDevInfos, maxDeviceNames * sizeof (HwDevInfo) ),
+                *maxDevices *= 2;
+                PA_UNLESS( (*hwDevInfos) = (HwDevInfo *) realloc( (*hwDevInfos), *maxDevices * sizeof (HwDevInfo) ),
                         paInsufficientMemory );
             }
 
-            PA_ENSURE( PaAlsa_StrDup( alsaApi, &alsaDeviceName, buf ) );
+            PA_ENSURE( PaAlsa_GroupStrDup( allocations, &alsaDeviceName, buf ) );
 
-            hwDevInfos[ numDeviceNames - 1 ].alsaName = alsaDeviceName;
-            hwDevInfos[ numDeviceNames - 1 ].name = deviceName;
-            hwDevInfos[ numDeviceNames - 1 ].isPlug = usePlughw;
-            hwDevInfos[ numDeviceNames - 1 ].hasPlayback = hasPlayback;
-            hwDevInfos[ numDeviceNames - 1 ].hasCapture = hasCapture;
+            (*hwDevInfos)[ *numDevices - 1 ].alsaName = alsaDeviceName;
+            (*hwDevInfos)[ *numDevices - 1 ].name = deviceName;
+            (*hwDevInfos)[ *numDevices - 1 ].isPlug = usePlughw;
+            (*hwDevInfos)[ *numDevices - 1 ].hasPlayback = hasPlayback;
+            (*hwDevInfos)[ *numDevices - 1 ].hasCapture = hasCapture;
+            (*hwDevInfos)[ *numDevices - 1 ].cardId = cardId;
+            (*hwDevInfos)[ *numDevices - 1 ].pcmDevice = devIdx;
+            (*hwDevInfos)[ *numDevices - 1 ].listed = 0;
         }
         alsa_snd_ctl_close( ctl );
     }
 
+error:
+    return result;
+}
+
+/* Build PaDeviceInfo list, ignore devices for which we cannot determine capabilities (possibly busy, sigh)
+ *
+ * Opening every device to query its capabilities is slow, two environment variables avoid most of it:
+ * If PA_ALSA_LAZY_PROBE is 1 (non-zero), devices are listed without being opened and probed on the first
+ * Pa_GetDeviceInfo() or stream open instead. Devices that turn out to be unusable then report zero channels.
+ * If PA_ALSA_DEVICE_CACHE names a file, capabilities are read from it and written back after probing. The
+ * cache is ignored when the sound cards or the ALSA configuration files have changed.
+ * If PA_ALSA_PROBE_THREADS is larger than 1, up to that many sound cards are probed concurrently. Devices keep
+ * their position in the list regardless of the order in which probing completes.
+ */
+static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
+{
+    PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
+    PaAlsaDeviceInfo *deviceInfoArray;
+    int devIdx = 0;
+    PaError result = paNoError;
+    size_t numDeviceNames = 0, maxDeviceNames = 1, i;
+    HwDevInfo *hwDevInfos = NULL;
+    size_t *probeJobs = NULL, numProbeJobs;
+    int numProbeThreads = 0;
+    snd_config_t *topNode = NULL;
+    int res;
+    int blocking = SND_PCM_NONBLOCK;
+    char cardIds[256] = "";
+    size_t cardIdsLen = 0;
+    const char *cachePath = getenv( "PA_ALSA_DEVICE_CACHE" );
+#ifdef PA_ENABLE_DEBUG_OUTPUT
+    PaTime startTime = PaUtil_GetTime();
+#endif
+
+    if( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) && atoi( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) ) )
+        blocking = 0;
+    alsaApi->probeMode = blocking;
+
+    if( getenv( "PA_ALSA_LAZY_PROBE" ) && atoi( getenv( "PA_ALSA_LAZY_PROBE" ) ) )
+    {
+        alsaApi->lazyProbe = 1;
+        PA_DEBUG(( "%s: Probing devices lazily\n", __FUNCTION__ ));
+    }
+    if( getenv( "PA_ALSA_PROBE_THREADS" ) )
+    {
+        numProbeThreads = PA_MIN( atoi( getenv( "PA_ALSA_PROBE_THREADS" ) ), 64 );
+        PA_DEBUG(( "%s: Probing with up to %d threads\n", __FUNCTION__, numProbeThreads ));
+    }
+
+    /* If PA_ALSA_PLUGHW is 1 (non-zero), use the plughw: pcm throughout instead of hw: */
+    if( getenv( "PA_ALSA_PLUGHW" ) && atoi( getenv( "PA_ALSA_PLUGHW" ) ) )
+    {
+        alsaApi->usePlughw = 1;
+        PA_DEBUG(( "%s: Using Plughw\n", __FUNCTION__ ));
+    }
+
+    /* These two will be set to the first working input and output device, respectively */
+    baseApi->info.defaultInputDevice = paNoDevice;
+    baseApi->info.defaultOutputDevice = paNoDevice;
+
+    PA_ENSURE( GatherCardDevices( alsaApi, alsaApi->allocations, &hwDevInfos, &numDeviceNames, &maxDeviceNames,
+            cardIds, sizeof (cardIds), &cardIdsLen ) );
+
     /* Iterate over plugin devices */
     if( NULL == (*alsa_snd_config) )
     {
@@ -1406,6 +2152,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             hwDevInfos[numDeviceNames - 1].alsaName = alsaDeviceName;
             hwDevInfos[numDeviceNames - 1].name     = deviceName;
             hwDevInfos[numDeviceNames - 1].isPlug   = 1;
+            hwDevInfos[numDeviceNames - 1].cardId   = NULL;
 
             if( predefined )
             {
@@ -1430,6 +2177,18 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
     PA_UNLESS( deviceInfoArray = (PaAlsaDeviceInfo*)PaUtil_GroupAllocateMemory(
             alsaApi->allocations, sizeof(PaAlsaDeviceInfo) * numDeviceNames ), paInsufficientMemory );
 
+    /* The cache can only be trusted if its key captures every card */
+    if( cachePath && cardIdsLen < sizeof (cardIds) && PaAlsaDeviceCache_SetKey( alsaApi, cardIds ) == paNoError )
+    {
+        PA_ENSURE( PaAlsa_StrDup( alsaApi, &alsaApi->cache.path, cachePath ) );
+        PaAlsaDeviceCache_Load( alsaApi );
+    }
+
+    PA_UNLESS( probeJobs = (size_t *) malloc( ( numDeviceNames ? numDeviceNames : 1 ) * sizeof (size_t) ),
+            paInsufficientMemory );
+    for( i = 0; i < numDeviceNames; ++i )
+        InitializeAlsaDeviceInfo( alsaApi, &hwDevInfos[i], &deviceInfoArray[i], 1 );
+
     /* Loop over list of cards, filling in info. If a device is deemed unavailable (can't get name),
      * it's ignored.
      *
@@ -1439,6 +2198,12 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
      * for this.
      */
     PA_DEBUG(( "%s: Filling device info for %d devices\n", __FUNCTION__, numDeviceNames ));
+    for( i = 0, numProbeJobs = 0; i < numDeviceNames; ++i )
+    {
+        if( strcmp( hwDevInfos[i].name, "dmix" ) && strcmp( hwDevInfos[i].name, "default" ) )
+            probeJobs[numProbeJobs++] = i;
+    }
+    PA_ENSURE( ProbeDevices( alsaApi, hwDevInfos, deviceInfoArray, probeJobs, numProbeJobs, numProbeThreads ) );
     for( i = 0, devIdx = 0; i < numDeviceNames; ++i )
     {
         PaAlsaDeviceInfo* devInfo = &deviceInfoArray[i];
@@ -1448,10 +2213,16 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             continue;
         }
 
-        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx ) );
+        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, devInfo, &devIdx ) );
     }
     assert( devIdx < numDeviceNames );
     /* Now inspect 'dmix' and 'default' plugins */
+    for( i = 0, numProbeJobs = 0; i < numDeviceNames; ++i )
+    {
+        if( !strcmp( hwDevInfos[i].name, "dmix" ) || !strcmp( hwDevInfos[i].name, "default" ) )
+            probeJobs[numProbeJobs++] = i;
+    }
+    PA_ENSURE( ProbeDevices( alsaApi, hwDevInfos, deviceInfoArray, probeJobs, numProbeJobs, numProbeThreads ) );
     for( i = 0; i < numDeviceNames; ++i )
     {
         PaAlsaDeviceInfo* devInfo = &deviceInfoArray[i];
@@ -1461,12 +2232,19 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             continue;
         }
 
-        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx ) );
+        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, devInfo, &devIdx ) );
     }
+    free( probeJobs );
     free( hwDevInfos );
 
     baseApi->info.deviceCount = devIdx;   /* Number of successfully queried devices */
 
+    if( alsaApi->lazyProbe )
+        PaUtil_SetDeviceInfoProbe( alsaApi->hostApiIndex, ProbeDeviceInfo );
+    else if( alsaApi->cache.dirty )
+        PaAlsaDeviceCache_Save( alsaApi );
+    PaUtil_SetDeviceListRefresher( alsaApi->hostApiIndex, RefreshDeviceList );
+
 #ifdef PA_ENABLE_DEBUG_OUTPUT
     PA_DEBUG(( "%s: Building device list took %f seconds\n", __FUNCTION__, PaUtil_GetTime() - startTime ));
 #endif
@@ -1475,10 +2253,228 @@ end:
     return result;
 
 error:
-    /* No particular action */
+    free( probeJobs );
+    goto end;
+}
+
+/** Bring a sound card device in the list up to date with a card found by GatherCardDevices.
+ *
+ * The card may have returned under a different index, so the names are taken from the new card and the
+ * capabilities probed again, bypassing the device cache whose entries may describe another card.
+ */
+static PaError ReviveDevice( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo *hwInfo, PaAlsaDeviceInfo *devInfo )
+{
+    PaError result = paNoError;
+
+    PA_ENSURE( PaAlsa_StrDup( alsaApi, &hwInfo->alsaName, hwInfo->alsaName ) );
+    PA_ENSURE( PaAlsa_StrDup( alsaApi, &hwInfo->name, hwInfo->name ) );
+    PA_ENSURE( PaAlsa_StrDup( alsaApi, &hwInfo->cardId, hwInfo->cardId ) );
+    InitializeAlsaDeviceInfo( alsaApi, hwInfo, devInfo, 0 );
+
+    if( !devInfo->probed && !alsaApi->lazyProbe )
+    {
+        if( ProbeDevice( alsaApi, devInfo ) != paNoError ||
+                ( devInfo->baseDeviceInfo.maxInputChannels <= 0 && devInfo->baseDeviceInfo.maxOutputChannels <= 0 ) )
+        {
+            /* Possibly busy, try again on the next refresh */
+            hwInfo->probeResult = paDeviceUnavailable;
+        }
+        else
+            MarkDeviceProbed( alsaApi, devInfo );
+    }
+
+error:
+    return result;
+}
+
+/** Mark a device whose sound card has been detached as unavailable, it keeps its place in the list.
+ */
+static void RetireDevice( PaAlsaDeviceInfo *devInfo )
+{
+    PA_DEBUG(( "%s: Device %s is gone\n", __FUNCTION__, devInfo->baseDeviceInfo.name ));
+
+    devInfo->unavailable = 1;
+    devInfo->probed = 1;
+    devInfo->baseDeviceInfo.maxInputChannels = 0;
+    devInfo->baseDeviceInfo.maxOutputChannels = 0;
+}
+
+/** Update the device list for sound cards which have been attached or detached, see Pa_RefreshDeviceList.
+ *
+ * Sound card devices are identified by the card id and PCM device number, which unlike the card index stay
+ * the same when a card is attached again. New devices are appended to the list, plugins are left alone.
+ */
+static PaError RefreshDeviceList( PaUtilHostApiRepresentation *hostApi )
+{
+    PaAlsaHostApiRepresentation *alsaApi = (PaAlsaHostApiRepresentation *)hostApi;
+    PaError result = paNoError;
+    PaUtilAllocationGroup *scratch = NULL;
+    HwDevInfo *hwDevInfos = NULL;
+    size_t numDevices = 0, maxDevices = 1, numAdded = 0, i;
+    char cardIds[256];
+    size_t cardIdsLen = 0;
+    PaDeviceInfo **deviceInfos;
+    int device, changed = 0;
+
+    /* The cache key only covers the sound cards present at initialization, write back what was probed for
+     * those before the list changes */
+    if( alsaApi->cache.dirty )
+        PaAlsaDeviceCache_Save( alsaApi );
+
+    /* Gather into a scratch group, only the names of new devices are kept */
+    PA_UNLESS( scratch = PaUtil_CreateAllocationGroup(), paInsufficientMemory );
+    PA_ENSURE( GatherCardDevices( alsaApi, scratch, &hwDevInfos, &numDevices, &maxDevices, cardIds,
+            sizeof (cardIds), &cardIdsLen ) );
+
+    for( device = 0; device < hostApi->info.deviceCount; ++device )
+    {
+        PaAlsaDeviceInfo *devInfo = (PaAlsaDeviceInfo *)hostApi->deviceInfos[device];
+        HwDevInfo *hwInfo = NULL;
+
+        if( !devInfo->cardId )
+            continue;
+
+        for( i = 0; i < numDevices; ++i )
+        {
+            if( !strcmp( hwDevInfos[i].cardId, devInfo->cardId ) && hwDevInfos[i].pcmDevice == devInfo->pcmDevice )
+            {
+                hwInfo = &hwDevInfos[i];
+                hwInfo->listed = 1;
+                break;
+            }
+        }
+
+        if( !hwInfo )
+        {
+            if( !devInfo->unavailable )
+            {
+                RetireDevice( devInfo );
+                changed = 1;
+            }
+        }
+        else if( devInfo->unavailable || strcmp( hwInfo->alsaName, devInfo->alsaName ) )
+        {
+            changed = 1;
+            PA_DEBUG(( "%s: Device %s is back as %s\n", __FUNCTION__, devInfo->baseDeviceInfo.name, hwInfo->name ));
+            PA_ENSURE( ReviveDevice( alsaApi, hwInfo, devInfo ) );
+            if( hwInfo->probeResult != paNoError )
+                RetireDevice( devInfo );
+        }
+    }
+
+    for( i = 0; i < numDevices; ++i )
+    {
+        if( !hwDevInfos[i].listed )
+            ++numAdded;
+    }
+    if( numAdded > 0 )
+        changed = 1;
+    if( changed && alsaApi->cache.path )
+    {
+        /* The list no longer matches the cache key, stop using the cache */
+        PA_DEBUG(( "%s: Sound cards changed, disabling the device cache\n", __FUNCTION__ ));
+        alsaApi->cache.path = NULL;
+        alsaApi->cache.dirty = 0;
+    }
+    if( 0 == numAdded )
+        goto end;
+
+    /* The client may hold on to the old array's entries but not to the array itself */
+    PA_UNLESS( deviceInfos = (PaDeviceInfo **)PaUtil_GroupAllocateMemory( alsaApi->allocations,
+                sizeof (PaDeviceInfo *) * ( hostApi->info.deviceCount + numAdded ) ), paInsufficientMemory );
+    memcpy( deviceInfos, hostApi->deviceInfos, sizeof (PaDeviceInfo *) * hostApi->info.deviceCount );
+    hostApi->deviceInfos = deviceInfos;
+
+    for( i = 0; i < numDevices; ++i )
+    {
+        HwDevInfo *hwInfo = &hwDevInfos[i];
+        PaAlsaDeviceInfo *devInfo;
+
+        if( hwInfo->listed )
+            continue;
+
+        PA_UNLESS( devInfo = (PaAlsaDeviceInfo *)PaUtil_GroupAllocateMemory( alsaApi->allocations,
+                    sizeof (PaAlsaDeviceInfo) ), paInsufficientMemory );
+        PA_ENSURE( ReviveDevice( alsaApi, hwInfo, devInfo ) );
+        if( hwInfo->probeResult != paNoError )
+            continue;
+
+        PA_DEBUG(( "%s: Adding device %s: %d\n", __FUNCTION__, hwInfo->name, hostApi->info.deviceCount ));
+        hostApi->deviceInfos[hostApi->info.deviceCount++] = (PaDeviceInfo *)devInfo;
+    }
+
+end:
+    free( hwDevInfos );
+    if( scratch )
+    {
+        PaUtil_FreeAllAllocations( scratch );
+        PaUtil_DestroyAllocationGroup( scratch );
+    }
+    return result;
+
+error:
     goto end;
 }
 
+/* Aggregate capture, see PaAlsaAggregateStreamInfo.
+ *
+ * The master pcm is read as a normal capture component, the members are read whenever the master is. Every
+ * channel is staged in one buffer in the master's host format, which the buffer processor is pointed at
+ * instead of the master's own buffer. The master's frames are held back by a fixed delay, the members'
+ * frames are resampled to the master's clock. Each member's rate is steered by the difference between how
+ * many of its captured frames are yet to be output and how many of the master's are: the two backlogs
+ * match as long as the channels are aligned, whatever the devices' buffering, so steering the difference
+ * to zero tracks the drift and keeps the alignment at the same time. */
+
+static int IsAggregateStreamInfo( const void *streamInfo )
+{
+    const PaAlsaAggregateStreamInfo *info = (const PaAlsaAggregateStreamInfo *)streamInfo;
+    return info != NULL && info->size == sizeof (PaAlsaAggregateStreamInfo);
+}
+
+static PaError ValidateAggregateStreamInfo( const PaAlsaAggregateStreamInfo *info, int channelCount,
+        StreamDirection mode )
+{
+    PaError result = paNoError;
+    int i, numChannels = 0;
+
+    PA_UNLESS( info->version == 1 && StreamDirection_In == mode, paIncompatibleHostApiSpecificStreamInfo );
+    PA_UNLESS( info->numDevices > 0 && info->numDevices <= PA_ALSA_AGGREGATE_MAX_DEVICES_ &&
+            info->deviceStrings != NULL && info->channelCounts != NULL, paIncompatibleHostApiSpecificStreamInfo );
+    for( i = 0; i < info->numDevices; ++i )
+    {
+        PA_UNLESS( info->deviceStrings[i] != NULL, paInvalidDevice );
+        PA_UNLESS( info->channelCounts[i] > 0, paInvalidChannelCount );
+        numChannels += info->channelCounts[i];
+    }
+    PA_UNLESS( numChannels == channelCount, paInvalidChannelCount );
+
+error:
+    return result;
+}
+
+/** Stand-in parameters addressing the master pcm of an aggregate, which is opened like any named pcm.
+ *
+ * @return params itself unless it describes an aggregate, else masterParams
+ */
+static const PaStreamParameters *AggregateMasterParameters( const PaStreamParameters *params,
+        PaStreamParameters *masterParams, PaAlsaStreamInfo *masterInfo )
+{
+    const PaAlsaAggregateStreamInfo *info;
+
+    if( !params || !IsAggregateStreamInfo( params->hostApiSpecificStreamInfo ) )
+        return params;
+
+    info = (const PaAlsaAggregateStreamInfo *)params->hostApiSpecificStreamInfo;
+    PaAlsa_InitializeStreamInfo( masterInfo );
+    masterInfo->deviceString = info->deviceStrings[0];
+    *masterParams = *params;
+    masterParams->channelCount = info->channelCounts[0];
+    masterParams->hostApiSpecificStreamInfo = masterInfo;
+
+    return masterParams;
+}
+
 /* Check against known device capabilities */
 static PaError ValidateParameters( const PaStreamParameters *parameters, PaUtilHostApiRepresentation *hostApi, StreamDirection mode )
 {
@@ -1489,9 +2485,13 @@ static PaError ValidateParameters( const PaStreamParameters *parameters, PaUtilH
 
     if( parameters->device != paUseHostApiSpecificDeviceSpecification )
     {
-        assert( parameters->device < hostApi->info.deviceCount );
         PA_UNLESS( parameters->hostApiSpecificStreamInfo == NULL, paBadIODeviceCombination );
         deviceInfo = GetDeviceInfo( hostApi, parameters->device );
+        PA_UNLESS( !deviceInfo->unavailable, paDeviceUnavailable );
+    }
+    else if( IsAggregateStreamInfo( parameters->hostApiSpecificStreamInfo ) )
+    {
+        return ValidateAggregateStreamInfo( parameters->hostApiSpecificStreamInfo, parameters->channelCount, mode );
     }
     else
     {
@@ -1831,11 +2831,15 @@ static PaError IsFormatSupported( struct PaUtilHostApiRepresentation *hostApi,
     int inputChannelCount = 0, outputChannelCount = 0;
     PaSampleFormat inputSampleFormat, outputSampleFormat;
     PaError result = paFormatIsSupported;
+    PaStreamParameters masterParameters;
+    PaAlsaStreamInfo masterInfo;
 
     if( inputParameters )
     {
         PA_ENSURE( ValidateParameters( inputParameters, hostApi, StreamDirection_In ) );
 
+        /* Of an aggregate only the master is tested, the members are resampled to match it */
+        inputParameters = AggregateMasterParameters( inputParameters, &masterParameters, &masterInfo );
         inputChannelCount = inputParameters->channelCount;
         inputSampleFormat = inputParameters->sampleFormat;
     }
@@ -1912,13 +2916,7 @@ static PaError PaAlsaStreamComponent_Initialize( PaAlsaStreamComponent *self, Pa
     self->canMmap = 0;
     self->nonMmapBuffer = NULL;
     self->nonMmapBufferSize = 0;
-
-    if( !callbackMode && !self->userInterleaved )
-    {
-        /* Pre-allocate non-interleaved user provided buffers */
-        PA_UNLESS( self->userBuffers = PaUtil_AllocateMemory( sizeof (void *) * self->numUserChannels ),
-                paInsufficientMemory );
-    }
+    self->userBuffers = NULL;
 
 error:
 
@@ -1935,8 +2933,50 @@ error:
 static void PaAlsaStreamComponent_Terminate( PaAlsaStreamComponent *self )
 {
     alsa_snd_pcm_close( self->pcm );
-    PaUtil_FreeMemory( self->userBuffers ); /* (Ptr can be NULL; PaUtil_FreeMemory includes a NULL check) */
-    PaUtil_FreeMemory( self->nonMmapBuffer );
+    if( self->setupParams )
+        alsa_snd_pcm_hw_params_free( self->setupParams );
+    self->setupParams = NULL;
+    /* userBuffers and nonMmapBuffer belong to the stream arena */
+    self->userBuffers = NULL;
+    self->nonMmapBuffer = NULL;
+}
+
+/** Reserve space in the stream arena for the component's host buffers.
+ *
+ * Must be called after configuration, since the size of the non-mmap buffer depends on the ALSA buffer size.
+ */
+static void PaAlsaStreamComponent_ReserveBuffers( PaAlsaStreamComponent *self, PaUtilArena *arena, int callbackMode )
+{
+    if( !callbackMode && !self->userInterleaved )
+    {
+        /* Non-interleaved user provided buffers */
+        PaUtil_ReserveArenaMemory( arena, sizeof (void *) * self->numUserChannels );
+    }
+    if( !self->canMmap )
+    {
+        /* Large enough for a whole ALSA buffer, so it need never grow in the audio thread */
+        self->nonMmapBufferSize = self->numHostChannels * alsa_snd_pcm_format_size( self->nativeFormat,
+                self->alsaBufferSize );
+        PaUtil_ReserveArenaMemory( arena, self->nonMmapBufferSize );
+    }
+}
+
+/** Carve the component's host buffers from the committed stream arena.
+ *
+ * Reservations must have been made with PaAlsaStreamComponent_ReserveBuffers.
+ */
+static void PaAlsaStreamComponent_AllocateBuffers( PaAlsaStreamComponent *self, PaUtilArena *arena, int callbackMode )
+{
+    if( !callbackMode && !self->userInterleaved )
+    {
+        self->userBuffers = PaUtil_ArenaAllocateMemory( arena, sizeof (void *) * self->numUserChannels );
+        assert( self->userBuffers );
+    }
+    if( !self->canMmap )
+    {
+        self->nonMmapBuffer = PaUtil_ArenaAllocateMemory( arena, self->nonMmapBufferSize );
+        assert( self->nonMmapBuffer );
+    }
 }
 
 /*
@@ -2060,6 +3100,46 @@ error:
     goto end;
 }
 
+/** Set the software parameters for the configured buffer size. */
+static PaError PaAlsaStreamComponent_SetSwParams( PaAlsaStreamComponent *self, int primeBuffers )
+{
+    PaError result = paNoError;
+    snd_pcm_sw_params_t* swParams;
+
+    alsa_snd_pcm_sw_params_alloca( &swParams );
+
+    ENSURE_( alsa_snd_pcm_sw_params_current( self->pcm, swParams ), paUnanticipatedHostError );
+
+    ENSURE_( alsa_snd_pcm_sw_params_set_start_threshold( self->pcm, swParams, self->framesPerPeriod ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_set_stop_threshold( self->pcm, swParams, self->alsaBufferSize ), paUnanticipatedHostError );
+
+    /* Silence buffer in the case of underrun */
+    if( !primeBuffers ) /* XXX: Make sense? */
+    {
+        snd_pcm_uframes_t boundary;
+        ENSURE_( alsa_snd_pcm_sw_params_get_boundary( swParams, &boundary ), paUnanticipatedHostError );
+        ENSURE_( alsa_snd_pcm_sw_params_set_silence_threshold( self->pcm, swParams, 0 ), paUnanticipatedHostError );
+        ENSURE_( alsa_snd_pcm_sw_params_set_silence_size( self->pcm, swParams, boundary ), paUnanticipatedHostError );
+    }
+
+    ENSURE_( alsa_snd_pcm_sw_params_set_avail_min( self->pcm, swParams, self->framesPerPeriod + self->adaptReserve ),
+            paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_set_xfer_align( self->pcm, swParams, 1 ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_set_tstamp_mode( self->pcm, swParams, SND_PCM_TSTAMP_ENABLE ), paUnanticipatedHostError );
+
+    /* Timestamps default to the system time, which may be set while streaming */
+    self->tstampClock = CLOCK_REALTIME;
+    if( alsa_snd_pcm_sw_params_set_tstamp_type != NULL &&
+            alsa_snd_pcm_sw_params_set_tstamp_type( self->pcm, swParams, SND_PCM_TSTAMP_TYPE_MONOTONIC ) >= 0 )
+        self->tstampClock = CLOCK_MONOTONIC;
+
+    /* Set the parameters! */
+    ENSURE_( alsa_snd_pcm_sw_params( self->pcm, swParams ), paUnanticipatedHostError );
+
+error:
+    return result;
+}
+
 /** Finish the configuration of the component's ALSA device.
  *
  * As part of this method, the component's alsaBufferSize attribute will be set.
@@ -2069,13 +3149,16 @@ static PaError PaAlsaStreamComponent_FinishConfigure( PaAlsaStreamComponent *sel
         const PaStreamParameters *params, int primeBuffers, double sampleRate, PaTime* latency )
 {
     PaError result = paNoError;
-    snd_pcm_sw_params_t* swParams;
     snd_pcm_uframes_t bufSz = 0;
     *latency = -1.;
 
-    alsa_snd_pcm_sw_params_alloca( &swParams );
+    /* Keep the configuration short of the buffer size, to resize the buffer for adaptive latency */
+    if( self->canMmap && !self->writeAhead && alsa_snd_pcm_hw_params_malloc( &self->setupParams ) >= 0 )
+        alsa_snd_pcm_hw_params_copy( self->setupParams, hwParams );
 
     bufSz = params->suggestedLatency * sampleRate + self->framesPerPeriod;
+    if( self->writeAhead )
+        bufSz = PA_MAX( bufSz, (snd_pcm_uframes_t)( PA_ALSA_TIMER_BUFFER_SECONDS_ * sampleRate ) );
     ENSURE_( alsa_snd_pcm_hw_params_set_buffer_size_near( self->pcm, hwParams, &bufSz ), paUnanticipatedHostError );
 
     /* Set the parameters! */
@@ -2102,60 +3185,305 @@ static PaError PaAlsaStreamComponent_FinishConfigure( PaAlsaStreamComponent *sel
 
     /* Latency in seconds */
     *latency = (self->alsaBufferSize - self->framesPerPeriod) / sampleRate;
-
-    /* Now software parameters... */
-    ENSURE_( alsa_snd_pcm_sw_params_current( self->pcm, swParams ), paUnanticipatedHostError );
-
-    ENSURE_( alsa_snd_pcm_sw_params_set_start_threshold( self->pcm, swParams, self->framesPerPeriod ), paUnanticipatedHostError );
-    ENSURE_( alsa_snd_pcm_sw_params_set_stop_threshold( self->pcm, swParams, self->alsaBufferSize ), paUnanticipatedHostError );
-
-    /* Silence buffer in the case of underrun */
-    if( !primeBuffers ) /* XXX: Make sense? */
+    if( self->writeAhead )
     {
-        snd_pcm_uframes_t boundary;
-        ENSURE_( alsa_snd_pcm_sw_params_get_boundary( swParams, &boundary ), paUnanticipatedHostError );
-        ENSURE_( alsa_snd_pcm_sw_params_set_silence_threshold( self->pcm, swParams, 0 ), paUnanticipatedHostError );
-        ENSURE_( alsa_snd_pcm_sw_params_set_silence_size( self->pcm, swParams, boundary ), paUnanticipatedHostError );
+        /* Only the write-ahead target is kept queued */
+        self->writeAhead = PA_MIN( self->writeAhead, self->alsaBufferSize - self->framesPerPeriod );
+        *latency = self->writeAhead / sampleRate;
+        PA_DEBUG(( "%s: Timer scheduling, buffer: %lu, write-ahead: %lu\n", __FUNCTION__, self->alsaBufferSize,
+                    self->writeAhead ));
     }
+    self->minBufferSize = self->alsaBufferSize;
+    self->adaptBufferSize = self->alsaBufferSize;
+    self->adaptReserve = 0;
 
-    ENSURE_( alsa_snd_pcm_sw_params_set_avail_min( self->pcm, swParams, self->framesPerPeriod ), paUnanticipatedHostError );
-    ENSURE_( alsa_snd_pcm_sw_params_set_xfer_align( self->pcm, swParams, 1 ), paUnanticipatedHostError );
-    ENSURE_( alsa_snd_pcm_sw_params_set_tstamp_mode( self->pcm, swParams, SND_PCM_TSTAMP_ENABLE ), paUnanticipatedHostError );
-
-    /* Set the parameters! */
-    ENSURE_( alsa_snd_pcm_sw_params( self->pcm, swParams ), paUnanticipatedHostError );
+    PA_ENSURE( PaAlsaStreamComponent_SetSwParams( self, primeBuffers ) );
 
 error:
     return result;
 }
 
-static PaError PaAlsaStream_Initialize( PaAlsaStream *self, PaAlsaHostApiRepresentation *alsaApi, const PaStreamParameters *inParams,
-        const PaStreamParameters *outParams, double sampleRate, unsigned long framesPerUserBuffer, PaStreamCallback callback,
-        PaStreamFlags streamFlags, void *userData )
+/** Open the members of an aggregate, the master has been opened as the capture component. */
+static PaError PaAlsaAggregate_Initialize( PaAlsaAggregate *self, const PaAlsaAggregateStreamInfo *info,
+        const PaAlsaStreamComponent *master )
 {
     PaError result = paNoError;
-    assert( self );
+    int i, firstChannel = info->channelCounts[0];
 
-    memset( self, 0, sizeof( PaAlsaStream ) );
+    self->numMembers = info->numDevices - 1;
+    PA_UNLESS( self->members = (PaAlsaAggregateMember *)PaUtil_AllocateMemory( self->numMembers *
+                sizeof (PaAlsaAggregateMember) ), paInsufficientMemory );
+    memset( self->members, 0, self->numMembers * sizeof (PaAlsaAggregateMember) );
+    self->numMasterChannels = master->numUserChannels;
 
-    if( NULL != callback )
-    {
-        PaUtil_InitializeStreamRepresentation( &self->streamRepresentation,
-                                               &alsaApi->callbackStreamInterface,
-                                               callback, userData );
-        self->callbackMode = 1;
-    }
-    else
+    for( i = 0; i < self->numMembers; ++i )
     {
-        PaUtil_InitializeStreamRepresentation( &self->streamRepresentation,
-                                               &alsaApi->blockingStreamInterface,
-                                               NULL, userData );
+        PaAlsaAggregateMember *member = &self->members[i];
+        int ret;
+
+        PA_DEBUG(( "%s: Opening aggregate member %s\n", __FUNCTION__, info->deviceStrings[i + 1] ));
+        if( (ret = OpenPcm( &member->pcm, info->deviceStrings[i + 1], SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK, 1 )) < 0 )
+        {
+            member->pcm = NULL;
+            ENSURE_( ret, -EBUSY == ret ? paDeviceUnavailable : paBadIODeviceCombination );
+        }
+
+        /* The members are converted to float for resampling anyway, stay close to the master otherwise */
+        PA_ENSURE( member->hostSampleFormat = PaUtil_SelectClosestAvailableFormat(
+                    GetAvailableFormats( member->pcm ), master->hostSampleFormat ) );
+        member->toFloat = PaUtil_SelectConverter( member->hostSampleFormat, paFloat32, paNoFlag );
+        PA_UNLESS( member->toFloat, paSampleFormatNotSupported );
+        member->numChannels = info->channelCounts[i + 1];
+        member->firstChannel = firstChannel;
+        firstChannel += member->numChannels;
     }
+    self->numChannels = firstChannel;
 
-    self->framesPerUserBuffer = framesPerUserBuffer;
-    self->neverDropInput = streamFlags & paNeverDropInput;
-    /* XXX: Ignore paPrimeOutputBuffersUsingStreamCallback untill buffer priming is fully supported in pa_process.c */
-    /*
+error:
+    return result;
+}
+
+static PaError PaAlsaAggregateMember_Configure( PaAlsaAggregateMember *self, snd_pcm_t *masterPcm,
+        snd_pcm_uframes_t framesPerPeriod, snd_pcm_uframes_t bufferSize, double sampleRate )
+{
+    PaError result = paNoError;
+    snd_pcm_hw_params_t *hwParams;
+    snd_pcm_sw_params_t *swParams;
+    snd_pcm_uframes_t boundary;
+    int dir = 0, err;
+
+    alsa_snd_pcm_hw_params_alloca( &hwParams );
+    alsa_snd_pcm_sw_params_alloca( &swParams );
+
+    ENSURE_( alsa_snd_pcm_hw_params_any( self->pcm, hwParams ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params_set_access( self->pcm, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED ),
+            paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params_set_format( self->pcm, hwParams, Pa2AlsaFormat( self->hostSampleFormat ) ),
+            paUnanticipatedHostError );
+    PA_UNLESS( alsa_snd_pcm_hw_params_set_channels( self->pcm, hwParams, self->numChannels ) >= 0,
+            paInvalidChannelCount );
+    PA_UNLESS( SetApproximateSampleRate( self->pcm, hwParams, sampleRate ) >= 0, paInvalidSampleRate );
+
+    self->framesPerPeriod = framesPerPeriod;
+    ENSURE_( alsa_snd_pcm_hw_params_set_period_size_near( self->pcm, hwParams, &self->framesPerPeriod, &dir ),
+            paUnanticipatedHostError );
+    self->alsaBufferSize = PA_MAX( bufferSize, 4 * self->framesPerPeriod );
+    ENSURE_( alsa_snd_pcm_hw_params_set_buffer_size_near( self->pcm, hwParams, &self->alsaBufferSize ),
+            paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params( self->pcm, hwParams ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params_get_buffer_size( hwParams, &self->alsaBufferSize ), paUnanticipatedHostError );
+
+    /* Members are started with the master, never by reading them */
+    ENSURE_( alsa_snd_pcm_sw_params_current( self->pcm, swParams ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_get_boundary( swParams, &boundary ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params_set_start_threshold( self->pcm, swParams, boundary ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_sw_params( self->pcm, swParams ), paUnanticipatedHostError );
+
+    if( (err = alsa_snd_pcm_link( masterPcm, self->pcm )) == 0 )
+        self->linked = 1;
+    else
+        PA_DEBUG(( "%s: Unable to link aggregate member: %s\n", __FUNCTION__, alsa_snd_strerror( err ) ));
+
+error:
+    return result;
+}
+
+/** Configure the members like the master, once the master has been configured.
+ *
+ * @param latency The master's latency, the delay of the master is added to it
+ */
+static PaError PaAlsaAggregate_Configure( PaAlsaAggregate *self, const PaAlsaStreamComponent *master,
+        double sampleRate, PaTime *latency )
+{
+    PaError result = paNoError;
+    int i;
+
+    self->sampleSize = Pa_GetSampleSize( master->hostSampleFormat );
+    self->maxFrames = master->alsaBufferSize;
+    self->copyMaster = PaUtil_SelectConverter( master->hostSampleFormat, master->hostSampleFormat,
+            paClipOff | paDitherOff );
+    self->fromFloat = PaUtil_SelectConverter( paFloat32, master->hostSampleFormat, paDitherOff );
+    self->zeroer = PaUtil_SelectZeroer( master->hostSampleFormat );
+    PA_UNLESS( self->copyMaster && self->fromFloat && self->zeroer, paSampleFormatNotSupported );
+    PaUtil_InitializeTriangularDitherState( &self->ditherGenerator );
+
+    /* A member's frames may not be readable until the end of its period */
+    self->delay = 0;
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+
+        PA_ENSURE( PaAlsaAggregateMember_Configure( member, master->pcm, master->framesPerPeriod,
+                    master->alsaBufferSize, sampleRate ) );
+        self->delay = PA_MAX( self->delay, member->framesPerPeriod );
+    }
+    self->delay += PA_ALSA_AGGREGATE_HEADROOM_;
+
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+        member->maxFrames = 1 + self->delay + member->alsaBufferSize + 2 * self->maxFrames;
+    }
+
+    *latency += self->delay / sampleRate;
+    PA_DEBUG(( "%s: Aggregate of %d channels, master delayed by %lu frames\n", __FUNCTION__, self->numChannels,
+                self->delay ));
+
+error:
+    return result;
+}
+
+static void PaAlsaAggregate_ReserveBuffers( PaAlsaAggregate *self, PaUtilArena *arena )
+{
+    int i;
+
+    PaUtil_ReserveArenaMemory( arena, self->numMasterChannels * ( self->delay + self->maxFrames ) * self->sampleSize );
+    PaUtil_ReserveArenaMemory( arena, self->numChannels * self->maxFrames * self->sampleSize );
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+
+        PaUtil_ReserveArenaMemory( arena, member->numChannels * member->alsaBufferSize *
+                Pa_GetSampleSize( member->hostSampleFormat ) );
+        PaUtil_ReserveArenaMemory( arena, member->numChannels * member->maxFrames * sizeof (float) );
+        PaUtil_ReserveArenaMemory( arena, member->numChannels * self->maxFrames * sizeof (float) );
+    }
+}
+
+static void PaAlsaAggregate_AllocateBuffers( PaAlsaAggregate *self, PaUtilArena *arena )
+{
+    int i;
+
+    self->masterFrames = PaUtil_ArenaAllocateMemory( arena, self->numMasterChannels * ( self->delay +
+                self->maxFrames ) * self->sampleSize );
+    self->staging = PaUtil_ArenaAllocateMemory( arena, self->numChannels * self->maxFrames * self->sampleSize );
+    assert( self->masterFrames && self->staging );
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+
+        member->readBuffer = PaUtil_ArenaAllocateMemory( arena, member->numChannels * member->alsaBufferSize *
+                Pa_GetSampleSize( member->hostSampleFormat ) );
+        member->frames = PaUtil_ArenaAllocateMemory( arena, member->numChannels * member->maxFrames *
+                sizeof (float) );
+        member->resampled = PaUtil_ArenaAllocateMemory( arena, member->numChannels * self->maxFrames *
+                sizeof (float) );
+        assert( member->readBuffer && member->frames && member->resampled );
+    }
+}
+
+/** Get ready to start, before the master is prepared.
+ *
+ * Both the master and the members start out with delay frames of silence, so the first frames of all of
+ * them come out together.
+ */
+static PaError PaAlsaAggregate_Prepare( PaAlsaAggregate *self )
+{
+    PaError result = paNoError;
+    int i;
+
+    self->zeroer( self->masterFrames, 1, self->numMasterChannels * self->delay );
+    self->renderedFrames = 0;
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+
+        /* One frame of history for the interpolator */
+        member->numFrames = 1 + self->delay;
+        memset( member->frames, 0, member->numChannels * member->numFrames * sizeof (float) );
+        member->position = 1.;
+        member->ratio = 1.;
+        member->error = member->integral = 0.;
+
+        /* Linked members are prepared along with the master */
+        if( !member->linked )
+            ENSURE_( alsa_snd_pcm_prepare( member->pcm ), paUnanticipatedHostError );
+    }
+
+error:
+    return result;
+}
+
+/** Start the members which couldn't be linked, after the master has been started. */
+static PaError PaAlsaAggregate_Start( PaAlsaAggregate *self )
+{
+    PaError result = paNoError;
+    int i;
+
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        if( !self->members[i].linked )
+            ENSURE_( alsa_snd_pcm_start( self->members[i].pcm ), paUnanticipatedHostError );
+    }
+
+error:
+    return result;
+}
+
+static PaError PaAlsaAggregate_Stop( PaAlsaAggregate *self )
+{
+    PaError result = paNoError;
+    int i;
+
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        if( !self->members[i].linked )
+            ENSURE_( alsa_snd_pcm_drop( self->members[i].pcm ), paUnanticipatedHostError );
+    }
+
+error:
+    return result;
+}
+
+static void PaAlsaAggregate_Terminate( PaAlsaAggregate *self )
+{
+    int i;
+
+    for( i = 0; i < self->numMembers && self->members; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+
+        if( !member->pcm )
+            continue;
+        if( member->linked )
+            alsa_snd_pcm_unlink( member->pcm );
+        alsa_snd_pcm_close( member->pcm );
+    }
+    PaUtil_FreeMemory( self->members );
+    self->members = NULL;
+    self->numMembers = 0;
+}
+
+static PaError PaAlsaStream_Initialize( PaAlsaStream *self, PaAlsaHostApiRepresentation *alsaApi, const PaStreamParameters *inParams,
+        const PaStreamParameters *outParams, double sampleRate, unsigned long framesPerUserBuffer, PaStreamCallback callback,
+        PaStreamFlags streamFlags, void *userData )
+{
+    PaError result = paNoError;
+    assert( self );
+
+    memset( self, 0, sizeof( PaAlsaStream ) );
+
+    if( NULL != callback )
+    {
+        PaUtil_InitializeStreamRepresentation( &self->streamRepresentation,
+                                               &alsaApi->callbackStreamInterface,
+                                               callback, userData );
+        self->callbackMode = 1;
+        self->streamRepresentation.headroom.supported = 1;
+        self->streamRepresentation.threadConfiguration.supported = 1;
+    }
+    else
+    {
+        PaUtil_InitializeStreamRepresentation( &self->streamRepresentation,
+                                               &alsaApi->blockingStreamInterface,
+                                               NULL, userData );
+    }
+
+    self->framesPerUserBuffer = framesPerUserBuffer;
+    self->neverDropInput = streamFlags & paNeverDropInput;
+    self->lockMemory = ( streamFlags & paLockMemory ) != 0;
+    /* XXX: Ignore paPrimeOutputBuffersUsingStreamCallback untill buffer priming is fully supported in pa_process.c */
+    /*
     if( outParams & streamFlags & paPrimeOutputBuffersUsingStreamCallback )
         self->primeBuffers = 1;
         */
@@ -2172,10 +3500,14 @@ static PaError PaAlsaStream_Initialize( PaAlsaStream *self, PaAlsaHostApiReprese
 
     assert( self->capture.nfds || self->playback.nfds );
 
-    PA_UNLESS( self->pfds = (struct pollfd*)PaUtil_AllocateMemory( ( self->capture.nfds +
-                    self->playback.nfds ) * sizeof( struct pollfd ) ), paInsufficientMemory );
+    /* Capture and full duplex streams are still woken by the capture pcm's periods */
+    self->timerScheduling = timerScheduling_ && callback && outParams && !inParams;
+    self->timerMargin = PA_ALSA_TIMER_MIN_MARGIN_;
+
+    PaUtil_InitializeArena( &self->arena, paAllocationHostApi );
 
     PaUtil_InitializeCpuLoadMeasurer( &self->cpuLoadMeasurer, sampleRate );
+    self->streamRepresentation.cpuLoadMeasurer = &self->cpuLoadMeasurer;
     ASSERT_CALL_( PaUnixMutex_Initialize( &self->stateMtx ), paNoError );
 
 error:
@@ -2190,6 +3522,12 @@ static void PaAlsaStream_Terminate( PaAlsaStream *self )
 {
     assert( self );
 
+    if( self->aggregate.members )
+    {
+        if( self->lockMemory )
+            PaUtil_UnlockMemory( self->aggregate.members, self->aggregate.numMembers * sizeof (PaAlsaAggregateMember) );
+        PaAlsaAggregate_Terminate( &self->aggregate );
+    }
     if( self->capture.pcm )
     {
         PaAlsaStreamComponent_Terminate( &self->capture );
@@ -2199,12 +3537,74 @@ static void PaAlsaStream_Terminate( PaAlsaStream *self )
         PaAlsaStreamComponent_Terminate( &self->playback );
     }
 
-    PaUtil_FreeMemory( self->pfds );
+    if( self->latencyNotifier )
+        PaUtil_DestroyNotifier( self->latencyNotifier );
+    self->pfds = NULL;
+    PaUtil_FreeArena( &self->arena );
     ASSERT_CALL_( PaUnixMutex_Terminate( &self->stateMtx ), paNoError );
 
+    if( self->lockMemory )
+        PaUtil_UnlockMemory( self, sizeof (PaAlsaStream) );
+    if( self->stackLockReserved )
+        PaUnixThread_ReleaseStackLock();
     PaUtil_FreeMemory( self );
 }
 
+/** Lock the memory touched by the callback thread, for the paLockMemory flag.
+ *
+ * The outcome is reported in the stream info; failure to lock is not fatal. The callback thread's stack is
+ * locked by the thread itself when it starts, room to record that is reserved here so the thread doesn't
+ * allocate.
+ */
+static void PaAlsaStream_LockMemory( PaAlsaStream *self )
+{
+    self->stackLockReserved = PaUnixThread_ReserveStackLock() == paNoError;
+    PaUtil_LockStreamMemory( &self->streamRepresentation, self, sizeof (PaAlsaStream) );
+    if( self->aggregate.numMembers )
+        PaUtil_LockStreamMemory( &self->streamRepresentation, self->aggregate.members,
+                self->aggregate.numMembers * sizeof (PaAlsaAggregateMember) );
+    PaUtil_LockStreamArena( &self->streamRepresentation, &self->arena );
+    PaUtil_LockStreamArena( &self->streamRepresentation, &self->bufferProcessor.arena );
+
+    PA_DEBUG(( "%s: Locked %lu bytes in %f s, result %d\n", __FUNCTION__,
+                self->streamRepresentation.streamInfo.lockedMemoryBytes,
+                self->streamRepresentation.streamInfo.memoryLockTime,
+                self->streamRepresentation.streamInfo.memoryLockResult ));
+}
+
+/** Allocate the stream's host memory from a single arena.
+ *
+ * Poll descriptors and the components' buffers are sized once configuration is complete, then carved from
+ * one contiguous block so that nothing needs to be allocated or grown while the stream is running.
+ */
+static PaError PaAlsaStream_AllocateHostBuffers( PaAlsaStream *self )
+{
+    PaError result = paNoError;
+    long pfdsSize = ( self->capture.nfds + self->playback.nfds ) * sizeof( struct pollfd );
+
+    PaUtil_ReserveArenaMemory( &self->arena, pfdsSize );
+    if( self->capture.pcm )
+        PaAlsaStreamComponent_ReserveBuffers( &self->capture, &self->arena, self->callbackMode );
+    if( self->playback.pcm )
+        PaAlsaStreamComponent_ReserveBuffers( &self->playback, &self->arena, self->callbackMode );
+    if( self->aggregate.numMembers )
+        PaAlsaAggregate_ReserveBuffers( &self->aggregate, &self->arena );
+
+    PA_ENSURE( PaUtil_CommitArena( &self->arena ) );
+
+    self->pfds = (struct pollfd*)PaUtil_ArenaAllocateMemory( &self->arena, pfdsSize );
+    assert( self->pfds );
+    if( self->capture.pcm )
+        PaAlsaStreamComponent_AllocateBuffers( &self->capture, &self->arena, self->callbackMode );
+    if( self->playback.pcm )
+        PaAlsaStreamComponent_AllocateBuffers( &self->playback, &self->arena, self->callbackMode );
+    if( self->aggregate.numMembers )
+        PaAlsaAggregate_AllocateBuffers( &self->aggregate, &self->arena );
+
+error:
+    return result;
+}
+
 /** Calculate polling timeout
  *
  * @param frames Time to wait
@@ -2716,9 +4116,29 @@ static PaError PaAlsaStream_Configure( PaAlsaStream *self, const PaStreamParamet
         PA_ENSURE( PaAlsaStreamComponent_InitialConfigure( &self->playback, outParams, self->primeBuffers, hwParamsPlayback,
                     &realSr ) );
 
+    if( self->timerScheduling )
+    {
+        /* Without period wakeups the hardware needn't interrupt at all, this is only allowed on non-blocking
+         * handles. Otherwise the periods still interrupt, but the callback thread doesn't wait for them. */
+        if( alsa_snd_pcm_hw_params_set_period_wakeup == NULL ||
+                alsa_snd_pcm_nonblock( self->playback.pcm, 1 ) < 0 ||
+                alsa_snd_pcm_hw_params_set_period_wakeup( self->playback.pcm, hwParamsPlayback, 0 ) < 0 )
+        {
+            PA_DEBUG(( "%s: Unable to disable period wakeups\n", __FUNCTION__ ));
+        }
+    }
+
     PA_ENSURE( PaAlsaStream_DetermineFramesPerBuffer( self, realSr, inParams, outParams, framesPerUserBuffer,
                 hwParamsCapture, hwParamsPlayback, hostBufferSizeMode ) );
 
+    if( self->timerScheduling )
+    {
+        /* The suggested latency becomes the write-ahead target, at least two periods so a whole period can be
+         * topped up before the buffer runs low */
+        self->playback.writeAhead = PA_MAX( (snd_pcm_uframes_t)( outParams->suggestedLatency * realSr ),
+                2 * self->playback.framesPerPeriod );
+    }
+
     if( self->capture.pcm )
     {
         assert( self->capture.framesPerPeriod != 0 );
@@ -2754,11 +4174,11 @@ static PaError PaAlsaStream_Configure( PaAlsaStream *self, const PaStreamParamet
         unsigned long minFramesPerHostBuffer = PA_MIN( self->capture.pcm ? self->capture.framesPerPeriod : ULONG_MAX,
             self->playback.pcm ? self->playback.framesPerPeriod : ULONG_MAX );
         self->pollTimeout = CalculatePollTimeout( self, minFramesPerHostBuffer );    /* Period in msecs, rounded up */
-
-        /* Time before watchdog unthrottles realtime thread == 1/4 of period time in msecs */
-        /* self->threading.throttledSleepTime = (unsigned long) (minFramesPerHostBuffer / sampleRate / 4 * 1000); */
     }
 
+    /* Stream time follows the capture pcm's timestamps in full duplex, like the callback's current time */
+    self->timeClock = self->capture.pcm ? self->capture.tstampClock : self->playback.tstampClock;
+
     if( self->callbackMode )
     {
         /* If the user expects a certain number of frames per callback we will either have to rely on block adaption
@@ -2804,6 +4224,9 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     /* Operate with fixed host buffer size by default, since other modes will invariably lead to block adaption */
     /* XXX: Use Bounded by default? Output tends to get stuttery with Fixed ... */
     PaUtilHostBufferSizeMode hostBufferSizeMode = paUtilFixedHostBufferSize;
+    const PaAlsaAggregateStreamInfo *aggregateInfo = NULL;
+    PaStreamParameters masterParameters;
+    PaAlsaStreamInfo masterInfo;
 
     if( ( streamFlags & paPlatformSpecificFlags ) != 0 )
         return paInvalidFlag;
@@ -2814,6 +4237,14 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
 
         numInputChannels = inputParameters->channelCount;
         inputSampleFormat = inputParameters->sampleFormat;
+
+        /* The master of an aggregate is captured as a named pcm, the others are read as it is processed */
+        if( IsAggregateStreamInfo( inputParameters->hostApiSpecificStreamInfo ) )
+        {
+            PA_UNLESS( callback, paIncompatibleHostApiSpecificStreamInfo );
+            aggregateInfo = inputParameters->hostApiSpecificStreamInfo;
+            inputParameters = AggregateMasterParameters( inputParameters, &masterParameters, &masterInfo );
+        }
     }
     if( outputParameters )
     {
@@ -2833,10 +4264,18 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     PA_UNLESS( stream = (PaAlsaStream*)PaUtil_AllocateMemory( sizeof(PaAlsaStream) ), paInsufficientMemory );
     PA_ENSURE( PaAlsaStream_Initialize( stream, alsaHostApi, inputParameters, outputParameters, sampleRate,
                 framesPerBuffer, callback, streamFlags, userData ) );
+    if( aggregateInfo )
+        PA_ENSURE( PaAlsaAggregate_Initialize( &stream->aggregate, aggregateInfo, &stream->capture ) );
 
     PA_ENSURE( PaAlsaStream_Configure( stream, inputParameters, outputParameters, sampleRate, framesPerBuffer,
                 &inputLatency, &outputLatency, &hostBufferSizeMode ) );
+    if( aggregateInfo )
+        PA_ENSURE( PaAlsaAggregate_Configure( &stream->aggregate, &stream->capture,
+                    stream->streamRepresentation.streamInfo.sampleRate, &inputLatency ) );
+    PA_ENSURE( PaAlsaStream_AllocateHostBuffers( stream ) );
     hostInputSampleFormat = stream->capture.hostSampleFormat | (!stream->capture.hostInterleaved ? paNonInterleaved : 0);
+    if( aggregateInfo )
+        hostInputSampleFormat = stream->capture.hostSampleFormat;   /* Staged interleaved */
     hostOutputSampleFormat = stream->playback.hostSampleFormat | (!stream->playback.hostInterleaved ? paNonInterleaved : 0);
 
     PA_ENSURE( PaUtil_InitializeBufferProcessor( &stream->bufferProcessor,
@@ -2845,6 +4284,23 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                     sampleRate, streamFlags, framesPerBuffer, stream->maxFramesPerHostBuffer,
                     hostBufferSizeMode, callback, userData ) );
 
+    /* A blocking direction whose user format is exactly the host's can hand out the mmap area itself */
+    if( !callback )
+    {
+        stream->capture.zeroCopy = stream->capture.pcm && stream->capture.canMmap &&
+            inputSampleFormat == hostInputSampleFormat &&
+            stream->capture.numUserChannels == stream->capture.numHostChannels;
+        stream->playback.zeroCopy = stream->playback.pcm && stream->playback.canMmap &&
+            outputSampleFormat == hostOutputSampleFormat &&
+            stream->playback.numUserChannels == stream->playback.numHostChannels;
+        if( stream->capture.zeroCopy || stream->playback.zeroCopy )
+            stream->streamRepresentation.regionInterface = &alsaHostApi->regionInterface;
+        stream->streamRepresentation.pollInterface = &alsaHostApi->pollInterface;
+    }
+
+    if( stream->lockMemory )
+        PaAlsaStream_LockMemory( stream );
+
     /* Ok, buffer processor is initialized, now we can deduce it's latency */
     if( numInputChannels > 0 )
         stream->streamRepresentation.streamInfo.inputLatency = inputLatency + (PaTime)(
@@ -2887,6 +4343,10 @@ static void SilenceBuffer( PaAlsaStream *stream )
     const snd_pcm_channel_area_t *areas;
     snd_pcm_uframes_t frames = (snd_pcm_uframes_t)alsa_snd_pcm_avail_update( stream->playback.pcm ), offset;
 
+    /* With timer scheduling the rest of the buffer is headroom, filling it would only add latency */
+    if( stream->playback.writeAhead )
+        frames = PA_MIN( frames, stream->playback.writeAhead );
+
     alsa_snd_pcm_mmap_begin( stream->playback.pcm, &areas, &offset, &frames );
     alsa_snd_pcm_areas_silence( areas, offset, stream->playback.numHostChannels, frames, stream->playback.nativeFormat );
     alsa_snd_pcm_mmap_commit( stream->playback.pcm, offset, frames );
@@ -2905,6 +4365,9 @@ static PaError AlsaStart( PaAlsaStream *stream, int priming )
 {
     PaError result = paNoError;
 
+    if( stream->aggregate.numMembers )
+        PA_ENSURE( PaAlsaAggregate_Prepare( &stream->aggregate ) );
+
     if( stream->playback.pcm )
     {
         if( stream->callbackMode )
@@ -2916,7 +4379,7 @@ static PaError AlsaStart( PaAlsaStream *stream, int priming )
                 if( stream->playback.canMmap )
                     SilenceBuffer( stream );
             }
-            if( stream->playback.canMmap )
+            if( stream->playback.canMmap && !stream->groupStart )
                 ENSURE_( alsa_snd_pcm_start( stream->playback.pcm ), paUnanticipatedHostError );
         }
         else
@@ -2926,8 +4389,11 @@ static PaError AlsaStart( PaAlsaStream *stream, int priming )
     {
         ENSURE_( alsa_snd_pcm_prepare( stream->capture.pcm ), paUnanticipatedHostError );
         /* For a blocking stream we want to start capture as well, since nothing will happen otherwise */
-        ENSURE_( alsa_snd_pcm_start( stream->capture.pcm ), paUnanticipatedHostError );
+        if( !stream->groupStart )
+            ENSURE_( alsa_snd_pcm_start( stream->capture.pcm ), paUnanticipatedHostError );
     }
+    if( stream->aggregate.numMembers )
+        PA_ENSURE( PaAlsaAggregate_Start( &stream->aggregate ) );
 
 end:
     return result;
@@ -2976,6 +4442,9 @@ error:
 }
 #endif
 
+static PaError AlsaStop( PaAlsaStream *stream, int abort );
+static PaError PaAlsaStream_ResizeBuffers( PaAlsaStream *self );
+
 static PaError StartStream( PaStream *s )
 {
     PaError result = paNoError;
@@ -2987,10 +4456,37 @@ static PaError StartStream( PaStream *s )
 
     /* Set now, so we can test for activity further down */
     stream->isActive = 1;
+    /* The pcms are stopped, apply what adaptive latency settled on while the stream last ran */
+    PA_ENSURE( PaAlsaStream_ResizeBuffers( stream ) );
+    stream->adaptLastChange = PaUtil_GetTime();
 
-    if( stream->callbackMode )
+    stream->sharedThread = NULL;
+    /* The shared thread waits for period wakeups, which timer scheduled streams don't have */
+    if( stream->callbackMode && stream->useSharedThread && !stream->timerScheduling )
+    {
+        PaUtilHostApiRepresentation *hostApi;
+        PaAlsaSharedThread *sharedThread;
+
+        PA_ENSURE( PaUtil_GetHostApiRepresentation( &hostApi, paALSA ) );
+        sharedThread = &((PaAlsaHostApiRepresentation*)hostApi)->sharedThread;
+        PA_ENSURE( PaAlsaSharedThread_Start( sharedThread, stream ) );
+
+        /* The shared thread takes over where CallbackThreadFunc would have started the pcms */
+        assert( !stream->primeBuffers );
+        PA_ENSURE( AlsaStart( stream, 0 ) );
+        streamStarted = 1;
+        PA_ENSURE( PaAlsaSharedThread_Attach( sharedThread, stream ) );
+        stream->sharedThread = sharedThread;
+    }
+    else if( stream->callbackMode )
     {
-        PA_ENSURE( PaUnixThread_New( &stream->thread, &CallbackThreadFunc, stream, 1., stream->rtSched ) );
+        PA_ENSURE( PaUnixThread_New( &stream->thread, &CallbackThreadFunc, stream, 1., stream->rtSched,
+                PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation ) ) );
+        stream->streamRepresentation.threadConfiguration.applied = stream->thread.configuration;
+
+        /* The stream runs fine without a watchdog */
+        if( stream->useWatchdog && PaUnixThread_StartWatchdog( &stream->thread, &stream->streamRepresentation ) != paNoError )
+            PA_DEBUG(( "%s: Failed starting the watchdog\n", __FUNCTION__ ));
     }
     else
     {
@@ -3003,7 +4499,7 @@ end:
 error:
     if( streamStarted )
     {
-        AbortStream( stream );
+        AlsaStop( stream, 1 );
     }
     stream->isActive = 0;
 
@@ -3062,6 +4558,8 @@ static PaError AlsaStop( PaAlsaStream *stream, int abort )
             }
         }
     }
+    if( stream->aggregate.numMembers )
+        PA_ENSURE( PaAlsaAggregate_Stop( &stream->aggregate ) );
 
 end:
     return result;
@@ -3094,15 +4592,18 @@ static PaError RealStop( PaAlsaStream *stream, int abort )
         {
             PA_DEBUG(( "Stopping callback\n" ));
         }
-        PA_ENSURE( PaUnixThread_Terminate( &stream->thread, !abort, &threadRes ) );
-        if( threadRes != paNoError )
+        if( stream->sharedThread )
         {
-            PA_DEBUG(( "Callback thread returned: %d\n", threadRes ));
+            PA_ENSURE( PaAlsaSharedThread_StopStream( stream->sharedThread, stream, abort ) );
+        }
+        else
+        {
+            PA_ENSURE( PaUnixThread_Terminate( &stream->thread, !abort, &threadRes ) );
+            if( threadRes != paNoError )
+            {
+                PA_DEBUG(( "Callback thread returned: %d\n", threadRes ));
+            }
         }
-#if 0
-        if( watchdogRes != paNoError )
-            PA_DEBUG(( "Watchdog thread returned: %d\n", watchdogRes ));
-#endif
 
         stream->callback_finished = 0;
     }
@@ -3148,31 +4649,47 @@ static PaError IsStreamActive( PaStream *s )
     return stream->isActive;
 }
 
-static PaTime GetStreamTime( PaStream *s )
+static PaTime GetClockTime( clockid_t clock )
 {
-    PaAlsaStream *stream = (PaAlsaStream*)s;
-
-    snd_timestamp_t timestamp;
-    snd_pcm_status_t* status;
-    alsa_snd_pcm_status_alloca( &status );
+    struct timespec ts;
+    clock_gettime( clock, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-    /* TODO: what if we have both?  does it really matter? */
+/** Publish the stream time seen by the callback, for GetStreamTime.
+ *
+ * Only the callback thread writes, an odd sequence count marks the update in progress. The count also guards
+ * the latency info of PaAlsaStream_PublishLatency.
+ */
+static void PaAlsaStream_PublishTime( PaAlsaStream *self, PaTime time )
+{
+    self->timeSequence++;
+    PaUtil_WriteMemoryBarrier();
+    self->lastTime = time;
+    PaUtil_WriteMemoryBarrier();
+    self->timeSequence++;
+}
 
-    /* TODO: if running in callback mode, this will mean
-     * libasound routines are being called from multiple threads.
-     * need to verify that libasound is thread-safe. */
+/* The stream is read on the clock ALSA timestamps by, so the callback's time info needs no conversion and
+ * reading the time is a matter of a vDSO call rather than snd_pcm_status from a foreign thread. The time
+ * is interpolated from the callback's latest time stamp, which keeps it from running backwards relative
+ * to the time info even if the timestamps had to fall back on the system time. */
+static PaTime GetStreamTime( PaStream *s )
+{
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    PaTime now = GetClockTime( stream->timeClock ), last;
+    unsigned int sequence;
 
-    if( stream->capture.pcm )
-    {
-        alsa_snd_pcm_status( stream->capture.pcm, status );
-    }
-    else if( stream->playback.pcm )
+    do
     {
-        alsa_snd_pcm_status( stream->playback.pcm, status );
+        sequence = stream->timeSequence;
+        PaUtil_ReadMemoryBarrier();
+        last = stream->lastTime;
+        PaUtil_ReadMemoryBarrier();
     }
+    while( (sequence & 1) || sequence != stream->timeSequence );
 
-    alsa_snd_pcm_status_get_tstamp( status, &timestamp );
-    return timestamp.tv_sec + (PaTime)timestamp.tv_usec / 1e6;
+    return PA_MAX( now, last );
 }
 
 static double GetStreamCpuLoad( PaStream* s )
@@ -3231,49 +4748,270 @@ static int GetExactSampleRate( snd_pcm_hw_params_t *hwParams, double *sampleRate
 
 /* Utility functions for blocking/callback interfaces */
 
-/* Atomic restart of stream (we don't want the intermediate state visible) */
-static PaError AlsaRestart( PaAlsaStream *stream )
+/** Notify the latency callback of adaptive latency, on the notifier's thread.
+ *
+ * The callback gets a copy of the stream info as of the latest change, the audio thread may change it
+ * again while the callback runs.
+ */
+static void NotifyLatency( void *userData )
 {
-    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream *)userData;
+    PaStreamInfo info;
+    unsigned int sequence;
 
-    PA_ENSURE( PaUnixMutex_Lock( &stream->stateMtx ) );
-    PA_ENSURE( AlsaStop( stream, 0 ) );
-    PA_ENSURE( AlsaStart( stream, 0 ) );
-
-    PA_DEBUG(( "%s: Restarted audio\n", __FUNCTION__ ));
+    do
+    {
+        sequence = stream->timeSequence;
+        PaUtil_ReadMemoryBarrier();
+        info = stream->latencyInfo;
+        PaUtil_ReadMemoryBarrier();
+    }
+    while( (sequence & 1) || sequence != stream->timeSequence );
 
-error:
-    PA_ENSURE( PaUnixMutex_Unlock( &stream->stateMtx ) );
+    stream->latencyCallback( (PaStream *)stream, &info, stream->latencyUserData );
+}
 
-    return result;
+/** Publish a change of latency for NotifyLatency, under the sequence count of PaAlsaStream_PublishTime.
+ *
+ * Only the thread processing the stream changes its latency, so there is still a single writer.
+ */
+static void PaAlsaStream_PublishLatency( PaAlsaStream *self )
+{
+    self->timeSequence++;
+    PaUtil_WriteMemoryBarrier();
+    self->latencyInfo = self->streamRepresentation.streamInfo;
+    PaUtil_WriteMemoryBarrier();
+    self->timeSequence++;
+
+    if( self->latencyNotifier )
+        PaUtil_SignalNotifier( self->latencyNotifier );
 }
 
-/** Recover from xrun state.
+/** The buffer size a step from the component's adaptive latency target, up if grow is set, else down.
  *
+ * Growing doubles the number of periods, as far as whole periods fit within adaptMaxLatency. Shrinking takes a
+ * quarter of them off. Neither goes below the size the stream was opened with.
  */
-static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
+static snd_pcm_uframes_t PaAlsaStream_StepBufferSize( const PaAlsaStream *self,
+        const PaAlsaStreamComponent *component, int grow )
+{
+    snd_pcm_uframes_t period = component->framesPerPeriod, numPeriods, minPeriods, maxPeriods;
+
+    numPeriods = component->adaptBufferSize / period;
+    minPeriods = ( component->minBufferSize + period - 1 ) / period;
+    maxPeriods = PA_MAX( (snd_pcm_uframes_t)( self->adaptMaxLatency * self->streamRepresentation.streamInfo.sampleRate /
+                period ), minPeriods );
+    if( grow )
+        numPeriods = PA_MIN( 2 * numPeriods, maxPeriods );
+    else
+        numPeriods = PA_MAX( numPeriods - PA_MAX( numPeriods / 4, 1 ), minPeriods );
+
+    return numPeriods > minPeriods ? numPeriods * period : component->minBufferSize;
+}
+
+/** Whether adaptive latency applies to the component. The buffers of an aggregate's members are sized by
+ * the master's, so those of an aggregate capture stay as they are.
+ */
+static int PaAlsaStream_CanAdapt( const PaAlsaStream *self, const PaAlsaStreamComponent *component )
+{
+    return component->pcm && component->setupParams && !( component == &self->capture && self->aggregate.numMembers );
+}
+
+/** Give the stopped stream's pcms the buffer sizes adaptive latency aims for, after growing them a step if
+ * adaptResize is set. Any playback reserve is dropped, the buffers are refilled from empty when they start.
+ */
+static PaError PaAlsaStream_ResizeBuffers( PaAlsaStream *self )
 {
     PaError result = paNoError;
-    snd_pcm_status_t *st;
-    PaTime now = PaUtil_GetTime();
-    snd_timestamp_t t;
-    int restartAlsa = 0; /* do not restart Alsa by default */
+    PaStreamInfo *streamInfo = &self->streamRepresentation.streamInfo;
+    PaAlsaStreamComponent *components[2];
+    PaTime *latencies[2];
+    snd_pcm_hw_params_t *hwParams;
+    int i, changed = 0;
 
-    alsa_snd_pcm_status_alloca( &st );
+    components[0] = &self->capture;
+    latencies[0] = &streamInfo->inputLatency;
+    components[1] = &self->playback;
+    latencies[1] = &streamInfo->outputLatency;
+    alsa_snd_pcm_hw_params_alloca( &hwParams );
 
-    if( self->playback.pcm )
+    for( i = 0; i < 2; ++i )
     {
-        alsa_snd_pcm_status( self->playback.pcm, st );
-        if( alsa_snd_pcm_status_get_state( st ) == SND_PCM_STATE_XRUN )
+        PaAlsaStreamComponent *component = components[i];
+        snd_pcm_uframes_t bufferSize, usedSize;
+
+        if( !PaAlsaStream_CanAdapt( self, component ) )
+            continue;
+
+        if( self->adaptResize > 0 )
+            component->adaptBufferSize = PaAlsaStream_StepBufferSize( self, component, 1 );
+        bufferSize = component->adaptBufferSize;
+        usedSize = component->alsaBufferSize - component->adaptReserve;
+        if( bufferSize == component->alsaBufferSize && !component->adaptReserve )
+            continue;
+
+        if( bufferSize != component->alsaBufferSize )
         {
-            alsa_snd_pcm_status_get_trigger_tstamp( st, &t );
-            self->underrun = now * 1000 - ( (PaTime)t.tv_sec * 1000 + (PaTime)t.tv_usec / 1000 );
+            alsa_snd_pcm_hw_params_copy( hwParams, component->setupParams );
+            ENSURE_( alsa_snd_pcm_hw_params_set_buffer_size_near( component->pcm, hwParams, &bufferSize ),
+                    paUnanticipatedHostError );
+            ENSURE_( alsa_snd_pcm_hw_params( component->pcm, hwParams ), paUnanticipatedHostError );
+            ENSURE_( alsa_snd_pcm_hw_params_get_buffer_size( hwParams, &bufferSize ), paUnanticipatedHostError );
+            PA_DEBUG(( "%s: %s buffer resized from %lu to %lu frames\n", __FUNCTION__, i == 0 ? "Capture" : "Playback",
+                        component->alsaBufferSize, bufferSize ));
+            component->alsaBufferSize = component->adaptBufferSize = bufferSize;
+        }
+        component->adaptReserve = 0;
 
-            if( !self->playback.canMmap )
-            {
-                if( alsa_snd_pcm_recover( self->playback.pcm, -EPIPE, 0 ) < 0 )
-                {
-                    PA_DEBUG(( "%s: [playback] non-MMAP-PCM failed recovering from XRUN, will restart Alsa\n", __FUNCTION__ ));
+        *latencies[i] += ( (PaTime)bufferSize - (PaTime)usedSize ) / streamInfo->sampleRate;
+        PA_ENSURE( PaAlsaStreamComponent_SetSwParams( component, self->primeBuffers ) );
+        changed = 1;
+    }
+
+    if( changed || self->adaptResize )
+        self->adaptLastChange = PaUtil_GetTime();
+    if( changed )
+        PaAlsaStream_PublishLatency( self );
+
+error:
+    self->adaptResize = 0;
+    return result;
+}
+
+/** Count an xrun towards growing the buffers for adaptive latency.
+ *
+ * @return Non-zero if the buffers are to grow, which takes a restart.
+ */
+static int PaAlsaStream_CountXrun( PaAlsaStream *self )
+{
+    PaTime now = PaUtil_GetTime();
+
+    if( self->adaptMaxLatency <= 0. || self->timerScheduling ||
+            !( self->capture.setupParams || self->playback.setupParams ) )
+        return 0;
+
+    self->adaptLastChange = now;
+    if( now - self->adaptWindowStart > PA_ALSA_ADAPT_WINDOW_ )
+    {
+        self->adaptWindowStart = now;
+        self->adaptXruns = 0;
+    }
+    if( ++self->adaptXruns < PA_ALSA_ADAPT_XRUNS_ )
+        return 0;
+
+    self->adaptXruns = 0;
+    self->adaptResize = 1;
+    return 1;
+}
+
+/* Atomic restart of stream (we don't want the intermediate state visible) */
+static PaError AlsaRestart( PaAlsaStream *stream )
+{
+    PaError result = paNoError;
+
+    PA_ENSURE( PaUnixMutex_Lock( &stream->stateMtx ) );
+    PA_ENSURE( AlsaStop( stream, 0 ) );
+    PA_ENSURE( PaAlsaStream_ResizeBuffers( stream ) );
+    PA_ENSURE( AlsaStart( stream, 0 ) );
+
+    PA_DEBUG(( "%s: Restarted audio\n", __FUNCTION__ ));
+
+error:
+    PA_ENSURE( PaUnixMutex_Unlock( &stream->stateMtx ) );
+
+    return result;
+}
+
+/** Shrink the latency a step for adaptive latency, once the stream has run without xruns for long enough.
+ *
+ * Restarting would drop the audio queued in the buffers, so the pcms keep running with their buffer size.
+ * Playback is kept filled to the smaller size instead, the queued audio drains to it as it plays. Capture is
+ * read as soon as a period has arrived, so its larger buffer only adds headroom. Both buffers are given the
+ * smaller size the next time the stream restarts anyway.
+ */
+static PaError PaAlsaStream_CheckLatency( PaAlsaStream *self )
+{
+    PaError result = paNoError;
+    PaAlsaStreamComponent *components[2];
+    int i, shrunk = 0, changed = 0;
+
+    if( self->adaptMaxLatency <= 0. || self->timerScheduling ||
+            PaUtil_GetTime() - self->adaptLastChange < PA_ALSA_ADAPT_CLEAN_ )
+        return result;
+
+    components[0] = &self->capture;
+    components[1] = &self->playback;
+    for( i = 0; i < 2; ++i )
+    {
+        PaAlsaStreamComponent *component = components[i];
+        snd_pcm_uframes_t bufferSize, usedSize;
+
+        if( !PaAlsaStream_CanAdapt( self, component ) )
+            continue;
+        bufferSize = PaAlsaStream_StepBufferSize( self, component, 0 );
+        if( bufferSize == component->adaptBufferSize )
+            continue;
+        component->adaptBufferSize = bufferSize;
+        shrunk = 1;
+        if( component != &self->playback )
+            continue;
+
+        usedSize = component->alsaBufferSize - component->adaptReserve;
+        component->adaptReserve = component->alsaBufferSize > bufferSize ? component->alsaBufferSize - bufferSize : 0;
+        PA_ENSURE( PaAlsaStreamComponent_SetSwParams( component, self->primeBuffers ) );
+        self->streamRepresentation.streamInfo.outputLatency -=
+            ( (PaTime)usedSize - (PaTime)( component->alsaBufferSize - component->adaptReserve ) ) /
+            self->streamRepresentation.streamInfo.sampleRate;
+        PA_DEBUG(( "%s: Playback kept filled to %lu of %lu frames\n", __FUNCTION__, bufferSize,
+                    component->alsaBufferSize ));
+        changed = 1;
+    }
+
+    if( shrunk )
+        self->adaptLastChange = PaUtil_GetTime();
+    if( changed )
+        PaAlsaStream_PublishLatency( self );
+
+error:
+    return result;
+}
+
+/** Recover from xrun state.
+ *
+ */
+static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
+{
+    PaError result = paNoError;
+    snd_pcm_status_t *st;
+    snd_timestamp_t now, t;
+    int restartAlsa = 0; /* do not restart Alsa by default */
+    int xruns = 0;
+
+    alsa_snd_pcm_status_alloca( &st );
+
+    if( self->playback.pcm )
+    {
+        alsa_snd_pcm_status( self->playback.pcm, st );
+        if( alsa_snd_pcm_status_get_state( st ) == SND_PCM_STATE_XRUN )
+        {
+            ++xruns;
+            /* the status timestamp is on the same clock as the trigger timestamp,
+                which need not be the one used by PaUtil_GetTime() */
+            alsa_snd_pcm_status_get_tstamp( st, &now );
+            alsa_snd_pcm_status_get_trigger_tstamp( st, &t );
+            self->underrun = ( (PaTime)now.tv_sec - t.tv_sec ) * 1000 + ( (PaTime)now.tv_usec - t.tv_usec ) / 1000;
+            PaUtil_RecordStreamXruns( &self->streamRepresentation, 0, 1 );
+            PaUtil_TraceInstant( paUtilTraceXrun, 2 );
+            /* keep the callback frame positions in step with the device clock */
+            if( self->underrun > 0. )
+                PaUtil_AdvanceBufferProcessorFramePositions( &self->bufferProcessor, 0,
+                        (unsigned long)( self->underrun / 1000 * self->streamRepresentation.streamInfo.sampleRate ) );
+
+            if( !self->playback.canMmap )
+            {
+                if( alsa_snd_pcm_recover( self->playback.pcm, -EPIPE, 0 ) < 0 )
+                {
+                    PA_DEBUG(( "%s: [playback] non-MMAP-PCM failed recovering from XRUN, will restart Alsa\n", __FUNCTION__ ));
                     ++ restartAlsa; /* did not manage to recover */
                 }
             }
@@ -3286,8 +5024,20 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
         alsa_snd_pcm_status( self->capture.pcm, st );
         if( alsa_snd_pcm_status_get_state( st ) == SND_PCM_STATE_XRUN )
         {
+            ++xruns;
+            alsa_snd_pcm_status_get_tstamp( st, &now );
             alsa_snd_pcm_status_get_trigger_tstamp( st, &t );
-            self->overrun = now * 1000 - ((PaTime) t.tv_sec * 1000 + (PaTime) t.tv_usec / 1000);
+            self->overrun = ( (PaTime)now.tv_sec - t.tv_sec ) * 1000 + ( (PaTime)now.tv_usec - t.tv_usec ) / 1000;
+            PaUtil_RecordStreamXruns( &self->streamRepresentation, 1, 0 );
+            PaUtil_TraceInstant( paUtilTraceXrun, 1 );
+            /* everything captured since the overrun was triggered is lost */
+            if( self->overrun > 0. )
+            {
+                unsigned long lostFrames = (unsigned long)( self->overrun / 1000 *
+                        self->streamRepresentation.streamInfo.sampleRate );
+                PaUtil_RecordStreamDroppedFrames( &self->streamRepresentation, lostFrames );
+                PaUtil_AdvanceBufferProcessorFramePositions( &self->bufferProcessor, lostFrames, 0 );
+            }
 
             if (!self->capture.canMmap)
             {
@@ -3302,6 +5052,10 @@ static PaError PaAlsaStream_HandleXrun( PaAlsaStream *self )
         }
     }
 
+    /* Growing the buffers takes a restart even where the pcm could recover */
+    if( xruns && PaAlsaStream_CountXrun( self ) )
+        ++ restartAlsa;
+
     if( restartAlsa )
     {
         PA_DEBUG(( "%s: restarting Alsa to recover from XRUN\n", __FUNCTION__ ));
@@ -3375,12 +5129,12 @@ error:
 
 /* Callback interface */
 
-static void OnExit( void *data )
+/** Stop the pcms once the callback has finished, and tell the user.
+ *
+ * Called by the stream's callback thread on exit, or by the shared thread when it lets go of the stream.
+ */
+static void PaAlsaStream_FinishCallback( PaAlsaStream *stream )
 {
-    PaAlsaStream *stream = (PaAlsaStream *) data;
-
-    assert( data );
-
     PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
 
     stream->callback_finished = 1;  /* Let the outside world know stream was stopped in callback */
@@ -3397,54 +5151,69 @@ static void OnExit( void *data )
     stream->isActive = 0;
 }
 
-static void CalculateTimeInfo( PaAlsaStream *stream, PaStreamCallbackTimeInfo *timeInfo )
+static void OnExit( void *data )
 {
-    snd_pcm_status_t *capture_status, *playback_status;
-    snd_timestamp_t capture_timestamp, playback_timestamp;
-    PaTime capture_time = 0., playback_time = 0.;
-
-    alsa_snd_pcm_status_alloca( &capture_status );
-    alsa_snd_pcm_status_alloca( &playback_status );
+    PaAlsaStream *stream = (PaAlsaStream *) data;
 
-    if( stream->capture.pcm )
-    {
-        snd_pcm_sframes_t capture_delay;
+    assert( data );
 
-        alsa_snd_pcm_status( stream->capture.pcm, capture_status );
-        alsa_snd_pcm_status_get_tstamp( capture_status, &capture_timestamp );
+    PaUtil_ReleaseTraceBuffer();
+    PaUnixThread_UnlockStack( stream->lockedStack );
+    stream->lockedStack = NULL;
+    PaAlsaStream_FinishCallback( stream );
+}
 
-        capture_time = capture_timestamp.tv_sec +
-            ( (PaTime)capture_timestamp.tv_usec / 1000000.0 );
-        timeInfo->currentTime = capture_time;
+/** Get the available frames along with the time the hardware pointer was last updated, on the stream's clock.
+ *
+ * snd_pcm_htimestamp pairs the two, so the time info is as exact as the period interrupt rather than
+ * subject to how late the callback thread got around to asking. Without a timestamp the frames are taken
+ * to be available as of now.
+ */
+static void PaAlsaStreamComponent_GetTimestamp( PaAlsaStreamComponent *self, clockid_t clock, PaTime now,
+        snd_pcm_uframes_t *avail, PaTime *tstamp )
+{
+    snd_htimestamp_t ts;
 
-        capture_delay = alsa_snd_pcm_status_get_delay( capture_status );
-        timeInfo->inputBufferAdcTime = timeInfo->currentTime -
-            (PaTime)capture_delay / stream->streamRepresentation.streamInfo.sampleRate;
+    if( alsa_snd_pcm_htimestamp != NULL && alsa_snd_pcm_htimestamp( self->pcm, avail, &ts ) >= 0 &&
+            ( ts.tv_sec || ts.tv_nsec ) )
+    {
+        *tstamp = ts.tv_sec + ts.tv_nsec * 1e-9;
+        if( self->tstampClock != clock )
+            *tstamp += now - GetClockTime( self->tstampClock );
     }
-    if( stream->playback.pcm )
+    else
     {
-        snd_pcm_sframes_t playback_delay;
-
-        alsa_snd_pcm_status( stream->playback.pcm, playback_status );
-        alsa_snd_pcm_status_get_tstamp( playback_status, &playback_timestamp );
+        snd_pcm_sframes_t frames = alsa_snd_pcm_avail_update( self->pcm );
+        *avail = frames > 0 ? frames : 0;
+        *tstamp = now;
+    }
+    *avail = PA_MIN( *avail, self->alsaBufferSize );
+}
 
-        playback_time = playback_timestamp.tv_sec +
-            ((PaTime)playback_timestamp.tv_usec / 1000000.0);
+static void CalculateTimeInfo( PaAlsaStream *stream, PaStreamCallbackTimeInfo *timeInfo )
+{
+    double sampleRate = stream->streamRepresentation.streamInfo.sampleRate;
+    snd_pcm_uframes_t avail;
+    PaTime tstamp;
 
-        if( stream->capture.pcm ) /* Full duplex */
-        {
-            /* Hmm, we have both a playback and a capture timestamp.
-             * Hopefully they are the same... */
-            if( fabs( capture_time - playback_time ) > 0.01 )
-                PA_DEBUG(( "Capture time and playback time differ by %f\n", fabs( capture_time-playback_time ) ));
-        }
-        else
-            timeInfo->currentTime = playback_time;
+    timeInfo->currentTime = GetClockTime( stream->timeClock );
 
-        playback_delay = alsa_snd_pcm_status_get_delay( playback_status );
-        timeInfo->outputBufferDacTime = timeInfo->currentTime +
-            (PaTime)playback_delay / stream->streamRepresentation.streamInfo.sampleRate;
+    if( stream->capture.pcm )
+    {
+        /* The oldest available frame was captured avail frames before the timestamp */
+        PaAlsaStreamComponent_GetTimestamp( &stream->capture, stream->timeClock, timeInfo->currentTime, &avail,
+                &tstamp );
+        timeInfo->inputBufferAdcTime = tstamp - (PaTime)avail / sampleRate;
+    }
+    if( stream->playback.pcm )
+    {
+        /* Whatever of the buffer isn't available is queued ahead of the frames written next */
+        PaAlsaStreamComponent_GetTimestamp( &stream->playback, stream->timeClock, timeInfo->currentTime, &avail,
+                &tstamp );
+        timeInfo->outputBufferDacTime = tstamp + (PaTime)( stream->playback.alsaBufferSize - avail ) / sampleRate;
     }
+
+    PaAlsaStream_PublishTime( stream, timeInfo->currentTime );
 }
 
 /** Called after buffer processing is finished.
@@ -3473,7 +5242,7 @@ static PaError PaAlsaStreamComponent_EndProcessing( PaAlsaStreamComponent *self,
         else
         {
             void *bufs[self->numHostChannels];
-            int bufsize = alsa_snd_pcm_format_size( self->nativeFormat, self->framesPerPeriod + 1 );
+            unsigned int bufsize = self->nonMmapBufferSize / self->numHostChannels;
             unsigned char *buffer = self->nonMmapBuffer;
             int i;
             for( i = 0; i < self->numHostChannels; ++i )
@@ -3508,6 +5277,233 @@ static unsigned char *ExtractAddress( const snd_pcm_channel_area_t *area, snd_pc
     return (unsigned char *) area->addr + ( area->first + offset * area->step ) / 8;
 }
 
+/** Read whatever the member has captured, without waiting.
+ *
+ * @param framesAvail Return the frames still waiting in the pcm
+ */
+static PaError PaAlsaAggregateMember_Read( PaAlsaAggregateMember *self, PaUtilTriangularDitherGenerator *ditherGenerator,
+        unsigned long *framesAvail )
+{
+    PaError result = paNoError;
+    unsigned int sampleSize = Pa_GetSampleSize( self->hostSampleFormat );
+    snd_pcm_sframes_t frames;
+    int i;
+
+    while( self->numFrames < self->maxFrames )
+    {
+        frames = alsa_snd_pcm_readi( self->pcm, self->readBuffer, PA_MIN( self->maxFrames - self->numFrames,
+                    self->alsaBufferSize ) );
+        if( frames == -EAGAIN || frames == 0 )
+            break;
+        if( frames == -EPIPE || frames == -ESTRPIPE )
+        {
+            /* A linked member's overrun stops the master as well, which restarts them all */
+            PA_DEBUG(( "%s: Aggregate member overrun\n", __FUNCTION__ ));
+            if( !self->linked )
+            {
+                ENSURE_( alsa_snd_pcm_prepare( self->pcm ), paUnanticipatedHostError );
+                ENSURE_( alsa_snd_pcm_start( self->pcm ), paUnanticipatedHostError );
+            }
+            break;
+        }
+        ENSURE_( frames, paUnanticipatedHostError );
+
+        for( i = 0; i < self->numChannels; ++i )
+        {
+            self->toFloat( self->frames + self->numFrames * self->numChannels + i, self->numChannels,
+                    (unsigned char *)self->readBuffer + i * sampleSize, self->numChannels, frames, ditherGenerator );
+        }
+        self->numFrames += frames;
+    }
+
+    frames = alsa_snd_pcm_avail_update( self->pcm );
+    *framesAvail = frames > 0 ? frames : 0;
+
+error:
+    return result;
+}
+
+/** Adjust the member's rate by the difference of its backlog to the master's, in frames.
+ *
+ * The difference is smoothed, since the hardware positions move in steps, and drives a PI controller whose
+ * integral term settles on the clocks' drift. Differences beyond the snap threshold, as after starting a
+ * member which couldn't be linked or recovering it from an overrun, are corrected at once by dropping or
+ * inserting frames.
+ */
+static void PaAlsaAggregateMember_Steer( PaAlsaAggregateMember *self, double difference, unsigned long snapThreshold,
+        double sampleRate, unsigned long numFrames )
+{
+    double dt = numFrames / sampleRate;
+    double alpha = PA_MIN( dt / PA_ALSA_AGGREGATE_SMOOTHING_, 1. ), correction;
+
+    if( difference > (double)snapThreshold )
+    {
+        self->position = PA_MIN( self->position + floor( difference ), self->numFrames - 2. );
+        self->error = 0.;
+        PA_DEBUG(( "%s: Dropped %.0f frames to realign\n", __FUNCTION__, floor( difference ) ));
+        return;
+    }
+    if( -difference > (double)snapThreshold )
+    {
+        unsigned long frames = PA_MIN( (unsigned long)-difference, self->maxFrames - self->numFrames );
+        memset( self->frames + self->numFrames * self->numChannels, 0, frames * self->numChannels * sizeof (float) );
+        self->numFrames += frames;
+        self->error = 0.;
+        PA_DEBUG(( "%s: Inserted %lu frames to realign\n", __FUNCTION__, frames ));
+        return;
+    }
+
+    self->error += alpha * ( difference / sampleRate - self->error );
+    self->integral += PA_ALSA_AGGREGATE_KI_ * self->error * dt;
+    self->integral = PA_MAX( PA_MIN( self->integral, PA_ALSA_AGGREGATE_MAX_CORRECTION_ ),
+            -PA_ALSA_AGGREGATE_MAX_CORRECTION_ );
+    correction = PA_ALSA_AGGREGATE_KP_ * self->error + self->integral;
+    self->ratio = 1. + PA_MAX( PA_MIN( correction, PA_ALSA_AGGREGATE_MAX_CORRECTION_ ),
+            -PA_ALSA_AGGREGATE_MAX_CORRECTION_ );
+}
+
+/** Resample numFrames frames at the current ratio with a cubic (Catmull-Rom) interpolator.
+ *
+ * Should the member run dry, the rest is silence.
+ */
+static void PaAlsaAggregateMember_Resample( PaAlsaAggregateMember *self, unsigned long numFrames )
+{
+    int channels = self->numChannels, c;
+    unsigned long k;
+
+    for( k = 0; k < numFrames; ++k )
+    {
+        double p = self->position + k * self->ratio;
+        unsigned long i = (unsigned long)p;
+        float t = (float)( p - i ), *out = self->resampled + k * channels;
+        const float *x0, *x1, *x2, *x3;
+
+        if( i + 2 >= self->numFrames )
+        {
+            memset( out, 0, ( numFrames - k ) * channels * sizeof (float) );
+            PA_DEBUG(( "%s: Aggregate member ran dry\n", __FUNCTION__ ));
+            break;
+        }
+
+        x0 = self->frames + ( i - 1 ) * channels;
+        x1 = x0 + channels;
+        x2 = x1 + channels;
+        x3 = x2 + channels;
+        for( c = 0; c < channels; ++c )
+        {
+            float c1 = .5f * ( x2[c] - x0[c] );
+            float c2 = x0[c] - 2.5f * x1[c] + 2.f * x2[c] - .5f * x3[c];
+            float c3 = .5f * ( x3[c] - x0[c] ) + 1.5f * ( x1[c] - x2[c] );
+            out[c] = ( ( c3 * t + c2 ) * t + c1 ) * t + x1[c];
+        }
+    }
+}
+
+/** Address and stride, in samples, of a channel of the host buffer registered by RegisterChannels. */
+static unsigned char *PaAlsaStreamComponent_ChannelAddress( const PaAlsaStreamComponent *self, int channel,
+        int *stride )
+{
+    int swidth = alsa_snd_pcm_format_size( self->nativeFormat, 1 );
+
+    if( self->canMmap )
+    {
+        const snd_pcm_channel_area_t *area = self->channelAreas + channel;
+        *stride = area->step / ( 8 * swidth );
+        return ExtractAddress( area, self->offset );
+    }
+    if( self->hostInterleaved )
+    {
+        *stride = self->numHostChannels;
+        return (unsigned char *)self->nonMmapBuffer + channel * swidth;
+    }
+    *stride = 1;
+    return (unsigned char *)self->nonMmapBuffer + channel * ( self->nonMmapBufferSize / self->numHostChannels );
+}
+
+/** Stage numFrames frames of all channels and register them with the buffer processor in place of the
+ * master's, after the master's channels have been registered.
+ */
+static PaError PaAlsaAggregate_Render( PaAlsaAggregate *self, const PaAlsaStreamComponent *master,
+        PaUtilBufferProcessor *bp, double sampleRate, unsigned long numFrames )
+{
+    PaError result = paNoError;
+    unsigned int ss = self->sampleSize;
+    unsigned long masterBacklog, memberAvail;
+    snd_pcm_sframes_t masterAvail;
+    int i, c, stride;
+
+    assert( numFrames <= self->maxFrames );
+
+    /* Queue the master's frames behind the delayed ones, and output the oldest */
+    for( c = 0; c < self->numMasterChannels; ++c )
+    {
+        unsigned char *channel = PaAlsaStreamComponent_ChannelAddress( master, c, &stride );
+        self->copyMaster( self->masterFrames + ( self->delay * self->numMasterChannels + c ) * ss,
+                self->numMasterChannels, channel, stride, numFrames, &self->ditherGenerator );
+        self->copyMaster( self->staging + c * ss, self->numChannels, self->masterFrames + c * ss,
+                self->numMasterChannels, numFrames, &self->ditherGenerator );
+    }
+
+    masterAvail = alsa_snd_pcm_avail_update( master->pcm );
+    masterBacklog = self->delay + ( masterAvail > 0 ? masterAvail : 0 );
+
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+        double memberBacklog;
+
+        PA_ENSURE( PaAlsaAggregateMember_Read( member, &self->ditherGenerator, &memberAvail ) );
+        memberBacklog = member->numFrames - member->position + memberAvail;
+        PaAlsaAggregateMember_Steer( member, memberBacklog - masterBacklog, 2 * self->delay, sampleRate, numFrames );
+        PaAlsaAggregateMember_Resample( member, numFrames );
+
+        for( c = 0; c < member->numChannels; ++c )
+        {
+            self->fromFloat( self->staging + ( member->firstChannel + c ) * ss, self->numChannels,
+                    member->resampled + c, member->numChannels, numFrames, &self->ditherGenerator );
+        }
+    }
+
+    for( c = 0; c < self->numChannels; ++c )
+        PaUtil_SetInputChannel( bp, c, self->staging + c * ss, self->numChannels );
+    self->renderedFrames = numFrames;
+
+error:
+    return result;
+}
+
+/** Advance past the frames the buffer processor consumed, at most those rendered. */
+static void PaAlsaAggregate_Consume( PaAlsaAggregate *self, unsigned long numFrames )
+{
+    unsigned long frameSize = self->numMasterChannels * self->sampleSize;
+    int i;
+
+    numFrames = PA_MIN( numFrames, self->renderedFrames );
+    self->renderedFrames = 0;
+    if( numFrames == 0 )
+        return;
+
+    memmove( self->masterFrames, self->masterFrames + numFrames * frameSize, self->delay * frameSize );
+
+    for( i = 0; i < self->numMembers; ++i )
+    {
+        PaAlsaAggregateMember *member = &self->members[i];
+        unsigned long drop;
+
+        member->position = PA_MIN( member->position + numFrames * member->ratio, member->numFrames - 2. );
+
+        /* Keep one frame of history before the position */
+        drop = member->position >= 2. ? (unsigned long)member->position - 1 : 0;
+        if( drop > 0 )
+        {
+            memmove( member->frames, member->frames + drop * member->numChannels,
+                    ( member->numFrames - drop ) * member->numChannels * sizeof (float) );
+            member->numFrames -= drop;
+            member->position -= drop;
+        }
+    }
+}
+
 /** Do necessary adaption between user and host channels.
  *
     @concern ChannelAdaption Adapting between user and host channels can involve silencing unused channels and
@@ -3585,6 +5581,8 @@ static PaError PaAlsaStream_EndProcessing( PaAlsaStream *self, unsigned long num
 
     if( self->capture.pcm )
     {
+        if( self->aggregate.numMembers )
+            PaAlsaAggregate_Consume( &self->aggregate, numFrames );
         PA_ENSURE( PaAlsaStreamComponent_EndProcessing( &self->capture, numFrames, &xrun ) );
     }
     if( self->playback.pcm )
@@ -3618,6 +5616,8 @@ static PaError PaAlsaStreamComponent_GetAvailableFrames( PaAlsaStreamComponent *
     else
     {
         ENSURE_( framesAvail, paUnanticipatedHostError );
+        /* Playback leaves the reserve of adaptive latency unfilled */
+        framesAvail = framesAvail > (snd_pcm_sframes_t)self->adaptReserve ? framesAvail - (snd_pcm_sframes_t)self->adaptReserve : 0;
     }
 
     *numFrames = framesAvail;
@@ -3626,6 +5626,33 @@ error:
     return result;
 }
 
+/** Frames available in the component which headroom is measured on: playback if the stream has output,
+ * otherwise capture. Negative on error.
+ */
+static snd_pcm_sframes_t PaAlsaStream_GetHeadroomAvail( PaAlsaStream *self )
+{
+    return alsa_snd_pcm_avail_update( self->playback.pcm ? self->playback.pcm : self->capture.pcm );
+}
+
+/** Report the headroom left once a buffer has been processed.
+ *
+ * For playback the audio still queued is the buffer size minus the available space, for capture the space
+ * left before an overrun is the buffer size minus the captured frames. In both cases the increase in
+ * available frames while processing is the part of the period's budget which was used.
+ */
+static void PaAlsaStream_RecordHeadroom( PaAlsaStream *self, snd_pcm_sframes_t startAvail, unsigned long framesProcessed )
+{
+    PaAlsaStreamComponent *component = self->playback.pcm ? &self->playback : &self->capture;
+    snd_pcm_sframes_t endAvail = PaAlsaStream_GetHeadroomAvail( self );
+
+    if( startAvail < 0 || endAvail < 0 || 0 == framesProcessed )
+        return;
+
+    PaUtil_RecordStreamHeadroom( &self->streamRepresentation,
+            ( (snd_pcm_sframes_t)component->alsaBufferSize - endAvail ) / self->streamRepresentation.streamInfo.sampleRate,
+            (double)( endAvail - startAvail ) / framesProcessed );
+}
+
 /** Fill in pollfd objects.
  */
 static PaError PaAlsaStreamComponent_BeginPolling( PaAlsaStreamComponent* self, struct pollfd* pfds )
@@ -3740,6 +5767,43 @@ error:
     return result;
 }
 
+/** Get the number of available frames for the pcms that are marked ready.
+ *
+ * @concern FullDuplex If only one direction is marked ready (from poll), the number of frames available for
+ * the other direction is returned. Output is normally preferred over capture however, so capture frames may be
+ * discarded to avoid overrun unless paNeverDropInput is specified.
+ */
+static PaError PaAlsaStream_GetReadyFrames( PaAlsaStream *self, unsigned long *framesAvail, int *xrunOccurred )
+{
+    PaError result = paNoError;
+    int captureReady = self->capture.pcm ? self->capture.ready : 0,
+        playbackReady = self->playback.pcm ? self->playback.ready : 0;
+
+    PA_ENSURE( PaAlsaStream_GetAvailableFrames( self, captureReady, playbackReady, framesAvail, xrunOccurred ) );
+
+    if( self->capture.pcm && self->playback.pcm )
+    {
+        if( !self->playback.ready && !self->neverDropInput )
+        {
+            /* Drop input, a period's worth */
+            assert( self->capture.ready );
+            PaUtil_RecordStreamDroppedFrames( &self->streamRepresentation,
+                    PA_MIN( self->capture.framesPerPeriod, *framesAvail ) );
+            PaAlsaStreamComponent_EndProcessing( &self->capture, PA_MIN( self->capture.framesPerPeriod,
+                        *framesAvail ), xrunOccurred );
+            *framesAvail = 0;
+            self->capture.ready = 0;
+        }
+    }
+    else if( self->capture.pcm )
+        assert( self->capture.ready );
+    else
+        assert( self->playback.ready );
+
+error:
+    return result;
+}
+
 /** Wait for and report available buffer space from ALSA.
  *
  * Unless ALSA reports a minimum of frames available for I/O, we poll the ALSA filedescriptors for more.
@@ -3761,6 +5825,8 @@ static PaError PaAlsaStream_WaitForFrames( PaAlsaStream *self, unsigned long *fr
     assert( self );
     assert( framesAvail );
 
+    PA_ENSURE( PaAlsaStream_CheckLatency( self ) );
+
     if( !self->callbackMode )
     {
         /* In blocking mode we will only wait if necessary */
@@ -3884,31 +5950,7 @@ static PaError PaAlsaStream_WaitForFrames( PaAlsaStream *self, unsigned long *fr
 
     if( !xrun )
     {
-        /* Get the number of available frames for the pcms that are marked ready.
-         * @concern FullDuplex If only one direction is marked ready (from poll), the number of frames available for
-         * the other direction is returned. Output is normally preferred over capture however, so capture frames may be
-         * discarded to avoid overrun unless paNeverDropInput is specified.
-         */
-        int captureReady = self->capture.pcm ? self->capture.ready : 0,
-            playbackReady = self->playback.pcm ? self->playback.ready : 0;
-        PA_ENSURE( PaAlsaStream_GetAvailableFrames( self, captureReady, playbackReady, framesAvail, &xrun ) );
-
-        if( self->capture.pcm && self->playback.pcm )
-        {
-            if( !self->playback.ready && !self->neverDropInput )
-            {
-                /* Drop input, a period's worth */
-                assert( self->capture.ready );
-                PaAlsaStreamComponent_EndProcessing( &self->capture, PA_MIN( self->capture.framesPerPeriod,
-                            *framesAvail ), &xrun );
-                *framesAvail = 0;
-                self->capture.ready = 0;
-            }
-        }
-        else if( self->capture.pcm )
-            assert( self->capture.ready );
-        else
-            assert( self->playback.ready );
+        PA_ENSURE( PaAlsaStream_GetReadyFrames( self, framesAvail, &xrun ) );
     }
 
 end:
@@ -3932,18 +5974,185 @@ error:
     return result;
 }
 
-/** Register per-channel ALSA buffer information with buffer processor.
+/** Wait until the playback buffer can be topped up to the write-ahead target, on behalf of timer scheduling.
  *
- * Mmapped buffer space is acquired from ALSA, and registered with the buffer processor. Differences between the
- * number of host and user channels is taken into account.
+ * Instead of waiting for period wakeups, the fill level is estimated with snd_pcm_delay and the thread sleeps
+ * until a period's worth is expected to have drained below the target. Each wakeup measures again, so the
+ * device clock drifting from the system clock is corrected as we go. The sleep ends timerMargin early to
+ * absorb scheduling latency, the margin is doubled after an underrun and slowly narrowed while playback runs
+ * smoothly, much like the watermark of PulseAudio's timer-based scheduling.
  *
- * @param numFrames On entrance the number of requested frames, on exit the number of contiguously accessible frames.
+ * @param framesAvail Return the number of frames to process, whole periods
+ * @param xrunOccurred Return whether an xrun has occurred
  */
-static PaError PaAlsaStreamComponent_RegisterChannels( PaAlsaStreamComponent* self, PaUtilBufferProcessor* bp,
-        unsigned long* numFrames, int* xrun )
+static PaError PaAlsaStream_WaitForTimer( PaAlsaStream *self, unsigned long *framesAvail, int *xrunOccurred )
 {
     PaError result = paNoError;
-    const snd_pcm_channel_area_t *areas, *area;
+    PaAlsaStreamComponent *playback = &self->playback;
+    double sampleRate = self->streamRepresentation.streamInfo.sampleRate;
+    double maxMargin = playback->writeAhead / sampleRate / 2;
+    int xrun = 0;
+
+    *framesAvail = 0;
+
+    while( !PaUnixThread_StopRequested( &self->thread ) )
+    {
+        unsigned long avail;
+        snd_pcm_sframes_t delay;
+        snd_pcm_uframes_t fill;
+        double sleepTime;
+        struct timespec ts;
+
+#ifdef PTHREAD_CANCELED
+        pthread_testcancel();
+#endif
+        PA_ENSURE( PaAlsaStreamComponent_GetAvailableFrames( playback, &avail, &xrun ) );
+        if( xrun )
+            break;
+
+        /* The delay includes frames in the device's FIFO, fall back on the buffer's fill level */
+        if( alsa_snd_pcm_delay( playback->pcm, &delay ) < 0 || delay < 0 )
+            delay = playback->alsaBufferSize - PA_MIN( avail, playback->alsaBufferSize );
+        fill = (snd_pcm_uframes_t)delay;
+
+        if( fill + playback->framesPerPeriod <= playback->writeAhead )
+        {
+            snd_pcm_uframes_t frames = playback->writeAhead - fill;
+
+            *framesAvail = PA_MIN( frames - frames % playback->framesPerPeriod, avail );
+            playback->ready = 1;
+            self->timerMargin = PA_MAX( self->timerMargin * 0.99, PA_ALSA_TIMER_MIN_MARGIN_ );
+            break;
+        }
+
+        sleepTime = ( fill + playback->framesPerPeriod - playback->writeAhead ) / sampleRate - self->timerMargin;
+        sleepTime = PA_MAX( sleepTime, PA_ALSA_TIMER_MIN_SLEEP_ );
+        ts.tv_sec = (time_t)sleepTime;
+        ts.tv_nsec = (long)( ( sleepTime - ts.tv_sec ) * 1e9 );
+        nanosleep( &ts, NULL );
+    }
+
+    if( xrun )
+    {
+        self->timerMargin = PA_MIN( self->timerMargin * 2, maxMargin );
+        PA_DEBUG(( "%s: Underrun, timer margin is now %f\n", __FUNCTION__, self->timerMargin ));
+
+        /* Recover from the xrun state */
+        PA_ENSURE( PaAlsaStream_HandleXrun( self ) );
+        *framesAvail = 0;
+    }
+
+error:
+    *xrunOccurred = xrun;
+    return result;
+}
+
+/** Check for available buffer space without blocking, on behalf of the shared thread.
+ *
+ * The counterpart of PaAlsaStream_WaitForFrames for streams serviced by the shared thread, which has already
+ * waited in epoll_wait. Only pcms that are not marked ready yet are polled.
+ *
+ * @concern FullDuplex If only one of two pcms is ready, and ContinuePoll says there is time to wait for the
+ * other one, no frames are reported and sharedDeadline is set to the time the shared thread should check
+ * again.
+ *
+ * @param framesAvail Return the number of available frames
+ * @param xrunOccurred Return whether an xrun has occurred
+ */
+static PaError PaAlsaStream_PollFrames( PaAlsaStream *self, unsigned long *framesAvail, int *xrunOccurred )
+{
+    PaError result = paNoError;
+    int pollCapture = self->capture.pcm && !self->capture.ready,
+        pollPlayback = self->playback.pcm && !self->playback.ready;
+    struct pollfd *capturePfds = self->pfds,
+        *playbackPfds = self->pfds + (self->capture.pcm ? self->capture.nfds : 0);
+    int pollTimeout = self->pollTimeout;
+    int xrun = 0;
+
+    *framesAvail = 0;
+    self->sharedDeadline = 0;
+
+    if( pollCapture || pollPlayback )
+    {
+        int pollResults;
+
+        if( pollCapture )
+        {
+            PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &self->capture, capturePfds ) );
+        }
+        if( pollPlayback )
+        {
+            PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &self->playback, playbackPfds ) );
+        }
+
+        /* The capture pfds precede the playback pfds, so both can be polled in one go */
+        pollResults = poll( pollCapture ? capturePfds : playbackPfds,
+                (pollCapture ? self->capture.nfds : 0) + (pollPlayback ? self->playback.nfds : 0), 0 );
+        if( pollResults < 0 && errno != EINTR )
+        {
+            PA_ENSURE( paInternalError );
+        }
+        else if( pollResults > 0 )
+        {
+            if( pollCapture )
+            {
+                PA_ENSURE( PaAlsaStreamComponent_EndPolling( &self->capture, capturePfds, &pollCapture, &xrun ) );
+            }
+            if( pollPlayback )
+            {
+                PA_ENSURE( PaAlsaStreamComponent_EndPolling( &self->playback, playbackPfds, &pollPlayback, &xrun ) );
+            }
+            if( xrun )
+            {
+                goto end;
+            }
+        }
+    }
+
+    if( self->capture.pcm && self->playback.pcm && self->capture.ready != self->playback.ready )
+    {
+        int continuePoll;
+        PA_ENSURE( ContinuePoll( self, self->capture.ready ? StreamDirection_Out : StreamDirection_In, &pollTimeout,
+                    &continuePoll ) );
+        if( continuePoll )
+        {
+            self->sharedDeadline = PaUtil_GetTime() + pollTimeout * .001;
+            goto end;
+        }
+    }
+
+    if( self->capture.ready || self->playback.ready )
+    {
+        PA_ENSURE( PaAlsaStream_GetReadyFrames( self, framesAvail, &xrun ) );
+    }
+
+end:
+error:
+    if( xrun )
+    {
+        /* Recover from the xrun state */
+        PaError xrunResult = PaAlsaStream_HandleXrun( self );
+        if( paNoError == result )
+            result = xrunResult;
+        *framesAvail = 0;
+    }
+    *xrunOccurred = xrun;
+
+    return result;
+}
+
+/** Register per-channel ALSA buffer information with buffer processor.
+ *
+ * Mmapped buffer space is acquired from ALSA, and registered with the buffer processor. Differences between the
+ * number of host and user channels is taken into account.
+ *
+ * @param numFrames On entrance the number of requested frames, on exit the number of contiguously accessible frames.
+ */
+static PaError PaAlsaStreamComponent_RegisterChannels( PaAlsaStreamComponent* self, PaUtilBufferProcessor* bp,
+        unsigned long* numFrames, int* xrun )
+{
+    PaError result = paNoError;
+    const snd_pcm_channel_area_t *areas, *area;
     void (*setChannel)(PaUtilBufferProcessor *, unsigned int, void *, unsigned int) =
         StreamDirection_In == self->streamDir ? PaUtil_SetInputChannel : PaUtil_SetOutputChannel;
     unsigned char *buffer, *p;
@@ -3966,16 +6175,8 @@ static PaError PaAlsaStreamComponent_RegisterChannels( PaAlsaStreamComponent* se
     }
     else
     {
-        unsigned int bufferSize = self->numHostChannels * alsa_snd_pcm_format_size( self->nativeFormat, *numFrames );
-        if( bufferSize > self->nonMmapBufferSize )
-        {
-            self->nonMmapBuffer = realloc( self->nonMmapBuffer, ( self->nonMmapBufferSize = bufferSize ) );
-            if( !self->nonMmapBuffer )
-            {
-                result = paInsufficientMemory;
-                goto error;
-            }
-        }
+        /* The non-mmap buffer holds a whole ALSA buffer; never hand out more than that */
+        *numFrames = PA_MIN( *numFrames, self->alsaBufferSize );
     }
 
     if( self->hostInterleaved )
@@ -4120,6 +6321,9 @@ static PaError PaAlsaStream_SetUpBuffers( PaAlsaStream* self, unsigned long* num
         if( self->capture.ready )
         {
             PaUtil_SetInputFrameCount( &self->bufferProcessor, commonFrames );
+            if( self->aggregate.numMembers && commonFrames > 0 )
+                PA_ENSURE( PaAlsaAggregate_Render( &self->aggregate, &self->capture, &self->bufferProcessor,
+                            self->streamRepresentation.streamInfo.sampleRate, commonFrames ) );
         }
         else
         {
@@ -4164,11 +6368,156 @@ error:
  * PaUtil_EndBufferProcessing. Finally, the number of processed frames is reported to ALSA. The processing can
  * happen in several iterations untill we have consumed the known number of available frames (or an xrun is detected).
  */
+/** Process the available frames, in chunks the size of the host buffers.
+ *
+ * Used by both the stream's callback thread and the shared thread.
+ * @param callbackResult The value returned by the callback, processing ends once it isn't paContinue.
+ * @param cbFlags Status flags for the next callback, cleared once they are passed on.
+ */
+static PaError PaAlsaStream_ProcessFrames( PaAlsaStream *self, unsigned long framesAvail, int *callbackResult,
+        PaStreamCallbackFlags *cbFlags )
+{
+    PaError result = paNoError;
+    PaStreamCallbackTimeInfo timeInfo = {0, 0, 0};
+    unsigned long framesGot;
+    int xrun;
+
+    /* Consume buffer space. Once we have a number of frames available for consumption we must retrieve the
+     * mmapped buffers from ALSA, this is contiguously accessible memory however, so we may receive smaller
+     * portions at a time than is available as a whole. Therefore we should be prepared to process several
+     * chunks successively. The buffers are passed to the PA buffer processor.
+     */
+    while( framesAvail > 0 )
+    {
+        snd_pcm_sframes_t headroomStartAvail = -1;
+        xrun = 0;
+
+#ifdef PTHREAD_CANCELED
+        pthread_testcancel();
+#endif
+
+        /** @concern Xruns Under/overflows are to be reported to the callback */
+        if( self->underrun > 0.0 )
+        {
+            *cbFlags |= paOutputUnderflow;
+            self->underrun = 0.0;
+        }
+        if( self->overrun > 0.0 )
+        {
+            *cbFlags |= paInputOverflow;
+            self->overrun = 0.0;
+        }
+        if( self->capture.pcm && self->playback.pcm )
+        {
+            /** @concern FullDuplex It's possible that only one direction is being processed to avoid an
+             * under- or overflow, this should be reported correspondingly */
+            if( !self->capture.ready )
+            {
+                *cbFlags |= paInputUnderflow;
+                PA_DEBUG(( "%s: Input underflow\n", __FUNCTION__ ));
+            }
+            else if( !self->playback.ready )
+            {
+                *cbFlags |= paOutputOverflow;
+                PA_DEBUG(( "%s: Output overflow\n", __FUNCTION__ ));
+            }
+        }
+
+#if 0
+        CallbackUpdate( &self->threading );
+#endif
+        CalculateTimeInfo( self, &timeInfo );
+        PaUtil_BeginBufferProcessing( &self->bufferProcessor, &timeInfo, *cbFlags );
+        *cbFlags = 0;
+
+        if( PaUtil_IsStreamHeadroomTracked( &self->streamRepresentation ) )
+            headroomStartAvail = PaAlsaStream_GetHeadroomAvail( self );
+
+        /* CPU load measurement should include processing activivity external to the stream callback */
+        PaUtil_BeginCpuLoadMeasurement( &self->cpuLoadMeasurer );
+        PaUtil_BeginStreamCallbackMeasurement( &self->streamRepresentation );
+
+        framesGot = framesAvail;
+        if( paUtilFixedHostBufferSize == self->bufferProcessor.hostBufferSizeMode )
+        {
+            /* We've committed to a fixed host buffer size, stick to that */
+            framesGot = framesGot >= self->maxFramesPerHostBuffer ? self->maxFramesPerHostBuffer : 0;
+        }
+        else
+        {
+            /* We've committed to an upper bound on the size of host buffers */
+            assert( paUtilBoundedHostBufferSize == self->bufferProcessor.hostBufferSizeMode );
+            framesGot = PA_MIN( framesGot, self->maxFramesPerHostBuffer );
+        }
+        PA_ENSURE( PaAlsaStream_SetUpBuffers( self, &framesGot, &xrun ) );
+        /* Check the host buffer size against the buffer processor configuration */
+        framesAvail -= framesGot;
+
+        if( framesGot > 0 )
+        {
+            assert( !xrun );
+            PaUtil_TraceBegin( paUtilTraceConvert );
+            PaUtil_EndBufferProcessing( &self->bufferProcessor, callbackResult );
+            PaUtil_TraceEnd( paUtilTraceConvert );
+            if( headroomStartAvail >= 0 )
+                PaAlsaStream_RecordHeadroom( self, headroomStartAvail, framesGot );
+            PaUtil_TraceBegin( paUtilTraceCommit );
+            PA_ENSURE( PaAlsaStream_EndProcessing( self, framesGot, &xrun ) );
+            PaUtil_TraceEnd( paUtilTraceCommit );
+        }
+        PaUtil_EndCpuLoadMeasurement( &self->cpuLoadMeasurer, framesGot );
+        if( framesGot > 0 )
+            PaUtil_EndStreamCallbackMeasurement( &self->streamRepresentation );
+
+        if( 0 == framesGot )
+        {
+            /* Go back to polling for more frames */
+            break;
+        }
+
+        if( paContinue != *callbackResult )
+            break;
+    }
+
+error:
+    return result;
+}
+
+/** Decide whether the callback has finished.
+ *
+ * @concern StreamStop if the main thread has requested a stop and the stream has not been effectively
+ * stopped we signal this condition by modifying callbackResult (we'll want to flush buffered output).
+ * @param stopRequest paComplete or paAbort if the main thread has requested a stop, else paContinue.
+ * @return 1 when the callback thread should let go of the stream.
+ */
+static int PaAlsaStream_CallbackFinished( PaAlsaStream *self, int stopRequest, int *callbackResult )
+{
+    if( paContinue != stopRequest && paContinue == *callbackResult )
+    {
+        PA_DEBUG(( "Setting callbackResult to %s\n", paAbort == stopRequest ? "paAbort" : "paComplete" ));
+        *callbackResult = stopRequest;
+    }
+
+    if( paContinue != *callbackResult )
+    {
+        self->callbackAbort = ( paAbort == *callbackResult );
+        if( self->callbackAbort ||
+                /** @concern BlockAdaption: Go on if adaption buffers are empty */
+                PaUtil_IsBufferProcessorOutputEmpty( &self->bufferProcessor ) )
+        {
+            return 1;
+        }
+
+        PA_DEBUG(( "%s: Flushing buffer processor\n", __FUNCTION__ ));
+        /* There is still buffered output that needs to be processed */
+    }
+    return 0;
+}
+
 static void *CallbackThreadFunc( void *userData )
 {
     PaError result = paNoError;
     PaAlsaStream *stream = (PaAlsaStream*) userData;
-    PaStreamCallbackTimeInfo timeInfo = {0, 0, 0};
     snd_pcm_sframes_t startThreshold = 0;
     int callbackResult = paContinue;
     PaStreamCallbackFlags cbFlags = 0;  /* We might want to keep state across iterations */
@@ -4176,6 +6525,26 @@ static void *CallbackThreadFunc( void *userData )
 
     assert( stream );
 
+    PaUtil_MarkAudioThread();
+    if( stream->lockMemory )
+    {
+        PaTime lockStart = PaUtil_GetTime();
+        PaError lockResult = PaUnixThread_LockStack( &stream->lockedStack );
+        if( !stream->stackLockRecorded )
+        {
+            /* Report once, restarting the stream locks a fresh stack of the same size */
+            PaUtil_RecordStreamMemoryLock( &stream->streamRepresentation, lockResult, PA_UNIX_LOCKED_STACK_SIZE,
+                    PaUtil_GetTime() - lockStart );
+            stream->stackLockRecorded = 1;
+        }
+    }
+
+    PaUtil_SetTraceThreadName( "ALSA callback" );
+    if( PaUnixThread_ConfigureDeadline( PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation ),
+                (stream->playback.pcm ? stream->playback.framesPerPeriod : stream->capture.framesPerPeriod) /
+                stream->streamRepresentation.streamInfo.sampleRate, &stream->thread.configuration ) != paNoError )
+        PA_DEBUG(( "%s: Failed configuring the callback thread\n", __FUNCTION__ ));
+
     /* Execute OnExit when exiting */
     pthread_cleanup_push( &OnExit, stream );
 
@@ -4212,40 +6581,32 @@ static void *CallbackThreadFunc( void *userData )
 
     while( 1 )
     {
-        unsigned long framesAvail, framesGot;
+        unsigned long framesAvail;
         int xrun = 0;
 
 #ifdef PTHREAD_CANCELED
         pthread_testcancel();
 #endif
 
-        /* @concern StreamStop if the main thread has requested a stop and the stream has not been effectively
-         * stopped we signal this condition by modifying callbackResult (we'll want to flush buffered output).
-         */
-        if( PaUnixThread_StopRequested( &stream->thread ) && paContinue == callbackResult )
-        {
-            PA_DEBUG(( "Setting callbackResult to paComplete\n" ));
-            callbackResult = paComplete;
-        }
-
-        if( paContinue != callbackResult )
+        if( PaAlsaStream_CallbackFinished( stream, PaUnixThread_StopRequested( &stream->thread ) ? paComplete :
+                    paContinue, &callbackResult ) )
         {
-            stream->callbackAbort = ( paAbort == callbackResult );
-            if( stream->callbackAbort ||
-                    /** @concern BlockAdaption: Go on if adaption buffers are empty */
-                    PaUtil_IsBufferProcessorOutputEmpty( &stream->bufferProcessor ) )
-            {
-                goto end;
-            }
-
-            PA_DEBUG(( "%s: Flushing buffer processor\n", __FUNCTION__ ));
-            /* There is still buffered output that needs to be processed */
+            goto end;
         }
 
         /* Wait for data to become available, this comes down to polling the ALSA file descriptors untill we have
          * a number of available frames.
          */
-        PA_ENSURE( PaAlsaStream_WaitForFrames( stream, &framesAvail, &xrun ) );
+        PaUtil_TraceBegin( paUtilTraceWait );
+        if( stream->timerScheduling )
+        {
+            PA_ENSURE( PaAlsaStream_WaitForTimer( stream, &framesAvail, &xrun ) );
+        }
+        else
+        {
+            PA_ENSURE( PaAlsaStream_WaitForFrames( stream, &framesAvail, &xrun ) );
+        }
+        PaUtil_TraceEnd( paUtilTraceWait );
         if( xrun )
         {
             assert( 0 == framesAvail );
@@ -4256,90 +6617,10 @@ static void *CallbackThreadFunc( void *userData )
              */
         }
 
-        /* Consume buffer space. Once we have a number of frames available for consumption we must retrieve the
-         * mmapped buffers from ALSA, this is contiguously accessible memory however, so we may receive smaller
-         * portions at a time than is available as a whole. Therefore we should be prepared to process several
-         * chunks successively. The buffers are passed to the PA buffer processor.
-         */
-        while( framesAvail > 0 )
-        {
-            xrun = 0;
-
-#ifdef PTHREAD_CANCELED
-           pthread_testcancel();
-#endif
-
-            /** @concern Xruns Under/overflows are to be reported to the callback */
-            if( stream->underrun > 0.0 )
-            {
-                cbFlags |= paOutputUnderflow;
-                stream->underrun = 0.0;
-            }
-            if( stream->overrun > 0.0 )
-            {
-                cbFlags |= paInputOverflow;
-                stream->overrun = 0.0;
-            }
-            if( stream->capture.pcm && stream->playback.pcm )
-            {
-                /** @concern FullDuplex It's possible that only one direction is being processed to avoid an
-                 * under- or overflow, this should be reported correspondingly */
-                if( !stream->capture.ready )
-                {
-                    cbFlags |= paInputUnderflow;
-                    PA_DEBUG(( "%s: Input underflow\n", __FUNCTION__ ));
-                }
-                else if( !stream->playback.ready )
-                {
-                    cbFlags |= paOutputOverflow;
-                    PA_DEBUG(( "%s: Output overflow\n", __FUNCTION__ ));
-                }
-            }
-
-#if 0
-            CallbackUpdate( &stream->threading );
-#endif
-            CalculateTimeInfo( stream, &timeInfo );
-            PaUtil_BeginBufferProcessing( &stream->bufferProcessor, &timeInfo, cbFlags );
-            cbFlags = 0;
-
-            /* CPU load measurement should include processing activivity external to the stream callback */
-            PaUtil_BeginCpuLoadMeasurement( &stream->cpuLoadMeasurer );
-
-            framesGot = framesAvail;
-            if( paUtilFixedHostBufferSize == stream->bufferProcessor.hostBufferSizeMode )
-            {
-                /* We've committed to a fixed host buffer size, stick to that */
-                framesGot = framesGot >= stream->maxFramesPerHostBuffer ? stream->maxFramesPerHostBuffer : 0;
-            }
-            else
-            {
-                /* We've committed to an upper bound on the size of host buffers */
-                assert( paUtilBoundedHostBufferSize == stream->bufferProcessor.hostBufferSizeMode );
-                framesGot = PA_MIN( framesGot, stream->maxFramesPerHostBuffer );
-            }
-            PA_ENSURE( PaAlsaStream_SetUpBuffers( stream, &framesGot, &xrun ) );
-            /* Check the host buffer size against the buffer processor configuration */
-            framesAvail -= framesGot;
-
-            if( framesGot > 0 )
-            {
-                assert( !xrun );
-                PaUtil_EndBufferProcessing( &stream->bufferProcessor, &callbackResult );
-                PA_ENSURE( PaAlsaStream_EndProcessing( stream, framesGot, &xrun ) );
-            }
-            PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesGot );
-
-            if( 0 == framesGot )
-            {
-                /* Go back to polling for more frames */
-                break;
-
-            }
+        PaUtil_RecordStreamWakeup( &stream->streamRepresentation,
+                stream->playback.pcm ? stream->playback.framesPerPeriod : stream->capture.framesPerPeriod );
 
-            if( paContinue != callbackResult )
-                break;
-        }
+        PA_ENSURE( PaAlsaStream_ProcessFrames( stream, framesAvail, &callbackResult, &cbFlags ) );
     }
 
 end:
@@ -4355,24 +6636,484 @@ error:
     goto end;
 }
 
-/* Blocking interface */
+/* Shared thread */
 
-static PaError ReadStream( PaStream* s, void *buffer, unsigned long frames )
-{
-    PaError result = paNoError;
-    PaAlsaStream *stream = (PaAlsaStream*)s;
-    unsigned long framesGot, framesAvail;
-    void *userBuffer;
-    snd_pcm_t *save = stream->playback.pcm;
+/** Maximum number of ready descriptors the shared thread picks up per epoll_wait. */
+#define PA_ALSA_SHARED_MAX_EVENTS_ (64)
 
-    assert( stream );
+/** Seconds without poll events before the shared thread tries to recover a stream, like the 2048 poll
+ * timeouts in PaAlsaStream_WaitForFrames. */
+#define PA_ALSA_SHARED_STALL_TIMEOUT_ (2.0)
 
-    PA_UNLESS( stream->capture.pcm, paCanNotReadFromAnOutputOnlyStream );
+static struct pollfd *PaAlsaStream_ComponentPfds( PaAlsaStream *self, const PaAlsaStreamComponent *component )
+{
+    /* The capture pfds precede the playback pfds */
+    return component == &self->capture ? self->pfds : self->pfds + (self->capture.pcm ? self->capture.nfds : 0);
+}
 
-    /* Disregard playback */
-    stream->playback.pcm = NULL;
+/** Add the poll descriptors of one of the stream's pcms to the shared thread's epoll set, or remove them.
+ *
+ * The descriptors must have been filled in by PaAlsaStreamComponent_BeginPolling.
+ */
+static PaError PaAlsaSharedThread_Watch( PaAlsaSharedThread *self, PaAlsaStream *stream,
+        const PaAlsaStreamComponent *component, int watch )
+{
+    PaError result = paNoError;
+    struct pollfd *pfds = PaAlsaStream_ComponentPfds( stream, component );
+    unsigned int i;
 
-    if( stream->overrun > 0. )
+    if( !component->pcm )
+        goto error;
+
+    for( i = 0; i < component->nfds; ++i )
+    {
+        struct epoll_event event;
+
+        memset( &event, 0, sizeof (event) );
+        event.events = ( pfds[i].events & POLLIN ? EPOLLIN : 0 ) | ( pfds[i].events & POLLOUT ? EPOLLOUT : 0 );
+        event.data.ptr = stream;
+        if( epoll_ctl( self->epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, pfds[i].fd, &event ) < 0 )
+        {
+            /* Both pcms may share a descriptor */
+            PA_UNLESS( errno == ( watch ? EEXIST : ENOENT ), paInternalError );
+        }
+    }
+
+error:
+    return result;
+}
+
+/** Let go of a stream, called by the shared thread once the callback has finished or failed.
+ *
+ * The stream may be freed as soon as this returns, it must not be touched afterwards.
+ */
+static void PaAlsaSharedThread_Remove( PaAlsaSharedThread *self, PaAlsaStream *stream )
+{
+    PaAlsaStream **link;
+
+    PaAlsaSharedThread_Watch( self, stream, &stream->capture, 0 );
+    PaAlsaSharedThread_Watch( self, stream, &stream->playback, 0 );
+    stream->sharedMasked = NULL;
+
+    for( link = &self->streams; *link != stream; link = &(*link)->nextShared )
+        ;
+    *link = stream->nextShared;
+
+    PaAlsaStream_FinishCallback( stream );
+
+    ASSERT_CALL_( PaUnixMutex_Lock( &self->mtx ), paNoError );
+    stream->sharedAttached = 0;
+    pthread_cond_broadcast( &self->detached );
+    ASSERT_CALL_( PaUnixMutex_Unlock( &self->mtx ), paNoError );
+}
+
+/** Service a stream the shared thread has been woken for, the counterpart of one iteration of the loop in
+ * CallbackThreadFunc.
+ *
+ * @return 0 if the stream was removed.
+ */
+static int PaAlsaSharedThread_Service( PaAlsaSharedThread *self, PaAlsaStream *stream )
+{
+    PaError result = paNoError;
+    unsigned long framesAvail = 0;
+    int xrun = 0;
+
+    PA_ENSURE( PaAlsaStream_PollFrames( stream, &framesAvail, &xrun ) );
+    if( xrun || stream->capture.ready || stream->playback.ready )
+        stream->sharedLastEvent = PaUtil_GetTime();
+
+    if( stream->sharedDeadline > 0 )
+    {
+        /* @concern FullDuplex The ready pcm would wake us continuously while we wait for the other one */
+        if( !stream->sharedMasked )
+        {
+            stream->sharedMasked = stream->capture.ready ? &stream->capture : &stream->playback;
+            PA_ENSURE( PaAlsaSharedThread_Watch( self, stream, stream->sharedMasked, 0 ) );
+        }
+        return 1;
+    }
+    if( stream->sharedMasked )
+    {
+        PA_ENSURE( PaAlsaSharedThread_Watch( self, stream, stream->sharedMasked, 1 ) );
+        stream->sharedMasked = NULL;
+    }
+
+    if( framesAvail > 0 )
+    {
+        PaUtil_RecordStreamWakeup( &stream->streamRepresentation,
+                stream->playback.pcm ? stream->playback.framesPerPeriod : stream->capture.framesPerPeriod );
+        PA_ENSURE( PaAlsaStream_ProcessFrames( stream, framesAvail, &stream->sharedCallbackResult,
+                    &stream->sharedCbFlags ) );
+    }
+    PA_ENSURE( PaAlsaStream_CheckLatency( stream ) );
+    /* Poll both pcms again next time */
+    stream->capture.ready = 0;
+    stream->playback.ready = 0;
+
+    if( PaAlsaStream_CallbackFinished( stream, stream->sharedStopRequest, &stream->sharedCallbackResult ) )
+    {
+        PaAlsaSharedThread_Remove( self, stream );
+        return 0;
+    }
+    return 1;
+
+error:
+    PA_DEBUG(( "%s: Servicing stream failed with error %d\n", __FUNCTION__, result ));
+    PaAlsaSharedThread_Remove( self, stream );
+    return 0;
+}
+
+/** Pick up the streams handed over by StartStream, and let go of those that have been stopped.
+ *
+ * @return 1 if the thread should quit.
+ */
+static int PaAlsaSharedThread_HandleRequests( PaAlsaSharedThread *self )
+{
+    PaAlsaStream *attaching, *stream, *next;
+    eventfd_t count;
+    int quit;
+
+    eventfd_read( self->wakeFd, &count );
+
+    ASSERT_CALL_( PaUnixMutex_Lock( &self->mtx ), paNoError );
+    attaching = self->attaching;
+    self->attaching = NULL;
+    quit = self->quit;
+    ASSERT_CALL_( PaUnixMutex_Unlock( &self->mtx ), paNoError );
+
+    for( stream = attaching; stream; stream = next )
+    {
+        next = stream->nextShared;
+        stream->nextShared = self->streams;
+        self->streams = stream;
+
+        if( PaAlsaSharedThread_Watch( self, stream, &stream->capture, 1 ) != paNoError ||
+                PaAlsaSharedThread_Watch( self, stream, &stream->playback, 1 ) != paNoError )
+        {
+            PA_DEBUG(( "%s: Failed watching the poll descriptors of a stream\n", __FUNCTION__ ));
+            PaAlsaSharedThread_Remove( self, stream );
+        }
+    }
+
+    for( stream = self->streams; stream; stream = next )
+    {
+        next = stream->nextShared;
+        if( PaAlsaStream_CallbackFinished( stream, stream->sharedStopRequest, &stream->sharedCallbackResult ) )
+            PaAlsaSharedThread_Remove( self, stream );
+    }
+
+    return quit;
+}
+
+/** Service the streams whose wait for the other pcm has expired, and try to recover stalled streams.
+ *
+ * @return The epoll_wait timeout in milliseconds until the next deadline, -1 if there is none.
+ */
+static int PaAlsaSharedThread_ServiceDeadlines( PaAlsaSharedThread *self )
+{
+    PaAlsaStream *stream, *next;
+    PaTime now = PaUtil_GetTime(), deadline;
+    int timeout = -1, streamTimeout;
+
+    for( stream = self->streams; stream; stream = next )
+    {
+        next = stream->nextShared;
+
+        if( stream->sharedDeadline > 0 && stream->sharedDeadline <= now )
+        {
+            if( !PaAlsaSharedThread_Service( self, stream ) )
+                continue;
+        }
+        else if( 0 == stream->sharedDeadline && now - stream->sharedLastEvent > PA_ALSA_SHARED_STALL_TIMEOUT_ )
+        {
+            PA_DEBUG(( "%s: No poll events for %g seconds, trying to recover the stream\n", __FUNCTION__,
+                        PA_ALSA_SHARED_STALL_TIMEOUT_ ));
+            stream->sharedLastEvent = now;
+            if( PaAlsaStream_HandleXrun( stream ) != paNoError )
+            {
+                PaAlsaSharedThread_Remove( self, stream );
+                continue;
+            }
+        }
+
+        deadline = stream->sharedDeadline > 0 ? stream->sharedDeadline :
+            stream->sharedLastEvent + PA_ALSA_SHARED_STALL_TIMEOUT_;
+        streamTimeout = deadline > now ? (int)ceil( (deadline - now) * 1000 ) : 0;
+        if( timeout < 0 || streamTimeout < timeout )
+            timeout = streamTimeout;
+    }
+
+    return timeout;
+}
+
+static void *SharedThreadFunc( void *userData )
+{
+    PaError result = paNoError;
+    PaAlsaSharedThread *self = (PaAlsaSharedThread *) userData;
+    struct epoll_event events[PA_ALSA_SHARED_MAX_EVENTS_];
+    unsigned long serial = 0;
+    int timeout = -1;
+
+    PaUtil_MarkAudioThread();
+    if( self->lockStack )
+    {
+        PaTime lockStart = PaUtil_GetTime();
+        self->stackLockResult = PaUnixThread_LockStack( &self->lockedStack );
+        self->stackLockDuration = PaUtil_GetTime() - lockStart;
+        self->stackLocked = 1;
+    }
+    PaUtil_SetTraceThreadName( "ALSA shared" );
+    if( PaUnixThread_ConfigureDeadline( self->configured ? &self->configuration : NULL, self->period,
+                &self->thread.configuration ) != paNoError )
+        PA_DEBUG(( "%s: Failed configuring the shared thread\n", __FUNCTION__ ));
+
+    PA_ENSURE( PaUnixThread_PrepareNotify( &self->thread ) );
+    PA_ENSURE( PaUnixThread_NotifyParent( &self->thread ) );
+
+    while( 1 )
+    {
+        int i, numEvents, wake = 0;
+
+        numEvents = epoll_wait( self->epollFd, events, PA_ALSA_SHARED_MAX_EVENTS_, timeout );
+        if( numEvents < 0 )
+        {
+            if( errno != EINTR )
+            {
+                PA_DEBUG(( "%s: epoll_wait failed: %s\n", __FUNCTION__, strerror( errno ) ));
+                Pa_Sleep( 1 ); /* avoid hot loop */
+            }
+            numEvents = 0;
+        }
+
+        ++serial;
+        for( i = 0; i < numEvents; ++i )
+        {
+            PaAlsaStream *stream = (PaAlsaStream *) events[i].data.ptr;
+
+            if( events[i].data.ptr == self )
+            {
+                wake = 1;
+                continue;
+            }
+            /* Streams with several ready descriptors are serviced once per round, removed ones not at all */
+            if( !stream || stream->sharedSerial == serial )
+                continue;
+            stream->sharedSerial = serial;
+
+            if( !PaAlsaSharedThread_Service( self, stream ) )
+            {
+                int j;
+                for( j = i + 1; j < numEvents; ++j )
+                {
+                    if( events[j].data.ptr == stream )
+                        events[j].data.ptr = NULL;
+                }
+            }
+        }
+
+        if( wake && PaAlsaSharedThread_HandleRequests( self ) )
+            break;
+        timeout = PaAlsaSharedThread_ServiceDeadlines( self );
+    }
+
+end:
+    PaUtil_ReleaseTraceBuffer();
+    PaUnixThread_UnlockStack( self->lockedStack );
+    self->lockedStack = NULL;
+    self->stackLocked = 0;
+    PA_DEBUG(( "%s: Thread %d exiting\n ", __FUNCTION__, pthread_self() ));
+    PaUnixThreading_EXIT( result );
+
+error:
+    PA_DEBUG(( "%s: Thread %d failed with error %d\n ", __FUNCTION__, pthread_self(), result ));
+    goto end;
+}
+
+static PaError PaAlsaSharedThread_Initialize( PaAlsaSharedThread *self )
+{
+    PaError result = paNoError;
+
+    memset( self, 0, sizeof (PaAlsaSharedThread) );
+    self->epollFd = -1;
+    self->wakeFd = -1;
+    PA_ENSURE( PaUnixMutex_Initialize( &self->mtx ) );
+    PA_ENSURE( PaUnixCondition_Initialize( &self->detached ) );
+
+error:
+    return result;
+}
+
+static void PaAlsaSharedThread_Terminate( PaAlsaSharedThread *self )
+{
+    if( self->running )
+    {
+        /* All streams have been closed by now */
+        assert( !self->streams && !self->attaching );
+        ASSERT_CALL_( PaUnixMutex_Lock( &self->mtx ), paNoError );
+        self->quit = 1;
+        eventfd_write( self->wakeFd, 1 );
+        ASSERT_CALL_( PaUnixMutex_Unlock( &self->mtx ), paNoError );
+
+        if( PaUnixThread_Terminate( &self->thread, 1, NULL ) != paNoError )
+            PA_DEBUG(( "%s: Failed joining the shared thread\n", __FUNCTION__ ));
+        self->running = 0;
+    }
+    if( self->stackLockReserved )
+        PaUnixThread_ReleaseStackLock();
+
+    if( self->epollFd >= 0 )
+        close( self->epollFd );
+    if( self->wakeFd >= 0 )
+        close( self->wakeFd );
+    ASSERT_CALL_( PaUnixMutex_Terminate( &self->mtx ), paNoError );
+    pthread_cond_destroy( &self->detached );
+}
+
+/** Start the shared thread unless it is running already.
+ *
+ * The thread takes the scheduling and memory locking of the first stream that starts it, and keeps running
+ * until the host API is terminated. The configuration applied is reported for every stream serviced by the
+ * thread, and so is the stack lock for streams asking for paLockMemory. The thread's stack is locked before
+ * it notifies us that it runs, never later on the real-time path, so streams asking for it when the thread
+ * runs unlocked are reported as failing to lock.
+ */
+static PaError PaAlsaSharedThread_Start( PaAlsaSharedThread *self, PaAlsaStream *stream )
+{
+    PaError result = paNoError;
+    int locked = 0;
+
+    PA_ENSURE( PaUnixMutex_Lock( &self->mtx ) );
+    locked = 1;
+
+    if( !self->running )
+    {
+        const PaThreadConfiguration *config = PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation );
+        struct epoll_event event;
+
+        PA_UNLESS( ( self->epollFd = epoll_create1( EPOLL_CLOEXEC ) ) >= 0, paInternalError );
+        PA_UNLESS( ( self->wakeFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ) >= 0, paInternalError );
+        memset( &event, 0, sizeof (event) );
+        event.events = EPOLLIN;
+        event.data.ptr = self;
+        PA_UNLESS( epoll_ctl( self->epollFd, EPOLL_CTL_ADD, self->wakeFd, &event ) == 0, paInternalError );
+
+        self->configured = NULL != config;
+        if( config )
+            self->configuration = *config;
+        self->period = (stream->playback.pcm ? stream->playback.framesPerPeriod : stream->capture.framesPerPeriod) /
+            stream->streamRepresentation.streamInfo.sampleRate;
+        self->quit = 0;
+        self->lockStack = stream->lockMemory;
+        if( self->lockStack && !self->stackLockReserved )
+            self->stackLockReserved = PaUnixThread_ReserveStackLock() == paNoError;
+
+        PA_ENSURE( PaUnixThread_New( &self->thread, &SharedThreadFunc, self, 1., stream->rtSched, config ) );
+        self->running = 1;
+    }
+
+    stream->streamRepresentation.threadConfiguration.applied = self->thread.configuration;
+    if( stream->lockMemory && !stream->stackLockRecorded )
+    {
+        PaUtil_RecordStreamMemoryLock( &stream->streamRepresentation,
+                self->stackLocked ? self->stackLockResult : paInsufficientMemory, PA_UNIX_LOCKED_STACK_SIZE,
+                self->stackLocked ? self->stackLockDuration : 0. );
+        stream->stackLockRecorded = 1;
+    }
+
+end:
+    if( locked )
+        ASSERT_CALL_( PaUnixMutex_Unlock( &self->mtx ), paNoError );
+    return result;
+
+error:
+    if( !self->running )
+    {
+        if( self->epollFd >= 0 )
+            close( self->epollFd );
+        if( self->wakeFd >= 0 )
+            close( self->wakeFd );
+        self->epollFd = -1;
+        self->wakeFd = -1;
+    }
+    goto end;
+}
+
+/** Hand a started stream over to the shared thread.
+ */
+static PaError PaAlsaSharedThread_Attach( PaAlsaSharedThread *self, PaAlsaStream *stream )
+{
+    PaError result = paNoError;
+
+    assert( self->running );
+
+    stream->sharedStopRequest = paContinue;
+    stream->sharedCallbackResult = paContinue;
+    stream->sharedCbFlags = 0;
+    stream->sharedDeadline = 0;
+    stream->sharedLastEvent = PaUtil_GetTime();
+    stream->sharedMasked = NULL;
+    if( stream->capture.pcm )
+    {
+        PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &stream->capture,
+                    PaAlsaStream_ComponentPfds( stream, &stream->capture ) ) );
+    }
+    if( stream->playback.pcm )
+    {
+        PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &stream->playback,
+                    PaAlsaStream_ComponentPfds( stream, &stream->playback ) ) );
+    }
+
+    PA_ENSURE( PaUnixMutex_Lock( &self->mtx ) );
+    stream->sharedAttached = 1;
+    stream->nextShared = self->attaching;
+    self->attaching = stream;
+    eventfd_write( self->wakeFd, 1 );
+    PA_ENSURE( PaUnixMutex_Unlock( &self->mtx ) );
+
+error:
+    return result;
+}
+
+/** Ask the shared thread to stop servicing a stream, and wait until it has let go of it.
+ *
+ * @param abort Drop buffered output instead of letting the stream play it out.
+ */
+static PaError PaAlsaSharedThread_StopStream( PaAlsaSharedThread *self, PaAlsaStream *stream, int abort )
+{
+    PaError result = paNoError;
+
+    PA_ENSURE( PaUnixMutex_Lock( &self->mtx ) );
+    if( stream->sharedAttached )
+    {
+        stream->sharedStopRequest = abort ? paAbort : paComplete;
+        eventfd_write( self->wakeFd, 1 );
+        while( stream->sharedAttached )
+            pthread_cond_wait( &self->detached, &self->mtx.mtx );
+    }
+    PA_ENSURE( PaUnixMutex_Unlock( &self->mtx ) );
+
+error:
+    return result;
+}
+
+/* Blocking interface */
+
+static PaError ReadStream( PaStream* s, void *buffer, unsigned long frames )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    unsigned long framesGot, framesAvail;
+    void *userBuffer;
+    snd_pcm_t *save = stream->playback.pcm;
+
+    assert( stream );
+
+    PA_UNLESS( stream->capture.pcm, paCanNotReadFromAnOutputOnlyStream );
+
+    /* Disregard playback */
+    stream->playback.pcm = NULL;
+
+    if( stream->overrun > 0. )
     {
         result = paInputOverflowed;
         stream->overrun = 0.0;
@@ -4484,6 +7225,263 @@ error:
     goto end;
 }
 
+/* Region interface, the blocking interface without the copy. Unlike ReadStream and WriteStream only the one pcm
+ * is touched, the other direction of a full duplex stream is left alone. */
+
+/** Wait until a component has at least minFrames available.
+ *
+ * Xruns are recovered from, and reported by the next region obtained through the stream's overrun/underrun.
+ */
+static PaError PaAlsaStream_WaitForRegion( PaAlsaStream *self, PaAlsaStreamComponent *component,
+        unsigned long minFrames, unsigned long *framesAvail )
+{
+    PaError result = paNoError;
+    int xrun, res;
+
+    minFrames = PA_MIN( minFrames, component->alsaBufferSize );
+    for( ;; )
+    {
+        PA_ENSURE( PaAlsaStreamComponent_GetAvailableFrames( component, framesAvail, &xrun ) );
+        if( xrun )
+        {
+            PA_ENSURE( PaAlsaStream_HandleXrun( self ) );
+            continue;
+        }
+        if( *framesAvail >= minFrames )
+            break;
+
+        /* Room in a full playback buffer only appears once it is playing */
+        if( StreamDirection_Out == component->streamDir &&
+                alsa_snd_pcm_state( component->pcm ) == SND_PCM_STATE_PREPARED )
+        {
+            ENSURE_( alsa_snd_pcm_start( component->pcm ), paUnanticipatedHostError );
+        }
+
+        /* An xrun is picked up by the next round */
+        res = alsa_snd_pcm_wait( component->pcm, self->pollTimeout );
+        if( res < 0 && res != -EPIPE && res != -ESTRPIPE )
+        {
+            ENSURE_( res, paUnanticipatedHostError );
+        }
+    }
+
+error:
+    return result;
+}
+
+/** Hand out the component's mmap area at the current position.
+ *
+ * @param frames On entrance the available frames, on exit the frames in the region
+ */
+static PaError PaAlsaStreamComponent_GetRegion( PaAlsaStreamComponent *self, void **buffer, unsigned long *frames )
+{
+    PaError result = paNoError;
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t regionFrames = *frames;
+    int i;
+
+    ENSURE_( alsa_snd_pcm_mmap_begin( self->pcm, &areas, &self->offset, &regionFrames ), paUnanticipatedHostError );
+
+    if( self->hostInterleaved )
+    {
+        *buffer = ExtractAddress( areas, self->offset );
+    }
+    else
+    {
+        for( i = 0; i < self->numHostChannels; ++i )
+            self->userBuffers[i] = ExtractAddress( areas + i, self->offset );
+        *buffer = self->userBuffers;
+    }
+    self->regionFrames = regionFrames;
+    *frames = regionFrames;
+
+error:
+    return result;
+}
+
+static PaError PaAlsaStreamComponent_CommitRegion( PaAlsaStreamComponent *self, unsigned long frames, int *xrun )
+{
+    PaError result = paNoError;
+    snd_pcm_sframes_t res;
+
+    *xrun = 0;
+    PA_UNLESS( frames <= self->regionFrames, paBufferTooBig );
+    self->regionFrames = 0;
+
+    res = alsa_snd_pcm_mmap_commit( self->pcm, self->offset, frames );
+    if( res == -EPIPE || res == -ESTRPIPE )
+    {
+        *xrun = 1;
+    }
+    else
+    {
+        ENSURE_( res, paUnanticipatedHostError );
+    }
+
+error:
+    return result;
+}
+
+static PaError GetStreamReadRegion( PaStream *s, const void **buffer, unsigned long *frames )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    unsigned long framesAvail;
+    void *region;
+
+    PA_UNLESS( stream->capture.pcm, paCanNotReadFromAnOutputOnlyStream );
+    PA_UNLESS( stream->capture.zeroCopy, paSampleFormatNotSupported );
+
+    /* Start stream if in prepared state */
+    if( alsa_snd_pcm_state( stream->capture.pcm ) == SND_PCM_STATE_PREPARED )
+    {
+        ENSURE_( alsa_snd_pcm_start( stream->capture.pcm ), paUnanticipatedHostError );
+    }
+
+    PA_ENSURE( PaAlsaStream_WaitForRegion( stream, &stream->capture, *frames, &framesAvail ) );
+    PA_ENSURE( PaAlsaStreamComponent_GetRegion( &stream->capture, &region, &framesAvail ) );
+    *buffer = region;
+    *frames = framesAvail;
+
+    if( stream->overrun > 0. )
+    {
+        result = paInputOverflowed;
+        stream->overrun = 0.0;
+    }
+
+error:
+    return result;
+}
+
+static PaError CommitStreamRead( PaStream *s, unsigned long frames )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    int xrun;
+
+    PA_UNLESS( stream->capture.pcm, paCanNotReadFromAnOutputOnlyStream );
+    PA_UNLESS( stream->capture.zeroCopy, paSampleFormatNotSupported );
+
+    PA_ENSURE( PaAlsaStreamComponent_CommitRegion( &stream->capture, frames, &xrun ) );
+    if( xrun )
+        PA_ENSURE( PaAlsaStream_HandleXrun( stream ) );
+
+error:
+    return result;
+}
+
+static PaError GetStreamWriteRegion( PaStream *s, void **buffer, unsigned long *frames )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    unsigned long framesAvail;
+
+    PA_UNLESS( stream->playback.pcm, paCanNotWriteToAnInputOnlyStream );
+    PA_UNLESS( stream->playback.zeroCopy, paSampleFormatNotSupported );
+
+    PA_ENSURE( PaAlsaStream_WaitForRegion( stream, &stream->playback, *frames, &framesAvail ) );
+    PA_ENSURE( PaAlsaStreamComponent_GetRegion( &stream->playback, buffer, &framesAvail ) );
+    *frames = framesAvail;
+
+    if( stream->underrun > 0. )
+    {
+        result = paOutputUnderflowed;
+        stream->underrun = 0.0;
+    }
+
+error:
+    return result;
+}
+
+static PaError CommitStreamWrite( PaStream *s, unsigned long frames )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    snd_pcm_sframes_t framesAvail;
+    int xrun;
+
+    PA_UNLESS( stream->playback.pcm, paCanNotWriteToAnInputOnlyStream );
+    PA_UNLESS( stream->playback.zeroCopy, paSampleFormatNotSupported );
+
+    PA_ENSURE( PaAlsaStreamComponent_CommitRegion( &stream->playback, frames, &xrun ) );
+    if( xrun )
+        PA_ENSURE( PaAlsaStream_HandleXrun( stream ) );
+
+    /* Start stream after one period of samples worth, as WriteStream does */
+    framesAvail = alsa_snd_pcm_avail_update( stream->playback.pcm );
+    if( !xrun && framesAvail >= 0 && alsa_snd_pcm_state( stream->playback.pcm ) == SND_PCM_STATE_PREPARED &&
+            stream->playback.alsaBufferSize - framesAvail >= stream->playback.framesPerPeriod )
+    {
+        ENSURE_( alsa_snd_pcm_start( stream->playback.pcm ), paUnanticipatedHostError );
+    }
+
+error:
+    return result;
+}
+
+/** The pcms' poll descriptors, capture first, as filled in for PaAlsaStream_WaitForFrames. */
+static int GetStreamPollDescriptors( PaStream *s, PaStreamPollDescriptor *descriptors, int maxDescriptors )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    int i, totalFds = stream->capture.nfds + stream->playback.nfds;
+
+    if( stream->capture.pcm )
+        PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &stream->capture, stream->pfds ) );
+    if( stream->playback.pcm )
+        PA_ENSURE( PaAlsaStreamComponent_BeginPolling( &stream->playback, stream->pfds + stream->capture.nfds ) );
+
+    for( i = 0; i < totalFds && i < maxDescriptors; ++i )
+    {
+        descriptors[i].fd = stream->pfds[i].fd;
+        descriptors[i].events = stream->pfds[i].events;
+        descriptors[i].revents = 0;
+    }
+    return totalFds;
+
+error:
+    return result;
+}
+
+/** Demangle the events of the pcms' poll descriptors, as PaAlsaStream_WaitForFrames does after poll(). */
+static PaError ProcessStreamPollEvents( PaStream *s, const PaStreamPollDescriptor *descriptors, int numDescriptors,
+        int *ready )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream = (PaAlsaStream*)s;
+    int i, totalFds = stream->capture.nfds + stream->playback.nfds, shouldPoll, xrun = 0;
+
+    *ready = 0;
+    PA_UNLESS( numDescriptors == totalFds, paBadBufferPtr );
+    for( i = 0; i < totalFds; ++i )
+    {
+        stream->pfds[i].fd = descriptors[i].fd;
+        stream->pfds[i].events = descriptors[i].events;
+        stream->pfds[i].revents = descriptors[i].revents;
+    }
+
+    stream->capture.ready = stream->playback.ready = 0;
+    if( stream->capture.pcm )
+        PA_ENSURE( PaAlsaStreamComponent_EndPolling( &stream->capture, stream->pfds, &shouldPoll, &xrun ) );
+    if( stream->playback.pcm )
+        PA_ENSURE( PaAlsaStreamComponent_EndPolling( &stream->playback, stream->pfds + stream->capture.nfds,
+                    &shouldPoll, &xrun ) );
+
+    if( xrun )
+    {
+        /* Playback is prepared again and can be written right away, capture has to fill up first */
+        PA_ENSURE( PaAlsaStream_HandleXrun( stream ) );
+        stream->playback.ready = stream->playback.pcm != NULL;
+    }
+    if( stream->capture.ready )
+        *ready |= paStreamPollReadable;
+    if( stream->playback.ready )
+        *ready |= paStreamPollWritable;
+
+error:
+    return result;
+}
+
 /* Return frames available for reading. In the event of an overflow, the capture pcm will be restarted */
 static signed long GetStreamReadAvailable( PaStream* s )
 {
@@ -4544,19 +7542,33 @@ void PaAlsa_InitializeStreamInfo( PaAlsaStreamInfo *info )
     info->deviceString = NULL;
 }
 
+void PaAlsa_InitializeAggregateStreamInfo( PaAlsaAggregateStreamInfo *info )
+{
+    info->size = sizeof (PaAlsaAggregateStreamInfo);
+    info->hostApiType = paALSA;
+    info->version = 1;
+    info->numDevices = 0;
+    info->deviceStrings = NULL;
+    info->channelCounts = NULL;
+}
+
 void PaAlsa_EnableRealtimeScheduling( PaStream *s, int enable )
 {
     PaAlsaStream *stream = (PaAlsaStream *) s;
     stream->rtSched = enable;
 }
 
-#if 0
 void PaAlsa_EnableWatchdog( PaStream *s, int enable )
 {
     PaAlsaStream *stream = (PaAlsaStream *) s;
-    stream->thread.useWatchdog = enable;
+    stream->useWatchdog = enable;
+}
+
+void PaAlsa_EnableSharedThread( PaStream *s, int enable )
+{
+    PaAlsaStream *stream = (PaAlsaStream *) s;
+    stream->useSharedThread = enable;
 }
-#endif
 
 static PaError GetAlsaStreamPointer( PaStream* s, PaAlsaStream** stream )
 {
@@ -4574,7 +7586,7 @@ static PaError GetAlsaStreamPointer( PaStream* s, PaAlsaStream** stream )
 
     *stream = (PaAlsaStream*)s;
 error:
-    return paNoError;
+    return result;
 }
 
 PaError PaAlsa_GetStreamInputCard( PaStream* s, int* card )
@@ -4615,8 +7627,179 @@ error:
     return result;
 }
 
+/* A pcm started by PaAlsa_StartStreamGroup */
+typedef struct
+{
+    snd_pcm_t *pcm;
+    int linked;     /* Linked to the group's first pcm, else started right after it */
+}
+PaAlsaGroupPcm;
+
+/** The pcms of a stream which PaAlsa_StartStreamGroup triggers, the others start when first written.
+ *
+ * @return The number of pcms added to pcms.
+ */
+static int PaAlsaStream_GetGroupPcms( const PaAlsaStream *self, PaAlsaGroupPcm *pcms )
+{
+    int numPcms = 0;
+    int groupPlayback = self->playback.pcm && self->callbackMode && self->playback.canMmap;
+
+    /* Synced pcms start with their playback, so are part of the group along with it or not at all */
+    if( self->capture.pcm && ( !self->pcmsSynced || groupPlayback ) )
+        pcms[numPcms++].pcm = self->capture.pcm;
+    if( groupPlayback )
+        pcms[numPcms++].pcm = self->playback.pcm;
+
+    return numPcms;
+}
+
+PaError PaAlsa_StartStreamGroup( PaStream * const *streams, int numStreams, PaTime *startSkew )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream;
+    PaAlsaGroupPcm *pcms = NULL;
+    snd_pcm_status_t *status;
+    snd_timestamp_t triggerTime;
+    PaTime t, first = 0., last = 0.;
+    int i, numPcms = 0, numStarted = 0, split = 0, err;
+
+    alsa_snd_pcm_status_alloca( &status );
+    if( startSkew )
+        *startSkew = 0.;
+
+    PA_UNLESS( streams && numStreams > 0, paBadStreamPtr );
+    for( i = 0; i < numStreams; ++i )
+    {
+        PA_ENSURE( GetAlsaStreamPointer( streams[i], &stream ) );
+        PA_UNLESS( Pa_IsStreamStopped( streams[i] ) == 1, paStreamIsNotStopped );
+    }
+    PA_UNLESS( pcms = (PaAlsaGroupPcm *)PaUtil_AllocateMemory( 2 * numStreams * sizeof (PaAlsaGroupPcm) ),
+            paInsufficientMemory );
+    memset( pcms, 0, 2 * numStreams * sizeof (PaAlsaGroupPcm) );
+
+    /* Get every stream going with its pcms prepared, the callbacks wait for the pcms to start */
+    for( i = 0; i < numStreams; ++i )
+    {
+        stream = (PaAlsaStream *)streams[i];
+        stream->groupStart = 1;
+        result = Pa_StartStream( streams[i] );
+        stream->groupStart = 0;
+        PA_ENSURE( result );
+        ++numStarted;
+        numPcms += PaAlsaStream_GetGroupPcms( stream, pcms + numPcms );
+    }
+    if( numPcms == 0 )
+        goto end;
+
+    /* A pcm can only be in one group, so synced pairs join the stream group separately */
+    for( i = 0; i < numStreams; ++i )
+    {
+        stream = (PaAlsaStream *)streams[i];
+        if( stream->pcmsSynced && stream->playback.canMmap )
+            alsa_snd_pcm_unlink( stream->capture.pcm );
+    }
+    split = 1;
+    for( i = 1; i < numPcms; ++i )
+    {
+        if( (err = alsa_snd_pcm_link( pcms[0].pcm, pcms[i].pcm )) == 0 )
+            pcms[i].linked = 1;
+        else
+            PA_DEBUG(( "%s: Unable to link pcm %d, starting it separately: %s\n", __FUNCTION__, i,
+                        alsa_snd_strerror( err ) ));
+    }
+
+    ENSURE_( alsa_snd_pcm_start( pcms[0].pcm ), paUnanticipatedHostError );
+    for( i = 1; i < numPcms; ++i )
+    {
+        if( !pcms[i].linked )
+            ENSURE_( alsa_snd_pcm_start( pcms[i].pcm ), paUnanticipatedHostError );
+    }
+
+    /* Linked pcms share the trigger time */
+    for( i = 0; i < numPcms; ++i )
+    {
+        ENSURE_( alsa_snd_pcm_status( pcms[i].pcm, status ), paUnanticipatedHostError );
+        alsa_snd_pcm_status_get_trigger_tstamp( status, &triggerTime );
+        t = triggerTime.tv_sec + triggerTime.tv_usec * 1e-6;
+        if( i == 0 || t < first )
+            first = t;
+        if( i == 0 || t > last )
+            last = t;
+    }
+    if( startSkew )
+        *startSkew = last - first;
+    PA_DEBUG(( "%s: Started %d pcms of %d streams, skew %f s\n", __FUNCTION__, numPcms, numStreams, last - first ));
+
+end:
+    if( pcms )
+    {
+        for( i = 1; i < numPcms; ++i )
+        {
+            if( pcms[i].linked )
+                alsa_snd_pcm_unlink( pcms[i].pcm );
+        }
+        for( i = 0; i < numStarted && split; ++i )
+        {
+            stream = (PaAlsaStream *)streams[i];
+            if( stream->pcmsSynced && stream->playback.canMmap &&
+                    alsa_snd_pcm_link( stream->capture.pcm, stream->playback.pcm ) < 0 )
+            {
+                PA_DEBUG(( "%s: Unable to sync pcms again\n", __FUNCTION__ ));
+                stream->pcmsSynced = 0;
+            }
+        }
+        PaUtil_FreeMemory( pcms );
+    }
+    return result;
+
+error:
+    for( i = 0; i < numStarted; ++i )
+        Pa_AbortStream( streams[i] );
+    goto end;
+}
+
+PaError PaAlsa_SetAdaptiveLatency( PaStream *s, PaTime maxLatency, PaAlsaLatencyCallback *latencyCallback,
+        void *userData )
+{
+    PaError result = paNoError;
+    PaAlsaStream *stream;
+
+    PA_ENSURE( GetAlsaStreamPointer( s, &stream ) );
+    PA_UNLESS( Pa_IsStreamStopped( s ) == 1, paStreamIsNotStopped );
+
+    if( stream->latencyNotifier )
+    {
+        PaUtil_DestroyNotifier( stream->latencyNotifier );
+        stream->latencyNotifier = NULL;
+    }
+    stream->adaptMaxLatency = 0.;
+    stream->latencyCallback = NULL;
+    stream->latencyUserData = NULL;
+    stream->adaptXruns = 0;
+
+    if( maxLatency > 0. )
+    {
+        if( latencyCallback )
+        {
+            PA_ENSURE( PaUtil_CreateNotifier( &stream->latencyNotifier, NotifyLatency, stream ) );
+            stream->latencyCallback = latencyCallback;
+            stream->latencyUserData = userData;
+        }
+        stream->adaptMaxLatency = maxLatency;
+    }
+
+error:
+    return result;
+}
+
 PaError PaAlsa_SetRetriesBusy( int retries )
 {
     busyRetries_ = retries;
     return paNoError;
 }
+
+PaError PaAlsa_SetTimerScheduling( int enable )
+{
+    timerScheduling_ = enable;
+    return paNoError;
+}
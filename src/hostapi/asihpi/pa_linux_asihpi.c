@@ -1795,6 +1795,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
         stream->callbackMode = 0;
     }
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->baseStreamRep.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
     /* Following pa_linux_alsa's lead, we operate with fixed host buffer size by default, */
     /* since other modes will invariably lead to block adaption (maybe Bounded better?) */
@@ -2616,6 +2617,7 @@ static void *CallbackThreadFunc( void *userData )
         /* Wait for data (or buffer space) to become available. This basically sleeps and
         polls the HPI interface until a full block of frames can be moved. */
         PA_ENSURE_( PaAsiHpi_WaitForFrames( stream, &framesAvail, &cbFlags ) );
+        PaUtil_RecordStreamWakeup( &stream->baseStreamRep, stream->maxFramesPerHostBuffer );
 
         /* Consume buffer space. Once we have a number of frames available for consumption we
         must retrieve the data from the HPI interface and pass it to the PA buffer processor.
@@ -2644,10 +2646,13 @@ static void *CallbackThreadFunc( void *userData )
             PaUtil_BeginBufferProcessing( &stream->bufferProcessor, &timeInfo, cbFlags );
             /* CPU load measurement should include processing activivity external to the stream callback */
             PaUtil_BeginCpuLoadMeasurement( &stream->cpuLoadMeasurer );
+            PaUtil_BeginStreamCallbackMeasurement( &stream->baseStreamRep );
             if( framesGot > 0 )
             {
                 /* READ FROM HPI INPUT STREAM */
                 PA_ENSURE_( PaAsiHpi_BeginProcessing( stream, &framesGot, &cbFlags ) );
+                PaUtil_RecordStreamXruns( &stream->baseStreamRep, (cbFlags & paInputOverflow) ? 1 : 0,
+                                          (cbFlags & paOutputUnderflow) ? 1 : 0 );
                 /* Input overflow in a full-duplex stream makes for interesting times */
                 if( stream->input && stream->output && (cbFlags & paInputOverflow) )
                 {
@@ -2669,6 +2674,8 @@ static void *CallbackThreadFunc( void *userData )
                 framesAvail -= framesGot;
             }
             PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesGot );
+            if( framesGot > 0 )
+                PaUtil_EndStreamCallbackMeasurement( &stream->baseStreamRep );
 
             if( framesGot == 0 )
             {
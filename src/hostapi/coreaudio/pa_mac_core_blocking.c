@@ -63,6 +63,7 @@
 #include "pa_mac_core_blocking.h"
 #include "pa_mac_core_internal.h"
 #include <assert.h>
+#include <string.h>
 #ifdef MOSX_USE_NON_ATOMIC_FLAG_BITS
 # define OSAtomicOr32( a, b ) ( (*(b)) |= (a) )
 # define OSAtomicAnd32( a, b ) ( (*(b)) &= (a) )
@@ -163,12 +164,14 @@ PaError initializeBlioRingBuffers(
    result = UNIX_ERR( pthread_cond_init( &(blio->outputCond), NULL ) );
 #endif
    if( inChan ) {
-      data = calloc( ringBufferSize, blio->inputSampleSizePow2*inChan );
+      data = PaUtil_AllocateMemoryInCategory(
+            ringBufferSize*blio->inputSampleSizePow2*inChan, paAllocationRingBuffer );
       if( !data )
       {
          result = paInsufficientMemory;
          goto error;
       }
+      memset( data, 0, ringBufferSize*blio->inputSampleSizePow2*inChan );
 
       err = PaUtil_InitializeRingBuffer(
             &blio->inputRingBuffer,
@@ -177,12 +180,14 @@ PaError initializeBlioRingBuffers(
       assert( !err );
    }
    if( outChan ) {
-      data = calloc( ringBufferSize, blio->outputSampleSizePow2*outChan );
+      data = PaUtil_AllocateMemoryInCategory(
+            ringBufferSize*blio->outputSampleSizePow2*outChan, paAllocationRingBuffer );
       if( !data )
       {
          result = paInsufficientMemory;
          goto error;
       }
+      memset( data, 0, ringBufferSize*blio->outputSampleSizePow2*outChan );
 
       err = PaUtil_InitializeRingBuffer(
             &blio->outputRingBuffer,
@@ -310,7 +315,7 @@ PaError destroyBlioRingBuffers( PaMacBlio *blio )
 {
    PaError result = paNoError;
    if( blio->inputRingBuffer.buffer ) {
-      free( blio->inputRingBuffer.buffer );
+      PaUtil_FreeMemory( blio->inputRingBuffer.buffer );
 #ifdef PA_MAC__BLIO_MUTEX
       result = UNIX_ERR( pthread_mutex_destroy( & blio->inputMutex ) );
       if( result ) return result;
@@ -320,7 +325,7 @@ PaError destroyBlioRingBuffers( PaMacBlio *blio )
    }
    blio->inputRingBuffer.buffer = NULL;
    if( blio->outputRingBuffer.buffer ) {
-      free( blio->outputRingBuffer.buffer );
+      PaUtil_FreeMemory( blio->outputRingBuffer.buffer );
 #ifdef PA_MAC__BLIO_MUTEX
       result = UNIX_ERR( pthread_mutex_destroy( & blio->outputMutex ) );
       if( result ) return result;
@@ -70,6 +70,8 @@
 #include "pa_cpuload.h"
 #include "pa_ringbuffer.h"
 #include "pa_debugprint.h"
+#include "pa_unix_util.h"
+#include "pa_trace.h"
 
 static pthread_t mainThread_;
 static char *jackErr_ = NULL;
@@ -217,6 +219,7 @@ typedef struct PaJackStream
     int callbackResult;
     int isSilenced;
     int xrun;
+    int lockMemory;     /* paLockMemory: lock memory touched by the process callback */
 
     /* These are useful for the blocking API */
 
@@ -258,16 +261,17 @@ static int JackCallback( jack_nframes_t frames, void *userData );
 static PaError BlockingInitFIFO( PaUtilRingBuffer *rbuf, long numFrames, long bytesPerFrame )
 {
     long numBytes = numFrames * bytesPerFrame;
-    char *buffer = (char *) malloc( numBytes );
+    char *buffer = (char *) PaUtil_AllocateMemoryInCategory( numBytes, paAllocationRingBuffer );
     if( buffer == NULL ) return paInsufficientMemory;
     memset( buffer, 0, numBytes );
     return (PaError) PaUtil_InitializeRingBuffer( rbuf, 1, numBytes, buffer );
 }
 
 /* Free buffer. */
-static PaError BlockingTermFIFO( PaUtilRingBuffer *rbuf )
+static PaError BlockingTermFIFO( PaUtilRingBuffer *rbuf, int lockMemory )
 {
-    if( rbuf->buffer ) free( rbuf->buffer );
+    if( rbuf->buffer && lockMemory ) PaUtil_UnlockMemory( rbuf->buffer, rbuf->bufferSize * rbuf->elementSizeBytes );
+    if( rbuf->buffer ) PaUtil_FreeMemory( rbuf->buffer );
     rbuf->buffer = NULL;
     return paNoError;
 }
@@ -286,7 +290,10 @@ BlockingCallback( const void                      *inputBuffer,
     /* This may get called with NULL inputBuffer during initial setup. */
     if( inputBuffer != NULL )
     {
-        PaUtil_WriteRingBuffer( &stream->inFIFO, inputBuffer, numBytes );
+        long numWritten = PaUtil_WriteRingBuffer( &stream->inFIFO, inputBuffer, numBytes );
+        /* Input the client hasn't read yet, there's no room for the rest */
+        PaUtil_RecordStreamDroppedFrames( &stream->streamRepresentation,
+                (numBytes - numWritten) / stream->bytesPerFrame );
     }
     if( outputBuffer != NULL )
     {
@@ -346,8 +353,8 @@ error:
 static void
 BlockingEnd( PaJackStream *stream )
 {
-    BlockingTermFIFO( &stream->inFIFO );
-    BlockingTermFIFO( &stream->outFIFO );
+    BlockingTermFIFO( &stream->inFIFO, stream->lockMemory );
+    BlockingTermFIFO( &stream->outFIFO, stream->lockMemory );
 
     sem_destroy( &stream->data_semaphore );
 }
@@ -721,7 +728,7 @@ PaError PaJack_Initialize( PaUtilHostApiRepresentation **hostApi,
 
     mainThread_ = pthread_self();
     ASSERT_CALL( pthread_mutex_init( &jackHostApi->mtx, NULL ), 0 );
-    ASSERT_CALL( pthread_cond_init( &jackHostApi->cond, NULL ), 0 );
+    ENSURE_PA( PaUnixCondition_Initialize( &jackHostApi->cond ) );
 
     /* Try to become a client of the JACK server.  If we cannot do
      * this, then this API cannot be used.
@@ -930,7 +937,7 @@ static PaError InitializeStream( PaJackStream *stream, PaJackHostApiRepresentati
     assert( stream );
 
     memset( stream, 0, sizeof (PaJackStream) );
-    UNLESS( stream->stream_memory = PaUtil_CreateAllocationGroup(), paInsufficientMemory );
+    UNLESS( stream->stream_memory = PaUtil_CreateAllocationGroupInCategory( paAllocationHostApi ), paInsufficientMemory );
     stream->jack_client = hostApi->jack_client;
     stream->hostApi = hostApi;
 
@@ -998,18 +1005,36 @@ static void CleanUpStream( PaJackStream *stream, int terminateStreamRepresentati
         PaUtil_FreeAllAllocations( stream->stream_memory );
         PaUtil_DestroyAllocationGroup( stream->stream_memory );
     }
+    if( stream->lockMemory )
+        PaUtil_UnlockMemory( stream, sizeof (PaJackStream) );
     PaUtil_FreeMemory( stream );
 }
 
+/*!
+ * Lock the memory touched by the JACK process callback, for the paLockMemory flag.
+ *
+ * The outcome is reported in the stream info; failure to lock is not fatal. The process
+ * thread belongs to JACK, so its stack is not ours to lock.
+ */
+static void LockStreamMemory( PaJackStream *stream )
+{
+    PaUtilStreamRepresentation *rep = &stream->streamRepresentation;
+
+    PaUtil_LockStreamMemory( rep, stream, sizeof (PaJackStream) );
+    PaUtil_LockStreamArena( rep, &stream->bufferProcessor.arena );
+    if( stream->inFIFO.buffer )
+        PaUtil_LockStreamMemory( rep, stream->inFIFO.buffer, stream->inFIFO.bufferSize * stream->inFIFO.elementSizeBytes );
+    if( stream->outFIFO.buffer )
+        PaUtil_LockStreamMemory( rep, stream->outFIFO.buffer, stream->outFIFO.bufferSize * stream->outFIFO.elementSizeBytes );
+}
+
 static PaError WaitCondition( PaJackHostApiRepresentation *hostApi )
 {
     PaError result = paNoError;
     int err = 0;
-    PaTime pt = PaUtil_GetTime();
     struct timespec ts;
 
-    ts.tv_sec = (time_t) floor( pt + 10 * 60 /* 10 minutes */ );
-    ts.tv_nsec = (long) ((pt - floor( pt )) * 1000000000);
+    PaUnixCondition_GetDeadline( 10 * 60 /* 10 minutes */, &ts );
     /* XXX: Best enclose in loop, in case of spurious wakeups? */
     err = pthread_cond_timedwait( &hostApi->cond, &hostApi->mtx, &ts );
 
@@ -1164,6 +1189,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
 
     UNLESS( stream = (PaJackStream*)PaUtil_AllocateMemory( sizeof(PaJackStream) ), paInsufficientMemory );
     ENSURE_PA( InitializeStream( stream, jackHostApi, inputChannelCount, outputChannelCount ) );
+    stream->lockMemory = ( streamFlags & paLockMemory ) != 0;
 
     /* the blocking emulation, if necessary */
     stream->isBlockingStream = !streamCallback;
@@ -1201,6 +1227,9 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     }
     srInitialized = 1;
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, jackSr );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
+    stream->streamRepresentation.headroom.supported = 1;
+    stream->streamRepresentation.threadConfiguration.supported = 1;
 
     /* create the JACK ports.  We cannot connect them until audio
      * processing begins */
@@ -1297,6 +1326,9 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                   userData ) );
     bpInitialized = 1;
 
+    if( stream->lockMemory )
+        LockStreamMemory( stream );
+
     if( stream->num_incoming_connections > 0 )
         stream->streamRepresentation.streamInfo.inputLatency = (jack_port_get_latency( stream->remote_output_ports[0] )
                 - jack_get_buffer_size( jackHostApi->jack_client )  /* One buffer is not counted as latency */
@@ -1370,13 +1402,19 @@ static PaError RealProcess( PaJackStream *stream, jack_nframes_t frames )
         timeInfo.outputBufferDacTime = timeInfo.currentTime + jack_port_get_latency( stream->remote_input_ports[0] )
             / sr;
 
+    /* JACK owns the process thread, so its trace buffer is never released */
+    PaUtil_SetTraceThreadName( "JACK process" );
+    PaUtil_RecordStreamWakeup( &stream->streamRepresentation, frames );
     PaUtil_BeginCpuLoadMeasurement( &stream->cpuLoadMeasurer );
+    PaUtil_BeginStreamCallbackMeasurement( &stream->streamRepresentation );
 
     if( stream->xrun )
     {
         /* XXX: Any way to tell which of these occurred? */
         cbFlags = paOutputUnderflow | paInputOverflow;
         stream->xrun = FALSE;
+        PaUtil_RecordStreamXruns( &stream->streamRepresentation, 1, 1 );
+        PaUtil_TraceInstant( paUtilTraceXrun, 3 );
     }
     PaUtil_BeginBufferProcessing( &stream->bufferProcessor, &timeInfo,
             cbFlags );
@@ -1408,12 +1446,23 @@ static PaError RealProcess( PaJackStream *stream, jack_nframes_t frames )
                 channel_buf );
     }
 
+    PaUtil_TraceBegin( paUtilTraceConvert );
     framesProcessed = PaUtil_EndBufferProcessing( &stream->bufferProcessor,
             &stream->callbackResult );
+    PaUtil_TraceEnd( paUtilTraceConvert );
+
+    /* JACK needs the buffers back by the end of the cycle, what is left of it is the headroom */
+    if( PaUtil_IsStreamHeadroomTracked( &stream->streamRepresentation ) )
+    {
+        jack_nframes_t elapsed = jack_frames_since_cycle_start( stream->jack_client );
+        PaUtil_RecordStreamHeadroom( &stream->streamRepresentation,
+                ( elapsed < frames ? frames - elapsed : 0 ) / sr, (double)elapsed / frames );
+    }
     /* We've specified a host buffer size mode where every frame should be consumed by the buffer processor */
     assert( framesProcessed == frames );
 
     PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesProcessed );
+    PaUtil_EndStreamCallbackMeasurement( &stream->streamRepresentation );
 
 end:
     return result;
@@ -1598,6 +1647,7 @@ static PaError StartStream( PaStream *s )
 
     /* Ready the processor */
     PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+    PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
 
     /* Connect the ports. Note that the ports may already have been connected by someone else in
      * the meantime, in which case JACK returns EEXIST. */
@@ -1649,6 +1699,19 @@ static PaError StartStream( PaStream *s )
     stream->is_running = TRUE;
     PA_DEBUG(( "%s: Stream started\n", __FUNCTION__ ));
 
+    /* Callback and blocking streams are both serviced by JACK's process thread. It is shared by all streams
+     * of the client and JACK chooses its stack, so only scheduling and affinity are applied. */
+    {
+        const PaThreadConfiguration *config = PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation );
+        PaThreadConfiguration defaults;
+
+        memset( &defaults, 0, sizeof (defaults) );
+        stream->streamRepresentation.threadConfiguration.applied = defaults;
+        if( PaUnixThread_Configure( jack_client_thread_id( stream->jack_client ), config ? config : &defaults,
+                    &stream->streamRepresentation.threadConfiguration.applied ) != paNoError )
+            PA_DEBUG(( "%s: Failed configuring the JACK process thread\n", __FUNCTION__ ));
+    }
+
 error:
     return result;
 }
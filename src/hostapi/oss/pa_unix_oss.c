@@ -89,6 +89,7 @@
 #include "pa_process.h"
 #include "pa_unix_util.h"
 #include "pa_debugprint.h"
+#include "pa_trace.h"
 
 static int sysErr_;
 static pthread_t mainThread_;
@@ -132,6 +133,7 @@ typedef struct
     PaUtilHostApiRepresentation inheritedHostApiRep;
     PaUtilStreamInterface callbackStreamInterface;
     PaUtilStreamInterface blockingStreamInterface;
+    PaUtilStreamPollInterface pollInterface;
 
     PaUtilAllocationGroup *allocations;
 
@@ -157,6 +159,7 @@ typedef struct
     double latency;
     unsigned long hostFrames, numBufs;
     void **userBuffers; /* For non-interleaved blocking */
+    unsigned long lockedBufferSize; /* Bytes of buffer locked for paLockMemory */
 } PaOssStreamComponent;
 
 /** Implementation specific representation of a PaStream.
@@ -185,6 +188,7 @@ typedef struct PaOssStream
     double sampleRate;
 
     int callbackMode;
+    int lockMemory;     /* paLockMemory: lock audio path memory */
     volatile int callbackStop, callbackAbort;
 
     PaOssStreamComponent *capture, *playback;
@@ -226,6 +230,9 @@ static PaError ReadStream( PaStream* stream, void *buffer, unsigned long frames
 static PaError WriteStream( PaStream* stream, const void *buffer, unsigned long frames );
 static signed long GetStreamReadAvailable( PaStream* stream );
 static signed long GetStreamWriteAvailable( PaStream* stream );
+static int GetStreamPollDescriptors( PaStream* stream, PaStreamPollDescriptor *descriptors, int maxDescriptors );
+static PaError ProcessStreamPollEvents( PaStream* stream, const PaStreamPollDescriptor *descriptors,
+                                        int numDescriptors, int *ready );
 static PaError BuildDeviceList( PaOSSHostApiRepresentation *hostApi );
 
 
@@ -271,6 +278,9 @@ PaError PaOSS_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
                                       GetStreamTime, PaUtil_DummyGetCpuLoad,
                                       ReadStream, WriteStream, GetStreamReadAvailable, GetStreamWriteAvailable );
 
+    ossHostApi->pollInterface.GetPollDescriptors = GetStreamPollDescriptors;
+    ossHostApi->pollInterface.ProcessPollEvents = ProcessStreamPollEvents;
+
     mainThread_ = pthread_self();
 
     return result;
@@ -777,7 +787,10 @@ static void PaOssStreamComponent_Terminate( PaOssStreamComponent *component )
     if( component->fd >= 0 )
         close( component->fd );
     if( component->buffer )
+    {
+        PaUtil_UnlockMemory( component->buffer, component->lockedBufferSize );
         PaUtil_FreeMemory( component->buffer );
+    }
 
     if( component->userBuffers )
         PaUtil_FreeMemory( component->userBuffers );
@@ -862,6 +875,7 @@ static PaError PaOssStream_Initialize( PaOssStream *stream, const PaStreamParame
 
     memset( stream, 0, sizeof (PaOssStream) );
     stream->isStopped = 1;
+    stream->lockMemory = ( streamFlags & paLockMemory ) != 0;
 
     PA_ENSURE( PaUtil_InitializeThreading( &stream->threading ) );
 
@@ -892,11 +906,13 @@ static PaError PaOssStream_Initialize( PaOssStream *stream, const PaStreamParame
         PaUtil_InitializeStreamRepresentation( &stream->streamRepresentation,
                                                &ossApi->callbackStreamInterface, callback, userData );
         stream->callbackMode = 1;
+        stream->streamRepresentation.threadConfiguration.supported = 1;
     }
     else
     {
         PaUtil_InitializeStreamRepresentation( &stream->streamRepresentation,
                                                &ossApi->blockingStreamInterface, callback, userData );
+        stream->streamRepresentation.pollInterface = &ossApi->pollInterface;
     }
 
     ENSURE_( sem_init( &stream->semaphore, 0, 0 ), paInternalError );
@@ -913,12 +929,22 @@ static void PaOssStream_Terminate( PaOssStream *stream )
     PaUtil_TerminateThreading( &stream->threading );
 
     if( stream->capture )
+    {
+        if( stream->lockMemory )
+            PaUtil_UnlockMemory( stream->capture, sizeof (PaOssStreamComponent) );
         PaOssStreamComponent_Terminate( stream->capture );
+    }
     if( stream->playback )
+    {
+        if( stream->lockMemory )
+            PaUtil_UnlockMemory( stream->playback, sizeof (PaOssStreamComponent) );
         PaOssStreamComponent_Terminate( stream->playback );
+    }
 
     sem_destroy( &stream->semaphore );
 
+    if( stream->lockMemory )
+        PaUtil_UnlockMemory( stream, sizeof (PaOssStream) );
     PaUtil_FreeMemory( stream );
 }
 
@@ -1083,6 +1109,33 @@ error:
     return result;
 }
 
+/** Lock the memory touched by the audio thread, for the paLockMemory flag.
+ *
+ * The outcome is reported in the stream info; failure to lock is not fatal.
+ */
+static void PaOssStream_LockMemory( PaOssStream *stream )
+{
+    PaUtilStreamRepresentation *rep = &stream->streamRepresentation;
+    PaOssStreamComponent *components[2];
+    int i;
+
+    components[0] = stream->capture;
+    components[1] = stream->playback;
+
+    PaUtil_LockStreamMemory( rep, stream, sizeof (PaOssStream) );
+    for( i = 0; i < 2; ++i )
+    {
+        PaOssStreamComponent *component = components[i];
+        if( !component )
+            continue;
+
+        PaUtil_LockStreamMemory( rep, component, sizeof (PaOssStreamComponent) );
+        if( PaUtil_LockStreamMemory( rep, component->buffer, PaOssStreamComponent_BufferSize( component ) ) == paNoError )
+            component->lockedBufferSize = PaOssStreamComponent_BufferSize( component );
+    }
+    PaUtil_LockStreamArena( rep, &stream->bufferProcessor.arena );
+}
+
 static PaError PaOssStreamComponent_Read( PaOssStreamComponent *component, unsigned long *frames )
 {
     PaError result = paNoError;
@@ -1251,6 +1304,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     PA_ENSURE( PaOssStream_Configure( stream, sampleRate, framesPerBuffer, &inLatency, &outLatency ) );
 
     PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, sampleRate );
+    stream->streamRepresentation.cpuLoadMeasurer = &stream->cpuLoadMeasurer;
 
     if( inputParameters )
     {
@@ -1275,6 +1329,9 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
               paUtilFixedHostBufferSize, streamCallback, userData ) );
     bpInitialized = 1;
 
+    if( stream->lockMemory )
+        PaOssStream_LockMemory( stream );
+
     *s = (PaStream*)stream;
 
     return result;
@@ -1454,6 +1511,40 @@ error:
     return result;
 }
 
+/** Fill in the time info passed to the stream callback.
+ *
+ * Times are in the GetStreamTime() time base, i.e. derived from the device position rather than the
+ * system clock. framesRead is the number of frames that were just read from the capture device; they
+ * were captured before the frames still queued in the driver.
+ */
+static void PaOssStream_CalculateTimeInfo( PaOssStream *stream, unsigned long framesRead,
+        PaStreamCallbackTimeInfo *timeInfo )
+{
+    timeInfo->currentTime = GetStreamTime( stream );
+    timeInfo->inputBufferAdcTime = timeInfo->currentTime;
+    timeInfo->outputBufferDacTime = timeInfo->currentTime;
+
+    if( stream->capture )
+    {
+        audio_buf_info bufInfo;
+        unsigned long framesQueued = 0;
+
+        if( ioctl( stream->capture->fd, SNDCTL_DSP_GETISPACE, &bufInfo ) == 0 && bufInfo.bytes > 0 )
+            framesQueued = bufInfo.bytes / PaOssStreamComponent_FrameSize( stream->capture );
+        timeInfo->inputBufferAdcTime -= (framesRead + framesQueued) / stream->sampleRate;
+    }
+#ifdef SNDCTL_DSP_GETODELAY
+    if( stream->playback )
+    {
+        int delay;
+
+        if( ioctl( stream->playback->fd, SNDCTL_DSP_GETODELAY, &delay ) == 0 && delay > 0 )
+            timeInfo->outputBufferDacTime +=
+                    (double)delay / PaOssStreamComponent_FrameSize( stream->playback ) / stream->sampleRate;
+    }
+#endif
+}
+
 /** Prepare stream for capture/playback.
  *
  * In order to synchronize capture and playback properly we use the SETTRIGGER command.
@@ -1558,6 +1649,7 @@ static void OnExit( void *data )
     assert( data );
 
     PaUtil_ResetCpuLoadMeasurer( &stream->cpuLoadMeasurer );
+    PaUtil_ReleaseTraceBuffer();
 
     PaOssStream_Stop( stream, stream->callbackAbort );
 
@@ -1591,6 +1683,40 @@ static PaError SetUpBuffers( PaOssStream *stream, unsigned long framesAvail )
     return result;
 }
 
+#ifdef SNDCTL_DSP_GETERROR
+/** Ask OSS whether there have been any under/overruns since we last checked.
+ *
+ * The counters are reset by the driver each time they are read. Report them to the callback through
+ * cbFlags, and count them in the stream statistics.
+ */
+static void PaOssStream_CheckErrors( PaOssStream *stream, PaStreamCallbackFlags *cbFlags )
+{
+    audio_errinfo errinfo;
+    int overruns = 0, underruns = 0;
+
+    if( stream->capture && ioctl( stream->capture->fd, SNDCTL_DSP_GETERROR, &errinfo ) >= 0 )
+    {
+        overruns = errinfo.rec_overruns;
+        if( stream->sharedDevice )
+            underruns = errinfo.play_underruns;
+    }
+    if( stream->playback && !stream->sharedDevice &&
+            ioctl( stream->playback->fd, SNDCTL_DSP_GETERROR, &errinfo ) >= 0 )
+    {
+        underruns = errinfo.play_underruns;
+    }
+
+    if( overruns > 0 )
+        *cbFlags |= paInputOverflow;
+    if( underruns > 0 )
+        *cbFlags |= paOutputUnderflow;
+    PaUtil_RecordStreamXruns( &stream->streamRepresentation, overruns > 0 ? overruns : 0,
+            underruns > 0 ? underruns : 0 );
+    if( overruns > 0 || underruns > 0 )
+        PaUtil_TraceInstant( paUtilTraceXrun, (overruns > 0 ? 1 : 0) | (underruns > 0 ? 2 : 0) );
+}
+#endif
+
 /** Thread procedure for callback processing.
  *
  * Aspect StreamState: StartStream will wait on this to initiate audio processing, useful in case the
@@ -1607,16 +1733,15 @@ static void *PaOSS_AudioThreadProc( void *userData )
     int triggered = stream->triggered;  /* See if SNDCTL_DSP_TRIGGER has been issued already */
     int initiateProcessing = triggered;    /* Already triggered? */
     PaStreamCallbackFlags cbFlags = 0;  /* We might want to keep state across iterations */
-    PaStreamCallbackTimeInfo timeInfo = {0,0,0}; /* TODO: IMPLEMENT ME */
-
-    /*
-#if ( SOUND_VERSION > 0x030904 )
-        audio_errinfo errinfo;
-#endif
-*/
+    PaStreamCallbackTimeInfo timeInfo = {0,0,0};
 
     assert( stream );
 
+    PaUtil_SetTraceThreadName( "OSS callback" );
+    if( PaUnixThread_ConfigureDeadline( PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation ),
+                stream->framesPerHostBuffer / stream->sampleRate,
+                &stream->streamRepresentation.threadConfiguration.applied ) != paNoError )
+        PA_DEBUG(( "%s: Failed configuring the callback thread\n", __FUNCTION__ ));
     pthread_cleanup_push( &OnExit, stream );	/* Execute OnExit when exiting */
 
     /* The first time the stream is started we use SNDCTL_DSP_TRIGGER to accurately start capture and
@@ -1660,8 +1785,11 @@ static void *PaOSS_AudioThreadProc( void *userData )
         if( !initiateProcessing )
         {
             /* Wait on available frames */
+            PaUtil_TraceBegin( paUtilTraceWait );
             PA_ENSURE( PaOssStream_WaitForFrames( stream, &framesAvail ) );
+            PaUtil_TraceEnd( paUtilTraceWait );
             assert( framesAvail % stream->framesPerHostBuffer == 0 );
+            PaUtil_RecordStreamWakeup( &stream->streamRepresentation, stream->framesPerHostBuffer );
         }
         else
         {
@@ -1688,6 +1816,7 @@ static void *PaOSS_AudioThreadProc( void *userData )
             }
 #endif
             PaUtil_BeginCpuLoadMeasurement( &stream->cpuLoadMeasurer );
+            PaUtil_BeginStreamCallbackMeasurement( &stream->streamRepresentation );
 
             /* Read data */
             if ( stream->capture )
@@ -1700,39 +1829,31 @@ static void *PaOSS_AudioThreadProc( void *userData )
                 }
             }
 
-#if ( SOUND_VERSION >= 0x030904 )
-            /*
-               Check with OSS to see if there have been any under/overruns
-               since last time we checked.
-               */
-            /*
-            if( ioctl( stream->deviceHandle, SNDCTL_DSP_GETERROR, &errinfo ) >= 0 )
-            {
-                if( errinfo.play_underruns )
-                    cbFlags |= paOutputUnderflow ;
-                if( errinfo.record_underruns )
-                    cbFlags |= paInputUnderflow ;
-            }
-            else
-                PA_DEBUG(( "SNDCTL_DSP_GETERROR command failed: %s\n", strerror( errno ) ));
-                */
+#ifdef SNDCTL_DSP_GETERROR
+            PaOssStream_CheckErrors( stream, &cbFlags );
 #endif
 
+            PaOssStream_CalculateTimeInfo( stream, stream->capture ? framesAvail : 0, &timeInfo );
             PaUtil_BeginBufferProcessing( &stream->bufferProcessor, &timeInfo,
                     cbFlags );
             cbFlags = 0;
             PA_ENSURE( SetUpBuffers( stream, framesAvail ) );
 
+            PaUtil_TraceBegin( paUtilTraceConvert );
             framesProcessed = PaUtil_EndBufferProcessing( &stream->bufferProcessor,
                     &callbackResult );
+            PaUtil_TraceEnd( paUtilTraceConvert );
             assert( framesProcessed == framesAvail );
             PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesProcessed );
+            PaUtil_EndStreamCallbackMeasurement( &stream->streamRepresentation );
 
             if ( stream->playback )
             {
                 frames = framesAvail;
 
+                PaUtil_TraceBegin( paUtilTraceCommit );
                 PA_ENSURE( PaOssStreamComponent_Write( stream->playback, &frames ) );
+                PaUtil_TraceEnd( paUtilTraceCommit );
                 if( frames < framesAvail )
                 {
                     /* TODO: handle bytesWritten != bytesRequested (slippage?) */
@@ -1809,7 +1930,19 @@ static PaError StartStream( PaStream *s )
     /* only use the thread for callback streams */
     if( stream->bufferProcessor.streamCallback )
     {
-        PA_ENSURE( PaUtil_StartThreading( &stream->threading, &PaOSS_AudioThreadProc, stream ) );
+        PaThreadConfiguration config;
+        PaThreadConfiguration *applied = &stream->streamRepresentation.threadConfiguration.applied;
+
+        if( PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation ) )
+            config = *PaUtil_GetStreamThreadConfiguration( &stream->streamRepresentation );
+        else
+            memset( &config, 0, sizeof (config) );
+
+        PA_ENSURE( PaUnixThread_Create( &stream->threading.callbackThread, &PaOSS_AudioThreadProc, stream,
+                    &config, applied ) );
+        /* the thread is running, carry on with whatever could be applied */
+        if( PaUnixThread_Configure( stream->threading.callbackThread, &config, applied ) != paNoError )
+            PA_DEBUG(( "%s: Failed configuring the callback thread\n", __FUNCTION__ ));
         sem_wait( &stream->semaphore );
     }
     else
@@ -1893,13 +2026,13 @@ static PaTime GetStreamTime( PaStream *s )
     if( stream->playback ) {
         if( ioctl( stream->playback->fd, SNDCTL_DSP_GETOPTR, &info) == 0 ) {
             delta = ( info.bytes - stream->lastPosPtr ) /* & 0x000FFFFF*/;
-            return (float)(stream->lastStreamBytes + delta) / PaOssStreamComponent_FrameSize( stream->playback ) / stream->sampleRate;
+            return (stream->lastStreamBytes + delta) / PaOssStreamComponent_FrameSize( stream->playback ) / stream->sampleRate;
         }
     }
     else {
         if (ioctl( stream->capture->fd, SNDCTL_DSP_GETIPTR, &info) == 0) {
             delta = (info.bytes - stream->lastPosPtr) /*& 0x000FFFFF*/;
-            return (float)(stream->lastStreamBytes + delta) / PaOssStreamComponent_FrameSize( stream->capture ) / stream->sampleRate;
+            return (stream->lastStreamBytes + delta) / PaOssStreamComponent_FrameSize( stream->capture ) / stream->sampleRate;
         }
     }
 
@@ -2011,6 +2144,67 @@ error:
 }
 
 
+/** One descriptor per device, capture first. A full duplex device is polled for both directions
+ * through a single descriptor, since most event loops refuse the same fd twice.
+ */
+static int GetStreamPollDescriptors( PaStream* s, PaStreamPollDescriptor *descriptors, int maxDescriptors )
+{
+    PaOssStream *stream = (PaOssStream*)s;
+    int numFds = 0;
+
+    if( stream->capture )
+    {
+        if( numFds < maxDescriptors )
+        {
+            descriptors[numFds].fd = stream->capture->fd;
+            descriptors[numFds].events = POLLIN | ( stream->sharedDevice ? POLLOUT : 0 );
+            descriptors[numFds].revents = 0;
+        }
+        ++numFds;
+    }
+    if( stream->playback && !stream->sharedDevice )
+    {
+        if( numFds < maxDescriptors )
+        {
+            descriptors[numFds].fd = stream->playback->fd;
+            descriptors[numFds].events = POLLOUT;
+            descriptors[numFds].revents = 0;
+        }
+        ++numFds;
+    }
+
+    return numFds;
+}
+
+/** Errors are reported as readiness, so that the following read or write surfaces them. */
+static PaError ProcessStreamPollEvents( PaStream* s, const PaStreamPollDescriptor *descriptors, int numDescriptors,
+                                        int *ready )
+{
+    PaError result = paNoError;
+    PaOssStream *stream = (PaOssStream*)s;
+    int i = 0;
+
+    *ready = 0;
+    PA_UNLESS( numDescriptors == ( stream->capture != NULL ) + ( stream->playback && !stream->sharedDevice ), paBadBufferPtr );
+
+    if( stream->capture )
+    {
+        if( descriptors[i].revents & ( POLLIN | POLLERR ) )
+            *ready |= paStreamPollReadable;
+        if( stream->sharedDevice && ( descriptors[i].revents & ( POLLOUT | POLLERR ) ) )
+            *ready |= paStreamPollWritable;
+        ++i;
+    }
+    if( stream->playback && !stream->sharedDevice )
+    {
+        if( descriptors[i].revents & ( POLLOUT | POLLERR ) )
+            *ready |= paStreamPollWritable;
+    }
+
+error:
+    return result;
+}
+
 static signed long GetStreamReadAvailable( PaStream* s )
 {
     PaError result = paNoError;
@@ -4368,7 +4368,7 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
     }
 
     /* Create allocation group */
-    stream->allocGroup = PaUtil_CreateAllocationGroup();
+    stream->allocGroup = PaUtil_CreateAllocationGroupInCategory( paAllocationHostApi );
     if( !stream->allocGroup )
     {
         result = paInsufficientMemory;
@@ -40,16 +40,22 @@
 /** @file
  @ingroup unix_src
 */
- 
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* for pthread_setaffinity_np() */
+#endif
+
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <limits.h> /* For PTHREAD_STACK_MIN */
 #include <time.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <string.h> /* For memset */
 #include <math.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #if defined(__APPLE__) && !defined(HAVE_MACH_ABSOLUTE_TIME)
 #define HAVE_MACH_ABSOLUTE_TIME
@@ -58,27 +64,115 @@
 #include <mach/mach_time.h>
 #endif
 
+/* unnamed POSIX semaphores are not implemented on Mac OS X */
+#ifdef __APPLE__
+#include <mach/mach_init.h>
+#include <mach/semaphore.h>
+#include <mach/task.h>
+#else
+#include <semaphore.h>
+#endif
+
+/* PaUtil_GetTime() must not jump when the system time is set, so prefer the
+    raw monotonic clock (not slewed by NTP) and fall back to the monotonic one */
+#if defined(HAVE_CLOCK_GETTIME)
+#if defined(CLOCK_MONOTONIC_RAW)
+#define PA_UNIX_CLOCK_  CLOCK_MONOTONIC_RAW
+#elif defined(CLOCK_MONOTONIC)
+#define PA_UNIX_CLOCK_  CLOCK_MONOTONIC
+#else
+#define PA_UNIX_CLOCK_  CLOCK_REALTIME
+#endif
+#endif
+
+/* Timed condition waits take an absolute deadline on the clock the condition
+    was initialized with. CLOCK_MONOTONIC_RAW is not accepted there. */
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
+#define PA_UNIX_CONDITION_CLOCK_    CLOCK_MONOTONIC
+#endif
+
+/* Build with PA_ENABLE_TSC_CLOCK defined to read the invariant time stamp
+    counter in PaUtil_GetMeasurementTime(), see PaUtil_InitializeClock() */
+#if defined(PA_ENABLE_TSC_CLOCK) && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) \
+        && !defined(HAVE_MACH_ABSOLUTE_TIME)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define PA_UNIX_TSC_CLOCK_
+#endif
+
+/* Thread CPU affinity, see PaUnixThread_Configure() */
+#if defined(__linux__) && defined(CPU_SET)
+#define PA_UNIX_THREAD_AFFINITY_
+#endif
+
+/* SCHED_DEADLINE is only reachable through the sched_setattr system call, see
+    PaUnixThread_ConfigureDeadline() */
+#if defined(__linux__)
+#include <stdint.h>
+#include <sys/syscall.h>
+#if defined(SYS_sched_setattr)
+#define PA_UNIX_SCHED_DEADLINE_
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE  6
+#endif
+
+/* struct sched_attr of the kernel ABI */
+typedef struct
+{
+    uint32_t size;
+    uint32_t schedPolicy;
+    uint64_t schedFlags;
+    int32_t schedNice;
+    uint32_t schedPriority;
+    uint64_t schedRuntime;
+    uint64_t schedDeadline;
+    uint64_t schedPeriod;
+} PaUnixSchedAttr;
+#endif
+#endif
+
+/* The fraction of the period reserved by paThreadPolicyDeadline when none is configured */
+#define PA_UNIX_DEFAULT_DEADLINE_RUNTIME_   (0.5)
+
+/* The watchdog samples the CPU time of the thread it monitors, see PaUnixThread_StartWatchdog() */
+#if defined(HAVE_CLOCK_GETTIME) && defined(_POSIX_THREAD_CPUTIME) && (_POSIX_THREAD_CPUTIME >= 0)
+#define PA_UNIX_WATCHDOG_
+#endif
+
+#define PA_UNIX_WATCHDOG_INTERVAL_              (0.1)   /* seconds between samples */
+#define PA_UNIX_WATCHDOG_CPU_LIMIT_             (0.9)   /* fraction of a CPU a real-time thread may use... */
+#define PA_UNIX_WATCHDOG_SUSTAIN_TIME_          (1.0)   /* ...on average over this long before it is demoted */
+#define PA_UNIX_WATCHDOG_MIN_THROTTLE_TIME_     (0.25)  /* time spent demoted, doubled for repeat offences */
+#define PA_UNIX_WATCHDOG_MAX_THROTTLE_TIME_     (4.0)
+
 #include "pa_util.h"
 #include "pa_unix_util.h"
+#include "pa_stream.h"
 #include "pa_debugprint.h"
 
 /*
-   Track memory allocations to avoid leaks.
+   Allocations carry a PaUtilAllocationHeader so they can be accounted for
+   by category. See PaUtil_AccountAllocation() in pa_front.c.
  */
 
-#if PA_TRACK_MEMORY
-static int numAllocations_ = 0;
-#endif
+void *PaUtil_AllocateMemoryInCategory( long size, PaAllocationCategory category )
+{
+    PaUtilAllocationHeader *header = (PaUtilAllocationHeader*)malloc( size + sizeof(PaUtilAllocationHeader) );
+
+    if( header == NULL )
+        return NULL;
+
+    header->info.size = size;
+    header->info.category = category;
+    PaUtil_AccountAllocation( category, size );
+
+    return header + 1;
+}
 
 
 void *PaUtil_AllocateMemory( long size )
 {
-    void *result = malloc( size );
-
-#if PA_TRACK_MEMORY
-    if( result != NULL ) numAllocations_ += 1;
-#endif
-    return result;
+    return PaUtil_AllocateMemoryInCategory( size, paAllocationHostApi );
 }
 
 
@@ -86,21 +180,200 @@ void PaUtil_FreeMemory( void *block )
 {
     if( block != NULL )
     {
-        free( block );
-#if PA_TRACK_MEMORY
-        numAllocations_ -= 1;
+        PaUtilAllocationHeader *header = ((PaUtilAllocationHeader*)block) - 1;
+
+        PaUtil_AccountFree( header->info.category, header->info.size );
+        free( header );
+    }
+}
+
+
+#if defined _POSIX_MEMLOCK_RANGE && (_POSIX_MEMLOCK_RANGE != -1)
+/*
+   mlock() works on whole pages and is not reference counted, so blocks that
+   share a page cannot simply be munlock()ed one by one. Every successfully
+   locked block is recorded, and unlocking a block only releases the pages
+   that no other recorded block covers.
+
+   Stacks are locked by the threads themselves, which may be real-time
+   threads, so room for their records is reserved up front by
+   PaUnixThread_ReserveStackLock() and recording them never allocates.
+ */
+typedef struct PaUtilLockedBlock
+{
+    void *block;
+    long size;
+    char *firstPage, *endPage;  /* the page aligned range mlock() applies to */
+    int reserved;               /* recorded in a slot reserved for a stack */
+}
+PaUtilLockedBlock;
+
+static pthread_mutex_t lockedBlocksMutex_ = PTHREAD_MUTEX_INITIALIZER;
+static PaUtilLockedBlock *lockedBlocks_ = NULL;
+static int lockedBlockCount_ = 0;
+static int lockedBlockCapacity_ = 0;
+static int reservedBlockCount_ = 0;     /* slots reserved for stacks */
+static int reservedBlocksInUse_ = 0;    /* reserved slots holding a locked stack */
+
+/* Make room for another record besides those still reserved */
+static PaError GrowLockedBlocks( void )
+{
+    int needed = lockedBlockCount_ + (reservedBlockCount_ - reservedBlocksInUse_) + 1;
+    int capacity = lockedBlockCapacity_ ? lockedBlockCapacity_ : 16;
+    PaUtilLockedBlock *blocks;
+
+    if( needed <= lockedBlockCapacity_ )
+        return paNoError;
+    while( capacity < needed )
+        capacity *= 2;
+    blocks = (PaUtilLockedBlock*)PaUtil_AllocateMemory( capacity * sizeof (PaUtilLockedBlock) );
+    if( blocks == NULL )
+        return paInsufficientMemory;
+    if( lockedBlocks_ )
+    {
+        memcpy( blocks, lockedBlocks_, lockedBlockCount_ * sizeof (PaUtilLockedBlock) );
+        PaUtil_FreeMemory( lockedBlocks_ );
+    }
+    lockedBlocks_ = blocks;
+    lockedBlockCapacity_ = capacity;
+    return paNoError;
+}
+
+static int IsPageLocked( const char *page )
+{
+    int i;
+
+    for( i = 0; i < lockedBlockCount_; ++i )
+    {
+        if( page >= lockedBlocks_[i].firstPage && page < lockedBlocks_[i].endPage )
+            return 1;
+    }
+    return 0;
+}
+
+static void FreeLockedBlocksIfUnused( void )
+{
+    if( lockedBlockCount_ == 0 && reservedBlockCount_ == 0 )
+    {
+        PaUtil_FreeMemory( lockedBlocks_ );
+        lockedBlocks_ = NULL;
+        lockedBlockCapacity_ = 0;
+    }
+}
 #endif
 
+
+static long GetPageSize( void )
+{
+    long pageSize = sysconf( _SC_PAGESIZE );
+    return pageSize > 0 ? pageSize : 4096;
+}
+
+
+/* Lock a block, recording it in a reserved slot if useReservation is set and one is free */
+static PaError LockMemory( void *block, long size, int useReservation )
+{
+    volatile unsigned char *p = (volatile unsigned char *)block;
+    long pageSize = GetPageSize();
+    long i;
+
+    if( block == NULL || size <= 0 )
+        return paNoError;
+
+    /* Write to each page so that copy-on-write and zero pages are replaced by real ones */
+    for( i = 0; i < size; i += pageSize )
+        p[i] = p[i];
+    p[size - 1] = p[size - 1];
+
+#if defined _POSIX_MEMLOCK_RANGE && (_POSIX_MEMLOCK_RANGE != -1)
+    {
+        PaError result = paNoError;
+        PaUtilLockedBlock *locked;
+
+        pthread_mutex_lock( &lockedBlocksMutex_ );
+        /* A free reserved slot means there is room without growing */
+        useReservation = useReservation && reservedBlocksInUse_ < reservedBlockCount_;
+        if( !useReservation )
+            result = GrowLockedBlocks();
+        if( result == paNoError && mlock( block, size ) != 0 )
+        {
+            PA_DEBUG(( "%s: Failed locking %ld bytes: %s\n", __FUNCTION__, size, strerror( errno ) ));
+            result = paInsufficientMemory;
+        }
+        if( result == paNoError )
+        {
+            locked = &lockedBlocks_[ lockedBlockCount_++ ];
+            locked->block = block;
+            locked->size = size;
+            locked->firstPage = (char*)block - (size_t)block % pageSize;
+            locked->endPage = (char*)block + size + ( pageSize - ((size_t)block + size) % pageSize ) % pageSize;
+            locked->reserved = useReservation;
+            if( useReservation )
+                ++reservedBlocksInUse_;
+        }
+        pthread_mutex_unlock( &lockedBlocksMutex_ );
+        return result;
     }
+#else
+    (void)useReservation;
+    return paInsufficientMemory;
+#endif
 }
 
 
-int PaUtil_CountCurrentlyAllocatedBlocks( void )
+PaError PaUtil_LockMemory( void *block, long size )
 {
-#if PA_TRACK_MEMORY
-    return numAllocations_;
+    return LockMemory( block, size, 0 );
+}
+
+
+void PaUtil_UnlockMemory( void *block, long size )
+{
+#if defined _POSIX_MEMLOCK_RANGE && (_POSIX_MEMLOCK_RANGE != -1)
+    long pageSize = GetPageSize();
+    PaUtilLockedBlock unlocked;
+    char *page, *run = NULL;
+    int i;
+
+    if( block == NULL || size <= 0 )
+        return;
+
+    pthread_mutex_lock( &lockedBlocksMutex_ );
+    for( i = 0; i < lockedBlockCount_; ++i )
+    {
+        if( lockedBlocks_[i].block == block && lockedBlocks_[i].size == size )
+            break;
+    }
+    if( i == lockedBlockCount_ ) /* never locked, or locking failed */
+    {
+        pthread_mutex_unlock( &lockedBlocksMutex_ );
+        return;
+    }
+    unlocked = lockedBlocks_[i];
+    lockedBlocks_[i] = lockedBlocks_[ --lockedBlockCount_ ];
+    if( unlocked.reserved )
+        --reservedBlocksInUse_;
+
+    /* Release runs of pages that are not part of any other locked block */
+    for( page = unlocked.firstPage; page <= unlocked.endPage; page += pageSize )
+    {
+        if( page < unlocked.endPage && !IsPageLocked( page ) )
+        {
+            if( !run )
+                run = page;
+        }
+        else if( run )
+        {
+            munlock( run, page - run );
+            run = NULL;
+        }
+    }
+
+    FreeLockedBlocksIfUnused();
+    pthread_mutex_unlock( &lockedBlocksMutex_ );
 #else
-    return 0;
+    (void)block;
+    (void)size;
 #endif
 }
 
@@ -143,6 +416,52 @@ void Pa_Sleep( long msec )
 static double machSecondsConversionScaler_ = 0.0; 
 #endif
 
+#ifdef PA_UNIX_TSC_CLOCK_
+/*
+    The time stamp counter is only used when the CPU reports it as invariant,
+    i.e. it ticks at a constant rate regardless of frequency scaling and
+    sleep states and is synchronized across cores. Its rate is calibrated
+    against PaUtil_GetTime() by busy waiting for a couple of milliseconds.
+*/
+
+#define PA_TSC_CALIBRATION_SECONDS_     (0.002)
+
+/* Scaler to convert the time stamp counter to seconds, zero when it is not used */
+static double tscSecondsConversionScaler_ = 0.0;
+
+static int HasInvariantTsc( void )
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if( !__get_cpuid( 0x80000000, &eax, &ebx, &ecx, &edx ) || eax < 0x80000007 )
+        return 0;
+
+    __cpuid( 0x80000007, eax, ebx, ecx, edx );
+    return (edx >> 8) & 1;
+}
+
+static void CalibrateTsc( void )
+{
+    PaTime startTime, endTime;
+    unsigned long long startTicks, endTicks;
+
+    tscSecondsConversionScaler_ = 0.0;
+    if( !HasInvariantTsc() )
+        return;
+
+    startTime = PaUtil_GetTime();
+    startTicks = __rdtsc();
+    do
+    {
+        endTime = PaUtil_GetTime();
+    } while( endTime - startTime < PA_TSC_CALIBRATION_SECONDS_ );
+    endTicks = __rdtsc();
+
+    if( endTicks > startTicks )
+        tscSecondsConversionScaler_ = (endTime - startTime) / (double)(endTicks - startTicks);
+}
+#endif /* PA_UNIX_TSC_CLOCK_ */
+
 void PaUtil_InitializeClock( void )
 {
 #ifdef HAVE_MACH_ABSOLUTE_TIME
@@ -151,6 +470,9 @@ void PaUtil_InitializeClock( void )
     if( err == 0  )
         machSecondsConversionScaler_ = 1e-9 * (double) info.numer / (double) info.denom;
 #endif
+#ifdef PA_UNIX_TSC_CLOCK_
+    CalibrateTsc();
+#endif
 }
 
 
@@ -160,7 +482,7 @@ PaTime PaUtil_GetTime( void )
     return mach_absolute_time() * machSecondsConversionScaler_;
 #elif defined(HAVE_CLOCK_GETTIME)
     struct timespec tp;
-    clock_gettime(CLOCK_REALTIME, &tp);
+    clock_gettime(PA_UNIX_CLOCK_, &tp);
     return (PaTime)(tp.tv_sec + tp.tv_nsec * 1e-9);
 #else
     struct timeval tv;
@@ -169,6 +491,119 @@ PaTime PaUtil_GetTime( void )
 #endif
 }
 
+PaTime PaUtil_GetMeasurementTime( void )
+{
+#ifdef PA_UNIX_TSC_CLOCK_
+    if( tscSecondsConversionScaler_ > 0.0 )
+        return __rdtsc() * tscSecondsConversionScaler_;
+#endif
+    return PaUtil_GetTime();
+}
+
+double PaUtil_GetThreadCpuTime( void )
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec tp;
+    if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &tp ) == 0 )
+        return (double)(tp.tv_sec + tp.tv_nsec * 1e-9);
+#endif
+    return -1.;
+}
+
+struct PaUtilNotifier
+{
+    pthread_t thread;
+#ifdef __APPLE__
+    semaphore_t semaphore;
+#else
+    sem_t semaphore;
+#endif
+    volatile int quit;
+    void (*function)( void *userData );
+    void *userData;
+};
+
+static void *NotifierThreadFunc( void *data )
+{
+    PaUtilNotifier *notifier = (PaUtilNotifier*)data;
+
+    for( ;; )
+    {
+#ifdef __APPLE__
+        if( semaphore_wait( notifier->semaphore ) != KERN_SUCCESS )
+            continue;
+#else
+        if( sem_wait( &notifier->semaphore ) != 0 )
+            continue; /* EINTR */
+#endif
+        if( notifier->quit )
+            break;
+        notifier->function( notifier->userData );
+    }
+    return NULL;
+}
+
+PaError PaUtil_CreateNotifier( PaUtilNotifier **notifier,
+        void (*function)( void *userData ), void *userData )
+{
+    PaError result = paNoError;
+    PaUtilNotifier *self;
+    int semaphoreCreated = 0;
+
+    PA_UNLESS( self = (PaUtilNotifier*)PaUtil_AllocateMemory( sizeof(PaUtilNotifier) ), paInsufficientMemory );
+    self->quit = 0;
+    self->function = function;
+    self->userData = userData;
+
+#ifdef __APPLE__
+    PA_UNLESS( semaphore_create( mach_task_self(), &self->semaphore, SYNC_POLICY_FIFO, 0 ) == KERN_SUCCESS,
+            paUnanticipatedHostError );
+#else
+    PA_UNLESS( sem_init( &self->semaphore, 0, 0 ) == 0, paUnanticipatedHostError );
+#endif
+    semaphoreCreated = 1;
+
+    PA_UNLESS( pthread_create( &self->thread, NULL, NotifierThreadFunc, self ) == 0, paUnanticipatedHostError );
+
+    *notifier = self;
+    return result;
+
+error:
+    if( semaphoreCreated )
+    {
+#ifdef __APPLE__
+        semaphore_destroy( mach_task_self(), self->semaphore );
+#else
+        sem_destroy( &self->semaphore );
+#endif
+    }
+    PaUtil_FreeMemory( self );
+    return result;
+}
+
+void PaUtil_SignalNotifier( PaUtilNotifier *notifier )
+{
+#ifdef __APPLE__
+    semaphore_signal( notifier->semaphore );
+#else
+    sem_post( &notifier->semaphore );
+#endif
+}
+
+void PaUtil_DestroyNotifier( PaUtilNotifier *notifier )
+{
+    notifier->quit = 1;
+    PaUtil_SignalNotifier( notifier );
+    pthread_join( notifier->thread, NULL );
+
+#ifdef __APPLE__
+    semaphore_destroy( mach_task_self(), notifier->semaphore );
+#else
+    sem_destroy( &notifier->semaphore );
+#endif
+    PaUtil_FreeMemory( notifier );
+}
+
 PaError PaUtil_InitializeThreading( PaUtilThreading *threading )
 {
     (void) paUtilErr_;
@@ -242,39 +677,243 @@ PaError PaUnixThreading_Initialize()
     return paNoError;
 }
 
-static PaError BoostPriority( PaUnixThread* self )
+static int PolicyToSched( PaThreadSchedulingPolicy policy )
+{
+    switch( policy )
+    {
+    case paThreadPolicyOther:
+        return SCHED_OTHER;
+    case paThreadPolicyRoundRobin:
+        return SCHED_RR;
+    default:
+        /* there is no portable SCHED_DEADLINE, fall back to FIFO */
+        return SCHED_FIFO;
+    }
+}
+
+static PaThreadSchedulingPolicy SchedToPolicy( int policy )
+{
+    switch( policy )
+    {
+    case SCHED_FIFO:
+        return paThreadPolicyFifo;
+    case SCHED_RR:
+        return paThreadPolicyRoundRobin;
+#ifdef PA_UNIX_SCHED_DEADLINE_
+    case SCHED_DEADLINE:
+        return paThreadPolicyDeadline;
+#endif
+    default:
+        return paThreadPolicyOther;
+    }
+}
+
+static int HasCpuAffinity( const PaThreadConfiguration *config )
+{
+    int i;
+    for( i = 0; i < paMaxThreadAffinityCpus / 8; ++i )
+    {
+        if( config->cpuAffinity[i] )
+            return 1;
+    }
+    return 0;
+}
+
+/** Fill in the CPU affinity the system reports for a thread. */
+static void GetThreadAffinity( pthread_t thread, PaThreadConfiguration *applied )
+{
+    memset( applied->cpuAffinity, 0, sizeof (applied->cpuAffinity) );
+#ifdef PA_UNIX_THREAD_AFFINITY_
+    {
+        cpu_set_t cpus;
+        int cpu;
+
+        CPU_ZERO( &cpus );
+        if( pthread_getaffinity_np( thread, sizeof (cpus), &cpus ) == 0 )
+        {
+            for( cpu = 0; cpu < paMaxThreadAffinityCpus && cpu < CPU_SETSIZE; ++cpu )
+            {
+                if( CPU_ISSET( cpu, &cpus ) )
+                    applied->cpuAffinity[cpu / 8] |= (unsigned char)(1 << (cpu % 8));
+            }
+        }
+    }
+#endif
+}
+
+/** Fill in the scheduling and affinity the system reports for a thread. */
+static void GetThreadConfiguration( pthread_t thread, PaThreadConfiguration *applied )
 {
-    PaError result = paNoError;
     struct sched_param spm = { 0 };
-    /* Priority should only matter between contending FIFO threads? */
-    spm.sched_priority = 1;
+    int policy;
 
-    assert( self );
+    applied->structVersion = 1;
+    if( pthread_getschedparam( thread, &policy, &spm ) == 0 )
+    {
+        applied->policy = SchedToPolicy( policy );
+        applied->priority = spm.sched_priority;
+    }
+    applied->deadlineRuntime = 0.;
+    GetThreadAffinity( thread, applied );
+}
+
+PaError PaUnixThread_Create( pthread_t *thread, void* (*threadFunc)( void* ), void* threadArg,
+        const PaThreadConfiguration *config, PaThreadConfiguration *applied )
+{
+    PaError result = paNoError;
+    pthread_attr_t attr;
+    size_t stackSize = 0;
 
-    if( pthread_setschedparam( self->thread, SCHED_FIFO, &spm ) != 0 )
+    PA_UNLESS( !pthread_attr_init( &attr ), paInternalError );
+    /* Priority relative to other processes */
+    if( pthread_attr_setscope( &attr, PTHREAD_SCOPE_SYSTEM ) != 0 )
     {
-        PA_UNLESS( errno == EPERM, paInternalError );  /* Lack permission to raise priority */
-        PA_DEBUG(( "Failed bumping priority\n" ));
-        result = 0;
+        pthread_attr_destroy( &attr );
+        PA_ENSURE( paInternalError );
     }
-    else
+
+    if( config && config->stackSize > 0 )
+    {
+        /* leave room for the locked stack of paLockMemory streams */
+        stackSize = PA_MAX( config->stackSize, PTHREAD_STACK_MIN + PA_UNIX_LOCKED_STACK_SIZE );
+        if( pthread_attr_setstacksize( &attr, stackSize ) != 0 )
+            PA_DEBUG(( "%s: Failed setting stack size %lu\n", __FUNCTION__, (unsigned long) stackSize ));
+    }
+    pthread_attr_getstacksize( &attr, &stackSize );
+
+    if( pthread_create( thread, &attr, threadFunc, threadArg ) != 0 )
+    {
+        pthread_attr_destroy( &attr );
+        PA_ENSURE( paInternalError );
+    }
+    pthread_attr_destroy( &attr );
+
+    if( applied )
+        applied->stackSize = (unsigned long) stackSize;
+
+error:
+    return result;
+}
+
+PaError PaUnixThread_Configure( pthread_t thread, const PaThreadConfiguration *config,
+        PaThreadConfiguration *applied )
+{
+    PaError result = paNoError;
+    int err;
+
+    /* The thread switches itself to SCHED_DEADLINE, which does not admit threads with restricted affinity,
+        and reports the outcome */
+    if( config->policy == paThreadPolicyDeadline )
+        return result;
+
+    if( config->policy != paThreadPolicyDefault )
+    {
+        struct sched_param spm = { 0 };
+        int policy = PolicyToSched( config->policy );
+
+        if( policy != SCHED_OTHER )
+        {
+            spm.sched_priority = PA_MIN( PA_MAX( config->priority, sched_get_priority_min( policy ) ),
+                    sched_get_priority_max( policy ) );
+        }
+        if( (err = pthread_setschedparam( thread, policy, &spm )) != 0 )
+        {
+            PA_UNLESS( err == EPERM, paInternalError );  /* Lack permission to raise priority */
+            PA_DEBUG(( "%s: Failed setting scheduling policy %d, priority %d\n", __FUNCTION__,
+                    policy, spm.sched_priority ));
+        }
+    }
+
+    if( HasCpuAffinity( config ) )
     {
-        result = 1; /* Success */
+#ifdef PA_UNIX_THREAD_AFFINITY_
+        cpu_set_t cpus;
+        int cpu;
+
+        CPU_ZERO( &cpus );
+        for( cpu = 0; cpu < paMaxThreadAffinityCpus && cpu < CPU_SETSIZE; ++cpu )
+        {
+            if( config->cpuAffinity[cpu / 8] & (1 << (cpu % 8)) )
+                CPU_SET( cpu, &cpus );
+        }
+        if( (err = pthread_setaffinity_np( thread, sizeof (cpus), &cpus )) != 0 )
+        {
+            /* EINVAL: none of the CPUs are online or allowed by the process' cpuset */
+            PA_UNLESS( err == EINVAL || err == EPERM, paInternalError );
+            PA_DEBUG(( "%s: Failed setting CPU affinity\n", __FUNCTION__ ));
+        }
+#else
+        PA_DEBUG(( "%s: CPU affinity is not supported on this platform\n", __FUNCTION__ ));
+#endif
+    }
+
+    if( applied )
+        GetThreadConfiguration( thread, applied );
+
+error:
+    return result;
+}
+
+PaError PaUnixThread_ConfigureDeadline( const PaThreadConfiguration *config, PaTime period,
+        PaThreadConfiguration *applied )
+{
+    PaError result = paNoError;
+    PaThreadConfiguration fallback;
+
+    if( !config || config->policy != paThreadPolicyDeadline )
+        return result;
+
+#ifdef PA_UNIX_SCHED_DEADLINE_
+    {
+        PaUnixSchedAttr attr;
+        double runtime = config->deadlineRuntime > 0. ? config->deadlineRuntime : PA_UNIX_DEFAULT_DEADLINE_RUNTIME_;
+
+        memset( &attr, 0, sizeof (attr) );
+        attr.size = sizeof (attr);
+        attr.schedPolicy = SCHED_DEADLINE;
+        attr.schedPeriod = (uint64_t)( period * 1e9 );
+        attr.schedDeadline = attr.schedPeriod;
+        attr.schedRuntime = (uint64_t)( period * runtime * 1e9 );
+
+        if( syscall( SYS_sched_setattr, 0, &attr, 0 ) == 0 )
+        {
+            PA_DEBUG(( "%s: SCHED_DEADLINE runtime %g us every %g us\n", __FUNCTION__,
+                    attr.schedRuntime / 1e3, attr.schedPeriod / 1e3 ));
+            /* pthread_getschedparam() may return a policy cached by the C library, so report directly */
+            if( applied )
+            {
+                applied->structVersion = 1;
+                applied->policy = paThreadPolicyDeadline;
+                applied->priority = 0;
+                applied->deadlineRuntime = runtime;
+                GetThreadAffinity( pthread_self(), applied );
+            }
+            return result;
+        }
+        /* EPERM: no privilege or restricted affinity, EBUSY: admission control refused the bandwidth */
+        PA_DEBUG(( "%s: SCHED_DEADLINE refused (%s), falling back to SCHED_FIFO\n", __FUNCTION__,
+                strerror( errno ) ));
     }
+#endif
+
+    fallback = *config;
+    fallback.policy = paThreadPolicyFifo;
+    PA_ENSURE( PaUnixThread_Configure( pthread_self(), &fallback, applied ) );
+
 error:
     return result;
 }
 
 PaError PaUnixThread_New( PaUnixThread* self, void* (*threadFunc)( void* ), void* threadArg, PaTime waitForChild,
-        int rtSched )
+        int rtSched, const PaThreadConfiguration *config )
 {
     PaError result = paNoError;
-    pthread_attr_t attr;
+    PaThreadConfiguration effective;
     int started = 0;
 
     memset( self, 0, sizeof (PaUnixThread) );
     PaUnixMutex_Initialize( &self->mtx );
-    PA_ASSERT_CALL( pthread_cond_init( &self->cond, NULL ), 0 );
+    PA_ENSURE( PaUnixCondition_Initialize( &self->cond ) );
 
     self->parentWaiting = 0 != waitForChild;
 
@@ -298,62 +937,24 @@ PaError PaUnixThread_New( PaUnixThread* self, void* (*threadFunc)( void* ), void
 #endif
 #endif
 
-    PA_UNLESS( !pthread_attr_init( &attr ), paInternalError );
-    /* Priority relative to other processes */
-    PA_UNLESS( !pthread_attr_setscope( &attr, PTHREAD_SCOPE_SYSTEM ), paInternalError );   
+    if( config )
+        effective = *config;
+    else
+        memset( &effective, 0, sizeof (effective) );
+    if( effective.policy == paThreadPolicyDefault && rtSched )
+    {
+        /* Priority should only matter between contending FIFO threads? */
+        effective.policy = paThreadPolicyFifo;
+        effective.priority = 1;
+    }
 
-    PA_UNLESS( !pthread_create( &self->thread, &attr, threadFunc, threadArg ), paInternalError );
+    PA_ENSURE( PaUnixThread_Create( &self->thread, threadFunc, threadArg, &effective, &self->configuration ) );
     started = 1;
 
-    if( rtSched )
-    {
-#if 0
-        if( self->useWatchdog )
-        {
-            int err;
-            struct sched_param wdSpm = { 0 };
-            /* Launch watchdog, watchdog sets callback thread priority */
-            int prio = PA_MIN( self->rtPrio + 4, sched_get_priority_max( SCHED_FIFO ) );
-            wdSpm.sched_priority = prio;
-
-            PA_UNLESS( !pthread_attr_init( &attr ), paInternalError );
-            PA_UNLESS( !pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED ), paInternalError );
-            PA_UNLESS( !pthread_attr_setscope( &attr, PTHREAD_SCOPE_SYSTEM ), paInternalError );
-            PA_UNLESS( !pthread_attr_setschedpolicy( &attr, SCHED_FIFO ), paInternalError );
-            PA_UNLESS( !pthread_attr_setschedparam( &attr, &wdSpm ), paInternalError );
-            if( (err = pthread_create( &self->watchdogThread, &attr, &WatchdogFunc, self )) )
-            {
-                PA_UNLESS( err == EPERM, paInternalError );
-                /* Permission error, go on without realtime privileges */
-                PA_DEBUG(( "Failed bumping priority\n" ));
-            }
-            else
-            {
-                int policy;
-                self->watchdogRunning = 1;
-                PA_ENSURE_SYSTEM( pthread_getschedparam( self->watchdogThread, &policy, &wdSpm ), 0 );
-                /* Check if priority is right, policy could potentially differ from SCHED_FIFO (but that's alright) */
-                if( wdSpm.sched_priority != prio )
-                {
-                    PA_DEBUG(( "Watchdog priority not set correctly (%d)\n", wdSpm.sched_priority ));
-                    PA_ENSURE( paInternalError );
-                }
-            }
-        }
-        else
-#endif
-            PA_ENSURE( BoostPriority( self ) );
-
-        {
-            int policy;
-            struct sched_param spm;
-            pthread_getschedparam(self->thread, &policy, &spm);
-        }
-    }
+    PA_ENSURE( PaUnixThread_Configure( self->thread, &effective, &self->configuration ) );
     
     if( self->parentWaiting )
     {
-        PaTime till;
         struct timespec ts;
         int res = 0;
         PaTime now;
@@ -362,14 +963,13 @@ PaError PaUnixThread_New( PaUnixThread* self, void* (*threadFunc)( void* ), void
 
         /* Wait for stream to be started */
         now = PaUtil_GetTime();
-        till = now + waitForChild;
+        (void) now; /* only used for debug output */
+        PaUnixCondition_GetDeadline( waitForChild, &ts );
 
         while( self->parentWaiting && !res )
         {
             if( waitForChild > 0 )
             {
-                ts.tv_sec = (time_t) floor( till );
-                ts.tv_nsec = (long) ((till - floor( till )) * 1e9);
                 res = pthread_cond_timedwait( &self->cond, &self->mtx.mtx, &ts );
             }
             else
@@ -408,23 +1008,10 @@ PaError PaUnixThread_Terminate( PaUnixThread* self, int wait, PaError* exitResul
     {
         *exitResult = paNoError;
     }
-#if 0
-    if( watchdogExitResult )
-        *watchdogExitResult = paNoError;
-
-    if( th->watchdogRunning )
-    {
-        pthread_cancel( th->watchdogThread );
-        PA_ENSURE_SYSTEM( pthread_join( th->watchdogThread, &pret ), 0 );
 
-        if( pret && pret != PTHREAD_CANCELED )
-        {
-            if( watchdogExitResult )
-                *watchdogExitResult = *(PaError *) pret;
-            free( pret );
-        }
-    }
-#endif
+    /* The thread must be joined regardless, a watchdog that won't stop cleanly is only worth a note */
+    if( PaUnixThread_StopWatchdog( self ) != paNoError )
+        PA_DEBUG(( "%s: Failed stopping the watchdog, joining the thread anyway\n", __FUNCTION__ ));
 
     /* Only kill the thread if it isn't in the process of stopping (flushing adaptation buffers) */
     /* TODO: Make join time out */
@@ -497,6 +1084,210 @@ int PaUnixThread_StopRequested( PaUnixThread* self )
     return self->stopRequested;
 }
 
+#ifdef PA_UNIX_WATCHDOG_
+/* Negative once the thread has exited and its clock is gone */
+static double GetThreadCpuTime( clockid_t clock )
+{
+    struct timespec ts;
+    if( clock_gettime( clock, &ts ) != 0 )
+        return -1.;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Monitor the CPU usage of a real-time thread.
+ *
+ * A thread which uses more than PA_UNIX_WATCHDOG_CPU_LIMIT_ of a CPU, averaged over
+ * PA_UNIX_WATCHDOG_SUSTAIN_TIME_, is most likely stuck in a loop, and at real-time priority it starves everything else on its CPU. Such a
+ * thread is demoted to SCHED_OTHER for a while and then restored. If it runs away again soon after being
+ * restored the time it spends demoted is doubled, up to PA_UNIX_WATCHDOG_MAX_THROTTLE_TIME_.
+ */
+static void *WatchdogFunc( void *userData )
+{
+    PaUnixThread *self = (PaUnixThread *) userData;
+    PaTime timeThen = PaUtil_GetTime(), timeNow, throttleStart = 0., restoreTime = -PA_UNIX_WATCHDOG_MAX_THROTTLE_TIME_;
+    PaTime throttleTime = PA_UNIX_WATCHDOG_MIN_THROTTLE_TIME_;
+    double cpuTimeThen = GetThreadCpuTime( self->watchdogClock ), cpuTimeNow, cpuLoad;
+    struct sched_param savedSpm = { 0 }, normalSpm = { 0 };
+    int savedPolicy = SCHED_OTHER, throttled = 0;
+    struct timespec deadline;
+
+    PaUnixMutex_Lock( &self->mtx );
+    while( !self->watchdogStopRequested && cpuTimeThen >= 0. )
+    {
+        PaUnixCondition_GetDeadline( PA_UNIX_WATCHDOG_INTERVAL_, &deadline );
+        pthread_cond_timedwait( &self->watchdogCond, &self->mtx.mtx, &deadline );
+        if( self->watchdogStopRequested )
+            break;
+
+        timeNow = PaUtil_GetTime();
+
+        if( !throttled )
+        {
+            /* average over the whole window, short dips (e.g. the kernel's own real-time throttling) don't count */
+            if( timeNow - timeThen < PA_UNIX_WATCHDOG_SUSTAIN_TIME_ )
+                continue;
+            cpuTimeNow = GetThreadCpuTime( self->watchdogClock );
+            if( cpuTimeNow < 0. )
+            {
+                PA_DEBUG(( "%s: Audio thread's CPU clock is gone, stopping\n", __FUNCTION__ ));
+                break;
+            }
+            cpuLoad = (cpuTimeNow - cpuTimeThen) / (timeNow - timeThen);
+            timeThen = timeNow;
+            cpuTimeThen = cpuTimeNow;
+            if( cpuLoad <= PA_UNIX_WATCHDOG_CPU_LIMIT_ )
+                continue;
+
+            /* the policy may have been changed by someone else in the meantime */
+            if( pthread_getschedparam( self->thread, &savedPolicy, &savedSpm ) != 0 || savedPolicy == SCHED_OTHER )
+                continue;
+            if( pthread_setschedparam( self->thread, SCHED_OTHER, &normalSpm ) != 0 )
+            {
+                PA_DEBUG(( "%s: Couldn't lower priority of audio thread: %s\n", __FUNCTION__, strerror( errno ) ));
+                continue;
+            }
+
+            if( timeNow - restoreTime < PA_UNIX_WATCHDOG_MAX_THROTTLE_TIME_ )
+                throttleTime = PA_MIN( throttleTime * 2, PA_UNIX_WATCHDOG_MAX_THROTTLE_TIME_ );
+            else
+                throttleTime = PA_UNIX_WATCHDOG_MIN_THROTTLE_TIME_;
+            throttled = 1;
+            throttleStart = timeNow;
+            PA_DEBUG(( "%s: Audio thread used %g of a CPU, throttling it for %g seconds\n", __FUNCTION__,
+                    cpuLoad, throttleTime ));
+            PaUtil_RecordStreamThrottle( self->watchdogStream, 1, 0. );
+        }
+        else if( timeNow - throttleStart >= throttleTime )
+        {
+            if( pthread_setschedparam( self->thread, savedPolicy, &savedSpm ) != 0 )
+                PA_DEBUG(( "%s: Couldn't raise priority of audio thread: %s\n", __FUNCTION__, strerror( errno ) ));
+            throttled = 0;
+            restoreTime = timeNow;
+            timeThen = timeNow;
+            cpuTimeThen = GetThreadCpuTime( self->watchdogClock );
+            PaUtil_RecordStreamThrottle( self->watchdogStream, 0, timeNow - throttleStart );
+        }
+    }
+
+    if( throttled )
+    {
+        pthread_setschedparam( self->thread, savedPolicy, &savedSpm );
+        PaUtil_RecordStreamThrottle( self->watchdogStream, 0, PaUtil_GetTime() - throttleStart );
+    }
+    PaUnixMutex_Unlock( &self->mtx );
+
+    return NULL;
+}
+#endif
+
+PaError PaUnixThread_StartWatchdog( PaUnixThread* self, struct PaUtilStreamRepresentation *stream )
+{
+    PaError result = paNoError;
+#ifdef PA_UNIX_WATCHDOG_
+    PaThreadConfiguration config;
+    struct sched_param spm = { 0 };
+    int policy, condInitialized = 0;
+
+    assert( !self->watchdogRunning );
+
+    /* Only real-time threads can starve the system, SCHED_DEADLINE threads are throttled by the kernel */
+    if( pthread_getschedparam( self->thread, &policy, &spm ) != 0 || (policy != SCHED_FIFO && policy != SCHED_RR) )
+    {
+        PA_DEBUG(( "%s: Audio thread is not real-time, not starting watchdog\n", __FUNCTION__ ));
+        return result;
+    }
+
+    PA_ENSURE_SYSTEM( pthread_getcpuclockid( self->thread, &self->watchdogClock ), 0 );
+    PA_ENSURE( PaUnixCondition_Initialize( &self->watchdogCond ) );
+    condInitialized = 1;
+    self->watchdogStream = stream;
+    self->watchdogStopRequested = 0;
+
+    /* The watchdog must be able to preempt the thread it monitors */
+    memset( &config, 0, sizeof (config) );
+    config.structVersion = 1;
+    config.policy = paThreadPolicyFifo;
+    config.priority = spm.sched_priority + 1;
+    PA_ENSURE( PaUnixThread_Create( &self->watchdogThread, &WatchdogFunc, self, NULL, NULL ) );
+    self->watchdogRunning = 1;
+    PA_ENSURE( PaUnixThread_Configure( self->watchdogThread, &config, NULL ) );
+
+end:
+    return result;
+error:
+    if( self->watchdogRunning )
+        PaUnixThread_StopWatchdog( self );
+    else if( condInitialized )
+        pthread_cond_destroy( &self->watchdogCond );
+    goto end;
+#else
+    (void) self;
+    (void) stream;
+    PA_DEBUG(( "%s: Thread CPU time clocks are not supported on this platform\n", __FUNCTION__ ));
+    return result;
+#endif
+}
+
+PaError PaUnixThread_StopWatchdog( PaUnixThread* self )
+{
+    PaError result = paNoError;
+
+    if( !self->watchdogRunning )
+        return result;
+
+    PA_ENSURE( PaUnixMutex_Lock( &self->mtx ) );
+    self->watchdogStopRequested = 1;
+    pthread_cond_signal( &self->watchdogCond );
+    PA_ENSURE( PaUnixMutex_Unlock( &self->mtx ) );
+
+    PA_ENSURE_SYSTEM( pthread_join( self->watchdogThread, NULL ), 0 );
+    pthread_cond_destroy( &self->watchdogCond );
+    self->watchdogRunning = 0;
+
+error:
+    return result;
+}
+
+PaError PaUnixThread_ReserveStackLock( void )
+{
+    PaError result = paNoError;
+
+#if defined _POSIX_MEMLOCK_RANGE && (_POSIX_MEMLOCK_RANGE != -1)
+    pthread_mutex_lock( &lockedBlocksMutex_ );
+    result = GrowLockedBlocks();
+    if( result == paNoError )
+        ++reservedBlockCount_;
+    pthread_mutex_unlock( &lockedBlocksMutex_ );
+#endif
+    return result;
+}
+
+void PaUnixThread_ReleaseStackLock( void )
+{
+#if defined _POSIX_MEMLOCK_RANGE && (_POSIX_MEMLOCK_RANGE != -1)
+    pthread_mutex_lock( &lockedBlocksMutex_ );
+    assert( reservedBlockCount_ > reservedBlocksInUse_ );
+    --reservedBlockCount_;
+    FreeLockedBlocksIfUnused();
+    pthread_mutex_unlock( &lockedBlocksMutex_ );
+#endif
+}
+
+PaError PaUnixThread_LockStack( void **stack )
+{
+    /* The pages stay mapped (and locked) after this frame is popped, ready for the caller's deeper frames */
+    unsigned char frame[PA_UNIX_LOCKED_STACK_SIZE];
+    PaError result = LockMemory( frame, sizeof (frame), 1 );
+
+    *stack = result == paNoError ? frame : NULL;
+    return result;
+}
+
+void PaUnixThread_UnlockStack( void *stack )
+{
+    PaUtil_UnlockMemory( stack, PA_UNIX_LOCKED_STACK_SIZE );
+}
+
 PaError PaUnixMutex_Initialize( PaUnixMutex* self )
 {
     PaError result = paNoError;
@@ -504,6 +1295,43 @@ PaError PaUnixMutex_Initialize( PaUnixMutex* self )
     return result;
 }
 
+PaError PaUnixCondition_Initialize( pthread_cond_t *cond )
+{
+    PaError result = paNoError;
+#ifdef PA_UNIX_CONDITION_CLOCK_
+    pthread_condattr_t attr;
+
+    PA_ASSERT_CALL( pthread_condattr_init( &attr ), 0 );
+    PA_ASSERT_CALL( pthread_condattr_setclock( &attr, PA_UNIX_CONDITION_CLOCK_ ), 0 );
+    PA_ASSERT_CALL( pthread_cond_init( cond, &attr ), 0 );
+    pthread_condattr_destroy( &attr );
+#else
+    PA_ASSERT_CALL( pthread_cond_init( cond, NULL ), 0 );
+#endif
+    return result;
+}
+
+void PaUnixCondition_GetDeadline( PaTime timeout, struct timespec *deadline )
+{
+    long seconds = (long)timeout;
+#ifdef PA_UNIX_CONDITION_CLOCK_
+    clock_gettime( PA_UNIX_CONDITION_CLOCK_, deadline );
+#else
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    deadline->tv_sec = tv.tv_sec;
+    deadline->tv_nsec = tv.tv_usec * 1000;
+#endif
+
+    deadline->tv_sec += seconds;
+    deadline->tv_nsec += (long)((timeout - seconds) * 1e9);
+    if( deadline->tv_nsec >= 1000000000 )
+    {
+        deadline->tv_sec += 1;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
 PaError PaUnixMutex_Terminate( PaUnixMutex* self )
 {
     PaError result = paNoError;
@@ -548,163 +1376,3 @@ error:
     return result;
 }
 
-
-#if 0
-static void OnWatchdogExit( void *userData )
-{
-    PaAlsaThreading *th = (PaAlsaThreading *) userData;
-    struct sched_param spm = { 0 };
-    assert( th );
-
-    PA_ASSERT_CALL( pthread_setschedparam( th->callbackThread, SCHED_OTHER, &spm ), 0 );    /* Lower before exiting */
-    PA_DEBUG(( "Watchdog exiting\n" ));
-}
-
-static void *WatchdogFunc( void *userData )
-{
-    PaError result = paNoError, *pres = NULL;
-    int err;
-    PaAlsaThreading *th = (PaAlsaThreading *) userData;
-    unsigned intervalMsec = 500;
-    const PaTime maxSeconds = 3.;   /* Max seconds between callbacks */
-    PaTime timeThen = PaUtil_GetTime(), timeNow, timeElapsed, cpuTimeThen, cpuTimeNow, cpuTimeElapsed;
-    double cpuLoad, avgCpuLoad = 0.;
-    int throttled = 0;
-
-    assert( th );
-
-    /* Execute OnWatchdogExit when exiting */
-    pthread_cleanup_push( &OnWatchdogExit, th );
-
-    /* Boost priority of callback thread */
-    PA_ENSURE( result = BoostPriority( th ) );
-    if( !result )
-    {
-        /* Boost failed, might as well exit */
-        pthread_exit( NULL );
-    }
-
-    cpuTimeThen = th->callbackCpuTime;
-    {
-        int policy;
-        struct sched_param spm = { 0 };
-        pthread_getschedparam( pthread_self(), &policy, &spm );
-        PA_DEBUG(( "%s: Watchdog priority is %d\n", __FUNCTION__, spm.sched_priority ));
-    }
-
-    while( 1 )
-    {
-        double lowpassCoeff = 0.9, lowpassCoeff1 = 0.99999 - lowpassCoeff;
-        
-        /* Test before and after in case whatever underlying sleep call isn't interrupted by pthread_cancel */
-        pthread_testcancel();
-        Pa_Sleep( intervalMsec );
-        pthread_testcancel();
-
-        if( PaUtil_GetTime() - th->callbackTime > maxSeconds )
-        {
-            PA_DEBUG(( "Watchdog: Terminating callback thread\n" ));
-            /* Tell thread to terminate */
-            err = pthread_kill( th->callbackThread, SIGKILL );
-            pthread_exit( NULL );
-        }
-
-        PA_DEBUG(( "%s: PortAudio reports CPU load: %g\n", __FUNCTION__, PaUtil_GetCpuLoad( th->cpuLoadMeasurer ) ));
-
-        /* Check if we should throttle, or unthrottle :P */
-        cpuTimeNow = th->callbackCpuTime;
-        cpuTimeElapsed = cpuTimeNow - cpuTimeThen;
-        cpuTimeThen = cpuTimeNow;
-
-        timeNow = PaUtil_GetTime();
-        timeElapsed = timeNow - timeThen;
-        timeThen = timeNow;
-        cpuLoad = cpuTimeElapsed / timeElapsed;
-        avgCpuLoad = avgCpuLoad * lowpassCoeff + cpuLoad * lowpassCoeff1;
-        /*
-        if( throttled )
-            PA_DEBUG(( "Watchdog: CPU load: %g, %g\n", avgCpuLoad, cpuTimeElapsed ));
-            */
-        if( PaUtil_GetCpuLoad( th->cpuLoadMeasurer ) > .925 )
-        {
-            static int policy;
-            static struct sched_param spm = { 0 };
-            static const struct sched_param defaultSpm = { 0 };
-            PA_DEBUG(( "%s: Throttling audio thread, priority %d\n", __FUNCTION__, spm.sched_priority ));
-
-            pthread_getschedparam( th->callbackThread, &policy, &spm );
-            if( !pthread_setschedparam( th->callbackThread, SCHED_OTHER, &defaultSpm ) )
-            {
-                throttled = 1;
-            }
-            else
-                PA_DEBUG(( "Watchdog: Couldn't lower priority of audio thread: %s\n", strerror( errno ) ));
-
-            /* Give other processes a go, before raising priority again */
-            PA_DEBUG(( "%s: Watchdog sleeping for %lu msecs before unthrottling\n", __FUNCTION__, th->throttledSleepTime ));
-            Pa_Sleep( th->throttledSleepTime );
-
-            /* Reset callback priority */
-            if( pthread_setschedparam( th->callbackThread, SCHED_FIFO, &spm ) != 0 )
-            {
-                PA_DEBUG(( "%s: Couldn't raise priority of audio thread: %s\n", __FUNCTION__, strerror( errno ) ));
-            }
-
-            if( PaUtil_GetCpuLoad( th->cpuLoadMeasurer ) >= .99 )
-                intervalMsec = 50;
-            else
-                intervalMsec = 100;
-
-            /*
-            lowpassCoeff = .97;
-            lowpassCoeff1 = .99999 - lowpassCoeff;
-            */
-        }
-        else if( throttled && avgCpuLoad < .8 )
-        {
-            intervalMsec = 500;
-            throttled = 0;
-
-            /*
-            lowpassCoeff = .9;
-            lowpassCoeff1 = .99999 - lowpassCoeff;
-            */
-        }
-    }
-
-    pthread_cleanup_pop( 1 );   /* Execute cleanup on exit */
-
-error:
-    /* Shouldn't get here in the normal case */
-
-    /* Pass on error code */
-    pres = malloc( sizeof (PaError) );
-    *pres = result;
-    
-    pthread_exit( pres );
-}
-
-static void CallbackUpdate( PaAlsaThreading *th )
-{
-    th->callbackTime = PaUtil_GetTime();
-    th->callbackCpuTime = PaUtil_GetCpuLoad( th->cpuLoadMeasurer );
-}
-
-/*
-static void *CanaryFunc( void *userData )
-{
-    const unsigned intervalMsec = 1000;
-    PaUtilThreading *th = (PaUtilThreading *) userData;
-
-    while( 1 )
-    {
-        th->canaryTime = PaUtil_GetTime();
-
-        pthread_testcancel();
-        Pa_Sleep( intervalMsec );
-    }
-
-    pthread_exit( NULL );
-}
-*/
-#endif
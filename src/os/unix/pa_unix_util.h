@@ -48,6 +48,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <signal.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -77,7 +78,14 @@ extern "C"
         } \
     } while (0);
 
-static PaError paUtilErr_;          /* Used with PA_ENSURE */
+/* Not every file including this header uses PA_ENSURE, keep its error variable from warning there */
+#if defined __GNUC__ && __GNUC__ >= 3
+#define PA_UNUSED_VARIABLE __attribute__((unused))
+#else
+#define PA_UNUSED_VARIABLE
+#endif
+
+static PaError paUtilErr_ PA_UNUSED_VARIABLE;          /* Used with PA_ENSURE */
 
 /* Check PaError */
 #define PA_ENSURE(expr) \
@@ -144,6 +152,18 @@ PaError PaUnixMutex_Terminate( PaUnixMutex* self );
 PaError PaUnixMutex_Lock( PaUnixMutex* self );
 PaError PaUnixMutex_Unlock( PaUnixMutex* self );
 
+/** Initialize a condition variable for timed waits with deadlines from
+ PaUnixCondition_GetDeadline(). Where pthreads allows it the condition uses a
+ monotonic clock, so changes to the system time do not affect timeouts.
+ */
+PaError PaUnixCondition_Initialize( pthread_cond_t *cond );
+
+/** Compute the absolute deadline, timeout seconds from now, for
+ pthread_cond_timedwait() on a condition initialized with
+ PaUnixCondition_Initialize().
+ */
+void PaUnixCondition_GetDeadline( PaTime timeout, struct timespec *deadline );
+
 typedef struct
 {
     pthread_t thread;
@@ -153,6 +173,15 @@ typedef struct
     PaUnixMutex mtx;
     pthread_cond_t cond;
     volatile sig_atomic_t stopRequest;
+    PaThreadConfiguration configuration; /**< the configuration applied by PaUnixThread_New */
+
+    /* watchdog state, see PaUnixThread_StartWatchdog */
+    int watchdogRunning;
+    int watchdogStopRequested;
+    pthread_t watchdogThread;
+    pthread_cond_t watchdogCond;
+    clockid_t watchdogClock;
+    struct PaUtilStreamRepresentation *watchdogStream;
 } PaUnixThread;
 
 /** Initialize global threading state.
@@ -187,11 +216,44 @@ PaError PaUnixThreading_Initialize();
  * @param threadFunc: The function to be executed in the child thread.
  * @param waitForChild: If not 0, wait for child thread to call PaUnixThread_NotifyParent. Less than 0 means
  * wait for ever, greater than 0 wait for the specified time.
- * @param rtSched: Enable realtime scheduling?
+ * @param rtSched: Enable realtime scheduling? Ignored if config selects a scheduling policy.
+ * @param config: The stream's thread configuration, or NULL for the defaults. The configuration actually
+ * applied is stored in self->configuration.
  * @return: If timed out waiting on child, paTimedOut.
  */
 PaError PaUnixThread_New( PaUnixThread* self, void* (*threadFunc)( void* ), void* threadArg, PaTime waitForChild,
-        int rtSched );
+        int rtSched, const PaThreadConfiguration *config );
+
+/** Create a thread with the stack size from a thread configuration.
+ *
+ * For threads which are not managed with PaUnixThread, pass the thread to PaUnixThread_Configure afterwards.
+ * @param config: The configuration, or NULL for the default stack size.
+ * @param applied: If non-null, receives the stack size the thread was created with.
+ */
+PaError PaUnixThread_Create( pthread_t *thread, void* (*threadFunc)( void* ), void* threadArg,
+        const PaThreadConfiguration *config, PaThreadConfiguration *applied );
+
+/** Apply the scheduling policy, priority and CPU affinity of a thread configuration to a running thread.
+ *
+ * A lack of privilege is not an error, the thread simply keeps its current settings.
+ * @param applied: If non-null, receives the policy, priority and affinity the system reports for the
+ * thread afterwards.
+ */
+PaError PaUnixThread_Configure( pthread_t thread, const PaThreadConfiguration *config,
+        PaThreadConfiguration *applied );
+
+/** Switch the calling thread to SCHED_DEADLINE if config selects paThreadPolicyDeadline.
+ *
+ * PaUnixThread_Configure leaves the policy and affinity of such threads alone, the thread must call this
+ * itself before it starts processing. If the kernel refuses, the thread falls back to SCHED_FIFO with the
+ * configured priority and CPU affinity.
+ * @param config: The stream's thread configuration, may be NULL.
+ * @param period: The host buffer period in seconds, used as the deadline and period.
+ * @param applied: If non-null and config selects paThreadPolicyDeadline, receives the policy, priority and
+ * affinity applied. Written before the thread notifies its parent that it has started.
+ */
+PaError PaUnixThread_ConfigureDeadline( const PaThreadConfiguration *config, PaTime period,
+        PaThreadConfiguration *applied );
 
 /** Terminate thread.
  *
@@ -200,6 +262,19 @@ PaError PaUnixThread_New( PaUnixThread* self, void* (*threadFunc)( void* ), void
  */
 PaError PaUnixThread_Terminate( PaUnixThread* self, int wait, PaError* exitResult );
 
+/** Start a watchdog which demotes the thread to normal scheduling while it uses nearly a whole CPU.
+ *
+ * The watchdog only runs for threads with a real-time policy. It monitors the thread's CPU time, and
+ * records how often and for how long the thread was throttled with PaUtil_RecordStreamThrottle. It is
+ * stopped by PaUnixThread_Terminate.
+ * @param stream: The stream whose statistics receive the throttling counts.
+ */
+PaError PaUnixThread_StartWatchdog( PaUnixThread* self, struct PaUtilStreamRepresentation *stream );
+
+/** Stop the watchdog, restoring the thread's priority if it is throttled. Does nothing if it isn't running.
+ */
+PaError PaUnixThread_StopWatchdog( PaUnixThread* self );
+
 /** Prepare to notify waiting parent thread.
  *
  * An internal lock must be held before the parent is notified in PaUnixThread_NotifyParent, call this to
@@ -218,6 +293,36 @@ PaError PaUnixThread_NotifyParent( PaUnixThread* self );
  */
 int PaUnixThread_StopRequested( PaUnixThread* self );
 
+/** Number of bytes of stack a callback thread prefaults and locks for the paLockMemory stream flag. */
+#define PA_UNIX_LOCKED_STACK_SIZE (64 * 1024)
+
+/** Make room to record a locked stack, so that PaUnixThread_LockStack doesn't allocate on the thread.
+ *
+ * Call it before creating a thread that locks its stack, and PaUnixThread_ReleaseStackLock once the thread
+ * has unlocked its stack. One reservation covers one locked stack at a time.
+ * @return: paInsufficientMemory if the room could not be allocated.
+ */
+PaError PaUnixThread_ReserveStackLock( void );
+
+/** Give back a reservation made by PaUnixThread_ReserveStackLock.
+ */
+void PaUnixThread_ReleaseStackLock( void );
+
+/** Prefault and lock the calling thread's stack.
+ *
+ * Must be called from the thread itself, near the top of its thread function, so that
+ * PA_UNIX_LOCKED_STACK_SIZE bytes of stack below the current frame are backed by locked physical memory
+ * before real-time work starts. With a reservation from PaUnixThread_ReserveStackLock nothing is allocated.
+ * @param stack: Receives the locked block, or NULL if locking failed. Pass it to PaUnixThread_UnlockStack
+ * before the thread exits.
+ * @return: The result of PaUtil_LockMemory.
+ */
+PaError PaUnixThread_LockStack( void **stack );
+
+/** Unlock a stack locked by PaUnixThread_LockStack. Harmless if stack is NULL.
+ */
+void PaUnixThread_UnlockStack( void *stack );
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
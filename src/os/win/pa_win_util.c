@@ -54,22 +54,28 @@
 
 
 /*
-   Track memory allocations to avoid leaks.
+   Allocations carry a PaUtilAllocationHeader so they can be accounted for
+   by category. See PaUtil_AccountAllocation() in pa_front.c.
  */
 
-#if PA_TRACK_MEMORY
-static int numAllocations_ = 0;
-#endif
+void *PaUtil_AllocateMemoryInCategory( long size, PaAllocationCategory category )
+{
+    PaUtilAllocationHeader *header = (PaUtilAllocationHeader*)GlobalAlloc( GPTR, size + sizeof(PaUtilAllocationHeader) );
+
+    if( header == NULL )
+        return NULL;
+
+    header->info.size = size;
+    header->info.category = category;
+    PaUtil_AccountAllocation( category, size );
+
+    return header + 1;
+}
 
 
 void *PaUtil_AllocateMemory( long size )
 {
-    void *result = GlobalAlloc( GPTR, size );
-
-#if PA_TRACK_MEMORY
-    if( result != NULL ) numAllocations_ += 1;
-#endif
-    return result;
+    return PaUtil_AllocateMemoryInCategory( size, paAllocationHostApi );
 }
 
 
@@ -77,21 +83,49 @@ void PaUtil_FreeMemory( void *block )
 {
     if( block != NULL )
     {
-        GlobalFree( block );
-#if PA_TRACK_MEMORY
-        numAllocations_ -= 1;
-#endif
+        PaUtilAllocationHeader *header = ((PaUtilAllocationHeader*)block) - 1;
 
+        PaUtil_AccountFree( header->info.category, header->info.size );
+        GlobalFree( header );
     }
 }
 
 
-int PaUtil_CountCurrentlyAllocatedBlocks( void )
+PaError PaUtil_LockMemory( void *block, long size )
 {
-#if PA_TRACK_MEMORY
-    return numAllocations_;
+    volatile unsigned char *p = (volatile unsigned char *)block;
+    SYSTEM_INFO systemInfo;
+    long i;
+
+    if( block == NULL || size <= 0 )
+        return paNoError;
+
+    GetSystemInfo( &systemInfo );
+
+    /* Write to each page so that it is committed to physical memory */
+    for( i = 0; i < size; i += (long)systemInfo.dwPageSize )
+        p[i] = p[i];
+    p[size - 1] = p[size - 1];
+
+#ifndef _WIN32_WCE
+    /* VirtualLock fails once the working set minimum is exhausted */
+    if( !VirtualLock( block, (SIZE_T)size ) )
+        return paInsufficientMemory;
+    return paNoError;
 #else
-    return 0;
+    return paInsufficientMemory;
+#endif
+}
+
+
+void PaUtil_UnlockMemory( void *block, long size )
+{
+#ifndef _WIN32_WCE
+    if( block != NULL && size > 0 )
+        VirtualUnlock( block, (SIZE_T)size );
+#else
+    (void)block;
+    (void)size;
 #endif
 }
 
@@ -151,3 +185,95 @@ double PaUtil_GetTime( void )
 #endif                
     }
 }
+
+
+double PaUtil_GetMeasurementTime( void )
+{
+    /* QueryPerformanceCounter already reads the TSC where it is reliable */
+    return PaUtil_GetTime();
+}
+
+
+struct PaUtilNotifier
+{
+    HANDLE thread;
+    HANDLE semaphore;
+    volatile int quit;
+    void (*function)( void *userData );
+    void *userData;
+};
+
+static DWORD WINAPI NotifierThreadFunc( LPVOID data )
+{
+    PaUtilNotifier *notifier = (PaUtilNotifier*)data;
+
+    while( WaitForSingleObject( notifier->semaphore, INFINITE ) == WAIT_OBJECT_0 && !notifier->quit )
+        notifier->function( notifier->userData );
+
+    return 0;
+}
+
+PaError PaUtil_CreateNotifier( PaUtilNotifier **notifier,
+        void (*function)( void *userData ), void *userData )
+{
+    PaUtilNotifier *self = (PaUtilNotifier*)PaUtil_AllocateMemory( sizeof(PaUtilNotifier) );
+
+    if( !self )
+        return paInsufficientMemory;
+
+    self->quit = 0;
+    self->function = function;
+    self->userData = userData;
+
+    self->semaphore = CreateSemaphore( NULL, 0, MAXLONG, NULL );
+    if( self->semaphore == NULL )
+    {
+        PaUtil_FreeMemory( self );
+        return paUnanticipatedHostError;
+    }
+
+    self->thread = CreateThread( NULL, 0, NotifierThreadFunc, self, 0, NULL );
+    if( self->thread == NULL )
+    {
+        CloseHandle( self->semaphore );
+        PaUtil_FreeMemory( self );
+        return paUnanticipatedHostError;
+    }
+
+    *notifier = self;
+    return paNoError;
+}
+
+void PaUtil_SignalNotifier( PaUtilNotifier *notifier )
+{
+    ReleaseSemaphore( notifier->semaphore, 1, NULL );
+}
+
+void PaUtil_DestroyNotifier( PaUtilNotifier *notifier )
+{
+    notifier->quit = 1;
+    PaUtil_SignalNotifier( notifier );
+    WaitForSingleObject( notifier->thread, INFINITE );
+
+    CloseHandle( notifier->thread );
+    CloseHandle( notifier->semaphore );
+    PaUtil_FreeMemory( notifier );
+}
+
+
+double PaUtil_GetThreadCpuTime( void )
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    ULARGE_INTEGER kernel, user;
+
+    if( !GetThreadTimes( GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+        return -1.;
+
+    /* FILETIMEs are in 100ns units */
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    return (double)(kernel.QuadPart + user.QuadPart) * 1e-7;
+}